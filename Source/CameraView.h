@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+// CameraView.h
+// ============
+// camera data computed by the view manager for the current frame
+//
+//  The view manager fills this in when it prepares the scene view, and
+//  the scene uses it for view dependent work such as light clustering.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  CAMERA_VIEW
+ *
+ *  The view and projection of the current frame along with
+ *  the values they were built from.
+ ***********************************************************/
+struct CAMERA_VIEW
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec3 position;
+	float nearPlane;
+	float farPlane;
+	bool bOrthographic;
+	int viewportWidth;
+	int viewportHeight;
+};
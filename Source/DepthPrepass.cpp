@@ -0,0 +1,346 @@
+///////////////////////////////////////////////////////////////////////////////
+// DepthPrepass.cpp
+// ============
+// lay down the scene depth first so each pixel is shaded only once
+//
+//  The visible scene geometry is drawn with the scene vertex shader
+//  and an empty fragment shader, writing depth but no color.  The shading pass that
+//  follows tests for equal depth with depth writes off, so only the
+//  nearest fragment of each pixel runs the lighting shader.  An
+//  overdraw view replaces the lighting shader with one that adds a
+//  constant to the color of every fragment it shades, so pixels shaded
+//  many times show up bright.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DepthPrepass.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// declaration of the pass shaders
+namespace
+{
+	const char* g_DepthFragmentShader =
+		"#version 330 core\n"
+		"void main()\n"
+		"{\n"
+		"}\n";
+	// ten shaded fragments make a pixel white
+	const char* g_OverdrawFragmentShader =
+		"#version 330 core\n"
+		"out vec4 fragmentColor;\n"
+		"void main()\n"
+		"{\n"
+		"   fragmentColor = vec4(0.1, 0.1, 0.1, 1.0);\n"
+		"}\n";
+}
+
+/***********************************************************
+ *  DepthPrepass()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DepthPrepass::DepthPrepass()
+{
+	m_depthProgram.id = 0;
+	m_overdrawProgram.id = 0;
+	m_pActiveProgram = NULL;
+	m_sceneProgram = 0;
+}
+
+/***********************************************************
+ *  ~DepthPrepass()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DepthPrepass::~DepthPrepass()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  CompileShader()
+ *
+ *  This method is used for compiling one stage of a pass
+ *  shader.  Compile errors are printed and zero is returned.
+ ***********************************************************/
+GLuint DepthPrepass::CompileShader(GLenum stage, const char* source)
+{
+	GLuint shader = glCreateShader(stage);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char infoLog[512];
+		glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Depth pass shader failed to compile:" << infoLog << std::endl;
+		glDeleteShader(shader);
+		return(0);
+	}
+
+	return(shader);
+}
+
+/***********************************************************
+ *  CreateProgram()
+ *
+ *  This method is used for linking the vertex shader with a
+ *  fragment shader and finding its uniforms.
+ ***********************************************************/
+bool DepthPrepass::CreateProgram(const char* vertexSource, const char* fragmentSource, PASS_PROGRAM& program)
+{
+	program.id = 0;
+
+	GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentSource);
+	if ((vertexShader == 0) || (fragmentShader == 0))
+	{
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return(false);
+	}
+
+	GLuint programID = glCreateProgram();
+	glAttachShader(programID, vertexShader);
+	glAttachShader(programID, fragmentShader);
+	glLinkProgram(programID);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(programID, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		std::cout << "Depth pass shader failed to link" << std::endl;
+		glDeleteProgram(programID);
+		return(false);
+	}
+
+	program.id = programID;
+	program.modelLocation = glGetUniformLocation(programID, "model");
+	program.viewLocation = glGetUniformLocation(programID, "view");
+	program.projectionLocation = glGetUniformLocation(programID, "projection");
+	program.instancedLocation = glGetUniformLocation(programID, "bUseInstancing");
+	program.packedLocation = glGetUniformLocation(programID, "bPackedVertices");
+
+	return(true);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the depth only and the
+ *  overdraw shaders.  Both use the vertex shader file of the
+ *  scene program, so the depth pass runs the very same
+ *  position code, and its invariant gl_Position gives the
+ *  same depth as the shading pass for the equal test.
+ ***********************************************************/
+bool DepthPrepass::Create(const char* vertexShaderPath)
+{
+	Destroy();
+
+	std::ifstream file(vertexShaderPath);
+	if (!file)
+	{
+		std::cout << "Could not open the vertex shader:" << vertexShaderPath << std::endl;
+		return(false);
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	std::string vertexSource = text.str();
+
+	if ((CreateProgram(vertexSource.c_str(), g_DepthFragmentShader, m_depthProgram) == false) ||
+		(CreateProgram(vertexSource.c_str(), g_OverdrawFragmentShader, m_overdrawProgram) == false))
+	{
+		Destroy();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the shaders.
+ ***********************************************************/
+void DepthPrepass::Destroy()
+{
+	if (m_depthProgram.id != 0)
+	{
+		glDeleteProgram(m_depthProgram.id);
+		m_depthProgram.id = 0;
+	}
+	if (m_overdrawProgram.id != 0)
+	{
+		glDeleteProgram(m_overdrawProgram.id);
+		m_overdrawProgram.id = 0;
+	}
+	m_pActiveProgram = NULL;
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for switching to a pass program.  The
+ *  scene program is remembered so it can be restored.
+ ***********************************************************/
+void DepthPrepass::UseProgram(const PASS_PROGRAM& program, const glm::mat4& view, const glm::mat4& projection)
+{
+	glGetIntegerv(GL_CURRENT_PROGRAM, &m_sceneProgram);
+	glUseProgram(program.id);
+	glUniformMatrix4fv(program.viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(program.projectionLocation, 1, GL_FALSE, glm::value_ptr(projection));
+	glUniform1i(program.instancedLocation, 0);
+	glUniform1i(program.packedLocation, 0);
+	m_pActiveProgram = &program;
+}
+
+/***********************************************************
+ *  RestoreSceneProgram()
+ *
+ *  This method is used for going back to the scene program.
+ ***********************************************************/
+void DepthPrepass::RestoreSceneProgram()
+{
+	glUseProgram((GLuint)m_sceneProgram);
+	m_pActiveProgram = NULL;
+}
+
+/***********************************************************
+ *  BeginDepthPass()
+ *
+ *  This method is used for starting the depth only pass.
+ *  Color writes are turned off, so the empty fragment shader
+ *  only leaves depth behind.
+ ***********************************************************/
+void DepthPrepass::BeginDepthPass(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (m_depthProgram.id == 0)
+	{
+		return;
+	}
+
+	UseProgram(m_depthProgram, view, projection);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
+
+/***********************************************************
+ *  EndDepthPass()
+ *
+ *  This method is used for ending the depth only pass.  The
+ *  depth buffer now holds the nearest surface of every
+ *  pixel, so the shading pass tests for equal depth and
+ *  leaves the depth as it is.
+ ***********************************************************/
+void DepthPrepass::EndDepthPass()
+{
+	if (m_depthProgram.id == 0)
+	{
+		return;
+	}
+
+	RestoreSceneProgram();
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_EQUAL);
+}
+
+/***********************************************************
+ *  EndShadingPass()
+ *
+ *  This method is used for restoring the default depth test
+ *  after the shading pass.
+ ***********************************************************/
+void DepthPrepass::EndShadingPass()
+{
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+}
+
+/***********************************************************
+ *  BeginOverdrawPass()
+ *
+ *  This method is used for drawing the shading pass with the
+ *  overdraw shader.  The depth test is left as the shading
+ *  pass would use it, and every fragment that passes adds
+ *  its constant to the color, so the image shows how many
+ *  times each pixel would be shaded.
+ ***********************************************************/
+void DepthPrepass::BeginOverdrawPass(const glm::mat4& view, const glm::mat4& projection)
+{
+	if (m_overdrawProgram.id == 0)
+	{
+		return;
+	}
+
+	UseProgram(m_overdrawProgram, view, projection);
+	glBlendFunc(GL_ONE, GL_ONE);
+}
+
+/***********************************************************
+ *  EndOverdrawPass()
+ *
+ *  This method is used for going back to the scene shader
+ *  and its alpha blending.
+ ***********************************************************/
+void DepthPrepass::EndOverdrawPass()
+{
+	if (m_overdrawProgram.id == 0)
+	{
+		return;
+	}
+
+	RestoreSceneProgram();
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+/***********************************************************
+ *  SetModel()
+ *
+ *  This method is used for setting the model matrix of the
+ *  next draw of the current pass.
+ ***********************************************************/
+void DepthPrepass::SetModel(const glm::mat4& model)
+{
+	if (NULL != m_pActiveProgram)
+	{
+		glUniformMatrix4fv(m_pActiveProgram->modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+	}
+}
+
+/***********************************************************
+ *  SetInstanced()
+ *
+ *  This method is used for taking the model matrix from the
+ *  per-instance attributes for the next draws.
+ ***********************************************************/
+void DepthPrepass::SetInstanced(bool bInstanced)
+{
+	if (NULL != m_pActiveProgram)
+	{
+		glUniform1i(m_pActiveProgram->instancedLocation, (bInstanced == true) ? 1 : 0);
+	}
+}
+
+/***********************************************************
+ *  SetPackedVertices()
+ *
+ *  This method is used for reading the positions of the
+ *  next draws as packed SNORM16 values.
+ ***********************************************************/
+void DepthPrepass::SetPackedVertices(bool bPacked)
+{
+	if (NULL != m_pActiveProgram)
+	{
+		glUniform1i(m_pActiveProgram->packedLocation, (bPacked == true) ? 1 : 0);
+	}
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// DepthPrepass.h
+// ============
+// lay down the scene depth first so each pixel is shaded only once
+//
+//  The visible scene geometry is drawn with a shader that only places
+//  the vertices, writing depth but no color.  The shading pass that
+//  follows tests for equal depth with depth writes off, so only the
+//  nearest fragment of each pixel runs the lighting shader.  An
+//  overdraw view replaces the lighting shader with one that adds a
+//  constant to the color of every fragment it shades, so pixels shaded
+//  many times show up bright.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  DepthPrepass
+ *
+ *  This class contains the depth only and overdraw shaders
+ *  and the depth test changes around the passes.
+ ***********************************************************/
+class DepthPrepass
+{
+public:
+	// constructor
+	DepthPrepass();
+	// destructor
+	~DepthPrepass();
+
+	// compile the depth only and overdraw shaders with the
+	// vertex shader file of the scene program
+	bool Create(const char* vertexShaderPath);
+	// free the shaders
+	void Destroy();
+	bool IsCreated() const { return(m_depthProgram.id != 0); }
+
+	// start drawing depth only with the camera matrices
+	void BeginDepthPass(const glm::mat4& view, const glm::mat4& projection);
+	// end the depth pass - the shading pass that follows only
+	// draws the fragments that match the depth already drawn
+	void EndDepthPass();
+	// restore the depth test after the shading pass
+	void EndShadingPass();
+
+	// start drawing the shading pass with the overdraw shader
+	void BeginOverdrawPass(const glm::mat4& view, const glm::mat4& projection);
+	// go back to the scene shader and blending
+	void EndOverdrawPass();
+
+	// set the model matrix of the next draw of the current pass
+	void SetModel(const glm::mat4& model);
+	// take the model matrix from the instance attributes instead
+	void SetInstanced(bool bInstanced);
+	// read the positions of the next draws as packed vertices
+	void SetPackedVertices(bool bPacked);
+
+private:
+	// a linked program and its uniform locations
+	struct PASS_PROGRAM
+	{
+		GLuint id;
+		GLint modelLocation;
+		GLint viewLocation;
+		GLint projectionLocation;
+		GLint instancedLocation;
+		GLint packedLocation;
+	};
+
+	PASS_PROGRAM m_depthProgram;
+	PASS_PROGRAM m_overdrawProgram;
+	// program of the current pass, or NULL between passes
+	const PASS_PROGRAM* m_pActiveProgram;
+	// scene program restored at the end of a pass
+	GLint m_sceneProgram;
+
+	// compile and link the vertex shader with a fragment shader
+	static bool CreateProgram(const char* vertexSource, const char* fragmentSource, PASS_PROGRAM& program);
+	// compile one stage of a shader
+	static GLuint CompileShader(GLenum stage, const char* source);
+	// switch to a pass program and send it the camera matrices
+	void UseProgram(const PASS_PROGRAM& program, const glm::mat4& view, const glm::mat4& projection);
+	// go back to the scene program
+	void RestoreSceneProgram();
+};
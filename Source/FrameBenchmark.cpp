@@ -0,0 +1,413 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameBenchmark.cpp
+// ============
+// render a fixed number of frames offscreen and record their timings
+//
+//  The scene is drawn into a framebuffer object while the camera follows
+//  a scripted path, so every run renders the same frames.  The CPU time
+//  and the GPU time of each frame are written out as JSON to serve as
+//  the baseline for rendering changes.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrameBenchmark.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+// declaration of the camera path and the JSON helpers
+namespace
+{
+	// the camera orbits the cake, swinging from one side to the other
+	const glm::vec3 g_PathTarget = glm::vec3(0.0f, 1.0f, 0.0f);
+	const float g_PathRadius = 12.0f;
+	const float g_PathHeight = 3.0f;
+	const float g_PathHeightSwing = 2.0f;
+	const float g_PathSweepDegrees = 120.0f;
+
+	const float g_Pi = 3.14159265f;
+
+	// quote a string for the JSON results, escaping the quotes,
+	// backslashes and control characters a driver string may hold
+	std::string EscapeJsonString(const char* text)
+	{
+		std::ostringstream escaped;
+		for (const char* pChar = text; *pChar != '\0'; pChar++)
+		{
+			unsigned char character = (unsigned char)*pChar;
+			if ((character == '"') || (character == '\\'))
+			{
+				escaped << '\\' << (char)character;
+			}
+			else if (character < 0x20)
+			{
+				escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)character << std::dec;
+			}
+			else
+			{
+				escaped << (char)character;
+			}
+		}
+
+		return(escaped.str());
+	}
+}
+
+/***********************************************************
+ *  FrameBenchmark()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrameBenchmark::FrameBenchmark(
+	ViewManager* pViewManager,
+	SceneManager* pSceneManager,
+	UniformCache* pUniformCache,
+	RenderStateCache* pStateCache)
+{
+	m_pViewManager = pViewManager;
+	m_pSceneManager = pSceneManager;
+	m_pUniformCache = pUniformCache;
+	m_pStateCache = pStateCache;
+	m_pProfiler = NULL;
+	m_frameScope = -1;
+	m_viewScope = -1;
+	m_renderScope = -1;
+	m_framebuffer = 0;
+	m_colorBuffer = 0;
+	m_depthBuffer = 0;
+	m_width = 0;
+	m_height = 0;
+}
+
+/***********************************************************
+ *  ~FrameBenchmark()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FrameBenchmark::~FrameBenchmark()
+{
+	DestroyFramebuffer();
+	m_pViewManager = NULL;
+	m_pSceneManager = NULL;
+	m_pUniformCache = NULL;
+	m_pStateCache = NULL;
+	m_pProfiler = NULL;
+}
+
+/***********************************************************
+ *  CreateFramebuffer()
+ *
+ *  This method is used for creating the framebuffer object
+ *  with the color and depth render buffers that the
+ *  benchmark frames are drawn into.
+ ***********************************************************/
+bool FrameBenchmark::CreateFramebuffer(int width, int height)
+{
+	DestroyFramebuffer();
+
+	m_width = width;
+	m_height = height;
+
+	glGenRenderbuffers(1, &m_colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glGenRenderbuffers(1, &m_depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "Could not create the benchmark framebuffer, status:" << status << std::endl;
+		DestroyFramebuffer();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  DestroyFramebuffer()
+ *
+ *  This method is used for freeing the offscreen render
+ *  target.
+ ***********************************************************/
+void FrameBenchmark::DestroyFramebuffer()
+{
+	if (m_framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &m_framebuffer);
+		m_framebuffer = 0;
+	}
+	if (m_colorBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_colorBuffer);
+		m_colorBuffer = 0;
+	}
+	if (m_depthBuffer != 0)
+	{
+		glDeleteRenderbuffers(1, &m_depthBuffer);
+		m_depthBuffer = 0;
+	}
+}
+
+/***********************************************************
+ *  SetProfiler()
+ *
+ *  This method is used for setting the profiler that
+ *  measures the scopes of the benchmark frames.
+ ***********************************************************/
+void FrameBenchmark::SetProfiler(Profiler* pProfiler)
+{
+	m_pProfiler = pProfiler;
+
+	if (NULL != m_pProfiler)
+	{
+		m_frameScope = m_pProfiler->RegisterScope("frame");
+		m_viewScope = m_pProfiler->RegisterScope("view setup");
+		m_renderScope = m_pProfiler->RegisterScope("render scene");
+	}
+}
+
+/***********************************************************
+ *  SetCameraPathPose()
+ *
+ *  This method is used for placing the camera on the
+ *  scripted path.  The path depends only on the frame
+ *  number, so every run sees the same frames.
+ ***********************************************************/
+void FrameBenchmark::SetCameraPathPose(int frame, int frameCount)
+{
+	float pathTime = (frameCount > 1) ? (float)frame / (float)(frameCount - 1) : 0.0f;
+	float angle = glm::radians(g_PathSweepDegrees) * (pathTime - 0.5f);
+
+	glm::vec3 position(
+		sinf(angle) * g_PathRadius,
+		g_PathHeight + g_PathHeightSwing * sinf(pathTime * g_Pi),
+		cosf(angle) * g_PathRadius);
+
+	m_pViewManager->SetCameraPose(position, g_PathTarget - position);
+}
+
+/***********************************************************
+ *  Run()
+ *
+ *  This method is used for rendering the benchmark frames.
+ *  The CPU time covers preparing and submitting a frame,
+ *  and the GPU time is measured with a time elapsed query
+ *  around the same work.  The query results are read after
+ *  the last frame so reading them never stalls a frame.
+ ***********************************************************/
+bool FrameBenchmark::Run(int frameCount)
+{
+	if ((m_framebuffer == 0) || (frameCount <= 0))
+	{
+		std::cout << "Could not run the benchmark, no framebuffer or frames" << std::endl;
+		return(false);
+	}
+
+	std::vector<GLuint> queries(frameCount);
+	glGenQueries(frameCount, queries.data());
+
+	m_timings.assign(frameCount, FRAME_TIMING());
+
+	// time the finished scene rather than the placeholder textures
+	m_pSceneManager->FinishTextureLoading();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+	glEnable(GL_DEPTH_TEST);
+
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		if (NULL != m_pProfiler)
+		{
+			m_pProfiler->BeginFrame();
+			m_pProfiler->BeginScope(m_frameScope);
+		}
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		m_pUniformCache->ResetCounters();
+		m_pStateCache->ResetCounters();
+
+		SetCameraPathPose(frame, frameCount);
+		if (NULL != m_pProfiler)
+			m_pProfiler->BeginScope(m_viewScope);
+		m_pViewManager->PrepareSceneView();
+		if (NULL != m_pProfiler)
+		{
+			m_pProfiler->EndScope();
+			m_pProfiler->BeginScope(m_renderScope);
+		}
+		m_pSceneManager->SetCameraView(m_pViewManager->GetCameraView());
+		m_pSceneManager->RenderScene();
+		if (NULL != m_pProfiler)
+			m_pProfiler->EndScope();
+
+		glEndQuery(GL_TIME_ELAPSED);
+		// hand the frame to the driver, as a buffer swap would
+		glFlush();
+		std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+
+		FRAME_TIMING& timing = m_timings[frame];
+		timing.frame = frame;
+		timing.cpuMilliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		timing.uniformCalls = m_pUniformCache->GetIssuedCalls();
+		timing.uniformCallsFiltered = m_pUniformCache->GetFilteredCalls();
+		timing.stateCalls = m_pStateCache->GetIssuedCalls();
+		timing.stateCallsFiltered = m_pStateCache->GetFilteredCalls();
+		timing.stateChangesSaved = m_pSceneManager->GetStateChangesSaved();
+		timing.visibleObjects = m_pSceneManager->GetVisibleObjectCount();
+		timing.culledObjects = m_pSceneManager->GetCulledObjectCount();
+		timing.occludedObjects = m_pSceneManager->GetOccludedObjectCount();
+		for (int mesh = 0; mesh < SceneManager::MESH_TYPE_COUNT; mesh++)
+		{
+			for (int level = 0; level < LodSelector::MAX_LEVELS; level++)
+			{
+				timing.lodObjects[mesh][level] = m_pSceneManager->GetLevelObjectCount(mesh, level);
+			}
+		}
+		timing.drawRecordTriangles = m_pSceneManager->GetDrawRecordTriangleCount();
+		timing.instancedTriangles = m_pSceneManager->GetInstancedTriangleCount();
+		const TextureResidency* pResidency = m_pSceneManager->GetTextureResidency();
+		timing.textureBytes = (long long)pResidency->GetResidentBytes();
+		timing.textureUploadsPending = pResidency->GetPendingUploads();
+		timing.textureEvictions = pResidency->GetEvictionCount();
+
+		if (NULL != m_pProfiler)
+		{
+			m_pProfiler->EndScope();
+			m_pProfiler->EndFrame();
+		}
+	}
+
+	glFinish();
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		GLuint64 elapsedNanoseconds = 0;
+		glGetQueryObjectui64v(queries[frame], GL_QUERY_RESULT, &elapsedNanoseconds);
+		m_timings[frame].gpuMilliseconds = (double)elapsedNanoseconds / 1.0e6;
+	}
+	glDeleteQueries(frameCount, queries.data());
+
+	return(true);
+}
+
+/***********************************************************
+ *  WriteResults()
+ *
+ *  This method is used for writing the timings of the last
+ *  run as JSON.  A summary with the mean, median and 95th
+ *  percentile of both times precedes the per-frame values.
+ ***********************************************************/
+bool FrameBenchmark::WriteResults(const std::string& filename) const
+{
+	std::ofstream file;
+	if (filename != "-")
+	{
+		file.open(filename.c_str());
+		if (!file.is_open())
+		{
+			std::cout << "Could not write the benchmark results:" << filename << std::endl;
+			return(false);
+		}
+	}
+	std::ostream& output = (filename != "-") ? (std::ostream&)file : std::cout;
+
+	// summary statistics of the CPU and GPU times
+	std::vector<double> cpuTimes;
+	std::vector<double> gpuTimes;
+	for (int i = 0; i < (int)m_timings.size(); i++)
+	{
+		cpuTimes.push_back(m_timings[i].cpuMilliseconds);
+		gpuTimes.push_back(m_timings[i].gpuMilliseconds);
+	}
+	std::vector<double>* series[2] = { &cpuTimes, &gpuTimes };
+	double mean[2] = { 0.0, 0.0 };
+	double median[2] = { 0.0, 0.0 };
+	double percentile95[2] = { 0.0, 0.0 };
+	for (int i = 0; i < 2; i++)
+	{
+		std::vector<double>& times = *series[i];
+		if (times.size() == 0)
+		{
+			continue;
+		}
+		std::sort(times.begin(), times.end());
+		for (int j = 0; j < (int)times.size(); j++)
+			mean[i] += times[j];
+		mean[i] /= (double)times.size();
+		median[i] = times[times.size() / 2];
+		percentile95[i] = times[std::min(times.size() - 1, (times.size() * 95) / 100)];
+	}
+
+	const GLubyte* renderer = glGetString(GL_RENDERER);
+
+	output << std::fixed << std::setprecision(4);
+	output << "{" << std::endl;
+	output << "  \"renderer\": \"" << EscapeJsonString((renderer != NULL) ? (const char*)renderer : "unknown") << "\"," << std::endl;
+	output << "  \"width\": " << m_width << "," << std::endl;
+	output << "  \"height\": " << m_height << "," << std::endl;
+	output << "  \"frameCount\": " << m_timings.size() << "," << std::endl;
+	output << "  \"summary\": {" << std::endl;
+	output << "    \"cpuMeanMs\": " << mean[0] << ", \"cpuMedianMs\": " << median[0] << ", \"cpuP95Ms\": " << percentile95[0] << "," << std::endl;
+	output << "    \"gpuMeanMs\": " << mean[1] << ", \"gpuMedianMs\": " << median[1] << ", \"gpuP95Ms\": " << percentile95[1] << std::endl;
+	output << "  }," << std::endl;
+	output << "  \"frames\": [" << std::endl;
+	for (int i = 0; i < (int)m_timings.size(); i++)
+	{
+		const FRAME_TIMING& timing = m_timings[i];
+		output << "    { \"frame\": " << timing.frame
+			<< ", \"cpuMs\": " << timing.cpuMilliseconds
+			<< ", \"gpuMs\": " << timing.gpuMilliseconds
+			<< ", \"uniformCalls\": " << timing.uniformCalls
+			<< ", \"uniformCallsFiltered\": " << timing.uniformCallsFiltered
+			<< ", \"stateCalls\": " << timing.stateCalls
+			<< ", \"stateCallsFiltered\": " << timing.stateCallsFiltered
+			<< ", \"stateChangesSaved\": " << timing.stateChangesSaved
+			<< ", \"visibleObjects\": " << timing.visibleObjects
+			<< ", \"culledObjects\": " << timing.culledObjects
+			<< ", \"occludedObjects\": " << timing.occludedObjects
+			<< ", \"lodObjects\": {";
+		for (int mesh = 0; mesh < SceneManager::MESH_TYPE_COUNT; mesh++)
+		{
+			output << ((mesh > 0) ? ", " : " ") << "\"" << m_pSceneManager->GetMeshName(mesh) << "\": [";
+			for (int level = 0; level < m_pSceneManager->GetMeshLevelCount(mesh); level++)
+			{
+				output << ((level > 0) ? ", " : "") << timing.lodObjects[mesh][level];
+			}
+			output << "]";
+		}
+		output << " }"
+			<< ", \"drawRecordTriangles\": " << timing.drawRecordTriangles
+			<< ", \"instancedTriangles\": " << timing.instancedTriangles
+			<< ", \"textureBytes\": " << timing.textureBytes
+			<< ", \"textureUploadsPending\": " << timing.textureUploadsPending
+			<< ", \"textureEvictions\": " << timing.textureEvictions
+			<< " }" << ((i + 1 < (int)m_timings.size()) ? "," : "") << std::endl;
+	}
+	output << "  ]" << std::endl;
+	output << "}" << std::endl;
+
+	return(true);
+}
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrameBenchmark.h
+// ============
+// render a fixed number of frames offscreen and record their timings
+//
+//  The scene is drawn into a framebuffer object while the camera follows
+//  a scripted path, so every run renders the same frames.  The CPU time
+//  and the GPU time of each frame are written out as JSON to serve as
+//  the baseline for rendering changes.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "ViewManager.h"
+#include "SceneManager.h"
+#include "UniformCache.h"
+#include "RenderStateCache.h"
+#include "Profiler.h"
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FRAME_TIMING
+ *
+ *  The measurements recorded for one benchmark frame.
+ ***********************************************************/
+struct FRAME_TIMING
+{
+	int frame;
+	double cpuMilliseconds;
+	double gpuMilliseconds;
+	int uniformCalls;
+	int uniformCallsFiltered;
+	int stateCalls;
+	int stateCallsFiltered;
+	int stateChangesSaved;
+	// scene objects inside and outside the camera frustum
+	int visibleObjects;
+	int culledObjects;
+	// scene objects skipped as hidden behind others
+	int occludedObjects;
+	// objects of each mesh type at each level of detail, and the
+	// triangles the draw records and instanced spheres submitted
+	int lodObjects[SceneManager::MESH_TYPE_COUNT][LodSelector::MAX_LEVELS];
+	long long drawRecordTriangles;
+	long long instancedTriangles;
+	// texture memory and streaming at the end of the frame
+	long long textureBytes;
+	int textureUploadsPending;
+	int textureEvictions;
+};
+
+/***********************************************************
+ *  FrameBenchmark
+ *
+ *  This class contains the code for the offscreen render
+ *  target, the scripted camera path and the timing of the
+ *  benchmark frames.
+ ***********************************************************/
+class FrameBenchmark
+{
+public:
+	// constructor
+	FrameBenchmark(
+		ViewManager* pViewManager,
+		SceneManager* pSceneManager,
+		UniformCache* pUniformCache,
+		RenderStateCache* pStateCache);
+	// destructor
+	~FrameBenchmark();
+
+	// create the offscreen color and depth render target
+	bool CreateFramebuffer(int width, int height);
+	// free the offscreen render target
+	void DestroyFramebuffer();
+
+	// set the profiler that measures the frame scopes, or NULL
+	void SetProfiler(Profiler* pProfiler);
+
+	// render the frames along the camera path and time each one
+	bool Run(int frameCount);
+	// write the recorded timings as JSON - "-" writes to the console
+	bool WriteResults(const std::string& filename) const;
+
+private:
+	// pointers to the managers that draw the scene
+	ViewManager* m_pViewManager;
+	SceneManager* m_pSceneManager;
+	UniformCache* m_pUniformCache;
+	RenderStateCache* m_pStateCache;
+	// optional profiler and the IDs of the frame scopes
+	Profiler* m_pProfiler;
+	int m_frameScope;
+	int m_viewScope;
+	int m_renderScope;
+	// offscreen render target
+	GLuint m_framebuffer;
+	GLuint m_colorBuffer;
+	GLuint m_depthBuffer;
+	int m_width;
+	int m_height;
+	// timings of the last run
+	std::vector<FRAME_TIMING> m_timings;
+
+	// place the camera at its position on the path for a frame
+	void SetCameraPathPose(int frame, int frameCount);
+};
@@ -0,0 +1,392 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrustumCuller.cpp
+// ============
+// skip scene objects whose bounding spheres are outside the view frustum
+//
+//  The six frustum planes are taken from the combined view and
+//  projection matrix each frame.  The bounding spheres are kept as
+//  separate arrays of center coordinates and radii, so four spheres at
+//  a time are tested against each plane with SSE instructions.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// SSE is part of every x64 target and of x86 targets built for it
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define FRUSTUM_CULLER_SSE 1
+#include <xmmintrin.h>
+#endif
+
+/***********************************************************
+ *  FrustumCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FrustumCuller::FrustumCuller()
+{
+	m_objectCount = 0;
+	m_bFrustumValid = false;
+	m_visibleCount = 0;
+	for (int i = 0; i < 6; i++)
+	{
+		m_planes[i] = glm::vec4(0.0f);
+	}
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every object.
+ ***********************************************************/
+void FrustumCuller::Clear()
+{
+	m_centerX.clear();
+	m_centerY.clear();
+	m_centerZ.clear();
+	m_radius.clear();
+	m_visible.clear();
+	m_objectCount = 0;
+	m_visibleCount = 0;
+}
+
+/***********************************************************
+ *  SetBounds()
+ *
+ *  This method is used for setting the bounding sphere of
+ *  an object.  The arrays grow in steps of four, and the
+ *  unused entries at the end are never reported.
+ ***********************************************************/
+void FrustumCuller::SetBounds(int objectIndex, const BOUNDING_SPHERE& bounds)
+{
+	if (objectIndex < 0)
+	{
+		return;
+	}
+
+	if (objectIndex >= m_objectCount)
+	{
+		m_objectCount = objectIndex + 1;
+		size_t paddedCount = ((size_t)m_objectCount + 3) & ~(size_t)3;
+		m_centerX.resize(paddedCount, 0.0f);
+		m_centerY.resize(paddedCount, 0.0f);
+		m_centerZ.resize(paddedCount, 0.0f);
+		m_radius.resize(paddedCount, 0.0f);
+		m_visible.resize(m_objectCount, 1);
+	}
+
+	m_centerX[objectIndex] = bounds.center.x;
+	m_centerY[objectIndex] = bounds.center.y;
+	m_centerZ[objectIndex] = bounds.center.z;
+	m_radius[objectIndex] = bounds.radius;
+}
+
+/***********************************************************
+ *  SetFrustum()
+ *
+ *  This method is used for taking the six frustum planes
+ *  from the rows of a projection times view matrix.  Each
+ *  plane is normalized, so a point's distance from it is a
+ *  plain dot product.
+ ***********************************************************/
+void FrustumCuller::SetFrustum(const glm::mat4& viewProjection)
+{
+	glm::vec4 rowX(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	glm::vec4 rowY(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	glm::vec4 rowZ(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	glm::vec4 rowW(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	m_planes[0] = rowW + rowX;
+	m_planes[1] = rowW - rowX;
+	m_planes[2] = rowW + rowY;
+	m_planes[3] = rowW - rowY;
+	m_planes[4] = rowW + rowZ;
+	m_planes[5] = rowW - rowZ;
+
+	for (int i = 0; i < 6; i++)
+	{
+		float length = glm::length(glm::vec3(m_planes[i]));
+		if (length > 0.0f)
+		{
+			m_planes[i] /= length;
+		}
+	}
+
+	m_bFrustumValid = true;
+}
+
+/***********************************************************
+ *  Cull()
+ *
+ *  This method is used for testing every object against the
+ *  frustum.  Without a frustum every object is visible.
+ ***********************************************************/
+int FrustumCuller::Cull()
+{
+	if (m_bFrustumValid == false)
+	{
+		std::fill(m_visible.begin(), m_visible.end(), (unsigned char)1);
+		m_visibleCount = m_objectCount;
+		return(m_visibleCount);
+	}
+
+	m_visibleCount = CullSIMD();
+
+	return(m_visibleCount);
+}
+
+/***********************************************************
+ *  CullHierarchy()
+ *
+ *  This method is used for testing the objects through a
+ *  bounding volume hierarchy, so subtrees wholly inside or
+ *  outside the frustum are decided without testing their
+ *  objects.  The objects of the leaves crossing the frustum
+ *  have their spheres tested four at a time.  The hierarchy
+ *  must have been built over the same objects, or every
+ *  sphere is tested instead.
+ ***********************************************************/
+int FrustumCuller::CullHierarchy(const SceneBVH& hierarchy)
+{
+	if ((m_bFrustumValid == false) || (hierarchy.GetObjectCount() != m_objectCount))
+	{
+		return(Cull());
+	}
+
+	m_visibleCount = hierarchy.CullFrustum(m_planes, m_visible, m_crossingObjects);
+	m_visibleCount += CullListSIMD(m_crossingObjects);
+
+	return(m_visibleCount);
+}
+
+/***********************************************************
+ *  CullScalar()
+ *
+ *  This method is used for testing the spheres one at a
+ *  time.  A sphere is outside when its center is further
+ *  than its radius behind any plane.
+ ***********************************************************/
+int FrustumCuller::CullScalar()
+{
+	int visibleCount = 0;
+
+	for (int i = 0; i < m_objectCount; i++)
+	{
+		bool bVisible = true;
+		for (int p = 0; (p < 6) && (bVisible == true); p++)
+		{
+			float distance = m_planes[p].x * m_centerX[i] + m_planes[p].y * m_centerY[i] + m_planes[p].z * m_centerZ[i] + m_planes[p].w;
+			bVisible = (distance >= -m_radius[i]);
+		}
+		m_visible[i] = (bVisible == true) ? 1 : 0;
+		visibleCount += (bVisible == true) ? 1 : 0;
+	}
+
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  CullSIMD()
+ *
+ *  This method is used for testing four spheres at a time.
+ *  The distances of the four centers from a plane are found
+ *  together and compared with their negated radii, and the
+ *  results of the six planes are combined into one mask.
+ *  Targets without SSE use the plain test.
+ ***********************************************************/
+int FrustumCuller::CullSIMD()
+{
+#if defined(FRUSTUM_CULLER_SSE)
+	int visibleCount = 0;
+
+	__m128 planeX[6];
+	__m128 planeY[6];
+	__m128 planeZ[6];
+	__m128 planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(m_planes[p].x);
+		planeY[p] = _mm_set1_ps(m_planes[p].y);
+		planeZ[p] = _mm_set1_ps(m_planes[p].z);
+		planeW[p] = _mm_set1_ps(m_planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (int i = 0; i < m_objectCount; i += 4)
+	{
+		__m128 centerX = _mm_loadu_ps(&m_centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&m_centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&m_centerZ[i]);
+		__m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(&m_radius[i]));
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		int laneCount = std::min(4, m_objectCount - i);
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			unsigned char bVisible = (unsigned char)((mask >> lane) & 1);
+			m_visible[i + lane] = bVisible;
+			visibleCount += bVisible;
+		}
+	}
+
+	return(visibleCount);
+#else
+	return(CullScalar());
+#endif
+}
+
+/***********************************************************
+ *  CullListSIMD()
+ *
+ *  This method is used for testing the spheres of a list
+ *  of objects four at a time, as CullSIMD() does.  The
+ *  listed objects are scattered through the arrays, so each
+ *  group of four is gathered first, and a short last group
+ *  repeats its first object in the unused lanes.  Targets
+ *  without SSE test the spheres one at a time.
+ ***********************************************************/
+int FrustumCuller::CullListSIMD(const std::vector<int>& objects)
+{
+	int visibleCount = 0;
+	int listCount = (int)objects.size();
+
+#if defined(FRUSTUM_CULLER_SSE)
+	__m128 planeX[6];
+	__m128 planeY[6];
+	__m128 planeZ[6];
+	__m128 planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(m_planes[p].x);
+		planeY[p] = _mm_set1_ps(m_planes[p].y);
+		planeZ[p] = _mm_set1_ps(m_planes[p].z);
+		planeW[p] = _mm_set1_ps(m_planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	for (int i = 0; i < listCount; i += 4)
+	{
+		int laneCount = std::min(4, listCount - i);
+		int index[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			index[lane] = objects[i + ((lane < laneCount) ? lane : 0)];
+		}
+
+		__m128 centerX = _mm_set_ps(m_centerX[index[3]], m_centerX[index[2]], m_centerX[index[1]], m_centerX[index[0]]);
+		__m128 centerY = _mm_set_ps(m_centerY[index[3]], m_centerY[index[2]], m_centerY[index[1]], m_centerY[index[0]]);
+		__m128 centerZ = _mm_set_ps(m_centerZ[index[3]], m_centerZ[index[2]], m_centerZ[index[1]], m_centerZ[index[0]]);
+		__m128 negativeRadius = _mm_sub_ps(zero,
+			_mm_set_ps(m_radius[index[3]], m_radius[index[2]], m_radius[index[1]], m_radius[index[0]]));
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planeX[p], centerX), _mm_mul_ps(planeY[p], centerY)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], centerZ), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < laneCount; lane++)
+		{
+			unsigned char bVisible = (unsigned char)((mask >> lane) & 1);
+			m_visible[index[lane]] = bVisible;
+			visibleCount += bVisible;
+		}
+	}
+#else
+	for (int i = 0; i < listCount; i++)
+	{
+		int objectIndex = objects[i];
+		bool bVisible = true;
+		for (int p = 0; (p < 6) && (bVisible == true); p++)
+		{
+			float distance = m_planes[p].x * m_centerX[objectIndex] + m_planes[p].y * m_centerY[objectIndex] + m_planes[p].z * m_centerZ[objectIndex] + m_planes[p].w;
+			bVisible = (distance >= -m_radius[objectIndex]);
+		}
+		m_visible[objectIndex] = (bVisible == true) ? 1 : 0;
+		visibleCount += (bVisible == true) ? 1 : 0;
+	}
+#endif
+
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  RunCullingBenchmark()
+ *
+ *  This method is used for timing the plain and the SSE
+ *  sphere tests on random spheres around a fixed camera,
+ *  and checking that they agree.
+ ***********************************************************/
+void FrustumCuller::RunCullingBenchmark()
+{
+	const int sphereCounts[] = { 1000, 10000, 100000 };
+	const int repeatCount = 200;
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1000.0f / 800.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 10.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	std::mt19937 generator(330);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> radius(0.1f, 2.0f);
+
+	std::cout << "Frustum culling benchmark" << std::endl;
+
+	for (int i = 0; i < (int)(sizeof(sphereCounts) / sizeof(sphereCounts[0])); i++)
+	{
+		FrustumCuller culler;
+		for (int j = 0; j < sphereCounts[i]; j++)
+		{
+			BOUNDING_SPHERE bounds;
+			bounds.center = glm::vec3(position(generator), position(generator), position(generator));
+			bounds.radius = radius(generator);
+			culler.SetBounds(j, bounds);
+		}
+		culler.SetFrustum(projection * view);
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		int scalarVisible = 0;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			scalarVisible = culler.CullScalar();
+		}
+		double scalarMicroseconds = std::chrono::duration<double, std::micro>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / repeatCount;
+		std::vector<unsigned char> scalarResults = culler.m_visible;
+
+		startTime = std::chrono::high_resolution_clock::now();
+		int simdVisible = 0;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			simdVisible = culler.CullSIMD();
+		}
+		double simdMicroseconds = std::chrono::duration<double, std::micro>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / repeatCount;
+
+		std::cout << "  spheres:" << sphereCounts[i]
+			<< ", visible:" << simdVisible
+			<< ", scalar us:" << scalarMicroseconds
+			<< ", simd us:" << simdMicroseconds
+			<< ", speedup:" << scalarMicroseconds / std::max(simdMicroseconds, 0.001)
+			<< ((scalarVisible != simdVisible) || (scalarResults != culler.m_visible) ? ", RESULTS DIFFER" : "")
+			<< std::endl;
+	}
+}
@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// FrustumCuller.h
+// ============
+// skip scene objects whose bounding spheres are outside the view frustum
+//
+//  The six frustum planes are taken from the combined view and
+//  projection matrix each frame.  The bounding spheres are kept as
+//  separate arrays of center coordinates and radii, so four spheres at
+//  a time are tested against each plane with SSE instructions.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class SceneBVH;
+
+/***********************************************************
+ *  FrustumCuller
+ *
+ *  This class contains the world space bounding spheres of
+ *  the scene objects and the code for testing them against
+ *  the frustum of the current camera.
+ ***********************************************************/
+class FrustumCuller
+{
+public:
+	// constructor
+	FrustumCuller();
+
+	// world space bounding sphere of an object
+	struct BOUNDING_SPHERE
+	{
+		glm::vec3 center;
+		float radius;
+	};
+
+	// set the bounding sphere of an object, adding objects as needed
+	void SetBounds(int objectIndex, const BOUNDING_SPHERE& bounds);
+	// remove every object
+	void Clear();
+	int GetObjectCount() const { return(m_objectCount); }
+
+	// take the frustum planes from a projection times view matrix
+	void SetFrustum(const glm::mat4& viewProjection);
+	// forget the frustum, so every object is visible
+	void ClearFrustum() { m_bFrustumValid = false; }
+	// frustum planes as xyz = inward normal, w = distance
+	const glm::vec4* GetPlanes() const { return(m_planes); }
+
+	// test every object against the frustum and return the number
+	// of visible objects
+	int Cull();
+	// test the objects through a hierarchy over the same objects,
+	// falling back to testing every sphere when it does not match
+	int CullHierarchy(const SceneBVH& hierarchy);
+	// whether an object was inside the frustum at the last test
+	bool IsVisible(int objectIndex) const { return(m_visible[objectIndex] != 0); }
+	// counts of the last test
+	int GetVisibleCount() const { return(m_visibleCount); }
+	int GetCulledCount() const { return(m_objectCount - m_visibleCount); }
+
+	// time the SSE sphere test against the plain one with many
+	// spheres and print the results - no OpenGL context is needed
+	static void RunCullingBenchmark();
+
+private:
+	// sphere centers and radii, padded to a multiple of four
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+	int m_objectCount;
+	// frustum planes as xyz = inward normal, w = distance
+	glm::vec4 m_planes[6];
+	bool m_bFrustumValid;
+	// result of the last test for every object
+	std::vector<unsigned char> m_visible;
+	int m_visibleCount;
+	// objects of the hierarchy leaves crossing the frustum
+	std::vector<int> m_crossingObjects;
+
+	// test the spheres one at a time
+	int CullScalar();
+	// test the spheres four at a time
+	int CullSIMD();
+	// test the spheres of the listed objects four at a time,
+	// marking the visible ones and returning how many
+	int CullListSIMD(const std::vector<int>& objects);
+};
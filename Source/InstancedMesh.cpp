@@ -0,0 +1,271 @@
+///////////////////////////////////////////////////////////////////////////////
+// InstancedMesh.cpp
+// ============
+// draw many copies of one mesh with a single instanced draw call
+//
+//  The mesh geometry is packed and uploaded once and shared by every
+//  batch.  Each batch owns an instance buffer with the per-instance model
+//  matrix, texture UV scale and material index, so all of its instances
+//  draw with one call.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InstancedMesh.h"
+
+#include <cstddef>
+
+// declaration of the vertex attribute locations used in the vertex shader
+namespace
+{
+	// the instance model matrix takes four consecutive locations
+	const GLuint g_InstanceModelLocation = 3;
+	const GLuint g_InstanceUVScaleLocation = 7;
+	const GLuint g_InstanceMaterialLocation = 8;
+	const GLuint g_InstanceTextureRectLocation = 9;
+	const GLuint g_InstanceTextureLayerLocation = 10;
+}
+
+/***********************************************************
+ *  InstancedMesh()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+InstancedMesh::InstancedMesh(RenderStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_indexCount = 0;
+}
+
+/***********************************************************
+ *  ~InstancedMesh()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+InstancedMesh::~InstancedMesh()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for packing the mesh geometry and
+ *  uploading it into the vertex and index buffers shared by
+ *  all batches.
+ ***********************************************************/
+bool InstancedMesh::Create(const MESH_DATA& mesh)
+{
+	PACKED_MESH_DATA packed;
+	if ((mesh.vertices.size() == 0) || (mesh.indices.size() == 0) ||
+		(VertexPacker::PackMesh(mesh, packed) == false))
+	{
+		return(false);
+	}
+
+	Destroy();
+
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, packed.vertices.size() * sizeof(PACKED_VERTEX), packed.vertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the index buffer is attached to each batch vertex array later
+	glGenBuffers(1, &m_ebo);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+	glBufferData(GL_COPY_WRITE_BUFFER, packed.indices.size() * sizeof(unsigned int), packed.indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	m_indexCount = (GLsizei)packed.indices.size();
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the shared geometry and
+ *  all of the batch vertex arrays and instance buffers.
+ ***********************************************************/
+void InstancedMesh::Destroy()
+{
+	for (int i = 0; i < (int)m_batches.size(); i++)
+	{
+		glDeleteVertexArrays(1, &m_batches[i].vao);
+		glDeleteBuffers(1, &m_batches[i].instanceVBO);
+	}
+	m_batches.clear();
+	// a deleted vertex array name can be handed out again
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateVertexArray();
+	}
+
+	if (m_vbo != 0)
+	{
+		glDeleteBuffers(1, &m_vbo);
+		m_vbo = 0;
+	}
+	if (m_ebo != 0)
+	{
+		glDeleteBuffers(1, &m_ebo);
+		m_ebo = 0;
+	}
+	m_indexCount = 0;
+}
+
+/***********************************************************
+ *  SetupBatchAttributes()
+ *
+ *  This method is used for configuring the vertex array of
+ *  a batch with the shared geometry attributes and its own
+ *  per-instance attributes.
+ ***********************************************************/
+void InstancedMesh::SetupBatchAttributes(INSTANCE_BATCH& batch)
+{
+	glBindVertexArray(batch.vao);
+
+	VertexPacker::SetupVertexAttributes(m_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	SetupInstanceAttributes(batch.instanceVBO);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  SetupInstanceAttributes()
+ *
+ *  This method is used for pointing the per-instance
+ *  attributes of the bound vertex array at a buffer of
+ *  instance data.  They advance once for every instance.
+ ***********************************************************/
+void InstancedMesh::SetupInstanceAttributes(GLuint instanceBuffer)
+{
+	const GLsizei instanceStride = sizeof(INSTANCE_DATA);
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(g_InstanceModelLocation + column);
+		glVertexAttribPointer(
+			g_InstanceModelLocation + column, 4, GL_FLOAT, GL_FALSE, instanceStride,
+			(void*)(offsetof(INSTANCE_DATA, model) + sizeof(glm::vec4) * column));
+		glVertexAttribDivisor(g_InstanceModelLocation + column, 1);
+	}
+	glEnableVertexAttribArray(g_InstanceUVScaleLocation);
+	glVertexAttribPointer(
+		g_InstanceUVScaleLocation, 2, GL_FLOAT, GL_FALSE, instanceStride,
+		(void*)offsetof(INSTANCE_DATA, uvScale));
+	glVertexAttribDivisor(g_InstanceUVScaleLocation, 1);
+	glEnableVertexAttribArray(g_InstanceMaterialLocation);
+	glVertexAttribIPointer(
+		g_InstanceMaterialLocation, 1, GL_INT, instanceStride,
+		(void*)offsetof(INSTANCE_DATA, materialIndex));
+	glVertexAttribDivisor(g_InstanceMaterialLocation, 1);
+	glEnableVertexAttribArray(g_InstanceTextureRectLocation);
+	glVertexAttribPointer(
+		g_InstanceTextureRectLocation, 4, GL_FLOAT, GL_FALSE, instanceStride,
+		(void*)offsetof(INSTANCE_DATA, textureRect));
+	glVertexAttribDivisor(g_InstanceTextureRectLocation, 1);
+	glEnableVertexAttribArray(g_InstanceTextureLayerLocation);
+	glVertexAttribPointer(
+		g_InstanceTextureLayerLocation, 1, GL_FLOAT, GL_FALSE, instanceStride,
+		(void*)offsetof(INSTANCE_DATA, textureLayer));
+	glVertexAttribDivisor(g_InstanceTextureLayerLocation, 1);
+}
+
+/***********************************************************
+ *  AddBatch()
+ *
+ *  This method is used for adding a batch of instances that
+ *  are drawn together with the shared mesh geometry.
+ ***********************************************************/
+int InstancedMesh::AddBatch(const std::vector<INSTANCE_DATA>& instances)
+{
+	INSTANCE_BATCH batch;
+
+	glGenVertexArrays(1, &batch.vao);
+	glGenBuffers(1, &batch.instanceVBO);
+	batch.instanceCount = 0;
+	batch.capacity = 0;
+
+	SetupBatchAttributes(batch);
+	// the vertex array was changed outside of the state cache
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateVertexArray();
+	}
+	m_batches.push_back(batch);
+
+	int batchIndex = (int)m_batches.size() - 1;
+	UpdateBatch(batchIndex, instances);
+
+	return(batchIndex);
+}
+
+/***********************************************************
+ *  UpdateBatch()
+ *
+ *  This method is used for replacing the instance data of a
+ *  batch.  The instance buffer is only reallocated when the
+ *  batch grows beyond its current capacity.
+ ***********************************************************/
+void InstancedMesh::UpdateBatch(int batchIndex, const std::vector<INSTANCE_DATA>& instances)
+{
+	if ((batchIndex < 0) || (batchIndex >= (int)m_batches.size()))
+	{
+		return;
+	}
+
+	INSTANCE_BATCH& batch = m_batches[batchIndex];
+	int count = (int)instances.size();
+
+	glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+	if (count > batch.capacity)
+	{
+		glBufferData(GL_ARRAY_BUFFER, count * sizeof(INSTANCE_DATA), instances.data(), GL_DYNAMIC_DRAW);
+		batch.capacity = count;
+	}
+	else if (count > 0)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(INSTANCE_DATA), instances.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	batch.instanceCount = count;
+}
+
+/***********************************************************
+ *  DrawBatch()
+ *
+ *  This method is used for drawing every instance of a batch
+ *  with one instanced draw call.
+ ***********************************************************/
+void InstancedMesh::DrawBatch(int batchIndex)
+{
+	if ((batchIndex < 0) || (batchIndex >= (int)m_batches.size()))
+	{
+		return;
+	}
+
+	const INSTANCE_BATCH& batch = m_batches[batchIndex];
+	if (batch.instanceCount == 0)
+	{
+		return;
+	}
+
+	// with a state cache the vertex array stays bound, so drawing
+	// the same batch again does not bind it again
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->BindVertexArray(batch.vao);
+		glDrawElementsInstanced(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, (void*)0, batch.instanceCount);
+	}
+	else
+	{
+		glBindVertexArray(batch.vao);
+		glDrawElementsInstanced(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, (void*)0, batch.instanceCount);
+		glBindVertexArray(0);
+	}
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// InstancedMesh.h
+// ============
+// draw many copies of one mesh with a single instanced draw call
+//
+//  The mesh geometry is packed and uploaded once and shared by every
+//  batch.  Each batch owns an instance buffer with the per-instance model
+//  matrix, texture UV scale, material index and texture array location,
+//  so all of its instances draw with one call.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "MeshGenerator.h"
+#include "VertexPacker.h"
+#include "RenderStateCache.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/***********************************************************
+ *  INSTANCE_DATA
+ *
+ *  The per-instance attributes read by the vertex shader.
+ ***********************************************************/
+struct INSTANCE_DATA
+{
+	glm::mat4 model;
+	glm::vec2 uvScale;
+	int materialIndex;
+	// part of the array layer the texture covers, and the layer
+	glm::vec4 textureRect;
+	float textureLayer;
+};
+
+/***********************************************************
+ *  InstancedMesh
+ *
+ *  This class manages the vertex buffers of one mesh and
+ *  the instance buffers of the batches drawn with it.
+ ***********************************************************/
+class InstancedMesh
+{
+public:
+	// constructor - the state cache filters the vertex array binds
+	InstancedMesh(RenderStateCache* pStateCache = NULL);
+	// destructor
+	~InstancedMesh();
+
+	// pack and upload the mesh geometry that is shared by all batches
+	bool Create(const MESH_DATA& mesh);
+	// free the geometry and all of the batch buffers
+	void Destroy();
+
+	// add a batch of instances and return its index
+	int AddBatch(const std::vector<INSTANCE_DATA>& instances);
+	// replace the instance data of a previously added batch
+	void UpdateBatch(int batchIndex, const std::vector<INSTANCE_DATA>& instances);
+	// draw all of the instances in a batch
+	void DrawBatch(int batchIndex);
+	// indices drawn for every instance
+	GLsizei GetIndexCount() const { return(m_indexCount); }
+
+	// point the per-instance attributes of the bound vertex array
+	// at a buffer of instance data
+	static void SetupInstanceAttributes(GLuint instanceBuffer);
+
+private:
+	struct INSTANCE_BATCH
+	{
+		GLuint vao;
+		GLuint instanceVBO;
+		int instanceCount;
+		int capacity;
+	};
+
+	// shared vertex and index buffers
+	GLuint m_vbo;
+	GLuint m_ebo;
+	GLsizei m_indexCount;
+	// batches drawn with the shared geometry
+	std::vector<INSTANCE_BATCH> m_batches;
+	// filters the vertex array binds, or NULL
+	RenderStateCache* m_pStateCache;
+
+	// configure the vertex attributes of a batch vertex array
+	void SetupBatchAttributes(INSTANCE_BATCH& batch);
+};
@@ -0,0 +1,436 @@
+///////////////////////////////////////////////////////////////////////////////
+// LightClusterer.cpp
+// ============
+// bin point lights into view space clusters for clustered forward lighting
+//
+//  The view frustum is split into a grid of screen tiles and exponential
+//  depth slices.  Each frame the point lights are assigned on the CPU to
+//  the clusters they reach, so the fragment shader only evaluates the
+//  lights listed for its own cluster.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LightClusterer.h"
+
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+/***********************************************************
+ *  LightClusterer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LightClusterer::LightClusterer()
+{
+	m_boundsProjection = glm::mat4(1.0f);
+	m_boundsNear = 0.0f;
+	m_boundsFar = 0.0f;
+	m_bBoundsValid = false;
+	m_sliceScale = 0.0f;
+	m_sliceBias = 0.0f;
+	m_droppedIndices = 0;
+	m_binningMilliseconds = 0.0;
+	m_clusterBuffer = 0;
+	m_clusterTexture = 0;
+	m_indexBuffer = 0;
+	m_indexTexture = 0;
+	m_indexCapacity = 0;
+
+	m_clusterMin.resize(TOTAL_CLUSTERS);
+	m_clusterMax.resize(TOTAL_CLUSTERS);
+	m_clusterData.assign(TOTAL_CLUSTERS * 2, 0);
+	m_clusterCounts.assign(TOTAL_CLUSTERS, 0);
+}
+
+/***********************************************************
+ *  ~LightClusterer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+LightClusterer::~LightClusterer()
+{
+	DestroyBuffers();
+}
+
+/***********************************************************
+ *  FindDepthSlice()
+ *
+ *  This method is used for finding the exponential depth
+ *  slice that contains the passed in view space depth.  The
+ *  fragment shader uses the same mapping.
+ ***********************************************************/
+int LightClusterer::FindDepthSlice(float depth) const
+{
+	int slice = (int)floorf(logf(depth) * m_sliceScale + m_sliceBias);
+
+	return(std::min(std::max(slice, 0), CLUSTERS_Z - 1));
+}
+
+/***********************************************************
+ *  UpdateClusterBounds()
+ *
+ *  This method is used for computing the view space bounding
+ *  box of every cluster.  The corners of each screen tile are
+ *  unprojected into view rays, which are cut at the near and
+ *  far depth of each slice.  The bounds only change with the
+ *  projection, so they are kept until it changes.
+ ***********************************************************/
+void LightClusterer::UpdateClusterBounds(const CAMERA_VIEW& camera)
+{
+	if ((m_bBoundsValid == true) &&
+		(m_boundsProjection == camera.projection) &&
+		(m_boundsNear == camera.nearPlane) &&
+		(m_boundsFar == camera.farPlane))
+	{
+		return;
+	}
+
+	float depthRatio = camera.farPlane / camera.nearPlane;
+	m_sliceScale = (float)CLUSTERS_Z / logf(depthRatio);
+	m_sliceBias = -(float)CLUSTERS_Z * logf(camera.nearPlane) / logf(depthRatio);
+
+	glm::mat4 inverseProjection = glm::inverse(camera.projection);
+
+	for (int y = 0; y < CLUSTERS_Y; y++)
+	{
+		for (int x = 0; x < CLUSTERS_X; x++)
+		{
+			// view space rays through the four corners of the tile
+			glm::vec3 rayStart[4];
+			glm::vec3 rayEnd[4];
+			for (int corner = 0; corner < 4; corner++)
+			{
+				float ndcX = -1.0f + 2.0f * (float)(x + (corner & 1)) / (float)CLUSTERS_X;
+				float ndcY = -1.0f + 2.0f * (float)(y + (corner >> 1)) / (float)CLUSTERS_Y;
+				glm::vec4 nearPoint = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+				glm::vec4 farPoint = inverseProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+				rayStart[corner] = glm::vec3(nearPoint) / nearPoint.w;
+				rayEnd[corner] = glm::vec3(farPoint) / farPoint.w;
+			}
+
+			for (int z = 0; z < CLUSTERS_Z; z++)
+			{
+				float sliceNear = camera.nearPlane * powf(depthRatio, (float)z / (float)CLUSTERS_Z);
+				float sliceFar = camera.nearPlane * powf(depthRatio, (float)(z + 1) / (float)CLUSTERS_Z);
+
+				glm::vec3 boundsMin(1.0e30f);
+				glm::vec3 boundsMax(-1.0e30f);
+				for (int corner = 0; corner < 4; corner++)
+				{
+					glm::vec3 direction = rayEnd[corner] - rayStart[corner];
+					float tNear = (-sliceNear - rayStart[corner].z) / direction.z;
+					float tFar = (-sliceFar - rayStart[corner].z) / direction.z;
+					glm::vec3 pointNear = rayStart[corner] + direction * tNear;
+					glm::vec3 pointFar = rayStart[corner] + direction * tFar;
+					boundsMin = glm::min(boundsMin, glm::min(pointNear, pointFar));
+					boundsMax = glm::max(boundsMax, glm::max(pointNear, pointFar));
+				}
+
+				int cluster = (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+				m_clusterMin[cluster] = boundsMin;
+				m_clusterMax[cluster] = boundsMax;
+			}
+		}
+	}
+
+	m_boundsProjection = camera.projection;
+	m_boundsNear = camera.nearPlane;
+	m_boundsFar = camera.farPlane;
+	m_bBoundsValid = true;
+}
+
+/***********************************************************
+ *  AssignLights()
+ *
+ *  This method is used for assigning every light to the
+ *  clusters that its range reaches.  The candidate clusters
+ *  of a light come from its depth range and the screen tiles
+ *  covered by its projected bounding box, and each candidate
+ *  is then tested against the light sphere.  The results are
+ *  stored as one light index list ordered by cluster.
+ ***********************************************************/
+void LightClusterer::AssignLights(const CAMERA_VIEW& camera, const std::vector<CLUSTER_LIGHT>& lights)
+{
+	std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+
+	UpdateClusterBounds(camera);
+
+	m_pairClusters.clear();
+	m_pairLights.clear();
+	m_globalLights.clear();
+
+	for (int i = 0; i < (int)lights.size(); i++)
+	{
+		const CLUSTER_LIGHT& light = lights[i];
+
+		// lights without a range reach every cluster
+		if (light.range <= 0.0f)
+		{
+			m_globalLights.push_back((unsigned int)i);
+			continue;
+		}
+
+		glm::vec4 viewPosition = camera.view * glm::vec4(light.position, 1.0f);
+		glm::vec3 center(viewPosition.x, viewPosition.y, viewPosition.z);
+		float radius = light.range;
+
+		// skip lights entirely in front of the near or behind the far plane
+		float depthMin = -center.z - radius;
+		float depthMax = -center.z + radius;
+		if ((depthMax < camera.nearPlane) || (depthMin > camera.farPlane))
+		{
+			continue;
+		}
+		int sliceFirst = FindDepthSlice(std::max(depthMin, camera.nearPlane));
+		int sliceLast = FindDepthSlice(std::min(depthMax, camera.farPlane));
+
+		// project the view space bounding box of the light, clipped to
+		// the depth range, to find the screen tiles it can cover
+		float zClose = std::min(center.z + radius, -camera.nearPlane);
+		float zAway = std::max(center.z - radius, -camera.farPlane);
+		glm::vec2 ndcMin(1.0e30f);
+		glm::vec2 ndcMax(-1.0e30f);
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec4 cornerPoint(
+				center.x + ((corner & 1) ? radius : -radius),
+				center.y + ((corner & 2) ? radius : -radius),
+				(corner & 4) ? zClose : zAway,
+				1.0f);
+			glm::vec4 clip = camera.projection * cornerPoint;
+			glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+			ndcMin = glm::min(ndcMin, ndc);
+			ndcMax = glm::max(ndcMax, ndc);
+		}
+		if ((ndcMax.x < -1.0f) || (ndcMin.x > 1.0f) || (ndcMax.y < -1.0f) || (ndcMin.y > 1.0f))
+		{
+			continue;
+		}
+
+		int tileFirstX = std::max((int)floorf((ndcMin.x * 0.5f + 0.5f) * CLUSTERS_X), 0);
+		int tileLastX = std::min((int)floorf((ndcMax.x * 0.5f + 0.5f) * CLUSTERS_X), CLUSTERS_X - 1);
+		int tileFirstY = std::max((int)floorf((ndcMin.y * 0.5f + 0.5f) * CLUSTERS_Y), 0);
+		int tileLastY = std::min((int)floorf((ndcMax.y * 0.5f + 0.5f) * CLUSTERS_Y), CLUSTERS_Y - 1);
+
+		float radiusSquared = radius * radius;
+		for (int z = sliceFirst; z <= sliceLast; z++)
+		{
+			for (int y = tileFirstY; y <= tileLastY; y++)
+			{
+				for (int x = tileFirstX; x <= tileLastX; x++)
+				{
+					// distance from the light center to the cluster box
+					int cluster = (z * CLUSTERS_Y + y) * CLUSTERS_X + x;
+					glm::vec3 closest = glm::max(m_clusterMin[cluster], glm::min(center, m_clusterMax[cluster]));
+					glm::vec3 offset = closest - center;
+					if (glm::dot(offset, offset) <= radiusSquared)
+					{
+						m_pairClusters.push_back((unsigned int)cluster);
+						m_pairLights.push_back((unsigned int)i);
+					}
+				}
+			}
+		}
+	}
+
+	// count the lights of every cluster and lay out the index list
+	std::fill(m_clusterCounts.begin(), m_clusterCounts.end(), (unsigned int)m_globalLights.size());
+	for (int i = 0; i < (int)m_pairClusters.size(); i++)
+	{
+		m_clusterCounts[m_pairClusters[i]]++;
+	}
+
+	unsigned int totalIndices = 0;
+	m_droppedIndices = 0;
+	for (int cluster = 0; cluster < TOTAL_CLUSTERS; cluster++)
+	{
+		unsigned int count = std::min(m_clusterCounts[cluster], (unsigned int)MAX_LIGHT_INDICES - totalIndices);
+		m_droppedIndices += (int)(m_clusterCounts[cluster] - count);
+		m_clusterData[cluster * 2 + 0] = totalIndices;
+		m_clusterData[cluster * 2 + 1] = count;
+		totalIndices += count;
+	}
+	m_lightIndices.resize(totalIndices);
+
+	// fill the index list - the counts are reused as write cursors
+	for (int cluster = 0; cluster < TOTAL_CLUSTERS; cluster++)
+	{
+		unsigned int offset = m_clusterData[cluster * 2 + 0];
+		unsigned int count = m_clusterData[cluster * 2 + 1];
+		unsigned int written = 0;
+		for (int i = 0; (i < (int)m_globalLights.size()) && (written < count); i++)
+		{
+			m_lightIndices[offset + written] = m_globalLights[i];
+			written++;
+		}
+		m_clusterCounts[cluster] = written;
+	}
+	for (int i = 0; i < (int)m_pairClusters.size(); i++)
+	{
+		unsigned int cluster = m_pairClusters[i];
+		if (m_clusterCounts[cluster] < m_clusterData[cluster * 2 + 1])
+		{
+			m_lightIndices[m_clusterData[cluster * 2 + 0] + m_clusterCounts[cluster]] = m_pairLights[i];
+			m_clusterCounts[cluster]++;
+		}
+	}
+
+	std::chrono::high_resolution_clock::time_point endTime = std::chrono::high_resolution_clock::now();
+	m_binningMilliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+}
+
+/***********************************************************
+ *  CreateBuffers()
+ *
+ *  This method is used for creating the texture buffers that
+ *  hold the cluster offsets and counts, and the light index
+ *  list.
+ ***********************************************************/
+bool LightClusterer::CreateBuffers()
+{
+	DestroyBuffers();
+
+	glGenBuffers(1, &m_clusterBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_clusterBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, TOTAL_CLUSTERS * 2 * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+
+	m_indexCapacity = 1024;
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, m_indexCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &m_clusterTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_clusterTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_clusterBuffer);
+
+	glGenTextures(1, &m_indexTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, m_indexTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_indexBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	return(true);
+}
+
+/***********************************************************
+ *  UploadBuffers()
+ *
+ *  This method is used for uploading the results of the last
+ *  light assignment.  The index buffer only grows when the
+ *  index list no longer fits.
+ ***********************************************************/
+void LightClusterer::UploadBuffers()
+{
+	if ((m_clusterBuffer == 0) || (m_indexBuffer == 0))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_clusterBuffer);
+	glBufferSubData(GL_TEXTURE_BUFFER, 0, m_clusterData.size() * sizeof(unsigned int), m_clusterData.data());
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_indexBuffer);
+	if ((int)m_lightIndices.size() > m_indexCapacity)
+	{
+		while (m_indexCapacity < (int)m_lightIndices.size())
+			m_indexCapacity *= 2;
+		glBufferData(GL_TEXTURE_BUFFER, m_indexCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+	}
+	if (m_lightIndices.size() > 0)
+	{
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, m_lightIndices.size() * sizeof(unsigned int), m_lightIndices.data());
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DestroyBuffers()
+ *
+ *  This method is used for freeing the cluster texture
+ *  buffers.
+ ***********************************************************/
+void LightClusterer::DestroyBuffers()
+{
+	if (m_clusterTexture != 0)
+	{
+		glDeleteTextures(1, &m_clusterTexture);
+		m_clusterTexture = 0;
+	}
+	if (m_indexTexture != 0)
+	{
+		glDeleteTextures(1, &m_indexTexture);
+		m_indexTexture = 0;
+	}
+	if (m_clusterBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_clusterBuffer);
+		m_clusterBuffer = 0;
+	}
+	if (m_indexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_indexBuffer);
+		m_indexBuffer = 0;
+	}
+	m_indexCapacity = 0;
+}
+
+/***********************************************************
+ *  RunBinningBenchmark()
+ *
+ *  This method is used for timing the CPU light binning with
+ *  100, 1k and 10k randomly placed lights seen from the
+ *  default scene camera.  No OpenGL context is needed.
+ ***********************************************************/
+void LightClusterer::RunBinningBenchmark()
+{
+	const int lightCounts[] = { 100, 1000, 10000 };
+	const int iterations = 50;
+
+	CAMERA_VIEW camera;
+	camera.position = glm::vec3(0.0f, 3.0f, 12.0f);
+	camera.view = glm::lookAt(camera.position, camera.position + glm::vec3(0.0f, -0.2f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	camera.nearPlane = 0.1f;
+	camera.farPlane = 100.0f;
+	camera.projection = glm::perspective(glm::radians(45.0f), 1000.0f / 800.0f, camera.nearPlane, camera.farPlane);
+	camera.bOrthographic = false;
+	camera.viewportWidth = 1000;
+	camera.viewportHeight = 800;
+
+	std::mt19937 generator(330);
+	std::uniform_real_distribution<float> spreadX(-40.0f, 40.0f);
+	std::uniform_real_distribution<float> spreadY(0.0f, 20.0f);
+	std::uniform_real_distribution<float> spreadZ(-80.0f, 10.0f);
+	std::uniform_real_distribution<float> spreadRange(1.0f, 6.0f);
+
+	std::cout << "Light binning benchmark (" << TOTAL_CLUSTERS << " clusters, "
+		<< iterations << " iterations)" << std::endl;
+
+	for (int i = 0; i < (int)(sizeof(lightCounts) / sizeof(lightCounts[0])); i++)
+	{
+		std::vector<CLUSTER_LIGHT> lights(lightCounts[i]);
+		for (int j = 0; j < lightCounts[i]; j++)
+		{
+			lights[j].position = glm::vec3(spreadX(generator), spreadY(generator), spreadZ(generator));
+			lights[j].range = spreadRange(generator);
+		}
+
+		LightClusterer clusterer;
+		double totalMilliseconds = 0.0;
+		double bestMilliseconds = 1.0e30;
+		for (int iteration = 0; iteration < iterations; iteration++)
+		{
+			clusterer.AssignLights(camera, lights);
+			totalMilliseconds += clusterer.GetBinningMilliseconds();
+			bestMilliseconds = std::min(bestMilliseconds, clusterer.GetBinningMilliseconds());
+		}
+
+		std::cout << "  lights:" << lightCounts[i]
+			<< ", avg ms:" << totalMilliseconds / iterations
+			<< ", min ms:" << bestMilliseconds
+			<< ", light indices:" << clusterer.GetLightIndexCount()
+			<< ", dropped:" << clusterer.GetDroppedIndexCount() << std::endl;
+	}
+}
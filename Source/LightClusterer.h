@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// LightClusterer.h
+// ============
+// bin point lights into view space clusters for clustered forward lighting
+//
+//  The view frustum is split into a grid of screen tiles and exponential
+//  depth slices.  Each frame the point lights are assigned on the CPU to
+//  the clusters they reach, so the fragment shader only evaluates the
+//  lights listed for its own cluster.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "CameraView.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/***********************************************************
+ *  CLUSTER_LIGHT
+ *
+ *  The position and range of a light to be clustered.  A
+ *  light with a range of zero or less reaches every cluster.
+ ***********************************************************/
+struct CLUSTER_LIGHT
+{
+	glm::vec3 position;
+	float range;
+};
+
+/***********************************************************
+ *  LightClusterer
+ *
+ *  This class contains the code for assigning point lights
+ *  to view space clusters and uploading the cluster light
+ *  lists into texture buffers for the fragment shader.
+ ***********************************************************/
+class LightClusterer
+{
+public:
+	// constructor
+	LightClusterer();
+	// destructor
+	~LightClusterer();
+
+	// cluster grid dimensions - screen tiles and depth slices
+	static const int CLUSTERS_X = 16;
+	static const int CLUSTERS_Y = 9;
+	static const int CLUSTERS_Z = 24;
+	static const int TOTAL_CLUSTERS = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+	// the smallest texture buffer size every implementation supports
+	static const int MAX_LIGHT_INDICES = 65536;
+
+	// assign the lights to the clusters of the camera view - CPU only
+	void AssignLights(const CAMERA_VIEW& camera, const std::vector<CLUSTER_LIGHT>& lights);
+
+	// create and upload the cluster texture buffers
+	bool CreateBuffers();
+	void UploadBuffers();
+	void DestroyBuffers();
+
+	// textures of the cluster offsets and counts, and of the light indices
+	GLuint GetClusterTexture() const { return(m_clusterTexture); }
+	GLuint GetIndexTexture() const { return(m_indexTexture); }
+
+	// values the fragment shader needs to find its depth slice
+	float GetSliceScale() const { return(m_sliceScale); }
+	float GetSliceBias() const { return(m_sliceBias); }
+
+	// statistics of the last light assignment
+	int GetLightIndexCount() const { return((int)m_lightIndices.size()); }
+	int GetDroppedIndexCount() const { return(m_droppedIndices); }
+	double GetBinningMilliseconds() const { return(m_binningMilliseconds); }
+
+	// time the light binning at several light counts and print the results
+	static void RunBinningBenchmark();
+
+private:
+	// view space bounds of every cluster
+	std::vector<glm::vec3> m_clusterMin;
+	std::vector<glm::vec3> m_clusterMax;
+	// projection and depth range the cluster bounds were built for
+	glm::mat4 m_boundsProjection;
+	float m_boundsNear;
+	float m_boundsFar;
+	bool m_bBoundsValid;
+	// exponential depth slice mapping - slice = log(depth) * scale + bias
+	float m_sliceScale;
+	float m_sliceBias;
+
+	// per cluster offset and count into the light index list
+	std::vector<unsigned int> m_clusterData;
+	// light indices of all clusters, stored cluster by cluster
+	std::vector<unsigned int> m_lightIndices;
+	// scratch lists of (cluster, light) pairs found while binning
+	std::vector<unsigned int> m_pairClusters;
+	std::vector<unsigned int> m_pairLights;
+	std::vector<unsigned int> m_globalLights;
+	std::vector<unsigned int> m_clusterCounts;
+
+	// statistics of the last light assignment
+	int m_droppedIndices;
+	double m_binningMilliseconds;
+
+	// texture buffers read by the fragment shader
+	GLuint m_clusterBuffer;
+	GLuint m_clusterTexture;
+	GLuint m_indexBuffer;
+	GLuint m_indexTexture;
+	int m_indexCapacity;
+
+	// rebuild the cluster bounds when the projection changes
+	void UpdateClusterBounds(const CAMERA_VIEW& camera);
+	// find the depth slice that contains a view space depth
+	int FindDepthSlice(float depth) const;
+};
@@ -0,0 +1,173 @@
+///////////////////////////////////////////////////////////////////////////////
+// LodSelector.cpp
+// ============
+// choose the tessellation level of each object from its size on screen
+//
+//  A mesh is generated at several levels of detail, finest first.  Each
+//  frame the bounding sphere of an object is projected to a radius in
+//  pixels and the level whose range holds that radius is chosen.  An
+//  object only moves to another level once its radius has passed the
+//  threshold by a margin, so an object hovering at a threshold does not
+//  switch back and forth every frame.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "LodSelector.h"
+
+#include <cfloat>
+
+/***********************************************************
+ *  LodSelector()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+LodSelector::LodSelector()
+{
+	m_levelCount = 1;
+	m_hysteresis = 0.15f;
+	for (int i = 0; i < MAX_LEVELS; i++)
+	{
+		m_minimumRadii[i] = 0.0f;
+		m_levelObjects[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  SetThresholds()
+ *
+ *  This method is used for setting the smallest radius in
+ *  pixels an object must have to use each level.  The
+ *  coarsest level takes every radius below the last
+ *  threshold.  The current levels are forgotten.
+ ***********************************************************/
+void LodSelector::SetThresholds(const float* minimumRadii, int levelCount)
+{
+	if (levelCount < 1)
+		levelCount = 1;
+	if (levelCount > MAX_LEVELS)
+		levelCount = MAX_LEVELS;
+
+	m_levelCount = levelCount;
+	for (int i = 0; i < MAX_LEVELS; i++)
+	{
+		m_minimumRadii[i] = (i < levelCount - 1) ? minimumRadii[i] : 0.0f;
+	}
+
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for forgetting the level of every
+ *  object, so each chooses its level afresh.
+ ***********************************************************/
+void LodSelector::Clear()
+{
+	m_objectLevels.clear();
+	BeginFrame();
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting to count the objects at
+ *  each level for a new frame.
+ ***********************************************************/
+void LodSelector::BeginFrame()
+{
+	for (int i = 0; i < MAX_LEVELS; i++)
+	{
+		m_levelObjects[i] = 0;
+	}
+}
+
+/***********************************************************
+ *  SelectLevel()
+ *
+ *  This method is used for choosing the level of an object.
+ *  An object seen for the first time takes the level its
+ *  radius falls in.  After that it moves to a finer level
+ *  only when its radius is above that level's threshold by
+ *  the hysteresis fraction, and to a coarser level only when
+ *  its radius is below its own threshold by the fraction.
+ ***********************************************************/
+int LodSelector::SelectLevel(int objectIndex, float screenRadius)
+{
+	if (objectIndex < 0)
+	{
+		return(0);
+	}
+	if (objectIndex >= (int)m_objectLevels.size())
+	{
+		m_objectLevels.resize(objectIndex + 1, -1);
+	}
+
+	int level = m_objectLevels[objectIndex];
+	if (level < 0)
+	{
+		level = 0;
+		while ((level < m_levelCount - 1) && (screenRadius < m_minimumRadii[level]))
+		{
+			level++;
+		}
+	}
+	else
+	{
+		while ((level > 0) && (screenRadius >= m_minimumRadii[level - 1] * (1.0f + m_hysteresis)))
+		{
+			level--;
+		}
+		while ((level < m_levelCount - 1) && (screenRadius < m_minimumRadii[level] * (1.0f - m_hysteresis)))
+		{
+			level++;
+		}
+	}
+
+	m_objectLevels[objectIndex] = level;
+	m_levelObjects[level]++;
+
+	return(level);
+}
+
+/***********************************************************
+ *  GetLevelObjectCount()
+ *
+ *  This method is used for getting the number of objects
+ *  that chose a level in the current frame.
+ ***********************************************************/
+int LodSelector::GetLevelObjectCount(int level) const
+{
+	if ((level < 0) || (level >= MAX_LEVELS))
+	{
+		return(0);
+	}
+
+	return(m_levelObjects[level]);
+}
+
+/***********************************************************
+ *  ProjectedRadius()
+ *
+ *  This method is used for getting the radius in pixels of a
+ *  world space sphere.  The vertical scale of the projection
+ *  turns a size at unit distance into a fraction of half the
+ *  viewport height.  A perspective projection divides it by
+ *  the distance to the sphere, and a sphere around the
+ *  camera fills the screen.
+ ***********************************************************/
+float LodSelector::ProjectedRadius(const CAMERA_VIEW& cameraView, glm::vec3 center, float radius)
+{
+	float pixelScale = cameraView.projection[1][1] * (float)cameraView.viewportHeight * 0.5f;
+	if (cameraView.bOrthographic == true)
+	{
+		return(radius * pixelScale);
+	}
+
+	float distance = glm::length(center - cameraView.position);
+	if (distance <= radius)
+	{
+		return(FLT_MAX);
+	}
+
+	return(radius * pixelScale / distance);
+}
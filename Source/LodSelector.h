@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// LodSelector.h
+// ============
+// choose the tessellation level of each object from its size on screen
+//
+//  A mesh is generated at several levels of detail, finest first.  Each
+//  frame the bounding sphere of an object is projected to a radius in
+//  pixels and the level whose range holds that radius is chosen.  An
+//  object only moves to another level once its radius has passed the
+//  threshold by a margin, so an object hovering at a threshold does not
+//  switch back and forth every frame.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "CameraView.h"
+#include <glm/glm.hpp>
+#include <vector>
+
+/***********************************************************
+ *  LodSelector
+ *
+ *  This class contains the level thresholds, the current
+ *  level of every object and the count of objects at each
+ *  level in the current frame.
+ ***********************************************************/
+class LodSelector
+{
+public:
+	// constructor
+	LodSelector();
+
+	// most levels of detail of a mesh
+	static const int MAX_LEVELS = 4;
+
+	// set the smallest radius in pixels of every level but the
+	// coarsest, finest level first
+	void SetThresholds(const float* minimumRadii, int levelCount);
+	// fraction a radius must pass a threshold by to change level
+	void SetHysteresis(float fraction) { m_hysteresis = fraction; }
+	int GetLevelCount() const { return(m_levelCount); }
+
+	// forget the levels of every object
+	void Clear();
+	// start counting the objects at each level
+	void BeginFrame();
+	// choose the level of an object for its radius in pixels
+	int SelectLevel(int objectIndex, float screenRadius);
+	// objects at a level in the current frame
+	int GetLevelObjectCount(int level) const;
+
+	// radius in pixels of a world space sphere seen by the camera
+	static float ProjectedRadius(const CAMERA_VIEW& cameraView, glm::vec3 center, float radius);
+
+private:
+	// smallest radius in pixels of each level
+	float m_minimumRadii[MAX_LEVELS];
+	int m_levelCount;
+	float m_hysteresis;
+	// current level of every object, or -1 before its first frame
+	std::vector<int> m_objectLevels;
+	// objects at each level in the current frame
+	int m_levelObjects[MAX_LEVELS];
+};
@@ -1,5 +1,8 @@
 #include <iostream>         // error handling and output
-#include <cstdlib>          // EXIT_FAILURE
+#include <cerrno>           // strtol range errors
+#include <cstdlib>          // EXIT_FAILURE, strtol
+#include <cstring>          // strcmp
+#include <string>           // benchmark output file name
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -13,12 +16,36 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "UniformCache.h"
+#include "LightClusterer.h"
+#include "RenderStateCache.h"
+#include "FrameBenchmark.h"
+#include "Profiler.h"
+#include "TextureCompressor.h"
+#include "TagRegistry.h"
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+#include "VertexPacker.h"
+#include "MeshOptimizer.h"
+#include "TransformCache.h"
 
 // Namespace for declaring global variables
 namespace
 {
 	// Macro for window title
 	const char* const WINDOW_TITLE = "7-1 FinalProject and Milestones"; 
+	// shader files of the scene program
+	const char* const VERTEX_SHADER_PATH = "shaders/vertexShader.glsl";
+	const char* const FRAGMENT_SHADER_PATH = "shaders/fragmentShader.glsl";
+
+	// number of frames and output file of the headless benchmark
+	const int DEFAULT_BENCHMARK_FRAMES = 300;
+	const int MAX_BENCHMARK_FRAMES = 1000000;
+	const char* const DEFAULT_BENCHMARK_OUTPUT = "benchmark.json";
+	// largest texture budget whose size in bytes fits a 32 bit size_t
+	const int MAX_TEXTURE_BUDGET_MEGABYTES = 4095;
+	// Chrome trace file written when profiling
+	const char* const DEFAULT_TRACE_OUTPUT = "profile_trace.json";
 
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
@@ -29,12 +56,21 @@ namespace
 	ShaderManager* g_ShaderManager = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// uniform cache object for setting shader values without name lookups
+	UniformCache* g_UniformCache = nullptr;
+	// state cache object for dropping redundant texture and vertex array binds
+	RenderStateCache* g_StateCache = nullptr;
+	// profiler object for measuring the CPU and GPU time of the frame scopes
+	Profiler* g_Profiler = nullptr;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
-bool InitializeGLFW();
+bool InitializeGLFW(bool bHeadless);
 bool InitializeGLEW();
+bool ParseIntegerOption(const char* optionName, const char* text, int minimum, int maximum, int& value);
+int RunBenchmark(const char* benchmarkName);
+int RunHeadlessBenchmark(int frameCount, const std::string& outputFile);
 
 
 /***********************************************************
@@ -45,8 +81,101 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// headless mode renders a fixed number of benchmark frames
+	// offscreen instead of opening the interactive window
+	bool bHeadless = false;
+	int benchmarkFrames = DEFAULT_BENCHMARK_FRAMES;
+	std::string benchmarkOutput = DEFAULT_BENCHMARK_OUTPUT;
+	// profiling prints scope statistics and writes a trace on exit
+	bool bProfile = false;
+	std::string traceOutput = DEFAULT_TRACE_OUTPUT;
+	// compressed formats the scene textures are stored in
+	TEXTURE_COMPRESSION textureCompression = COMPRESSION_BC1_BC3;
+	// most texture memory in megabytes, zero for no limit
+	int textureBudgetMegabytes = 0;
+	// hidden objects are skipped with occlusion queries
+	bool bOcclusionCulling = true;
+	// depth only pass before shading, and the overdraw view
+	bool bDepthPrepass = false;
+	bool bShowOverdraw = false;
+	// the frame is submitted with indirect draws when supported
+	bool bIndirectDraws = true;
+
+	for (int i = 1; i < argc; i++)
+	{
+		// run a named CPU benchmark instead of the application
+		if ((strcmp(argv[i], "--bench") == 0) && (i + 1 < argc))
+		{
+			return(RunBenchmark(argv[i + 1]));
+		}
+		else if (strcmp(argv[i], "--headless") == 0)
+		{
+			bHeadless = true;
+		}
+		else if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc))
+		{
+			if (ParseIntegerOption("--frames", argv[++i], 1, MAX_BENCHMARK_FRAMES, benchmarkFrames) == false)
+			{
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--output") == 0) && (i + 1 < argc))
+		{
+			benchmarkOutput = argv[++i];
+		}
+		else if (strcmp(argv[i], "--profile") == 0)
+		{
+			bProfile = true;
+		}
+		else if ((strcmp(argv[i], "--trace") == 0) && (i + 1 < argc))
+		{
+			bProfile = true;
+			traceOutput = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--texture-compression") == 0) && (i + 1 < argc))
+		{
+			i++;
+			if (strcmp(argv[i], "none") == 0)
+				textureCompression = COMPRESSION_NONE;
+			else if (strcmp(argv[i], "bc") == 0)
+				textureCompression = COMPRESSION_BC1_BC3;
+			else if (strcmp(argv[i], "bc7") == 0)
+				textureCompression = COMPRESSION_BC7;
+			else
+			{
+				std::cout << "Unknown texture compression:" << argv[i] << std::endl;
+				std::cout << "Available texture compressions: none, bc, bc7" << std::endl;
+				return(EXIT_FAILURE);
+			}
+		}
+		else if ((strcmp(argv[i], "--texture-budget") == 0) && (i + 1 < argc))
+		{
+			// zero turns the budget off
+			if (ParseIntegerOption("--texture-budget", argv[++i], 0, MAX_TEXTURE_BUDGET_MEGABYTES, textureBudgetMegabytes) == false)
+			{
+				return(EXIT_FAILURE);
+			}
+		}
+		else if (strcmp(argv[i], "--no-occlusion") == 0)
+		{
+			bOcclusionCulling = false;
+		}
+		else if (strcmp(argv[i], "--depth-prepass") == 0)
+		{
+			bDepthPrepass = true;
+		}
+		else if (strcmp(argv[i], "--overdraw") == 0)
+		{
+			bShowOverdraw = true;
+		}
+		else if (strcmp(argv[i], "--no-indirect") == 0)
+		{
+			bIndirectDraws = false;
+		}
+	}
+
 	// if GLFW fails initialization, then terminate the application
-	if (InitializeGLFW() == false)
+	if (InitializeGLFW(bHeadless) == false)
 	{
 		return(EXIT_FAILURE);
 	}
@@ -59,6 +188,10 @@ int main(int argc, char* argv[])
 
 	// try to create the main display window
 	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
+	if (g_Window == NULL)
+	{
+		return(EXIT_FAILURE);
+	}
 
 	// if GLEW fails initialization, then terminate the application
 	if (InitializeGLEW() == false)
@@ -67,18 +200,53 @@ int main(int argc, char* argv[])
 	}
 
 	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"shaders/vertexShader.glsl", "shaders/fragmentShader.glsl");
+	g_ShaderManager->LoadShaders(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
 	g_ShaderManager->use();
 
+	// resolve the locations of all the active shader uniforms once
+	GLint programID = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &programID);
+	g_UniformCache = new UniformCache();
+	g_UniformCache->LoadProgramUniforms((GLuint)programID);
+	g_ViewManager->SetUniformCache(g_UniformCache);
+	g_StateCache = new RenderStateCache();
+
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
+	g_SceneManager = new SceneManager(g_ShaderManager, g_UniformCache, g_StateCache);
+	g_SceneManager->SetTextureCompression(textureCompression);
+	g_SceneManager->SetVertexShaderPath(VERTEX_SHADER_PATH);
+	g_SceneManager->SetTextureBudget((textureBudgetMegabytes > 0) ? (size_t)textureBudgetMegabytes * 1024 * 1024 : 0);
 	g_SceneManager->PrepareScene();
+	if (bOcclusionCulling == false)
+	{
+		g_SceneManager->SetOcclusionCulling(false);
+	}
+	g_SceneManager->SetDepthPrepass(bDepthPrepass);
+	g_SceneManager->SetOverdrawView(bShowOverdraw);
+	g_SceneManager->SetIndirectDraws(bIndirectDraws);
+
+	// the profiler only measures when profiling was requested
+	g_Profiler = new Profiler();
+	g_Profiler->SetEnabled(bProfile);
+	g_SceneManager->SetProfiler(g_Profiler);
+	int frameScope = g_Profiler->RegisterScope("frame");
+	int viewScope = g_Profiler->RegisterScope("view setup");
+	int renderScope = g_Profiler->RegisterScope("render scene");
+	int swapScope = g_Profiler->RegisterScope("swap");
+
+	int exitCode = EXIT_SUCCESS;
+	if (bHeadless == true)
+	{
+		exitCode = RunHeadlessBenchmark(benchmarkFrames, benchmarkOutput);
+	}
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
-	while (!glfwWindowShouldClose(g_Window))
+	while ((bHeadless == false) && (!glfwWindowShouldClose(g_Window)))
 	{
+		g_Profiler->BeginFrame();
+		g_Profiler->BeginScope(frameScope);
+
 		// Enable z-depth
 		glEnable(GL_DEPTH_TEST);
 
@@ -86,20 +254,53 @@ int main(int argc, char* argv[])
 		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		// count the issued and filtered state calls of this frame
+		g_UniformCache->ResetCounters();
+		g_StateCache->ResetCounters();
+
 		// convert from 3D object space to 2D view
+		g_Profiler->BeginScope(viewScope);
 		g_ViewManager->PrepareSceneView();
+		g_Profiler->EndScope();
 
-		// refresh the 3D scene
+		// refresh the 3D scene - the point lights are clustered
+		// for the camera of this frame
+		g_Profiler->BeginScope(renderScope);
+		g_SceneManager->SetCameraView(g_ViewManager->GetCameraView());
 		g_SceneManager->RenderScene();
+		g_Profiler->EndScope();
 
+		// report the scene object clicked with the mouse
+		glm::vec3 pickOrigin;
+		glm::vec3 pickDirection;
+		if (g_ViewManager->GetPickRay(pickOrigin, pickDirection) == true)
+		{
+			int pickedObject = g_SceneManager->PickObject(pickOrigin, pickDirection);
+			if (pickedObject >= 0)
+			{
+				std::cout << "Picked scene object:" << pickedObject << std::endl;
+			}
+		}
 
 		// Flips the the back buffer with the front buffer every frame.
+		g_Profiler->BeginScope(swapScope);
 		glfwSwapBuffers(g_Window);
+		g_Profiler->EndScope();
+
+		g_Profiler->EndScope();
+		g_Profiler->EndFrame();
 
 		// query the latest GLFW events
 		glfwPollEvents();
 	}
 
+	if (bProfile == true)
+	{
+		g_Profiler->Flush();
+		g_Profiler->PrintStatistics();
+		g_Profiler->WriteChromeTrace(traceOutput);
+	}
+
 	// clear the allocated manager objects from memory
 	if (NULL != g_SceneManager)
 	{
@@ -111,14 +312,29 @@ int main(int argc, char* argv[])
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_Profiler)
+	{
+		delete g_Profiler;
+		g_Profiler = NULL;
+	}
+	if (NULL != g_StateCache)
+	{
+		delete g_StateCache;
+		g_StateCache = NULL;
+	}
+	if (NULL != g_UniformCache)
+	{
+		delete g_UniformCache;
+		g_UniformCache = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
 		g_ShaderManager = NULL;
 	}
 
-	// Terminates the program successfully
-	exit(EXIT_SUCCESS); 
+	// Terminates the program
+	exit(exitCode); 
 }
 
 /***********************************************************
@@ -126,11 +342,22 @@ int main(int argc, char* argv[])
  * 
  *  This function is used to initialize the GLFW library.   
  ***********************************************************/
-bool InitializeGLFW()
+bool InitializeGLFW(bool bHeadless)
 {
 	// GLFW: initialize and configure library
 	// --------------------------------------
-	glfwInit();
+#if (GLFW_VERSION_MAJOR > 3) || ((GLFW_VERSION_MAJOR == 3) && (GLFW_VERSION_MINOR >= 4))
+	// the null platform runs without a display server
+	if (bHeadless == true)
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
+	if (glfwInit() == GLFW_FALSE)
+	{
+		std::cout << "Failed to initialize GLFW" << std::endl;
+		return(false);
+	}
 
 #ifdef __APPLE__
 	// set the version of OpenGL and profile to use
@@ -143,6 +370,17 @@ bool InitializeGLFW()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #endif
+
+	// headless mode uses a hidden window with a software rendered
+	// OSMesa context - the shaders only need OpenGL 3.3
+	if (bHeadless == true)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+	}
 	// GLFW: end -------------------------------
 
 	return(true);
@@ -173,4 +411,113 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
 	return(true);
+}
+
+/***********************************************************
+ *	ParseIntegerOption()
+ *
+ *  This function is used to read the whole number value of
+ *  a command line option.  Text that is not a number, has
+ *  trailing characters or is outside the passed in range is
+ *  reported and false is returned.
+ ***********************************************************/
+bool ParseIntegerOption(const char* optionName, const char* text, int minimum, int maximum, int& value)
+{
+	char* pEnd = NULL;
+	errno = 0;
+	long parsed = strtol(text, &pEnd, 10);
+	if ((pEnd == text) || (*pEnd != '\0') || (errno == ERANGE) ||
+		(parsed < minimum) || (parsed > maximum))
+	{
+		std::cout << "Invalid value for " << optionName << ":" << text << std::endl;
+		std::cout << "Expected a whole number from " << minimum << " to " << maximum << std::endl;
+		return(false);
+	}
+
+	value = (int)parsed;
+	return(true);
+}
+
+/***********************************************************
+ *	RunBenchmark()
+ *
+ *  This function is used to run the CPU benchmark with the
+ *  passed in name.  No window or OpenGL context is created.
+ ***********************************************************/
+int RunBenchmark(const char* benchmarkName)
+{
+	if (strcmp(benchmarkName, "clusters") == 0)
+	{
+		LightClusterer::RunBinningBenchmark();
+		return(EXIT_SUCCESS);
+	}
+	if (strcmp(benchmarkName, "compression") == 0)
+	{
+		TextureCompressor::RunCompressionBenchmark();
+		return(EXIT_SUCCESS);
+	}
+	if (strcmp(benchmarkName, "registry") == 0)
+	{
+		TagRegistry::RunLookupBenchmark();
+		return(EXIT_SUCCESS);
+	}
+	if (strcmp(benchmarkName, "culling") == 0)
+	{
+		FrustumCuller::RunCullingBenchmark();
+		return(EXIT_SUCCESS);
+	}
+	if (strcmp(benchmarkName, "bvh") == 0)
+	{
+		SceneBVH::RunBVHBenchmark();
+		return(EXIT_SUCCESS);
+	}
+	if (strcmp(benchmarkName, "vertices") == 0)
+	{
+		VertexPacker::RunVertexBenchmark();
+		return(EXIT_SUCCESS);
+	}
+	if (strcmp(benchmarkName, "meshes") == 0)
+	{
+		MeshOptimizer::RunOptimizerBenchmark();
+		return(EXIT_SUCCESS);
+	}
+	if (strcmp(benchmarkName, "transforms") == 0)
+	{
+		TransformCache::RunTransformBenchmark();
+		return(EXIT_SUCCESS);
+	}
+
+	std::cout << "Unknown benchmark:" << benchmarkName << std::endl;
+	std::cout << "Available benchmarks: clusters, compression, registry, culling, bvh, vertices, meshes, transforms" << std::endl;
+	return(EXIT_FAILURE);
+}
+
+/***********************************************************
+ *	RunHeadlessBenchmark()
+ *
+ *  This function is used to render the benchmark frames
+ *  offscreen along the scripted camera path and write the
+ *  per-frame timings to the passed in JSON file.
+ ***********************************************************/
+int RunHeadlessBenchmark(int frameCount, const std::string& outputFile)
+{
+	const CAMERA_VIEW& cameraView = g_ViewManager->GetCameraView();
+
+	FrameBenchmark benchmark(g_ViewManager, g_SceneManager, g_UniformCache, g_StateCache);
+	benchmark.SetProfiler(g_Profiler);
+	if (benchmark.CreateFramebuffer(cameraView.viewportWidth, cameraView.viewportHeight) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+	if (benchmark.Run(frameCount) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+	if (benchmark.WriteResults(outputFile) == false)
+	{
+		return(EXIT_FAILURE);
+	}
+
+	std::cout << "Benchmark of " << frameCount << " frames written to " << outputFile << std::endl;
+	return(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -0,0 +1,354 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshBuffer.cpp
+// ============
+// pack every primitive mesh into one vertex buffer and one index buffer
+//
+//  The meshes are packed and appended to a single vertex buffer and a
+//  single index buffer, and each keeps its first index and base vertex.
+//  All of them draw from one vertex array, so switching meshes does not
+//  rebind any vertex state.  A frame can be drawn one mesh at a time
+//  with glDrawElementsBaseVertex, or as a list of draw commands built on
+//  the CPU and submitted with glMultiDrawElementsIndirect, where each
+//  command reads its model matrix, material and texture location from
+//  the instance data.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshBuffer.h"
+
+/***********************************************************
+ *  MeshBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MeshBuffer::MeshBuffer(RenderStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_vao = 0;
+	m_commandVao = 0;
+	m_instanceVBO = 0;
+	m_commandBuffer = 0;
+	m_instanceCapacity = 0;
+	m_commandCapacity = 0;
+}
+
+/***********************************************************
+ *  ~MeshBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MeshBuffer::~MeshBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  AddMesh()
+ *
+ *  This method is used for packing a mesh and appending it
+ *  to the shared vertex and index data.  Its indices are
+ *  kept relative to its own first vertex, which is passed
+ *  as the base vertex when it is drawn.
+ ***********************************************************/
+int MeshBuffer::AddMesh(const MESH_DATA& mesh)
+{
+	PACKED_MESH_DATA packed;
+	if ((IsCreated() == true) || (mesh.vertices.size() == 0) || (mesh.indices.size() == 0) ||
+		(VertexPacker::PackMesh(mesh, packed) == false))
+	{
+		return(-1);
+	}
+
+	MESH_RANGE range;
+	range.firstIndex = (GLuint)m_indices.size();
+	range.indexCount = (GLsizei)packed.indices.size();
+	range.baseVertex = (GLint)m_vertices.size();
+
+	m_vertices.insert(m_vertices.end(), packed.vertices.begin(), packed.vertices.end());
+	m_indices.insert(m_indices.end(), packed.indices.begin(), packed.indices.end());
+	m_meshes.push_back(range);
+
+	return((int)m_meshes.size() - 1);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for uploading the added meshes into
+ *  the shared buffers and creating the vertex array that
+ *  draws them.  When the context can draw indirectly, a
+ *  second vertex array also reads the instance data of the
+ *  command list.
+ ***********************************************************/
+bool MeshBuffer::Create()
+{
+	if ((IsCreated() == true) || (m_meshes.size() == 0))
+	{
+		return(false);
+	}
+
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(PACKED_VERTEX), m_vertices.data(), GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+	glGenBuffers(1, &m_ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int), m_indices.data(), GL_STATIC_DRAW);
+	VertexPacker::SetupVertexAttributes(m_vbo);
+
+	if (IsIndirectSupported() == true)
+	{
+		glGenBuffers(1, &m_instanceVBO);
+		glGenBuffers(1, &m_commandBuffer);
+
+		glGenVertexArrays(1, &m_commandVao);
+		glBindVertexArray(m_commandVao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+		VertexPacker::SetupVertexAttributes(m_vbo);
+		InstancedMesh::SetupInstanceAttributes(m_instanceVBO);
+	}
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// the vertex array was changed outside of the state cache
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateVertexArray();
+	}
+
+	// the data lives on the GPU now
+	m_vertices.clear();
+	m_vertices.shrink_to_fit();
+	m_indices.clear();
+	m_indices.shrink_to_fit();
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing all of the buffers and
+ *  vertex arrays and forgetting the added meshes.
+ ***********************************************************/
+void MeshBuffer::Destroy()
+{
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+	}
+	if (m_commandVao != 0)
+	{
+		glDeleteVertexArrays(1, &m_commandVao);
+		m_commandVao = 0;
+	}
+	// a deleted vertex array name can be handed out again
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateVertexArray();
+	}
+
+	GLuint* buffers[] = { &m_vbo, &m_ebo, &m_instanceVBO, &m_commandBuffer };
+	for (int i = 0; i < 4; i++)
+	{
+		if (*buffers[i] != 0)
+		{
+			glDeleteBuffers(1, buffers[i]);
+			*buffers[i] = 0;
+		}
+	}
+
+	m_instanceCapacity = 0;
+	m_commandCapacity = 0;
+	m_meshes.clear();
+	m_vertices.clear();
+	m_indices.clear();
+	m_commands.clear();
+	m_instances.clear();
+}
+
+/***********************************************************
+ *  IsIndirectSupported()
+ *
+ *  This method is used for checking whether the context can
+ *  draw a command list with glMultiDrawElementsIndirect.
+ *  The commands start at their own instance data, which
+ *  needs the base instance of OpenGL 4.2.
+ ***********************************************************/
+bool MeshBuffer::IsIndirectSupported()
+{
+	bool bMultiDraw = (GLEW_VERSION_4_3) || (GLEW_ARB_multi_draw_indirect);
+	bool bBaseInstance = (GLEW_VERSION_4_2) || (GLEW_ARB_base_instance);
+
+	return((bMultiDraw == true) && (bBaseInstance == true));
+}
+
+/***********************************************************
+ *  GetIndexCount()
+ *
+ *  This method is used for getting the number of indices of
+ *  a mesh.
+ ***********************************************************/
+GLsizei MeshBuffer::GetIndexCount(int meshIndex) const
+{
+	if ((meshIndex < 0) || (meshIndex >= (int)m_meshes.size()))
+	{
+		return(0);
+	}
+
+	return(m_meshes[meshIndex].indexCount);
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is used for binding a vertex array.  With a
+ *  state cache it stays bound, so drawing mesh after mesh
+ *  binds it only once.
+ ***********************************************************/
+void MeshBuffer::BindVertexArray(GLuint vao)
+{
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->BindVertexArray(vao);
+	}
+	else
+	{
+		glBindVertexArray(vao);
+	}
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing one mesh from the shared
+ *  buffers with the uniforms that are already set.
+ ***********************************************************/
+void MeshBuffer::DrawMesh(int meshIndex)
+{
+	if ((IsCreated() == false) || (meshIndex < 0) || (meshIndex >= (int)m_meshes.size()))
+	{
+		return;
+	}
+
+	const MESH_RANGE& range = m_meshes[meshIndex];
+	BindVertexArray(m_vao);
+	glDrawElementsBaseVertex(
+		GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+		(void*)(sizeof(unsigned int) * range.firstIndex), range.baseVertex);
+	if (NULL == m_pStateCache)
+	{
+		glBindVertexArray(0);
+	}
+}
+
+/***********************************************************
+ *  ClearCommands()
+ *
+ *  This method is used for starting a new command list.
+ ***********************************************************/
+void MeshBuffer::ClearCommands()
+{
+	m_commands.clear();
+	m_instances.clear();
+}
+
+/***********************************************************
+ *  AddCommand()
+ *
+ *  This method is used for adding a command that draws a
+ *  mesh once for each of the passed in instances.  The base
+ *  instance points the command at its own instance data.
+ ***********************************************************/
+void MeshBuffer::AddCommand(int meshIndex, const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	if ((meshIndex < 0) || (meshIndex >= (int)m_meshes.size()) || (instanceCount <= 0))
+	{
+		return;
+	}
+
+	const MESH_RANGE& range = m_meshes[meshIndex];
+
+	DRAW_ELEMENTS_COMMAND command;
+	command.count = (GLuint)range.indexCount;
+	command.instanceCount = (GLuint)instanceCount;
+	command.firstIndex = range.firstIndex;
+	command.baseVertex = range.baseVertex;
+	command.baseInstance = (GLuint)m_instances.size();
+
+	m_commands.push_back(command);
+	m_instances.insert(m_instances.end(), pInstances, pInstances + instanceCount);
+}
+
+/***********************************************************
+ *  UploadCommands()
+ *
+ *  This method is used for uploading the command list and
+ *  its instance data.  The buffers are only reallocated
+ *  when the list grows beyond their current capacity.
+ ***********************************************************/
+void MeshBuffer::UploadCommands()
+{
+	if ((IsIndirectReady() == false) || (m_commands.size() == 0))
+	{
+		return;
+	}
+
+	int instanceCount = (int)m_instances.size();
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	if (instanceCount > m_instanceCapacity)
+	{
+		glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(INSTANCE_DATA), m_instances.data(), GL_DYNAMIC_DRAW);
+		m_instanceCapacity = instanceCount;
+	}
+	else
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instanceCount * sizeof(INSTANCE_DATA), m_instances.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	int commandCount = (int)m_commands.size();
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	if (commandCount > m_commandCapacity)
+	{
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, commandCount * sizeof(DRAW_ELEMENTS_COMMAND), m_commands.data(), GL_DYNAMIC_DRAW);
+		m_commandCapacity = commandCount;
+	}
+	else
+	{
+		glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commandCount * sizeof(DRAW_ELEMENTS_COMMAND), m_commands.data());
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DrawCommands()
+ *
+ *  This method is used for drawing a run of the uploaded
+ *  commands with one glMultiDrawElementsIndirect call.  The
+ *  shader reads the model, material and texture location of
+ *  each draw from its instance data.
+ ***********************************************************/
+void MeshBuffer::DrawCommands(int firstCommand, int commandCount)
+{
+	if ((IsIndirectReady() == false) || (firstCommand < 0) || (commandCount <= 0) ||
+		(firstCommand + commandCount > (int)m_commands.size()))
+	{
+		return;
+	}
+
+	BindVertexArray(m_commandVao);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(
+		GL_TRIANGLES, GL_UNSIGNED_INT,
+		(void*)(sizeof(DRAW_ELEMENTS_COMMAND) * firstCommand), commandCount, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	if (NULL == m_pStateCache)
+	{
+		glBindVertexArray(0);
+	}
+}
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshBuffer.h
+// ============
+// pack every primitive mesh into one vertex buffer and one index buffer
+//
+//  The meshes are packed and appended to a single vertex buffer and a
+//  single index buffer, and each keeps its first index and base vertex.
+//  All of them draw from one vertex array, so switching meshes does not
+//  rebind any vertex state.  A frame can be drawn one mesh at a time
+//  with glDrawElementsBaseVertex, or as a list of draw commands built on
+//  the CPU and submitted with glMultiDrawElementsIndirect, where each
+//  command reads its model matrix, material and texture location from
+//  the instance data.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "InstancedMesh.h"
+#include "MeshGenerator.h"
+#include "VertexPacker.h"
+#include "RenderStateCache.h"
+#include <GL/glew.h>
+#include <vector>
+
+/***********************************************************
+ *  MeshBuffer
+ *
+ *  This class manages the shared geometry buffers, the
+ *  range of each mesh within them, and the instance and
+ *  indirect command buffers of the current frame.
+ ***********************************************************/
+class MeshBuffer
+{
+public:
+	// constructor - the state cache filters the vertex array binds
+	MeshBuffer(RenderStateCache* pStateCache = NULL);
+	// destructor
+	~MeshBuffer();
+
+	// append a mesh before the buffers are created and return its index
+	int AddMesh(const MESH_DATA& mesh);
+	// upload all of the added meshes
+	bool Create();
+	// free the buffers and forget the meshes
+	void Destroy();
+	bool IsCreated() const { return(m_vao != 0); }
+
+	// whether the context can draw the command list indirectly
+	static bool IsIndirectSupported();
+	// whether the command list can be drawn with this buffer
+	bool IsIndirectReady() const { return(m_commandVao != 0); }
+
+	// number of indices of a mesh
+	GLsizei GetIndexCount(int meshIndex) const;
+	// draw one mesh with the shader values already set
+	void DrawMesh(int meshIndex);
+
+	// start a new list of draw commands
+	void ClearCommands();
+	// add a command drawing a mesh once for each instance
+	void AddCommand(int meshIndex, const INSTANCE_DATA* pInstances, int instanceCount);
+	int GetCommandCount() const { return((int)m_commands.size()); }
+	// upload the commands and their instance data
+	void UploadCommands();
+	// draw a run of the uploaded commands with one call
+	void DrawCommands(int firstCommand, int commandCount);
+
+private:
+	// the layout read by glMultiDrawElementsIndirect
+	struct DRAW_ELEMENTS_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// where a mesh lives in the shared buffers
+	struct MESH_RANGE
+	{
+		GLuint firstIndex;
+		GLsizei indexCount;
+		GLint baseVertex;
+	};
+
+	// meshes added so far, and their data until it is uploaded
+	std::vector<MESH_RANGE> m_meshes;
+	std::vector<PACKED_VERTEX> m_vertices;
+	std::vector<unsigned int> m_indices;
+	// shared geometry and the vertex array drawing single meshes
+	GLuint m_vbo;
+	GLuint m_ebo;
+	GLuint m_vao;
+	// vertex array with the instance attributes, and the instance
+	// and command buffers of the command list
+	GLuint m_commandVao;
+	GLuint m_instanceVBO;
+	GLuint m_commandBuffer;
+	int m_instanceCapacity;
+	int m_commandCapacity;
+	std::vector<DRAW_ELEMENTS_COMMAND> m_commands;
+	std::vector<INSTANCE_DATA> m_instances;
+	// filters the vertex array binds, or NULL
+	RenderStateCache* m_pStateCache;
+
+	// bind a vertex array through the state cache when there is one
+	void BindVertexArray(GLuint vao);
+};
@@ -0,0 +1,275 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshGenerator.cpp
+// ============
+// generate vertex and index data for the basic primitive shapes
+//
+//  Generated meshes use the same unit dimensions as the ShapeMeshes
+//  primitives so they can be drawn with the same scene transforms.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshGenerator.h"
+
+#include <glm/glm.hpp>
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	const float g_PI = 3.14159265358979f;
+
+	// append one interleaved vertex and return its index
+	unsigned int AddVertex(MESH_DATA& mesh, glm::vec3 position, glm::vec3 normal, float u, float v)
+	{
+		unsigned int index = (unsigned int)(mesh.vertices.size() / MeshGenerator::FLOATS_PER_VERTEX);
+		mesh.vertices.push_back(position.x);
+		mesh.vertices.push_back(position.y);
+		mesh.vertices.push_back(position.z);
+		mesh.vertices.push_back(normal.x);
+		mesh.vertices.push_back(normal.y);
+		mesh.vertices.push_back(normal.z);
+		mesh.vertices.push_back(u);
+		mesh.vertices.push_back(v);
+		return(index);
+	}
+
+	// append a flat triangle with its corners in counterclockwise
+	// order seen from the front
+	void AddTriangle(MESH_DATA& mesh, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+	{
+		glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+		mesh.indices.push_back(AddVertex(mesh, p0, normal, 0.0f, 0.0f));
+		mesh.indices.push_back(AddVertex(mesh, p1, normal, 1.0f, 0.0f));
+		mesh.indices.push_back(AddVertex(mesh, p2, normal, 0.5f, 1.0f));
+	}
+
+	// append a flat quad with its corners in counterclockwise order
+	// seen from the front, textured with the whole image
+	void AddQuad(MESH_DATA& mesh, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3)
+	{
+		glm::vec3 normal = glm::normalize(glm::cross(p1 - p0, p2 - p0));
+		unsigned int first = AddVertex(mesh, p0, normal, 0.0f, 0.0f);
+		AddVertex(mesh, p1, normal, 1.0f, 0.0f);
+		AddVertex(mesh, p2, normal, 1.0f, 1.0f);
+		AddVertex(mesh, p3, normal, 0.0f, 1.0f);
+
+		mesh.indices.push_back(first);
+		mesh.indices.push_back(first + 1);
+		mesh.indices.push_back(first + 2);
+		mesh.indices.push_back(first);
+		mesh.indices.push_back(first + 2);
+		mesh.indices.push_back(first + 3);
+	}
+}
+
+/***********************************************************
+ *  BuildPlane()
+ *
+ *  This method is used for generating a plane facing up that
+ *  spans from -1 to 1 in x and z.
+ ***********************************************************/
+void MeshGenerator::BuildPlane(MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	AddQuad(mesh,
+		glm::vec3(-1.0f, 0.0f, 1.0f), glm::vec3(1.0f, 0.0f, 1.0f),
+		glm::vec3(1.0f, 0.0f, -1.0f), glm::vec3(-1.0f, 0.0f, -1.0f));
+}
+
+/***********************************************************
+ *  BuildPrism()
+ *
+ *  This method is used for generating a prism whose front
+ *  and back are triangles with the point at the top, filling
+ *  the unit cube centered at the origin.  Every face has its
+ *  own vertices so the edges stay sharp.
+ ***********************************************************/
+void MeshGenerator::BuildPrism(MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	glm::vec3 frontLeft(-0.5f, -0.5f, 0.5f);
+	glm::vec3 frontRight(0.5f, -0.5f, 0.5f);
+	glm::vec3 frontTop(0.0f, 0.5f, 0.5f);
+	glm::vec3 backLeft(-0.5f, -0.5f, -0.5f);
+	glm::vec3 backRight(0.5f, -0.5f, -0.5f);
+	glm::vec3 backTop(0.0f, 0.5f, -0.5f);
+
+	AddTriangle(mesh, frontLeft, frontRight, frontTop);
+	AddTriangle(mesh, backRight, backLeft, backTop);
+	AddQuad(mesh, backLeft, backRight, frontRight, frontLeft);
+	AddQuad(mesh, frontRight, backRight, backTop, frontTop);
+	AddQuad(mesh, backLeft, frontLeft, frontTop, backTop);
+}
+
+/***********************************************************
+ *  BuildBox()
+ *
+ *  This method is used for generating a cube with sides of
+ *  1 centered at the origin.  Every face has its own
+ *  vertices and the whole texture.
+ ***********************************************************/
+void MeshGenerator::BuildBox(MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	// the eight corners, named by their sides in x, y and z
+	glm::vec3 lbf(-0.5f, -0.5f, 0.5f);
+	glm::vec3 rbf(0.5f, -0.5f, 0.5f);
+	glm::vec3 rtf(0.5f, 0.5f, 0.5f);
+	glm::vec3 ltf(-0.5f, 0.5f, 0.5f);
+	glm::vec3 lbb(-0.5f, -0.5f, -0.5f);
+	glm::vec3 rbb(0.5f, -0.5f, -0.5f);
+	glm::vec3 rtb(0.5f, 0.5f, -0.5f);
+	glm::vec3 ltb(-0.5f, 0.5f, -0.5f);
+
+	AddQuad(mesh, lbf, rbf, rtf, ltf);		// front
+	AddQuad(mesh, rbb, lbb, ltb, rtb);		// back
+	AddQuad(mesh, rbf, rbb, rtb, rtf);		// right
+	AddQuad(mesh, lbb, lbf, ltf, ltb);		// left
+	AddQuad(mesh, ltf, rtf, rtb, ltb);		// top
+	AddQuad(mesh, lbb, rbb, rbf, lbf);		// bottom
+}
+
+/***********************************************************
+ *  BuildCylinder()
+ *
+ *  This method is used for generating a cylinder with a
+ *  radius of 1 standing on the origin with a height of 1,
+ *  closed at both ends.  The side texture wraps once around
+ *  and the caps map the image onto the circle.
+ ***********************************************************/
+void MeshGenerator::BuildCylinder(MESH_DATA& mesh, int slices)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	if (slices < 3)
+		slices = 3;
+
+	mesh.vertices.reserve(((slices + 1) * 4 + 2) * FLOATS_PER_VERTEX);
+	mesh.indices.reserve(slices * 12);
+
+	// side rings at the bottom and top, with normals facing out
+	for (int slice = 0; slice <= slices; slice++)
+	{
+		float u = (float)slice / (float)slices;
+		float theta = 2.0f * g_PI * u;
+		glm::vec3 normal(cosf(theta), 0.0f, sinf(theta));
+
+		AddVertex(mesh, glm::vec3(normal.x, 0.0f, normal.z), normal, u, 0.0f);
+		AddVertex(mesh, glm::vec3(normal.x, 1.0f, normal.z), normal, u, 1.0f);
+	}
+	for (int slice = 0; slice < slices; slice++)
+	{
+		unsigned int bottomLeft = slice * 2;
+		unsigned int topLeft = bottomLeft + 1;
+		unsigned int bottomRight = bottomLeft + 2;
+		unsigned int topRight = bottomLeft + 3;
+
+		mesh.indices.push_back(bottomLeft);
+		mesh.indices.push_back(topLeft);
+		mesh.indices.push_back(bottomRight);
+
+		mesh.indices.push_back(bottomRight);
+		mesh.indices.push_back(topLeft);
+		mesh.indices.push_back(topRight);
+	}
+
+	// caps as triangle fans around their centers - the ring runs
+	// clockwise seen from above, so the top fan is reversed
+	for (int cap = 0; cap < 2; cap++)
+	{
+		float y = (float)cap;
+		glm::vec3 normal(0.0f, (cap == 0) ? -1.0f : 1.0f, 0.0f);
+		unsigned int center = AddVertex(mesh, glm::vec3(0.0f, y, 0.0f), normal, 0.5f, 0.5f);
+
+		for (int slice = 0; slice <= slices; slice++)
+		{
+			float theta = 2.0f * g_PI * (float)slice / (float)slices;
+			float x = cosf(theta);
+			float z = sinf(theta);
+			AddVertex(mesh, glm::vec3(x, y, z), normal, 0.5f + 0.5f * x, 0.5f - 0.5f * z);
+		}
+		for (int slice = 0; slice < slices; slice++)
+		{
+			unsigned int current = center + 1 + slice;
+			mesh.indices.push_back(center);
+			mesh.indices.push_back((cap == 0) ? current : current + 1);
+			mesh.indices.push_back((cap == 0) ? current + 1 : current);
+		}
+	}
+}
+
+/***********************************************************
+ *  BuildSphere()
+ *
+ *  This method is used for generating a UV sphere with a
+ *  radius of 1 that is centered at the origin.  The texture
+ *  coordinates wrap once around the sphere horizontally and
+ *  run from the bottom pole to the top pole vertically.
+ ***********************************************************/
+void MeshGenerator::BuildSphere(MESH_DATA& mesh, int slices, int stacks)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	if (slices < 3)
+		slices = 3;
+	if (stacks < 2)
+		stacks = 2;
+
+	mesh.vertices.reserve((slices + 1) * (stacks + 1) * FLOATS_PER_VERTEX);
+	mesh.indices.reserve(slices * stacks * 6);
+
+	// generate the vertex rings from the bottom pole to the top pole
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		float v = (float)stack / (float)stacks;
+		float phi = g_PI * v - (g_PI / 2.0f);
+		float y = sinf(phi);
+		float ringRadius = cosf(phi);
+
+		for (int slice = 0; slice <= slices; slice++)
+		{
+			float u = (float)slice / (float)slices;
+			float theta = 2.0f * g_PI * u;
+			float x = ringRadius * cosf(theta);
+			float z = ringRadius * sinf(theta);
+
+			// position - the normal of a unit sphere is its position
+			mesh.vertices.push_back(x);
+			mesh.vertices.push_back(y);
+			mesh.vertices.push_back(z);
+			mesh.vertices.push_back(x);
+			mesh.vertices.push_back(y);
+			mesh.vertices.push_back(z);
+			mesh.vertices.push_back(u);
+			mesh.vertices.push_back(v);
+		}
+	}
+
+	// connect each pair of neighboring rings with two triangles per slice
+	int ringVertices = slices + 1;
+	for (int stack = 0; stack < stacks; stack++)
+	{
+		for (int slice = 0; slice < slices; slice++)
+		{
+			unsigned int bottomLeft = stack * ringVertices + slice;
+			unsigned int bottomRight = bottomLeft + 1;
+			unsigned int topLeft = bottomLeft + ringVertices;
+			unsigned int topRight = topLeft + 1;
+
+			mesh.indices.push_back(bottomLeft);
+			mesh.indices.push_back(topLeft);
+			mesh.indices.push_back(bottomRight);
+
+			mesh.indices.push_back(bottomRight);
+			mesh.indices.push_back(topLeft);
+			mesh.indices.push_back(topRight);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshGenerator.h
+// ============
+// generate vertex and index data for the basic primitive shapes
+//
+//  Generated meshes use the same unit dimensions as the ShapeMeshes
+//  primitives so they can be drawn with the same scene transforms.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+
+/***********************************************************
+ *  MESH_DATA
+ *
+ *  Interleaved vertex data - position(3), normal(3) and
+ *  texture coordinate(2) - and triangle list indices.
+ ***********************************************************/
+struct MESH_DATA
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+};
+
+/***********************************************************
+ *  MeshGenerator
+ *
+ *  This class contains the code for generating the vertex
+ *  and index data of the basic primitive shapes on the CPU.
+ ***********************************************************/
+class MeshGenerator
+{
+public:
+	// number of floats for each interleaved vertex
+	static const int FLOATS_PER_VERTEX = 8;
+
+	// generate a plane 2 units wide in x and z at a height of 0
+	static void BuildPlane(MESH_DATA& mesh);
+	// generate a triangular prism in the unit cube centered at the origin
+	static void BuildPrism(MESH_DATA& mesh);
+	// generate a unit cube centered at the origin
+	static void BuildBox(MESH_DATA& mesh);
+	// generate a capped cylinder with a radius of 1 from a height of 0 to 1
+	static void BuildCylinder(MESH_DATA& mesh, int slices);
+	// generate a sphere with a radius of 1 centered at the origin
+	static void BuildSphere(MESH_DATA& mesh, int slices, int stacks);
+};
@@ -0,0 +1,585 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshOptimizer.cpp
+// ============
+// reorder the triangles and vertices of a mesh for the GPU caches
+//
+//  Generated meshes list their triangles ring by ring, so most vertices
+//  have left the post-transform cache before they are used again.  The
+//  triangles are first reordered with Forsyth's linear-speed algorithm,
+//  which scores vertices by their age in a simulated cache and by how
+//  many of their triangles remain.  The result is then cut into clusters
+//  that give up little of the cache locality, and the clusters are
+//  ordered so the ones facing out from the mesh are drawn first and hide
+//  the ones behind them.  Last the vertices are stored in the order they
+//  are first used, so vertex fetches walk memory forward.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MeshOptimizer.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+// declaration of global variables
+namespace
+{
+	// weights of the Forsyth vertex score
+	const float g_LastTriangleScore = 0.75f;
+	const float g_CacheDecayPower = 1.5f;
+	const float g_ValenceBoostScale = 2.0f;
+	const float g_ValenceBoostPower = 0.5f;
+
+	// growth of the vertices per triangle allowed by the clusters
+	const float g_OverdrawThreshold = 1.05f;
+
+	// position of a vertex in the interleaved float layout
+	glm::vec3 GetPosition(const std::vector<float>& vertices, unsigned int index)
+	{
+		const float* pVertex = &vertices[index * MeshGenerator::FLOATS_PER_VERTEX];
+		return(glm::vec3(pVertex[0], pVertex[1], pVertex[2]));
+	}
+
+	// a cluster of triangles and the key it is drawn in order of
+	struct TRIANGLE_CLUSTER
+	{
+		int firstTriangle;
+		int triangleCount;
+		float sortKey;
+	};
+}
+
+/***********************************************************
+ *  OptimizeMesh()
+ *
+ *  This method is used for running every optimization stage
+ *  on a generated mesh.  The stages only reorder, so the
+ *  mesh draws the same triangles as before.
+ ***********************************************************/
+void MeshOptimizer::OptimizeMesh(MESH_DATA& mesh)
+{
+	int vertexCount = (int)(mesh.vertices.size() / MeshGenerator::FLOATS_PER_VERTEX);
+
+	OptimizeVertexCache(mesh.indices, vertexCount);
+	OptimizeOverdraw(mesh.indices, mesh.vertices, g_OverdrawThreshold);
+	OptimizeVertexFetch(mesh.vertices, mesh.indices);
+}
+
+/***********************************************************
+ *  ScoreVertex()
+ *
+ *  This method is used for scoring a vertex.  The three
+ *  vertices of the last triangle get a fixed score, so the
+ *  next triangle does not simply reuse its edge, and older
+ *  cache entries score less the older they are.  Vertices
+ *  with few triangles left get a boost, so they are finished
+ *  rather than left behind as lone triangles.
+ ***********************************************************/
+float MeshOptimizer::ScoreVertex(int cachePosition, int remainingTriangles)
+{
+	if (remainingTriangles == 0)
+	{
+		return(-1.0f);
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			score = g_LastTriangleScore;
+		}
+		else
+		{
+			float scale = 1.0f / (float)(SCORE_CACHE_SIZE - 3);
+			score = powf(1.0f - (float)(cachePosition - 3) * scale, g_CacheDecayPower);
+		}
+	}
+
+	score += g_ValenceBoostScale * powf((float)remainingTriangles, -g_ValenceBoostPower);
+
+	return(score);
+}
+
+/***********************************************************
+ *  OptimizeVertexCache()
+ *
+ *  This method is used for reordering the triangles with
+ *  Forsyth's algorithm.  The triangle with the best score is
+ *  drawn next, and only the vertices in the simulated cache
+ *  change score, so only their triangles are searched.  When
+ *  none of them has a triangle left, the next triangle that
+ *  was not drawn starts a new area.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, int vertexCount)
+{
+	int triangleCount = (int)indices.size() / 3;
+	if ((triangleCount == 0) || (vertexCount == 0))
+	{
+		return;
+	}
+
+	// triangles of each vertex, packed into one list
+	std::vector<int> triangleOffsets(vertexCount + 1, 0);
+	std::vector<int> remaining(vertexCount, 0);
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+	for (int v = 0; v < vertexCount; v++)
+	{
+		triangleOffsets[v + 1] = triangleOffsets[v] + remaining[v];
+	}
+	std::vector<int> vertexTriangles(triangleCount * 3);
+	std::vector<int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			vertexTriangles[fill[indices[t * 3 + corner]]++] = t;
+		}
+	}
+
+	std::vector<int> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (int v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = ScoreVertex(-1, remaining[v]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	for (int t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	std::vector<unsigned char> drawn(triangleCount, 0);
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> nextCache;
+	cache.reserve(SCORE_CACHE_SIZE + 3);
+	nextCache.reserve(SCORE_CACHE_SIZE + 3);
+
+	int bestTriangle = 0;
+	int nextUndrawn = 0;
+	for (int drawnCount = 0; drawnCount < triangleCount; drawnCount++)
+	{
+		if (bestTriangle < 0)
+		{
+			while (drawn[nextUndrawn] != 0)
+			{
+				nextUndrawn++;
+			}
+			bestTriangle = nextUndrawn;
+		}
+
+		drawn[bestTriangle] = 1;
+		const unsigned int* pCorners = &indices[bestTriangle * 3];
+		result.insert(result.end(), pCorners, pCorners + 3);
+
+		// the drawn triangle leaves the lists of its vertices
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int v = pCorners[corner];
+			int first = triangleOffsets[v];
+			int last = first + remaining[v] - 1;
+			for (int k = first; k <= last; k++)
+			{
+				if (vertexTriangles[k] == bestTriangle)
+				{
+					std::swap(vertexTriangles[k], vertexTriangles[last]);
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// the triangle's vertices move to the front of the cache
+		nextCache.assign(pCorners, pCorners + 3);
+		for (int i = 0; i < (int)cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			if ((v != pCorners[0]) && (v != pCorners[1]) && (v != pCorners[2]))
+			{
+				nextCache.push_back(v);
+			}
+		}
+		cache.swap(nextCache);
+
+		// rescore the cached vertices and their triangles, and
+		// drop the ones pushed out of the cache
+		for (int i = 0; i < (int)cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			cachePositions[v] = (i < SCORE_CACHE_SIZE) ? i : -1;
+			float score = ScoreVertex(cachePositions[v], remaining[v]);
+			float change = score - vertexScores[v];
+			vertexScores[v] = score;
+			for (int k = triangleOffsets[v]; k < triangleOffsets[v] + remaining[v]; k++)
+			{
+				triangleScores[vertexTriangles[k]] += change;
+			}
+		}
+		if ((int)cache.size() > SCORE_CACHE_SIZE)
+		{
+			cache.resize(SCORE_CACHE_SIZE);
+		}
+
+		// the best triangle still to draw around the cache
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (int i = 0; i < (int)cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			for (int k = triangleOffsets[v]; k < triangleOffsets[v] + remaining[v]; k++)
+			{
+				int t = vertexTriangles[k];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(result);
+}
+
+/***********************************************************
+ *  OptimizeOverdraw()
+ *
+ *  This method is used for reordering clusters of triangles
+ *  to reduce overdraw, after the cache order is found.  The
+ *  list is cut where the cache was refilled, and cut again
+ *  inside those runs wherever the vertices per triangle of
+ *  the run so far are within the threshold of the whole
+ *  run, so each new cluster costs little cache locality.
+ *  Clusters facing away from the center of the mesh are
+ *  drawn first, since they are the most likely to hide the
+ *  rest of the mesh from any direction.
+ ***********************************************************/
+void MeshOptimizer::OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, float threshold)
+{
+	int triangleCount = (int)indices.size() / 3;
+	int vertexCount = (int)(vertices.size() / MeshGenerator::FLOATS_PER_VERTEX);
+	if ((triangleCount < 2) || (vertexCount == 0))
+	{
+		return;
+	}
+
+	// a FIFO cache simulated with the time each vertex entered it
+	std::vector<int> cacheTimes(vertexCount, -STATS_CACHE_SIZE - 1);
+	int time = 0;
+
+	// hard boundaries where a triangle missed all three vertices
+	std::vector<int> hardBoundaries;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		int misses = 0;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			unsigned int v = indices[t * 3 + corner];
+			if (time - cacheTimes[v] > STATS_CACHE_SIZE)
+			{
+				cacheTimes[v] = time;
+				time++;
+				misses++;
+			}
+		}
+		if ((t == 0) || (misses == 3))
+		{
+			hardBoundaries.push_back(t);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	// soft boundaries inside each run, starting each cluster with
+	// an empty cache so the clusters can be drawn in any order
+	std::vector<int> boundaries;
+	for (int h = 0; h + 1 < (int)hardBoundaries.size(); h++)
+	{
+		int runStart = hardBoundaries[h];
+		int runEnd = hardBoundaries[h + 1];
+
+		time += STATS_CACHE_SIZE + 1;
+		int runMisses = 0;
+		for (int t = runStart; t < runEnd; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = indices[t * 3 + corner];
+				if (time - cacheTimes[v] > STATS_CACHE_SIZE)
+				{
+					cacheTimes[v] = time;
+					time++;
+					runMisses++;
+				}
+			}
+		}
+		float runThreshold = threshold * (float)runMisses / (float)(runEnd - runStart);
+
+		time += STATS_CACHE_SIZE + 1;
+		int clusterStart = runStart;
+		int clusterMisses = 0;
+		boundaries.push_back(runStart);
+		for (int t = runStart; t < runEnd; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int v = indices[t * 3 + corner];
+				if (time - cacheTimes[v] > STATS_CACHE_SIZE)
+				{
+					cacheTimes[v] = time;
+					time++;
+					clusterMisses++;
+				}
+			}
+
+			float clusterAcmr = (float)clusterMisses / (float)(t - clusterStart + 1);
+			if ((t + 1 < runEnd) && (clusterAcmr <= runThreshold))
+			{
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				boundaries.push_back(clusterStart);
+				time += STATS_CACHE_SIZE + 1;
+			}
+		}
+	}
+	boundaries.push_back(triangleCount);
+
+	// area weighted center of the mesh
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (int t = 0; t < triangleCount; t++)
+	{
+		glm::vec3 p0 = GetPosition(vertices, indices[t * 3]);
+		glm::vec3 p1 = GetPosition(vertices, indices[t * 3 + 1]);
+		glm::vec3 p2 = GetPosition(vertices, indices[t * 3 + 2]);
+		float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+		meshCenter = meshCenter + (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	meshCenter = (meshArea > 0.0f) ? meshCenter * (1.0f / meshArea) : GetPosition(vertices, indices[0]);
+
+	// each cluster is keyed by how far its center lies out along
+	// its average normal, seen from the center of the mesh
+	std::vector<TRIANGLE_CLUSTER> clusters;
+	for (int c = 0; c + 1 < (int)boundaries.size(); c++)
+	{
+		TRIANGLE_CLUSTER cluster;
+		cluster.firstTriangle = boundaries[c];
+		cluster.triangleCount = boundaries[c + 1] - boundaries[c];
+
+		glm::vec3 center(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+		for (int t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+		{
+			glm::vec3 p0 = GetPosition(vertices, indices[t * 3]);
+			glm::vec3 p1 = GetPosition(vertices, indices[t * 3 + 1]);
+			glm::vec3 p2 = GetPosition(vertices, indices[t * 3 + 2]);
+			glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(areaNormal);
+			center = center + (p0 + p1 + p2) * (triangleArea / 3.0f);
+			normal = normal + areaNormal;
+			area += triangleArea;
+		}
+
+		cluster.sortKey = 0.0f;
+		float normalLength = glm::length(normal);
+		if ((area > 0.0f) && (normalLength > 0.0f))
+		{
+			center = center * (1.0f / area);
+			cluster.sortKey = glm::dot(center - meshCenter, normal * (1.0f / normalLength));
+		}
+		clusters.push_back(cluster);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const TRIANGLE_CLUSTER& a, const TRIANGLE_CLUSTER& b) { return(a.sortKey > b.sortKey); });
+
+	std::vector<unsigned int> result;
+	result.reserve(indices.size());
+	for (int c = 0; c < (int)clusters.size(); c++)
+	{
+		const unsigned int* pFirst = &indices[clusters[c].firstTriangle * 3];
+		result.insert(result.end(), pFirst, pFirst + clusters[c].triangleCount * 3);
+	}
+
+	indices.swap(result);
+}
+
+/***********************************************************
+ *  OptimizeVertexFetch()
+ *
+ *  This method is used for storing the vertices in the order
+ *  the triangles first use them, so fetching them walks the
+ *  vertex buffer forward.  Vertices no triangle uses are
+ *  dropped.
+ ***********************************************************/
+void MeshOptimizer::OptimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices)
+{
+	const int stride = MeshGenerator::FLOATS_PER_VERTEX;
+	int vertexCount = (int)(vertices.size() / stride);
+
+	std::vector<int> remap(vertexCount, -1);
+	std::vector<float> result;
+	result.reserve(vertices.size());
+	int nextVertex = 0;
+
+	for (int i = 0; i < (int)indices.size(); i++)
+	{
+		unsigned int v = indices[i];
+		if (remap[v] < 0)
+		{
+			remap[v] = nextVertex;
+			nextVertex++;
+			result.insert(result.end(), vertices.begin() + v * stride, vertices.begin() + (v + 1) * stride);
+		}
+		indices[i] = (unsigned int)remap[v];
+	}
+
+	vertices.swap(result);
+}
+
+/***********************************************************
+ *  AnalyzeVertexCache()
+ *
+ *  This method is used for counting how many vertices a
+ *  FIFO cache of the passed in size transforms for a
+ *  triangle list.  The count is reported per triangle
+ *  (ACMR) and per vertex used (ATVR).
+ ***********************************************************/
+MeshOptimizer::CACHE_STATS MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize)
+{
+	CACHE_STATS stats;
+	stats.acmr = 0.0f;
+	stats.atvr = 0.0f;
+
+	int triangleCount = (int)indices.size() / 3;
+	if ((triangleCount == 0) || (vertexCount == 0))
+	{
+		return(stats);
+	}
+
+	std::vector<int> cacheTimes(vertexCount, -cacheSize - 1);
+	std::vector<unsigned char> used(vertexCount, 0);
+	int time = 0;
+	int transformed = 0;
+	int usedCount = 0;
+	for (int i = 0; i < triangleCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		if (time - cacheTimes[v] > cacheSize)
+		{
+			cacheTimes[v] = time;
+			time++;
+			transformed++;
+		}
+		if (used[v] == 0)
+		{
+			used[v] = 1;
+			usedCount++;
+		}
+	}
+
+	stats.acmr = (float)transformed / (float)triangleCount;
+	stats.atvr = (float)transformed / (float)usedCount;
+
+	return(stats);
+}
+
+/***********************************************************
+ *  RunOptimizerBenchmark()
+ *
+ *  This method is used for printing the ACMR and ATVR of
+ *  the generated meshes as they are generated, after the
+ *  vertex cache order, and after the overdraw clusters,
+ *  with the time each stage takes.  The optimized meshes
+ *  are checked to still hold the same triangles.
+ ***********************************************************/
+void MeshOptimizer::RunOptimizerBenchmark()
+{
+	const int meshCount = 5;
+	const char* meshNames[meshCount] = { "sphere 40x20", "sphere 256x128", "cylinder 36", "cylinder 1024", "box" };
+	MESH_DATA meshes[meshCount];
+	MeshGenerator::BuildSphere(meshes[0], 40, 20);
+	MeshGenerator::BuildSphere(meshes[1], 256, 128);
+	MeshGenerator::BuildCylinder(meshes[2], 36);
+	MeshGenerator::BuildCylinder(meshes[3], 1024);
+	MeshGenerator::BuildBox(meshes[4]);
+
+	std::cout << "Mesh optimizer benchmark, FIFO cache of " << STATS_CACHE_SIZE << std::endl;
+
+	for (int m = 0; m < meshCount; m++)
+	{
+		MESH_DATA mesh = meshes[m];
+		int vertexCount = (int)(mesh.vertices.size() / MeshGenerator::FLOATS_PER_VERTEX);
+		CACHE_STATS original = AnalyzeVertexCache(mesh.indices, vertexCount, STATS_CACHE_SIZE);
+
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		OptimizeVertexCache(mesh.indices, vertexCount);
+		double cacheMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+		CACHE_STATS cacheOrder = AnalyzeVertexCache(mesh.indices, vertexCount, STATS_CACHE_SIZE);
+
+		startTime = std::chrono::high_resolution_clock::now();
+		OptimizeOverdraw(mesh.indices, mesh.vertices, g_OverdrawThreshold);
+		double overdrawMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+		CACHE_STATS overdrawOrder = AnalyzeVertexCache(mesh.indices, vertexCount, STATS_CACHE_SIZE);
+
+		startTime = std::chrono::high_resolution_clock::now();
+		OptimizeVertexFetch(mesh.vertices, mesh.indices);
+		double fetchMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+
+		// compare the triangles by their corner positions, each
+		// rotated to start at its smallest corner
+		bool bSameTriangles = (mesh.indices.size() == meshes[m].indices.size());
+		if (bSameTriangles == true)
+		{
+			std::vector<std::vector<float> > before;
+			std::vector<std::vector<float> > after;
+			const MESH_DATA* pMeshes[2] = { &meshes[m], &mesh };
+			std::vector<std::vector<float> >* pLists[2] = { &before, &after };
+			for (int k = 0; k < 2; k++)
+			{
+				for (int t = 0; t < (int)pMeshes[k]->indices.size() / 3; t++)
+				{
+					std::vector<float> corners[3];
+					for (int corner = 0; corner < 3; corner++)
+					{
+						const float* pVertex = &pMeshes[k]->vertices[pMeshes[k]->indices[t * 3 + corner] * MeshGenerator::FLOATS_PER_VERTEX];
+						corners[corner].assign(pVertex, pVertex + MeshGenerator::FLOATS_PER_VERTEX);
+					}
+					int first = (int)(std::min_element(corners, corners + 3) - corners);
+					std::vector<float> triangle;
+					for (int corner = 0; corner < 3; corner++)
+					{
+						triangle.insert(triangle.end(), corners[(first + corner) % 3].begin(), corners[(first + corner) % 3].end());
+					}
+					pLists[k]->push_back(triangle);
+				}
+				std::sort(pLists[k]->begin(), pLists[k]->end());
+			}
+			bSameTriangles = (before == after);
+		}
+
+		std::cout << "  " << meshNames[m]
+			<< ", vertices:" << vertexCount
+			<< ", triangles:" << mesh.indices.size() / 3 << std::endl;
+		std::cout << "    ACMR original:" << original.acmr
+			<< ", vertex cache:" << cacheOrder.acmr
+			<< ", overdraw:" << overdrawOrder.acmr << std::endl;
+		std::cout << "    ATVR original:" << original.atvr
+			<< ", vertex cache:" << cacheOrder.atvr
+			<< ", overdraw:" << overdrawOrder.atvr << std::endl;
+		std::cout << "    ms vertex cache:" << cacheMilliseconds
+			<< ", overdraw:" << overdrawMilliseconds
+			<< ", vertex fetch:" << fetchMilliseconds
+			<< ((bSameTriangles == false) ? ", TRIANGLES DIFFER" : "") << std::endl;
+	}
+}
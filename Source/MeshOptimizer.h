@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// MeshOptimizer.h
+// ============
+// reorder the triangles and vertices of a mesh for the GPU caches
+//
+//  Generated meshes list their triangles ring by ring, so most vertices
+//  have left the post-transform cache before they are used again.  The
+//  triangles are first reordered with Forsyth's linear-speed algorithm,
+//  which scores vertices by their age in a simulated cache and by how
+//  many of their triangles remain.  The result is then cut into clusters
+//  that give up little of the cache locality, and the clusters are
+//  ordered so the ones facing out from the mesh are drawn first and hide
+//  the ones behind them.  Last the vertices are stored in the order they
+//  are first used, so vertex fetches walk memory forward.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "MeshGenerator.h"
+#include <vector>
+
+/***********************************************************
+ *  MeshOptimizer
+ *
+ *  This class contains the code for the mesh optimization
+ *  stages and for measuring the vertex cache efficiency.
+ ***********************************************************/
+class MeshOptimizer
+{
+public:
+	// vertex cache efficiency of a triangle order
+	struct CACHE_STATS
+	{
+		// vertices transformed per triangle, from 0.5 to 3
+		float acmr;
+		// vertices transformed per unique vertex, 1 at best
+		float atvr;
+	};
+
+	// entries of the simulated FIFO cache of the statistics
+	static const int STATS_CACHE_SIZE = 16;
+
+	// run every stage on a mesh
+	static void OptimizeMesh(MESH_DATA& mesh);
+
+	// reorder the triangles for the post-transform vertex cache
+	static void OptimizeVertexCache(std::vector<unsigned int>& indices, int vertexCount);
+	// reorder clusters of a cache optimized triangle list so the
+	// outward facing clusters are drawn first - the threshold is
+	// how much the vertices per triangle may grow
+	static void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, float threshold);
+	// store the vertices in the order the triangles first use them
+	static void OptimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices);
+
+	// simulate a FIFO vertex cache over a triangle list
+	static CACHE_STATS AnalyzeVertexCache(const std::vector<unsigned int>& indices, int vertexCount, int cacheSize);
+
+	// print the cache statistics of each stage for the generated
+	// meshes - no OpenGL context is needed
+	static void RunOptimizerBenchmark();
+
+private:
+	// entries of the LRU cache the triangle order is scored for
+	static const int SCORE_CACHE_SIZE = 32;
+
+	// score of a vertex from its place in the cache and the
+	// number of its triangles not yet drawn
+	static float ScoreVertex(int cachePosition, int remainingTriangles);
+};
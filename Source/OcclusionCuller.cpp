@@ -0,0 +1,411 @@
+///////////////////////////////////////////////////////////////////////////////
+// OcclusionCuller.cpp
+// ============
+// skip scene objects hidden behind other objects with occlusion queries
+//
+//  After the scene is drawn, the bounding box of every object inside the
+//  frustum is drawn into the depth buffer with depth and color writes off,
+//  each inside its own occlusion query.  In the next frame an object
+//  whose query found no visible samples is not drawn.  Queries the GPU
+//  has not finished yet are not waited for - the object is drawn with
+//  conditional rendering instead, so the GPU skips it when the result
+//  arrives in time.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "OcclusionCuller.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <iostream>
+
+// declaration of the box geometry and the depth only shader
+namespace
+{
+	const GLuint g_PositionLocation = 0;
+	// boxes are grown a little so they are not hidden by the
+	// depth of the object they hold
+	const float g_BoxMargin = 0.02f;
+
+	const float g_CubeVertices[] =
+	{
+		-1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,   1.0f,  1.0f, -1.0f,  -1.0f,  1.0f, -1.0f,
+		-1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,   1.0f,  1.0f,  1.0f,  -1.0f,  1.0f,  1.0f
+	};
+	const GLuint g_CubeIndices[] =
+	{
+		0, 2, 1,   0, 3, 2,
+		4, 5, 6,   4, 6, 7,
+		0, 1, 5,   0, 5, 4,
+		3, 6, 2,   3, 7, 6,
+		0, 4, 7,   0, 7, 3,
+		1, 2, 6,   1, 6, 5
+	};
+
+	const char* g_BoxVertexShader =
+		"#version 330 core\n"
+		"layout (location = 0) in vec3 inVertexPosition;\n"
+		"uniform mat4 viewProjection;\n"
+		"uniform vec3 boxCenter;\n"
+		"uniform vec3 boxHalfSize;\n"
+		"void main()\n"
+		"{\n"
+		"   gl_Position = viewProjection * vec4(boxCenter + inVertexPosition * boxHalfSize, 1.0);\n"
+		"}\n";
+	const char* g_BoxFragmentShader =
+		"#version 330 core\n"
+		"void main()\n"
+		"{\n"
+		"}\n";
+}
+
+/***********************************************************
+ *  OcclusionCuller()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+OcclusionCuller::OcclusionCuller(RenderStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	m_vao = 0;
+	m_vbo = 0;
+	m_ebo = 0;
+	m_program = 0;
+	m_viewProjectionLocation = -1;
+	m_boxCenterLocation = -1;
+	m_boxHalfSizeLocation = -1;
+}
+
+/***********************************************************
+ *  ~OcclusionCuller()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+OcclusionCuller::~OcclusionCuller()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  CompileShader()
+ *
+ *  This method is used for compiling one stage of the depth
+ *  only shader.  Compile errors are printed and zero is
+ *  returned.
+ ***********************************************************/
+GLuint OcclusionCuller::CompileShader(GLenum stage, const char* source)
+{
+	GLuint shader = glCreateShader(stage);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint status = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char infoLog[512];
+		glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Occlusion box shader failed to compile:" << infoLog << std::endl;
+		glDeleteShader(shader);
+		return(0);
+	}
+
+	return(shader);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the unit cube that every
+ *  box is drawn with, and the shader that only places it.
+ ***********************************************************/
+bool OcclusionCuller::Create()
+{
+	Destroy();
+
+	GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, g_BoxVertexShader);
+	GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, g_BoxFragmentShader);
+	if ((vertexShader == 0) || (fragmentShader == 0))
+	{
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return(false);
+	}
+
+	m_program = glCreateProgram();
+	glAttachShader(m_program, vertexShader);
+	glAttachShader(m_program, fragmentShader);
+	glLinkProgram(m_program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(m_program, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		std::cout << "Occlusion box shader failed to link" << std::endl;
+		Destroy();
+		return(false);
+	}
+	m_viewProjectionLocation = glGetUniformLocation(m_program, "viewProjection");
+	m_boxCenterLocation = glGetUniformLocation(m_program, "boxCenter");
+	m_boxHalfSizeLocation = glGetUniformLocation(m_program, "boxHalfSize");
+
+	glGenVertexArrays(1, &m_vao);
+	glGenBuffers(1, &m_vbo);
+	glGenBuffers(1, &m_ebo);
+
+	glBindVertexArray(m_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(g_CubeVertices), g_CubeVertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(g_PositionLocation);
+	glVertexAttribPointer(g_PositionLocation, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(g_CubeIndices), g_CubeIndices, GL_STATIC_DRAW);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// the vertex array was changed outside of the state cache
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateVertexArray();
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the queries, the cube
+ *  geometry and the shader.
+ ***********************************************************/
+void OcclusionCuller::Destroy()
+{
+	if (m_queries.size() > 0)
+	{
+		glDeleteQueries((GLsizei)m_queries.size(), m_queries.data());
+		m_queries.clear();
+	}
+	m_queryStates.clear();
+
+	if (m_vao != 0)
+	{
+		glDeleteVertexArrays(1, &m_vao);
+		m_vao = 0;
+		// a deleted vertex array name can be handed out again
+		if (NULL != m_pStateCache)
+		{
+			m_pStateCache->InvalidateVertexArray();
+		}
+	}
+	if (m_vbo != 0)
+	{
+		glDeleteBuffers(1, &m_vbo);
+		m_vbo = 0;
+	}
+	if (m_ebo != 0)
+	{
+		glDeleteBuffers(1, &m_ebo);
+		m_ebo = 0;
+	}
+	if (m_program != 0)
+	{
+		glDeleteProgram(m_program);
+		m_program = 0;
+	}
+}
+
+/***********************************************************
+ *  Reset()
+ *
+ *  This method is used for forgetting every query result,
+ *  so the next frame draws every object without conditions.
+ ***********************************************************/
+void OcclusionCuller::Reset()
+{
+	std::fill(m_queryStates.begin(), m_queryStates.end(), (unsigned char)QUERY_NONE);
+}
+
+/***********************************************************
+ *  ResolveQueries()
+ *
+ *  This method is used for reading the results of the
+ *  queries issued in an earlier frame.  Only results the
+ *  GPU has already written are read, so the CPU never waits
+ *  for the GPU.  Queries are added for new objects.
+ ***********************************************************/
+void OcclusionCuller::ResolveQueries(int objectCount)
+{
+	if (m_program == 0)
+	{
+		return;
+	}
+
+	if (objectCount > (int)m_queries.size())
+	{
+		int firstNew = (int)m_queries.size();
+		m_queries.resize(objectCount, 0);
+		m_queryStates.resize(objectCount, QUERY_NONE);
+		glGenQueries(objectCount - firstNew, &m_queries[firstNew]);
+	}
+
+	for (int i = 0; i < (int)m_queryStates.size(); i++)
+	{
+		if (m_queryStates[i] != QUERY_PENDING)
+		{
+			continue;
+		}
+
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(m_queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+		{
+			continue;
+		}
+
+		GLuint anySamplesPassed = GL_FALSE;
+		glGetQueryObjectuiv(m_queries[i], GL_QUERY_RESULT, &anySamplesPassed);
+		m_queryStates[i] = (anySamplesPassed != GL_FALSE) ? QUERY_VISIBLE : QUERY_OCCLUDED;
+	}
+}
+
+/***********************************************************
+ *  IsOccluded()
+ *
+ *  This method is used for checking whether the last query
+ *  of an object found no visible samples.
+ ***********************************************************/
+bool OcclusionCuller::IsOccluded(int objectIndex) const
+{
+	if ((objectIndex < 0) || (objectIndex >= (int)m_queryStates.size()))
+	{
+		return(false);
+	}
+
+	return(m_queryStates[objectIndex] == QUERY_OCCLUDED);
+}
+
+/***********************************************************
+ *  BeginConditionalDraw()
+ *
+ *  This method is used for starting the draw of an object
+ *  whose query is not finished yet.  The GPU skips the draw
+ *  if the query finishes before the draw and found no
+ *  samples, and draws it otherwise.
+ ***********************************************************/
+void OcclusionCuller::BeginConditionalDraw(int objectIndex)
+{
+	if ((objectIndex >= 0) && (objectIndex < (int)m_queryStates.size()) &&
+		(m_queryStates[objectIndex] == QUERY_PENDING))
+	{
+		glBeginConditionalRender(m_queries[objectIndex], GL_QUERY_NO_WAIT);
+	}
+}
+
+/***********************************************************
+ *  EndConditionalDraw()
+ *
+ *  This method is used for ending the draw of an object
+ *  started with BeginConditionalDraw().
+ ***********************************************************/
+void OcclusionCuller::EndConditionalDraw(int objectIndex)
+{
+	if ((objectIndex >= 0) && (objectIndex < (int)m_queryStates.size()) &&
+		(m_queryStates[objectIndex] == QUERY_PENDING))
+	{
+		glEndConditionalRender();
+	}
+}
+
+/***********************************************************
+ *  IssueQueries()
+ *
+ *  This method is used for drawing the box of every
+ *  candidate object inside its query, after the scene is
+ *  drawn so its depth hides the boxes behind it.  The boxes
+ *  pass where they are not behind the depth already drawn,
+ *  and write neither depth nor color.  The box of an object
+ *  the camera is inside would be clipped by the near plane,
+ *  so that object is counted as visible without a query.
+ *  Objects that are not candidates have their results
+ *  forgotten, so they are drawn when they return.
+ ***********************************************************/
+void OcclusionCuller::IssueQueries(
+	const std::vector<int>& objects,
+	const SceneBVH& hierarchy,
+	const glm::mat4& viewProjection,
+	glm::vec3 cameraPosition)
+{
+	if ((m_program == 0) || (objects.size() == 0))
+	{
+		return;
+	}
+
+	std::vector<unsigned char> bCandidate(m_queryStates.size(), 0);
+	for (int i = 0; i < (int)objects.size(); i++)
+	{
+		if ((objects[i] >= 0) && (objects[i] < (int)bCandidate.size()))
+		{
+			bCandidate[objects[i]] = 1;
+		}
+	}
+	for (int i = 0; i < (int)m_queryStates.size(); i++)
+	{
+		if (bCandidate[i] == 0)
+		{
+			m_queryStates[i] = QUERY_NONE;
+		}
+	}
+
+	GLint sceneProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &sceneProgram);
+	glUseProgram(m_program);
+	glUniformMatrix4fv(m_viewProjectionLocation, 1, GL_FALSE, glm::value_ptr(viewProjection));
+
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->BindVertexArray(m_vao);
+	}
+	else
+	{
+		glBindVertexArray(m_vao);
+	}
+
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_LEQUAL);
+
+	for (int i = 0; i < (int)objects.size(); i++)
+	{
+		int objectIndex = objects[i];
+		if ((objectIndex < 0) || (objectIndex >= (int)m_queries.size()) ||
+			(objectIndex >= hierarchy.GetObjectCount()))
+		{
+			continue;
+		}
+
+		const SceneBVH::AABB& box = hierarchy.GetObjectBounds(objectIndex);
+		glm::vec3 center = (box.minimum + box.maximum) * 0.5f;
+		glm::vec3 halfSize = (box.maximum - box.minimum) * (0.5f + g_BoxMargin) + glm::vec3(g_BoxMargin);
+
+		glm::vec3 offset = glm::abs(cameraPosition - center);
+		if ((offset.x <= halfSize.x) && (offset.y <= halfSize.y) && (offset.z <= halfSize.z))
+		{
+			m_queryStates[objectIndex] = QUERY_VISIBLE;
+			continue;
+		}
+
+		glUniform3fv(m_boxCenterLocation, 1, glm::value_ptr(center));
+		glUniform3fv(m_boxHalfSizeLocation, 1, glm::value_ptr(halfSize));
+
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, m_queries[objectIndex]);
+		glDrawElements(GL_TRIANGLES, sizeof(g_CubeIndices) / sizeof(g_CubeIndices[0]), GL_UNSIGNED_INT, (void*)0);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		m_queryStates[objectIndex] = QUERY_PENDING;
+	}
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glUseProgram((GLuint)sceneProgram);
+}
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// OcclusionCuller.h
+// ============
+// skip scene objects hidden behind other objects with occlusion queries
+//
+//  After the scene is drawn, the bounding box of every object inside the
+//  frustum is drawn into the depth buffer with depth and color writes off,
+//  each inside its own occlusion query.  In the next frame an object
+//  whose query found no visible samples is not drawn.  Queries the GPU
+//  has not finished yet are not waited for - the object is drawn with
+//  conditional rendering instead, so the GPU skips it when the result
+//  arrives in time.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "RenderStateCache.h"
+#include "SceneBVH.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/***********************************************************
+ *  OcclusionCuller
+ *
+ *  This class contains the occlusion queries of the scene
+ *  objects and the box geometry and shader used to issue
+ *  them.
+ ***********************************************************/
+class OcclusionCuller
+{
+public:
+	// constructor - the state cache filters the vertex array binds
+	OcclusionCuller(RenderStateCache* pStateCache = NULL);
+	// destructor
+	~OcclusionCuller();
+
+	// create the box geometry and the depth only shader
+	bool Create();
+	// free the queries, geometry and shader
+	void Destroy();
+
+	// forget every query result, so all objects are drawn
+	void Reset();
+	// read the query results that are ready without waiting,
+	// for the given number of objects
+	void ResolveQueries(int objectCount);
+	// whether the last finished query of an object found it hidden
+	bool IsOccluded(int objectIndex) const;
+	// draw an object only if its unfinished query finds it visible
+	void BeginConditionalDraw(int objectIndex);
+	void EndConditionalDraw(int objectIndex);
+
+	// draw the hierarchy boxes of the candidate objects inside
+	// queries - objects whose box holds the camera are visible
+	void IssueQueries(
+		const std::vector<int>& objects,
+		const SceneBVH& hierarchy,
+		const glm::mat4& viewProjection,
+		glm::vec3 cameraPosition);
+
+private:
+	// state of the query of an object
+	enum QUERY_STATE
+	{
+		QUERY_NONE,
+		QUERY_PENDING,
+		QUERY_VISIBLE,
+		QUERY_OCCLUDED
+	};
+
+	// one query per object and the state of its result
+	std::vector<GLuint> m_queries;
+	std::vector<unsigned char> m_queryStates;
+	// unit cube drawn for every box
+	GLuint m_vao;
+	GLuint m_vbo;
+	GLuint m_ebo;
+	// depth only shader and its uniform locations
+	GLuint m_program;
+	GLint m_viewProjectionLocation;
+	GLint m_boxCenterLocation;
+	GLint m_boxHalfSizeLocation;
+	// filters the vertex array binds, or NULL
+	RenderStateCache* m_pStateCache;
+
+	// compile one stage of the depth only shader
+	static GLuint CompileShader(GLenum stage, const char* source);
+};
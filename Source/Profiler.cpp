@@ -0,0 +1,704 @@
+///////////////////////////////////////////////////////////////////////////////
+// Profiler.cpp
+// ============
+// measure named CPU and GPU scopes of every frame
+//
+//  Scopes are opened and closed around parts of the frame and can nest.
+//  The CPU side is timed with a high resolution clock and the GPU side
+//  with timestamp queries.  The queries of a frame are read back two
+//  frames later, so reading them does not stall the pipeline.  Results
+//  are kept as rolling statistics and as events for a Chrome trace.
+//  Counters measure what the GPU did between their begin and end, such
+//  as samples passed or primitives generated, with queries read back
+//  the same way, or take values added by the CPU.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+/***********************************************************
+ *  Profiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+Profiler::Profiler()
+{
+	m_bEnabled = true;
+	m_bInFrame = false;
+	m_currentFrame = 0;
+	m_gpuToCpuOffsetMs = 0.0;
+	m_bGpuOffsetKnown = false;
+	m_startTime = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		m_frames[i].queriesUsed = 0;
+		m_frames[i].bPending = false;
+	}
+}
+
+/***********************************************************
+ *  ~Profiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+Profiler::~Profiler()
+{
+	DestroyQueries();
+}
+
+/***********************************************************
+ *  DestroyQueries()
+ *
+ *  This method is used for freeing the query objects of all
+ *  of the frames in flight.
+ ***********************************************************/
+void Profiler::DestroyQueries()
+{
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		if (m_frames[i].queries.size() > 0)
+		{
+			glDeleteQueries((GLsizei)m_frames[i].queries.size(), m_frames[i].queries.data());
+			m_frames[i].queries.clear();
+		}
+		for (int j = 0; j < (int)m_frames[i].counterPools.size(); j++)
+		{
+			QUERY_POOL& pool = m_frames[i].counterPools[j];
+			if (pool.queries.size() > 0)
+			{
+				glDeleteQueries((GLsizei)pool.queries.size(), pool.queries.data());
+			}
+		}
+		m_frames[i].counterPools.clear();
+		m_frames[i].counterEvents.clear();
+		m_frames[i].queriesUsed = 0;
+		m_frames[i].bPending = false;
+	}
+}
+
+/***********************************************************
+ *  RegisterScope()
+ *
+ *  This method is used for registering a scope name.  The
+ *  ID of an already registered name is returned again.
+ ***********************************************************/
+int Profiler::RegisterScope(const std::string& name)
+{
+	for (int i = 0; i < (int)m_scopes.size(); i++)
+	{
+		if (m_scopes[i].name == name)
+		{
+			return(i);
+		}
+	}
+
+	SCOPE_STATS scope;
+	scope.name = name;
+	scope.cpuSamples.assign(HISTORY_FRAMES, 0.0);
+	scope.gpuSamples.assign(HISTORY_FRAMES, 0.0);
+	scope.sampleCount = 0;
+	scope.nextSample = 0;
+	scope.cpuFrameTotal = 0.0;
+	scope.gpuFrameTotal = 0.0;
+	scope.bSeenThisFrame = false;
+	m_scopes.push_back(scope);
+
+	return((int)m_scopes.size() - 1);
+}
+
+/***********************************************************
+ *  RegisterCounter()
+ *
+ *  This method is used for registering a counter name with
+ *  the query target it counts.  The ID of an already
+ *  registered name is returned again.
+ ***********************************************************/
+int Profiler::RegisterCounter(const std::string& name, GLenum queryTarget)
+{
+	for (int i = 0; i < (int)m_counters.size(); i++)
+	{
+		if (m_counters[i].name == name)
+		{
+			return(i);
+		}
+	}
+
+	COUNTER_STATS counter;
+	counter.name = name;
+	counter.queryTarget = queryTarget;
+	counter.openEvent = -1;
+	counter.samples.assign(HISTORY_FRAMES, 0.0);
+	counter.sampleCount = 0;
+	counter.nextSample = 0;
+	counter.frameTotal = 0.0;
+	counter.bSeenThisFrame = false;
+	m_counters.push_back(counter);
+
+	return((int)m_counters.size() - 1);
+}
+
+/***********************************************************
+ *  GetCpuMilliseconds()
+ *
+ *  This method is used for reading the CPU clock in
+ *  milliseconds since the profiler was created.
+ ***********************************************************/
+double Profiler::GetCpuMilliseconds() const
+{
+	return(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count());
+}
+
+/***********************************************************
+ *  AcquireQuery()
+ *
+ *  This method is used for taking the next unused query of
+ *  a frame.  The pool grows when a frame opens more scopes
+ *  than any frame before it.
+ ***********************************************************/
+GLuint Profiler::AcquireQuery(FRAME_RECORD& frame)
+{
+	if (frame.queriesUsed == (int)frame.queries.size())
+	{
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+
+	GLuint query = frame.queries[frame.queriesUsed];
+	frame.queriesUsed++;
+	return(query);
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a frame.  The frame that
+ *  last used the same query pool is resolved first.
+ ***********************************************************/
+void Profiler::BeginFrame()
+{
+	if (m_bEnabled == false)
+	{
+		return;
+	}
+
+	FRAME_RECORD& frame = m_frames[m_currentFrame];
+	if (frame.bPending == true)
+	{
+		ResolveFrame(frame);
+	}
+
+	frame.events.clear();
+	frame.queriesUsed = 0;
+	frame.counterEvents.clear();
+	for (int i = 0; i < (int)frame.counterPools.size(); i++)
+	{
+		frame.counterPools[i].queriesUsed = 0;
+	}
+	m_openScopes.clear();
+	for (int i = 0; i < (int)m_counters.size(); i++)
+	{
+		m_counters[i].openEvent = -1;
+	}
+	m_bInFrame = true;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for ending a frame.  Its queries are
+ *  left in flight and the next query pool is used for the
+ *  next frame.
+ ***********************************************************/
+void Profiler::EndFrame()
+{
+	if ((m_bEnabled == false) || (m_bInFrame == false))
+	{
+		return;
+	}
+
+	// close any scopes that were left open
+	while (m_openScopes.size() > 0)
+	{
+		EndScope();
+	}
+	for (int i = 0; i < (int)m_counters.size(); i++)
+	{
+		EndCounter(i);
+	}
+
+	m_frames[m_currentFrame].bPending = true;
+	m_currentFrame = (m_currentFrame + 1) % FRAME_LATENCY;
+	m_bInFrame = false;
+}
+
+/***********************************************************
+ *  BeginScope()
+ *
+ *  This method is used for opening a scope.  A timestamp
+ *  query is issued and the CPU clock is read.  An unknown
+ *  scope ID opens a scope that is not measured, so it still
+ *  pairs with its EndScope call.
+ ***********************************************************/
+void Profiler::BeginScope(int scopeID)
+{
+	if ((m_bEnabled == false) || (m_bInFrame == false))
+	{
+		return;
+	}
+	if ((scopeID < 0) || (scopeID >= (int)m_scopes.size()))
+	{
+		m_openScopes.push_back(-1);
+		return;
+	}
+
+	FRAME_RECORD& frame = m_frames[m_currentFrame];
+
+	SCOPE_EVENT event;
+	event.scopeID = scopeID;
+	event.beginQuery = AcquireQuery(frame);
+	event.endQuery = 0;
+	glQueryCounter(event.beginQuery, GL_TIMESTAMP);
+	event.cpuBeginMs = GetCpuMilliseconds();
+	event.cpuEndMs = event.cpuBeginMs;
+
+	m_openScopes.push_back((int)frame.events.size());
+	frame.events.push_back(event);
+}
+
+/***********************************************************
+ *  EndScope()
+ *
+ *  This method is used for closing the most recently opened
+ *  scope.
+ ***********************************************************/
+void Profiler::EndScope()
+{
+	if ((m_bEnabled == false) || (m_bInFrame == false) || (m_openScopes.size() == 0))
+	{
+		return;
+	}
+
+	int eventIndex = m_openScopes.back();
+	m_openScopes.pop_back();
+	if (eventIndex < 0)
+	{
+		return;
+	}
+
+	FRAME_RECORD& frame = m_frames[m_currentFrame];
+	SCOPE_EVENT& event = frame.events[eventIndex];
+
+	event.cpuEndMs = GetCpuMilliseconds();
+	event.endQuery = AcquireQuery(frame);
+	glQueryCounter(event.endQuery, GL_TIMESTAMP);
+}
+
+/***********************************************************
+ *  AcquireCounterQuery()
+ *
+ *  This method is used for taking the next unused query of
+ *  a query target.  Each target has its own pool, so every
+ *  query is always used with the same target.
+ ***********************************************************/
+GLuint Profiler::AcquireCounterQuery(FRAME_RECORD& frame, GLenum target)
+{
+	int poolIndex = -1;
+	for (int i = 0; (i < (int)frame.counterPools.size()) && (poolIndex < 0); i++)
+	{
+		if (frame.counterPools[i].target == target)
+		{
+			poolIndex = i;
+		}
+	}
+	if (poolIndex < 0)
+	{
+		QUERY_POOL pool;
+		pool.target = target;
+		pool.queriesUsed = 0;
+		frame.counterPools.push_back(pool);
+		poolIndex = (int)frame.counterPools.size() - 1;
+	}
+
+	QUERY_POOL& pool = frame.counterPools[poolIndex];
+	if (pool.queriesUsed == (int)pool.queries.size())
+	{
+		GLuint query = 0;
+		glGenQueries(1, &query);
+		pool.queries.push_back(query);
+	}
+
+	GLuint query = pool.queries[pool.queriesUsed];
+	pool.queriesUsed++;
+	return(query);
+}
+
+/***********************************************************
+ *  BeginCounter()
+ *
+ *  This method is used for starting to count with the query
+ *  target of a counter.  Only one query of each target can
+ *  be active, so a counter opened while another counter of
+ *  the same target is open is not measured.
+ ***********************************************************/
+void Profiler::BeginCounter(int counterID)
+{
+	if ((m_bEnabled == false) || (m_bInFrame == false))
+	{
+		return;
+	}
+	if ((counterID < 0) || (counterID >= (int)m_counters.size()) || (m_counters[counterID].queryTarget == 0))
+	{
+		return;
+	}
+	for (int i = 0; i < (int)m_counters.size(); i++)
+	{
+		if ((m_counters[i].openEvent >= 0) && (m_counters[i].queryTarget == m_counters[counterID].queryTarget))
+		{
+			return;
+		}
+	}
+
+	FRAME_RECORD& frame = m_frames[m_currentFrame];
+
+	COUNTER_EVENT event;
+	event.counterID = counterID;
+	event.cpuBeginMs = GetCpuMilliseconds();
+	event.query = AcquireCounterQuery(frame, m_counters[counterID].queryTarget);
+	event.value = 0.0;
+	glBeginQuery(m_counters[counterID].queryTarget, event.query);
+
+	m_counters[counterID].openEvent = (int)frame.counterEvents.size();
+	frame.counterEvents.push_back(event);
+}
+
+/***********************************************************
+ *  EndCounter()
+ *
+ *  This method is used for ending a counter that is open.
+ ***********************************************************/
+void Profiler::EndCounter(int counterID)
+{
+	if ((m_bEnabled == false) || (m_bInFrame == false))
+	{
+		return;
+	}
+	if ((counterID < 0) || (counterID >= (int)m_counters.size()) || (m_counters[counterID].openEvent < 0))
+	{
+		return;
+	}
+
+	glEndQuery(m_counters[counterID].queryTarget);
+	m_counters[counterID].openEvent = -1;
+}
+
+/***********************************************************
+ *  AddCounterValue()
+ *
+ *  This method is used for adding a value counted by the
+ *  CPU to a counter of the current frame.  It is resolved
+ *  with the frame, so it lines up with the GPU counters.
+ ***********************************************************/
+void Profiler::AddCounterValue(int counterID, double value)
+{
+	if ((m_bEnabled == false) || (m_bInFrame == false))
+	{
+		return;
+	}
+	if ((counterID < 0) || (counterID >= (int)m_counters.size()))
+	{
+		return;
+	}
+
+	COUNTER_EVENT event;
+	event.counterID = counterID;
+	event.cpuBeginMs = GetCpuMilliseconds();
+	event.query = 0;
+	event.value = value;
+	m_frames[m_currentFrame].counterEvents.push_back(event);
+}
+
+/***********************************************************
+ *  ResolveCounters()
+ *
+ *  This method is used for reading back the counts of a
+ *  finished frame.  The counts of every counter are added
+ *  to its per-frame total and stored in the rolling
+ *  statistics.
+ ***********************************************************/
+void Profiler::ResolveCounters(FRAME_RECORD& frame)
+{
+	for (int i = 0; i < (int)m_counters.size(); i++)
+	{
+		m_counters[i].frameTotal = 0.0;
+		m_counters[i].bSeenThisFrame = false;
+	}
+
+	for (int i = 0; i < (int)frame.counterEvents.size(); i++)
+	{
+		const COUNTER_EVENT& event = frame.counterEvents[i];
+
+		double value = event.value;
+		if (event.query != 0)
+		{
+			GLuint64 count = 0;
+			glGetQueryObjectui64v(event.query, GL_QUERY_RESULT, &count);
+			value = (double)count;
+		}
+
+		COUNTER_STATS& counter = m_counters[event.counterID];
+		counter.frameTotal += value;
+		counter.bSeenThisFrame = true;
+
+		if ((int)m_traceCounters.size() < MAX_TRACE_EVENTS)
+		{
+			TRACE_COUNTER traceCounter;
+			traceCounter.counterID = event.counterID;
+			traceCounter.cpuMs = event.cpuBeginMs;
+			traceCounter.value = value;
+			m_traceCounters.push_back(traceCounter);
+		}
+	}
+
+	for (int i = 0; i < (int)m_counters.size(); i++)
+	{
+		COUNTER_STATS& counter = m_counters[i];
+		if (counter.bSeenThisFrame == false)
+		{
+			continue;
+		}
+
+		counter.samples[counter.nextSample] = counter.frameTotal;
+		counter.nextSample = (counter.nextSample + 1) % HISTORY_FRAMES;
+		counter.sampleCount = std::min(counter.sampleCount + 1, (int)HISTORY_FRAMES);
+	}
+
+	frame.counterEvents.clear();
+}
+
+/***********************************************************
+ *  ResolveFrame()
+ *
+ *  This method is used for reading back the timestamps of a
+ *  finished frame.  The time of every scope is added to the
+ *  per-frame total of its name, and the totals are stored
+ *  in the rolling statistics.
+ ***********************************************************/
+void Profiler::ResolveFrame(FRAME_RECORD& frame)
+{
+	frame.bPending = false;
+	ResolveCounters(frame);
+
+	for (int i = 0; i < (int)m_scopes.size(); i++)
+	{
+		m_scopes[i].cpuFrameTotal = 0.0;
+		m_scopes[i].gpuFrameTotal = 0.0;
+		m_scopes[i].bSeenThisFrame = false;
+	}
+
+	for (int i = 0; i < (int)frame.events.size(); i++)
+	{
+		const SCOPE_EVENT& event = frame.events[i];
+
+		GLuint64 beginNanoseconds = 0;
+		GLuint64 endNanoseconds = 0;
+		glGetQueryObjectui64v(event.beginQuery, GL_QUERY_RESULT, &beginNanoseconds);
+		glGetQueryObjectui64v(event.endQuery, GL_QUERY_RESULT, &endNanoseconds);
+
+		double gpuBeginMs = (double)beginNanoseconds / 1.0e6;
+		double gpuDurationMs = (endNanoseconds > beginNanoseconds) ? (double)(endNanoseconds - beginNanoseconds) / 1.0e6 : 0.0;
+		double cpuDurationMs = event.cpuEndMs - event.cpuBeginMs;
+
+		// line the GPU clock up with the CPU clock at the first scope
+		if (m_bGpuOffsetKnown == false)
+		{
+			m_gpuToCpuOffsetMs = event.cpuBeginMs - gpuBeginMs;
+			m_bGpuOffsetKnown = true;
+		}
+
+		SCOPE_STATS& scope = m_scopes[event.scopeID];
+		scope.cpuFrameTotal += cpuDurationMs;
+		scope.gpuFrameTotal += gpuDurationMs;
+		scope.bSeenThisFrame = true;
+
+		if ((int)m_traceEvents.size() < MAX_TRACE_EVENTS)
+		{
+			TRACE_EVENT traceEvent;
+			traceEvent.scopeID = event.scopeID;
+			traceEvent.cpuBeginMs = event.cpuBeginMs;
+			traceEvent.cpuDurationMs = cpuDurationMs;
+			traceEvent.gpuBeginMs = gpuBeginMs + m_gpuToCpuOffsetMs;
+			traceEvent.gpuDurationMs = gpuDurationMs;
+			m_traceEvents.push_back(traceEvent);
+		}
+	}
+
+	for (int i = 0; i < (int)m_scopes.size(); i++)
+	{
+		SCOPE_STATS& scope = m_scopes[i];
+		if (scope.bSeenThisFrame == false)
+		{
+			continue;
+		}
+
+		scope.cpuSamples[scope.nextSample] = scope.cpuFrameTotal;
+		scope.gpuSamples[scope.nextSample] = scope.gpuFrameTotal;
+		scope.nextSample = (scope.nextSample + 1) % HISTORY_FRAMES;
+		scope.sampleCount = std::min(scope.sampleCount + 1, (int)HISTORY_FRAMES);
+	}
+
+	frame.events.clear();
+}
+
+/***********************************************************
+ *  Flush()
+ *
+ *  This method is used for resolving every frame that is
+ *  still in flight, oldest first.
+ ***********************************************************/
+void Profiler::Flush()
+{
+	for (int i = 0; i < FRAME_LATENCY; i++)
+	{
+		FRAME_RECORD& frame = m_frames[(m_currentFrame + i) % FRAME_LATENCY];
+		if (frame.bPending == true)
+		{
+			ResolveFrame(frame);
+		}
+	}
+}
+
+/***********************************************************
+ *  PrintStatistics()
+ *
+ *  This method is used for printing the minimum, average
+ *  and 99th percentile CPU and GPU time per frame of every
+ *  scope over the rolling history.
+ ***********************************************************/
+void Profiler::PrintStatistics() const
+{
+	char line[256];
+
+	snprintf(line, sizeof(line), "%-28s %8s | %9s %9s %9s | %9s %9s %9s",
+		"scope (ms per frame)", "frames", "cpu min", "cpu avg", "cpu p99", "gpu min", "gpu avg", "gpu p99");
+	std::cout << line << std::endl;
+
+	for (int i = 0; i < (int)m_scopes.size(); i++)
+	{
+		const SCOPE_STATS& scope = m_scopes[i];
+		if (scope.sampleCount == 0)
+		{
+			continue;
+		}
+
+		double minimum[2];
+		double average[2];
+		double percentile99[2];
+		const std::vector<double>* samples[2] = { &scope.cpuSamples, &scope.gpuSamples };
+		for (int j = 0; j < 2; j++)
+		{
+			std::vector<double> sorted(samples[j]->begin(), samples[j]->begin() + scope.sampleCount);
+			std::sort(sorted.begin(), sorted.end());
+
+			double total = 0.0;
+			for (int k = 0; k < (int)sorted.size(); k++)
+				total += sorted[k];
+
+			minimum[j] = sorted.front();
+			average[j] = total / (double)sorted.size();
+			percentile99[j] = sorted[std::min((int)sorted.size() - 1, ((int)sorted.size() * 99) / 100)];
+		}
+
+		snprintf(line, sizeof(line), "%-28s %8d | %9.4f %9.4f %9.4f | %9.4f %9.4f %9.4f",
+			scope.name.c_str(), scope.sampleCount,
+			minimum[0], average[0], percentile99[0],
+			minimum[1], average[1], percentile99[1]);
+		std::cout << line << std::endl;
+	}
+
+	if (m_counters.size() == 0)
+	{
+		return;
+	}
+
+	snprintf(line, sizeof(line), "%-28s %8s | %12s %12s %12s",
+		"counter (per frame)", "frames", "min", "avg", "p99");
+	std::cout << line << std::endl;
+
+	for (int i = 0; i < (int)m_counters.size(); i++)
+	{
+		const COUNTER_STATS& counter = m_counters[i];
+		if (counter.sampleCount == 0)
+		{
+			continue;
+		}
+
+		std::vector<double> sorted(counter.samples.begin(), counter.samples.begin() + counter.sampleCount);
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0.0;
+		for (int k = 0; k < (int)sorted.size(); k++)
+			total += sorted[k];
+
+		snprintf(line, sizeof(line), "%-28s %8d | %12.0f %12.0f %12.0f",
+			counter.name.c_str(), counter.sampleCount,
+			sorted.front(), total / (double)sorted.size(),
+			sorted[std::min((int)sorted.size() - 1, ((int)sorted.size() * 99) / 100)]);
+		std::cout << line << std::endl;
+	}
+}
+
+/***********************************************************
+ *  WriteChromeTrace()
+ *
+ *  This method is used for writing the recorded scopes in
+ *  the Chrome trace event format.  The CPU scopes are on
+ *  one track and the GPU scopes on another, so the file can
+ *  be opened in chrome://tracing or Perfetto.
+ ***********************************************************/
+bool Profiler::WriteChromeTrace(const std::string& filename) const
+{
+	std::ofstream file(filename.c_str());
+	if (!file.is_open())
+	{
+		std::cout << "Could not write the profiler trace:" << filename << std::endl;
+		return(false);
+	}
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[" << std::endl;
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+	for (int i = 0; i < (int)m_traceEvents.size(); i++)
+	{
+		const TRACE_EVENT& event = m_traceEvents[i];
+		const std::string& name = m_scopes[event.scopeID].name;
+
+		// the trace format expects microseconds
+		file << "," << std::endl << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+			<< ",\"ts\":" << event.cpuBeginMs * 1000.0 << ",\"dur\":" << event.cpuDurationMs * 1000.0 << "}";
+		file << "," << std::endl << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":2"
+			<< ",\"ts\":" << event.gpuBeginMs * 1000.0 << ",\"dur\":" << event.gpuDurationMs * 1000.0 << "}";
+	}
+
+	// counters are drawn as graphs above the tracks
+	for (int i = 0; i < (int)m_traceCounters.size(); i++)
+	{
+		const TRACE_COUNTER& counter = m_traceCounters[i];
+		const std::string& name = m_counters[counter.counterID].name;
+
+		file << "," << std::endl << "{\"name\":\"" << name << "\",\"ph\":\"C\",\"pid\":1"
+			<< ",\"ts\":" << counter.cpuMs * 1000.0 << ",\"args\":{\"value\":" << counter.value << "}}";
+	}
+
+	file << std::endl << "]}" << std::endl;
+
+	return(true);
+}
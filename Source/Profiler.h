@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+// Profiler.h
+// ============
+// measure named CPU and GPU scopes of every frame
+//
+//  Scopes are opened and closed around parts of the frame and can nest.
+//  The CPU side is timed with a high resolution clock and the GPU side
+//  with timestamp queries.  The queries of a frame are read back two
+//  frames later, so reading them does not stall the pipeline.  Results
+//  are kept as rolling statistics and as events for a Chrome trace.
+//  Counters measure what the GPU did between their begin and end, such
+//  as samples passed or primitives generated, with queries read back
+//  the same way, or take values added by the CPU.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <GL/glew.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  Profiler
+ *
+ *  This class contains the scope timers, the per-frame query
+ *  pools, and the statistics and trace events built from the
+ *  resolved timings.
+ ***********************************************************/
+class Profiler
+{
+public:
+	// constructor
+	Profiler();
+	// destructor
+	~Profiler();
+
+	// number of frames in flight before their queries are read
+	static const int FRAME_LATENCY = 2;
+	// number of frames the rolling statistics cover
+	static const int HISTORY_FRAMES = 240;
+	// most events kept for the Chrome trace
+	static const int MAX_TRACE_EVENTS = 262144;
+
+	// register a scope name and return its ID - call once at setup time
+	int RegisterScope(const std::string& name);
+
+	// turn the measurements on or off
+	void SetEnabled(bool bEnabled) { m_bEnabled = bEnabled; }
+	bool IsEnabled() const { return(m_bEnabled); }
+
+	// mark the start and end of a frame
+	void BeginFrame();
+	void EndFrame();
+	// open and close a scope - scopes close in reverse order
+	void BeginScope(int scopeID);
+	void EndScope();
+
+	// register a counter name and return its ID - the query target
+	// is what it counts on the GPU, or zero for values from the CPU
+	int RegisterCounter(const std::string& name, GLenum queryTarget = GL_SAMPLES_PASSED);
+	// count between begin and end - only one counter of each query
+	// target can be open, and a second begin is ignored
+	void BeginCounter(int counterID);
+	void EndCounter(int counterID);
+	// add a value from the CPU to a counter of the current frame
+	void AddCounterValue(int counterID, double value);
+
+	// read back the queries of every frame still in flight
+	void Flush();
+	// print the rolling min, average and 99th percentile of every scope
+	// and counter
+	void PrintStatistics() const;
+	// write the recorded events as a Chrome trace JSON file
+	bool WriteChromeTrace(const std::string& filename) const;
+
+private:
+	// one opened scope of a frame
+	struct SCOPE_EVENT
+	{
+		int scopeID;
+		double cpuBeginMs;
+		double cpuEndMs;
+		GLuint beginQuery;
+		GLuint endQuery;
+	};
+
+	// one counted range of a frame
+	struct COUNTER_EVENT
+	{
+		int counterID;
+		double cpuBeginMs;
+		// query of a GPU counter, or zero with the CPU value
+		GLuint query;
+		double value;
+	};
+
+	// reusable queries of one query target
+	struct QUERY_POOL
+	{
+		GLenum target;
+		std::vector<GLuint> queries;
+		int queriesUsed;
+	};
+
+	// the scopes and query pool of one frame in flight
+	struct FRAME_RECORD
+	{
+		std::vector<SCOPE_EVENT> events;
+		std::vector<GLuint> queries;
+		int queriesUsed;
+		// counter queries are pooled by target apart from the
+		// timestamps, since a query keeps the type of its first use
+		std::vector<COUNTER_EVENT> counterEvents;
+		std::vector<QUERY_POOL> counterPools;
+		bool bPending;
+	};
+
+	// rolling per-frame totals of one scope
+	struct SCOPE_STATS
+	{
+		std::string name;
+		std::vector<double> cpuSamples;
+		std::vector<double> gpuSamples;
+		int sampleCount;
+		int nextSample;
+		// totals of the frame being resolved
+		double cpuFrameTotal;
+		double gpuFrameTotal;
+		bool bSeenThisFrame;
+	};
+
+	// rolling per-frame totals of one counter
+	struct COUNTER_STATS
+	{
+		std::string name;
+		GLenum queryTarget;
+		// event index while the counter is open, or -1
+		int openEvent;
+		std::vector<double> samples;
+		int sampleCount;
+		int nextSample;
+		double frameTotal;
+		bool bSeenThisFrame;
+	};
+
+	// one resolved counter value for the Chrome trace
+	struct TRACE_COUNTER
+	{
+		int counterID;
+		double cpuMs;
+		double value;
+	};
+
+	// one resolved scope for the Chrome trace
+	struct TRACE_EVENT
+	{
+		int scopeID;
+		double cpuBeginMs;
+		double cpuDurationMs;
+		double gpuBeginMs;
+		double gpuDurationMs;
+	};
+
+	bool m_bEnabled;
+	bool m_bInFrame;
+	// frames in flight, used round robin
+	FRAME_RECORD m_frames[FRAME_LATENCY];
+	int m_currentFrame;
+	// indices of the open scopes in the current frame
+	std::vector<int> m_openScopes;
+	// statistics of every registered scope
+	std::vector<SCOPE_STATS> m_scopes;
+	// statistics of every registered counter
+	std::vector<COUNTER_STATS> m_counters;
+	// resolved events for the trace
+	std::vector<TRACE_EVENT> m_traceEvents;
+	std::vector<TRACE_COUNTER> m_traceCounters;
+	// start of the CPU clock and offset from GPU to CPU time
+	std::chrono::steady_clock::time_point m_startTime;
+	double m_gpuToCpuOffsetMs;
+	bool m_bGpuOffsetKnown;
+
+	// milliseconds since the profiler was created
+	double GetCpuMilliseconds() const;
+	// take the next timestamp query from the pool of a frame
+	GLuint AcquireQuery(FRAME_RECORD& frame);
+	// read the queries of a frame and add them to the statistics
+	void ResolveFrame(FRAME_RECORD& frame);
+	// take the next unused query of a target from the pools of a frame
+	GLuint AcquireCounterQuery(FRAME_RECORD& frame, GLenum target);
+	// read the counts of a frame into the counter statistics
+	void ResolveCounters(FRAME_RECORD& frame);
+	// free all of the query objects
+	void DestroyQueries();
+};
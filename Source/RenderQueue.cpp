@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.cpp
+// ============
+// collect draw packets and order them to minimize render state changes
+//
+//  Every draw is submitted as a packet with a 64-bit sort key built from
+//  its render pass, transparency, texture slot, material and mesh.  The
+//  packets are radix sorted by key, so draws sharing state end up next
+//  to each other and the renderer only sends the state that changed.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderQueue.h"
+
+// declaration of the sort key layout
+namespace
+{
+	// bit position and width of each key field, most significant first
+	const int g_PassShift = 60;
+	const int g_TransparentShift = 59;
+	const int g_TextureShift = 49;
+	const int g_MaterialShift = 39;
+	const int g_MeshShift = 31;
+
+	const uint64_t g_PassMask = 0xF;
+	const uint64_t g_TextureMask = 0x3FF;
+	const uint64_t g_MaterialMask = 0x3FF;
+	const uint64_t g_MeshMask = 0xFF;
+
+	// the key is sorted 8 bits at a time
+	const int g_RadixBits = 8;
+	const int g_RadixBuckets = 1 << g_RadixBits;
+}
+
+/***********************************************************
+ *  RenderQueue()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderQueue::RenderQueue()
+{
+	m_unsortedStateChanges = 0;
+	m_sortedStateChanges = 0;
+}
+
+/***********************************************************
+ *  MakeSortKey()
+ *
+ *  This method is used for building the sort key of a draw.
+ *  The texture slot and material index are stored one higher
+ *  so that -1, for none, sorts ahead of the first slot.
+ ***********************************************************/
+uint64_t RenderQueue::MakeSortKey(
+	RENDER_PASS pass,
+	bool bTransparent,
+	int textureSlot,
+	int materialIndex,
+	int mesh)
+{
+	uint64_t sortKey = 0;
+
+	sortKey |= ((uint64_t)pass & g_PassMask) << g_PassShift;
+	sortKey |= (uint64_t)(bTransparent ? 1 : 0) << g_TransparentShift;
+	sortKey |= ((uint64_t)(textureSlot + 1) & g_TextureMask) << g_TextureShift;
+	sortKey |= ((uint64_t)(materialIndex + 1) & g_MaterialMask) << g_MaterialShift;
+	sortKey |= ((uint64_t)mesh & g_MeshMask) << g_MeshShift;
+
+	return(sortKey);
+}
+
+/***********************************************************
+ *  GetKeyTextureSlot()
+ *
+ *  This method is used for reading the texture slot out of
+ *  a sort key.
+ ***********************************************************/
+int RenderQueue::GetKeyTextureSlot(uint64_t sortKey)
+{
+	return((int)((sortKey >> g_TextureShift) & g_TextureMask) - 1);
+}
+
+/***********************************************************
+ *  GetKeyMaterialIndex()
+ *
+ *  This method is used for reading the material index out
+ *  of a sort key.
+ ***********************************************************/
+int RenderQueue::GetKeyMaterialIndex(uint64_t sortKey)
+{
+	return((int)((sortKey >> g_MaterialShift) & g_MaterialMask) - 1);
+}
+
+/***********************************************************
+ *  GetKeyMesh()
+ *
+ *  This method is used for reading the mesh out of a sort
+ *  key.
+ ***********************************************************/
+int RenderQueue::GetKeyMesh(uint64_t sortKey)
+{
+	return((int)((sortKey >> g_MeshShift) & g_MeshMask));
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing all of the queued
+ *  packets.  The packet memory is kept for the next frame.
+ ***********************************************************/
+void RenderQueue::Clear()
+{
+	m_packets.clear();
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for queueing a draw with its sort key.
+ ***********************************************************/
+void RenderQueue::Submit(uint64_t sortKey, int drawIndex)
+{
+	DRAW_PACKET packet;
+	packet.sortKey = sortKey;
+	packet.drawIndex = drawIndex;
+	m_packets.push_back(packet);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used for sorting the queued packets with
+ *  a least significant digit radix sort.  The sort is stable,
+ *  so draws with equal keys keep their submission order, and
+ *  digits that are the same for every packet are skipped.
+ ***********************************************************/
+void RenderQueue::Sort()
+{
+	m_unsortedStateChanges = CountStateChanges(m_packets);
+
+	int packetCount = (int)m_packets.size();
+	m_sortScratch.resize(packetCount);
+
+	for (int shift = 0; shift < 64; shift += g_RadixBits)
+	{
+		int bucketCounts[g_RadixBuckets] = { 0 };
+		for (int i = 0; i < packetCount; i++)
+		{
+			bucketCounts[(m_packets[i].sortKey >> shift) & (g_RadixBuckets - 1)]++;
+		}
+
+		// nothing to reorder when every packet has the same digit
+		int firstDigit = (packetCount > 0) ? (int)((m_packets[0].sortKey >> shift) & (g_RadixBuckets - 1)) : 0;
+		if (bucketCounts[firstDigit] == packetCount)
+		{
+			continue;
+		}
+
+		int bucketOffsets[g_RadixBuckets];
+		int offset = 0;
+		for (int bucket = 0; bucket < g_RadixBuckets; bucket++)
+		{
+			bucketOffsets[bucket] = offset;
+			offset += bucketCounts[bucket];
+		}
+
+		for (int i = 0; i < packetCount; i++)
+		{
+			int bucket = (int)((m_packets[i].sortKey >> shift) & (g_RadixBuckets - 1));
+			m_sortScratch[bucketOffsets[bucket]] = m_packets[i];
+			bucketOffsets[bucket]++;
+		}
+		m_packets.swap(m_sortScratch);
+	}
+
+	m_sortedStateChanges = CountStateChanges(m_packets);
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method is used for counting how many texture,
+ *  material and mesh changes drawing the packets in their
+ *  current order needs.  The first packet sets all three.
+ ***********************************************************/
+int RenderQueue::CountStateChanges(const std::vector<DRAW_PACKET>& packets)
+{
+	int stateChanges = 0;
+
+	for (int i = 0; i < (int)packets.size(); i++)
+	{
+		uint64_t sortKey = packets[i].sortKey;
+		if ((i == 0) || (GetKeyTextureSlot(sortKey) != GetKeyTextureSlot(packets[i - 1].sortKey)))
+			stateChanges++;
+		if ((i == 0) || (GetKeyMaterialIndex(sortKey) != GetKeyMaterialIndex(packets[i - 1].sortKey)))
+			stateChanges++;
+		if ((i == 0) || (GetKeyMesh(sortKey) != GetKeyMesh(packets[i - 1].sortKey)))
+			stateChanges++;
+	}
+
+	return(stateChanges);
+}
@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderQueue.h
+// ============
+// collect draw packets and order them to minimize render state changes
+//
+//  Every draw is submitted as a packet with a 64-bit sort key built from
+//  its render pass, transparency, texture slot, material and mesh.  The
+//  packets are radix sorted by key, so draws sharing state end up next
+//  to each other and the renderer only sends the state that changed.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  DRAW_PACKET
+ *
+ *  One queued draw - the sort key and the index of the draw
+ *  in the list owned by the renderer.
+ ***********************************************************/
+struct DRAW_PACKET
+{
+	uint64_t sortKey;
+	int drawIndex;
+};
+
+/***********************************************************
+ *  RenderQueue
+ *
+ *  This class contains the code for building sort keys,
+ *  sorting the queued draw packets and counting the state
+ *  changes the sorted order saves.
+ ***********************************************************/
+class RenderQueue
+{
+public:
+	// constructor
+	RenderQueue();
+
+	// render passes, in the order they are drawn
+	enum RENDER_PASS
+	{
+		PASS_SCENE = 0,
+		PASS_OVERLAY = 1
+	};
+
+	// build the sort key of a draw - the fields are ordered from
+	// the most to the least expensive state to change
+	static uint64_t MakeSortKey(
+		RENDER_PASS pass,
+		bool bTransparent,
+		int textureSlot,
+		int materialIndex,
+		int mesh);
+	// read the state fields back out of a sort key
+	static int GetKeyTextureSlot(uint64_t sortKey);
+	static int GetKeyMaterialIndex(uint64_t sortKey);
+	static int GetKeyMesh(uint64_t sortKey);
+
+	// remove all of the queued packets
+	void Clear();
+	// queue a draw with its sort key
+	void Submit(uint64_t sortKey, int drawIndex);
+	// sort the queued packets by key and count the state changes
+	void Sort();
+
+	int GetPacketCount() const { return((int)m_packets.size()); }
+	const DRAW_PACKET& GetPacket(int index) const { return(m_packets[index]); }
+
+	// state changes of the last sorted frame in submission order,
+	// in sorted order, and the difference between them
+	int GetUnsortedStateChanges() const { return(m_unsortedStateChanges); }
+	int GetSortedStateChanges() const { return(m_sortedStateChanges); }
+	int GetStateChangesSaved() const { return(m_unsortedStateChanges - m_sortedStateChanges); }
+
+private:
+	// queued packets, and the scratch list used while sorting
+	std::vector<DRAW_PACKET> m_packets;
+	std::vector<DRAW_PACKET> m_sortScratch;
+	// state change counts of the last sorted frame
+	int m_unsortedStateChanges;
+	int m_sortedStateChanges;
+
+	// count the texture, material and mesh changes in packet order
+	static int CountStateChanges(const std::vector<DRAW_PACKET>& packets);
+};
@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderStateCache.cpp
+// ============
+// remember the bound textures and vertex array and drop redundant binds
+//
+//  The last texture bound to each texture unit and the last bound vertex
+//  array are shadowed on the CPU.  A bind that matches the shadowed value
+//  is counted and dropped instead of being sent to OpenGL.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RenderStateCache.h"
+
+/***********************************************************
+ *  RenderStateCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+RenderStateCache::RenderStateCache()
+{
+	m_boundTextures.assign(MAX_TEXTURE_UNITS * TARGET_COUNT, 0);
+	m_bTextureKnown.assign(MAX_TEXTURE_UNITS * TARGET_COUNT, false);
+	m_activeTextureUnit = 0;
+	m_bActiveUnitKnown = false;
+	m_boundVertexArray = 0;
+	m_bVertexArrayKnown = false;
+	m_issuedCalls = 0;
+	m_filteredCalls = 0;
+}
+
+/***********************************************************
+ *  FindTargetIndex()
+ *
+ *  This method is used for finding the shadow slot of the
+ *  passed in texture target.
+ ***********************************************************/
+int RenderStateCache::FindTargetIndex(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:
+		return(TARGET_2D);
+	case GL_TEXTURE_2D_ARRAY:
+		return(TARGET_2D_ARRAY);
+	case GL_TEXTURE_BUFFER:
+		return(TARGET_BUFFER);
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  SetActiveTextureUnit()
+ *
+ *  This method is used for selecting the active texture unit
+ *  when it differs from the shadowed one.
+ ***********************************************************/
+void RenderStateCache::SetActiveTextureUnit(GLuint textureUnit)
+{
+	if ((m_bActiveUnitKnown == true) && (m_activeTextureUnit == textureUnit))
+	{
+		m_filteredCalls++;
+		return;
+	}
+
+	glActiveTexture(GL_TEXTURE0 + textureUnit);
+	m_activeTextureUnit = textureUnit;
+	m_bActiveUnitKnown = true;
+	m_issuedCalls++;
+}
+
+/***********************************************************
+ *  BindTexture()
+ *
+ *  This method is used for binding a texture to a texture
+ *  unit.  The bind and the unit selection are dropped when
+ *  the texture is already bound there.  Units and targets
+ *  that are not shadowed are always bound.
+ ***********************************************************/
+void RenderStateCache::BindTexture(GLuint textureUnit, GLenum target, GLuint textureID)
+{
+	int targetIndex = FindTargetIndex(target);
+	if ((targetIndex < 0) || (textureUnit >= (GLuint)MAX_TEXTURE_UNITS))
+	{
+		glActiveTexture(GL_TEXTURE0 + textureUnit);
+		glBindTexture(target, textureID);
+		m_bActiveUnitKnown = false;
+		m_issuedCalls += 2;
+		return;
+	}
+
+	int slot = textureUnit * TARGET_COUNT + targetIndex;
+	if ((m_bTextureKnown[slot] == true) && (m_boundTextures[slot] == textureID))
+	{
+		m_filteredCalls++;
+		return;
+	}
+
+	SetActiveTextureUnit(textureUnit);
+	glBindTexture(target, textureID);
+	m_boundTextures[slot] = textureID;
+	m_bTextureKnown[slot] = true;
+	m_issuedCalls++;
+}
+
+/***********************************************************
+ *  BindVertexArray()
+ *
+ *  This method is used for binding a vertex array object
+ *  when it differs from the shadowed one.
+ ***********************************************************/
+void RenderStateCache::BindVertexArray(GLuint vertexArrayID)
+{
+	if ((m_bVertexArrayKnown == true) && (m_boundVertexArray == vertexArrayID))
+	{
+		m_filteredCalls++;
+		return;
+	}
+
+	glBindVertexArray(vertexArrayID);
+	m_boundVertexArray = vertexArrayID;
+	m_bVertexArrayKnown = true;
+	m_issuedCalls++;
+}
+
+/***********************************************************
+ *  InvalidateTextures()
+ *
+ *  This method is used for forgetting the shadowed texture
+ *  bindings, so the next bind of every unit is sent.
+ ***********************************************************/
+void RenderStateCache::InvalidateTextures()
+{
+	m_bTextureKnown.assign(m_bTextureKnown.size(), false);
+	m_bActiveUnitKnown = false;
+}
+
+/***********************************************************
+ *  InvalidateVertexArray()
+ *
+ *  This method is used for forgetting the shadowed vertex
+ *  array binding, so the next bind is sent.
+ ***********************************************************/
+void RenderStateCache::InvalidateVertexArray()
+{
+	m_bVertexArrayKnown = false;
+}
+
+/***********************************************************
+ *  ResetCounters()
+ *
+ *  This method is used for clearing the issued and filtered
+ *  call counters, usually once per frame.
+ ***********************************************************/
+void RenderStateCache::ResetCounters()
+{
+	m_issuedCalls = 0;
+	m_filteredCalls = 0;
+}
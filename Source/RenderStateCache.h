@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// RenderStateCache.h
+// ============
+// remember the bound textures and vertex array and drop redundant binds
+//
+//  The last texture bound to each texture unit and the last bound vertex
+//  array are shadowed on the CPU.  A bind that matches the shadowed value
+//  is counted and dropped instead of being sent to OpenGL.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+/***********************************************************
+ *  RenderStateCache
+ *
+ *  This class contains the shadowed texture unit and vertex
+ *  array bindings, and the counters of issued and filtered
+ *  binding calls.
+ ***********************************************************/
+class RenderStateCache
+{
+public:
+	// constructor
+	RenderStateCache();
+
+	// texture units that are shadowed - the minimum every
+	// implementation supports in the fragment shader
+	static const int MAX_TEXTURE_UNITS = 16;
+
+	// bind a texture to a texture unit
+	void BindTexture(GLuint textureUnit, GLenum target, GLuint textureID);
+	// bind a vertex array object
+	void BindVertexArray(GLuint vertexArrayID);
+
+	// forget the shadowed bindings - called after code outside
+	// of the cache has changed them
+	void InvalidateTextures();
+	void InvalidateVertexArray();
+
+	// number of binding calls sent to OpenGL and dropped
+	int GetIssuedCalls() const { return(m_issuedCalls); }
+	int GetFilteredCalls() const { return(m_filteredCalls); }
+	void ResetCounters();
+
+private:
+	// texture targets that are shadowed separately on every unit
+	enum TEXTURE_TARGET
+	{
+		TARGET_2D,
+		TARGET_2D_ARRAY,
+		TARGET_BUFFER,
+		TARGET_COUNT
+	};
+
+	// shadowed texture of every unit and target
+	std::vector<GLuint> m_boundTextures;
+	std::vector<bool> m_bTextureKnown;
+	// shadowed active texture unit
+	GLuint m_activeTextureUnit;
+	bool m_bActiveUnitKnown;
+	// shadowed vertex array object
+	GLuint m_boundVertexArray;
+	bool m_bVertexArrayKnown;
+
+	// binding call counters
+	int m_issuedCalls;
+	int m_filteredCalls;
+
+	// find the shadow slot of a texture target, or -1 when the
+	// target is not shadowed
+	static int FindTargetIndex(GLenum target);
+	// select the active texture unit
+	void SetActiveTextureUnit(GLuint textureUnit);
+};
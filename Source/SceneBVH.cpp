@@ -0,0 +1,713 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneBVH.cpp
+// ============
+// bounding volume hierarchy over the scene objects for culling and picking
+//
+//  The hierarchy is built top down over the object bounding boxes.  Each
+//  node is split where the surface area heuristic, evaluated over a few
+//  bins of object centers, predicts the cheapest traversal.  Moving
+//  objects only refit the boxes on the path from their leaf to the
+//  root, so the tree is built once and stays valid.  Whole subtrees are
+//  then accepted or rejected by the frustum, and rays visit the nodes
+//  they cross nearest first.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SceneBVH.h"
+#include "FrustumCuller.h"
+
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+/***********************************************************
+ *  SceneBVH()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+SceneBVH::SceneBVH()
+{
+}
+
+/***********************************************************
+ *  EmptyBox()
+ *
+ *  This method is used for getting a box that holds nothing,
+ *  so merging any box into it gives that box.
+ ***********************************************************/
+SceneBVH::AABB SceneBVH::EmptyBox()
+{
+	AABB box;
+	box.minimum = glm::vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	box.maximum = glm::vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	return(box);
+}
+
+/***********************************************************
+ *  Merge()
+ *
+ *  This method is used for getting the box that holds both
+ *  of the passed in boxes.
+ ***********************************************************/
+SceneBVH::AABB SceneBVH::Merge(const AABB& first, const AABB& second)
+{
+	AABB box;
+	box.minimum = glm::min(first.minimum, second.minimum);
+	box.maximum = glm::max(first.maximum, second.maximum);
+
+	return(box);
+}
+
+/***********************************************************
+ *  SurfaceArea()
+ *
+ *  This method is used for getting the surface area of a
+ *  box, which the heuristic uses as the chance of a ray or
+ *  view reaching it.
+ ***********************************************************/
+float SceneBVH::SurfaceArea(const AABB& box)
+{
+	glm::vec3 size = glm::max(box.maximum - box.minimum, glm::vec3(0.0f));
+
+	return(2.0f * (size.x * size.y + size.y * size.z + size.z * size.x));
+}
+
+/***********************************************************
+ *  ComputeBounds()
+ *
+ *  This method is used for getting the box that holds a run
+ *  of the ordered objects.
+ ***********************************************************/
+SceneBVH::AABB SceneBVH::ComputeBounds(int firstObject, int objectCount) const
+{
+	AABB box = EmptyBox();
+
+	for (int i = firstObject; i < firstObject + objectCount; i++)
+	{
+		box = Merge(box, m_objectBounds[m_orderedObjects[i]]);
+	}
+
+	return(box);
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the hierarchy over the
+ *  bounds of every object, replacing the previous tree.
+ ***********************************************************/
+void SceneBVH::Build(const std::vector<AABB>& bounds)
+{
+	m_objectBounds = bounds;
+	int objectCount = (int)bounds.size();
+
+	m_centers.resize(objectCount);
+	m_orderedObjects.resize(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		m_centers[i] = (bounds[i].minimum + bounds[i].maximum) * 0.5f;
+		m_orderedObjects[i] = i;
+	}
+	m_objectLeaves.assign(objectCount, -1);
+
+	m_nodes.clear();
+	m_dirtyLeaves.clear();
+	m_nodes.reserve(std::max(objectCount * 2, 1));
+	if (objectCount == 0)
+	{
+		m_leafDirty.clear();
+		return;
+	}
+
+	BVH_NODE root;
+	root.bounds = ComputeBounds(0, objectCount);
+	root.firstChild = -1;
+	root.parent = -1;
+	root.firstObject = 0;
+	root.objectCount = objectCount;
+	root.bLeaf = true;
+	m_nodes.push_back(root);
+
+	BuildNode(0);
+
+	m_leafDirty.assign(m_nodes.size(), 0);
+}
+
+/***********************************************************
+ *  FindSplit()
+ *
+ *  This method is used for finding the cheapest split of a
+ *  node.  The object centers are sorted into bins along
+ *  each axis, and every boundary between bins is costed as
+ *  one traversal step plus the objects on each side,
+ *  weighted by the share of the node's surface area the
+ *  side covers.  A leaf costs its object count, so the
+ *  split is only taken when it is cheaper.
+ ***********************************************************/
+bool SceneBVH::FindSplit(const BVH_NODE& node, int& splitAxis, float& splitPosition) const
+{
+	AABB centerBounds = EmptyBox();
+	for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+	{
+		const glm::vec3& center = m_centers[m_orderedObjects[i]];
+		centerBounds.minimum = glm::min(centerBounds.minimum, center);
+		centerBounds.maximum = glm::max(centerBounds.maximum, center);
+	}
+
+	float parentArea = SurfaceArea(node.bounds);
+	float bestCost = (float)node.objectCount;
+	bool bFound = false;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = centerBounds.maximum[axis] - centerBounds.minimum[axis];
+		if ((extent <= 0.0f) || (parentArea <= 0.0f))
+		{
+			continue;
+		}
+
+		AABB binBounds[SAH_BINS];
+		int binCounts[SAH_BINS];
+		for (int b = 0; b < SAH_BINS; b++)
+		{
+			binBounds[b] = EmptyBox();
+			binCounts[b] = 0;
+		}
+
+		float binScale = (float)SAH_BINS / extent;
+		for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+		{
+			int objectIndex = m_orderedObjects[i];
+			int bin = std::min((int)((m_centers[objectIndex][axis] - centerBounds.minimum[axis]) * binScale), SAH_BINS - 1);
+			binBounds[bin] = Merge(binBounds[bin], m_objectBounds[objectIndex]);
+			binCounts[bin]++;
+		}
+
+		// sweep from the left, then from the right, so every
+		// boundary knows the area and count on both of its sides
+		float leftArea[SAH_BINS];
+		int leftCount[SAH_BINS];
+		AABB sweepBox = EmptyBox();
+		int sweepCount = 0;
+		for (int b = 0; b < SAH_BINS - 1; b++)
+		{
+			sweepBox = Merge(sweepBox, binBounds[b]);
+			sweepCount += binCounts[b];
+			leftArea[b] = (sweepCount > 0) ? SurfaceArea(sweepBox) : 0.0f;
+			leftCount[b] = sweepCount;
+		}
+
+		sweepBox = EmptyBox();
+		sweepCount = 0;
+		for (int b = SAH_BINS - 1; b > 0; b--)
+		{
+			sweepBox = Merge(sweepBox, binBounds[b]);
+			sweepCount += binCounts[b];
+			if ((leftCount[b - 1] == 0) || (sweepCount == 0))
+			{
+				continue;
+			}
+
+			float cost = 1.0f + (leftArea[b - 1] * leftCount[b - 1] + SurfaceArea(sweepBox) * sweepCount) / parentArea;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				splitAxis = axis;
+				splitPosition = centerBounds.minimum[axis] + (float)b / binScale;
+				bFound = true;
+			}
+		}
+	}
+
+	return(bFound);
+}
+
+/***********************************************************
+ *  BuildNode()
+ *
+ *  This method is used for splitting the objects of a node
+ *  into two children and building those in turn.  When the
+ *  heuristic finds no useful split but the node holds too
+ *  many objects, or the split leaves one side empty, the
+ *  objects are split in half along their widest axis.
+ ***********************************************************/
+void SceneBVH::BuildNode(int nodeIndex)
+{
+	int firstObject = m_nodes[nodeIndex].firstObject;
+	int objectCount = m_nodes[nodeIndex].objectCount;
+
+	int splitAxis = 0;
+	float splitPosition = 0.0f;
+	bool bSplit = (objectCount > 1) && (FindSplit(m_nodes[nodeIndex], splitAxis, splitPosition) == true);
+	if ((bSplit == false) && (objectCount <= MAX_LEAF_OBJECTS))
+	{
+		for (int i = firstObject; i < firstObject + objectCount; i++)
+		{
+			m_objectLeaves[m_orderedObjects[i]] = nodeIndex;
+		}
+		return;
+	}
+
+	std::vector<int>::iterator first = m_orderedObjects.begin() + firstObject;
+	std::vector<int>::iterator last = first + objectCount;
+	int middle = firstObject;
+	if (bSplit == true)
+	{
+		middle = (int)(std::partition(first, last,
+			[this, splitAxis, splitPosition](int objectIndex) { return(m_centers[objectIndex][splitAxis] < splitPosition); }) -
+			m_orderedObjects.begin());
+	}
+	if ((middle == firstObject) || (middle == firstObject + objectCount))
+	{
+		glm::vec3 extent = m_nodes[nodeIndex].bounds.maximum - m_nodes[nodeIndex].bounds.minimum;
+		int axis = ((extent.x >= extent.y) && (extent.x >= extent.z)) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+		middle = firstObject + objectCount / 2;
+		std::nth_element(first, m_orderedObjects.begin() + middle, last,
+			[this, axis](int a, int b) { return(m_centers[a][axis] < m_centers[b][axis]); });
+	}
+
+	int childIndex = (int)m_nodes.size();
+	for (int c = 0; c < 2; c++)
+	{
+		BVH_NODE child;
+		child.firstObject = (c == 0) ? firstObject : middle;
+		child.objectCount = (c == 0) ? middle - firstObject : firstObject + objectCount - middle;
+		child.bounds = ComputeBounds(child.firstObject, child.objectCount);
+		child.firstChild = -1;
+		child.parent = nodeIndex;
+		child.bLeaf = true;
+		m_nodes.push_back(child);
+	}
+	m_nodes[nodeIndex].firstChild = childIndex;
+	m_nodes[nodeIndex].bLeaf = false;
+
+	BuildNode(childIndex);
+	BuildNode(childIndex + 1);
+}
+
+/***********************************************************
+ *  UpdateBounds()
+ *
+ *  This method is used for changing the bounds of an object
+ *  and remembering its leaf for the next refit.
+ ***********************************************************/
+void SceneBVH::UpdateBounds(int objectIndex, const AABB& bounds)
+{
+	if ((objectIndex < 0) || (objectIndex >= (int)m_objectBounds.size()))
+	{
+		return;
+	}
+
+	m_objectBounds[objectIndex] = bounds;
+	m_centers[objectIndex] = (bounds.minimum + bounds.maximum) * 0.5f;
+
+	int leaf = m_objectLeaves[objectIndex];
+	if ((leaf >= 0) && (m_leafDirty[leaf] == 0))
+	{
+		m_leafDirty[leaf] = 1;
+		m_dirtyLeaves.push_back(leaf);
+	}
+}
+
+/***********************************************************
+ *  Refit()
+ *
+ *  This method is used for refitting the boxes of the
+ *  leaves whose objects changed and of the nodes above
+ *  them.  The walk up stops at the first node whose box
+ *  stays the same, so small moves touch few nodes.  The
+ *  tree shape is kept, so it slowly loses quality if the
+ *  objects move far.
+ ***********************************************************/
+void SceneBVH::Refit()
+{
+	for (int i = 0; i < (int)m_dirtyLeaves.size(); i++)
+	{
+		int nodeIndex = m_dirtyLeaves[i];
+		m_leafDirty[nodeIndex] = 0;
+		m_nodes[nodeIndex].bounds = ComputeBounds(m_nodes[nodeIndex].firstObject, m_nodes[nodeIndex].objectCount);
+
+		nodeIndex = m_nodes[nodeIndex].parent;
+		while (nodeIndex >= 0)
+		{
+			BVH_NODE& node = m_nodes[nodeIndex];
+			AABB bounds = Merge(m_nodes[node.firstChild].bounds, m_nodes[node.firstChild + 1].bounds);
+			if ((bounds.minimum == node.bounds.minimum) && (bounds.maximum == node.bounds.maximum))
+			{
+				break;
+			}
+			node.bounds = bounds;
+			nodeIndex = node.parent;
+		}
+	}
+
+	m_dirtyLeaves.clear();
+}
+
+/***********************************************************
+ *  ClassifyBox()
+ *
+ *  This method is used for testing a box against the
+ *  frustum planes.  For each plane the corner furthest
+ *  along the normal decides whether the box is outside, and
+ *  the opposite corner whether it is entirely inside.
+ ***********************************************************/
+int SceneBVH::ClassifyBox(const AABB& box, const glm::vec4 planes[6])
+{
+	bool bInside = true;
+
+	for (int p = 0; p < 6; p++)
+	{
+		const glm::vec4& plane = planes[p];
+		glm::vec3 furthest(
+			(plane.x >= 0.0f) ? box.maximum.x : box.minimum.x,
+			(plane.y >= 0.0f) ? box.maximum.y : box.minimum.y,
+			(plane.z >= 0.0f) ? box.maximum.z : box.minimum.z);
+		if (plane.x * furthest.x + plane.y * furthest.y + plane.z * furthest.z + plane.w < 0.0f)
+		{
+			return(-1);
+		}
+
+		glm::vec3 nearest(
+			(plane.x >= 0.0f) ? box.minimum.x : box.maximum.x,
+			(plane.y >= 0.0f) ? box.minimum.y : box.maximum.y,
+			(plane.z >= 0.0f) ? box.minimum.z : box.maximum.z);
+		if (plane.x * nearest.x + plane.y * nearest.y + plane.z * nearest.z + plane.w < 0.0f)
+		{
+			bInside = false;
+		}
+	}
+
+	return((bInside == true) ? 1 : 0);
+}
+
+/***********************************************************
+ *  CullFrustum()
+ *
+ *  This method is used for marking the objects inside the
+ *  frustum, testing the boxes of the objects in the leaves
+ *  that cross its edges.
+ ***********************************************************/
+int SceneBVH::CullFrustum(const glm::vec4 planes[6], std::vector<unsigned char>& visible) const
+{
+	std::vector<int> crossingObjects;
+	int visibleCount = CullFrustum(planes, visible, crossingObjects);
+
+	for (int i = 0; i < (int)crossingObjects.size(); i++)
+	{
+		int objectIndex = crossingObjects[i];
+		if (ClassifyBox(m_objectBounds[objectIndex], planes) >= 0)
+		{
+			visible[objectIndex] = 1;
+			visibleCount++;
+		}
+	}
+
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  CullFrustum()
+ *
+ *  This method is used for marking the objects of the
+ *  subtrees inside the frustum.  Subtrees outside the
+ *  frustum are skipped and subtrees entirely inside it are
+ *  accepted without testing their objects, so only the
+ *  nodes crossing the frustum edges are opened.  The
+ *  objects of the leaves crossing an edge are listed
+ *  untested, so the caller can test them in one batch.
+ ***********************************************************/
+int SceneBVH::CullFrustum(const glm::vec4 planes[6], std::vector<unsigned char>& visible, std::vector<int>& crossingObjects) const
+{
+	visible.assign(m_objectBounds.size(), 0);
+	crossingObjects.clear();
+	if (m_nodes.size() == 0)
+	{
+		return(0);
+	}
+
+	int visibleCount = 0;
+	std::vector<int> stack;
+	stack.push_back(0);
+
+	while (stack.size() > 0)
+	{
+		const BVH_NODE& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		int classification = ClassifyBox(node.bounds, planes);
+		if (classification < 0)
+		{
+			continue;
+		}
+
+		if (classification > 0)
+		{
+			for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				visible[m_orderedObjects[i]] = 1;
+			}
+			visibleCount += node.objectCount;
+		}
+		else if (node.bLeaf == true)
+		{
+			for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				crossingObjects.push_back(m_orderedObjects[i]);
+			}
+		}
+		else
+		{
+			stack.push_back(node.firstChild);
+			stack.push_back(node.firstChild + 1);
+		}
+	}
+
+	return(visibleCount);
+}
+
+/***********************************************************
+ *  IntersectRay()
+ *
+ *  This method is used for finding where a ray enters a box
+ *  with the slab test.  A ray starting inside the box enters
+ *  it at zero, and hits beyond the maximum distance are
+ *  ignored.
+ ***********************************************************/
+bool SceneBVH::IntersectRay(const AABB& box, glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance, float& entryDistance)
+{
+	float entry = 0.0f;
+	float exit = maxDistance;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float slabEntry = (box.minimum[axis] - origin[axis]) * inverseDirection[axis];
+		float slabExit = (box.maximum[axis] - origin[axis]) * inverseDirection[axis];
+		if (slabEntry > slabExit)
+		{
+			std::swap(slabEntry, slabExit);
+		}
+		// written so a NaN from a ray inside a flat slab is ignored
+		entry = (slabEntry > entry) ? slabEntry : entry;
+		exit = (slabExit < exit) ? slabExit : exit;
+		if (entry > exit)
+		{
+			return(false);
+		}
+	}
+
+	entryDistance = entry;
+	return(true);
+}
+
+/***********************************************************
+ *  Raycast()
+ *
+ *  This method is used for finding the nearest object whose
+ *  box the ray hits.  Of the two children of a node the one
+ *  the ray enters first is visited first, and nodes further
+ *  away than the nearest hit so far are skipped.
+ ***********************************************************/
+int SceneBVH::Raycast(glm::vec3 origin, glm::vec3 direction, float& hitDistance) const
+{
+	if (m_nodes.size() == 0)
+	{
+		return(-1);
+	}
+
+	glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float nearestDistance = FLT_MAX;
+	int nearestObject = -1;
+
+	std::vector<int> stack;
+	stack.push_back(0);
+	while (stack.size() > 0)
+	{
+		const BVH_NODE& node = m_nodes[stack.back()];
+		stack.pop_back();
+
+		float entryDistance = 0.0f;
+		if (IntersectRay(node.bounds, origin, inverseDirection, nearestDistance, entryDistance) == false)
+		{
+			continue;
+		}
+
+		if (node.bLeaf == true)
+		{
+			for (int i = node.firstObject; i < node.firstObject + node.objectCount; i++)
+			{
+				int objectIndex = m_orderedObjects[i];
+				if (IntersectRay(m_objectBounds[objectIndex], origin, inverseDirection, nearestDistance, entryDistance) == true)
+				{
+					nearestDistance = entryDistance;
+					nearestObject = objectIndex;
+				}
+			}
+			continue;
+		}
+
+		float firstEntry = FLT_MAX;
+		float secondEntry = FLT_MAX;
+		bool bFirstHit = IntersectRay(m_nodes[node.firstChild].bounds, origin, inverseDirection, nearestDistance, firstEntry);
+		bool bSecondHit = IntersectRay(m_nodes[node.firstChild + 1].bounds, origin, inverseDirection, nearestDistance, secondEntry);
+
+		// push the farther child first so the nearer one is popped next
+		if ((bFirstHit == true) && (bSecondHit == true))
+		{
+			bool bFirstNearer = (firstEntry <= secondEntry);
+			stack.push_back(bFirstNearer ? node.firstChild + 1 : node.firstChild);
+			stack.push_back(bFirstNearer ? node.firstChild : node.firstChild + 1);
+		}
+		else if (bFirstHit == true)
+		{
+			stack.push_back(node.firstChild);
+		}
+		else if (bSecondHit == true)
+		{
+			stack.push_back(node.firstChild + 1);
+		}
+	}
+
+	hitDistance = nearestDistance;
+	return(nearestObject);
+}
+
+/***********************************************************
+ *  RunBVHBenchmark()
+ *
+ *  This method is used for timing the hierarchy on random
+ *  boxes: building it, refitting it after a hundredth of
+ *  the boxes move, culling against a camera frustum, and
+ *  casting rays from the camera.  The culling and rays are
+ *  also done by testing every box, to compare the times and
+ *  check that both find the same objects.
+ ***********************************************************/
+void SceneBVH::RunBVHBenchmark()
+{
+	const int objectCounts[] = { 1000, 10000, 100000 };
+	const int cullRepeats = 50;
+	const int rayCount = 1000;
+
+	glm::vec3 cameraPosition(0.0f, 2.0f, 60.0f);
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1000.0f / 800.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	FrustumCuller frustum;
+	frustum.SetFrustum(projection * view);
+	const glm::vec4* planes = frustum.GetPlanes();
+
+	std::mt19937 generator(330);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.2f, 2.0f);
+	std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+
+	std::cout << "BVH benchmark" << std::endl;
+
+	for (int i = 0; i < (int)(sizeof(objectCounts) / sizeof(objectCounts[0])); i++)
+	{
+		int objectCount = objectCounts[i];
+		std::vector<AABB> bounds(objectCount);
+		for (int j = 0; j < objectCount; j++)
+		{
+			glm::vec3 center(position(generator), position(generator), position(generator));
+			glm::vec3 halfSize(size(generator), size(generator), size(generator));
+			bounds[j].minimum = center - halfSize;
+			bounds[j].maximum = center + halfSize;
+		}
+
+		SceneBVH bvh;
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		bvh.Build(bounds);
+		double buildMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+
+		// move a hundredth of the objects a little and refit
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int j = 0; j < objectCount; j += 100)
+		{
+			glm::vec3 move(offset(generator), offset(generator), offset(generator));
+			bounds[j].minimum = bounds[j].minimum + move;
+			bounds[j].maximum = bounds[j].maximum + move;
+			bvh.UpdateBounds(j, bounds[j]);
+		}
+		bvh.Refit();
+		double refitMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+
+		// hierarchical and linear frustum culling
+		std::vector<unsigned char> visible;
+		int bvhVisible = 0;
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < cullRepeats; r++)
+		{
+			bvhVisible = bvh.CullFrustum(planes, visible);
+		}
+		double bvhCullMicroseconds = std::chrono::duration<double, std::micro>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / cullRepeats;
+
+		int linearVisible = 0;
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < cullRepeats; r++)
+		{
+			linearVisible = 0;
+			for (int j = 0; j < objectCount; j++)
+			{
+				linearVisible += (ClassifyBox(bounds[j], planes) >= 0) ? 1 : 0;
+			}
+		}
+		double linearCullMicroseconds = std::chrono::duration<double, std::micro>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / cullRepeats;
+
+		// rays from the camera toward random points
+		std::vector<glm::vec3> directions(rayCount);
+		for (int r = 0; r < rayCount; r++)
+		{
+			glm::vec3 target(position(generator) * 0.5f, position(generator) * 0.5f, position(generator) * 0.5f);
+			directions[r] = glm::normalize(target - cameraPosition);
+		}
+
+		std::vector<int> bvhHits(rayCount);
+		float distance = 0.0f;
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < rayCount; r++)
+		{
+			bvhHits[r] = bvh.Raycast(cameraPosition, directions[r], distance);
+		}
+		double bvhRayMicroseconds = std::chrono::duration<double, std::micro>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / rayCount;
+
+		int mismatchedHits = 0;
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < rayCount; r++)
+		{
+			glm::vec3 inverseDirection(1.0f / directions[r].x, 1.0f / directions[r].y, 1.0f / directions[r].z);
+			float nearestDistance = FLT_MAX;
+			int nearestObject = -1;
+			for (int j = 0; j < objectCount; j++)
+			{
+				if (IntersectRay(bounds[j], cameraPosition, inverseDirection, nearestDistance, distance) == true)
+				{
+					nearestDistance = distance;
+					nearestObject = j;
+				}
+			}
+			mismatchedHits += (nearestObject != bvhHits[r]) ? 1 : 0;
+		}
+		double linearRayMicroseconds = std::chrono::duration<double, std::micro>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / rayCount;
+
+		std::cout << "  objects:" << objectCount
+			<< ", nodes:" << bvh.GetNodeCount()
+			<< ", build ms:" << buildMilliseconds
+			<< ", refit ms:" << refitMilliseconds << std::endl;
+		std::cout << "    cull us bvh:" << bvhCullMicroseconds
+			<< ", linear:" << linearCullMicroseconds
+			<< ", visible:" << bvhVisible
+			<< ((bvhVisible != linearVisible) ? ", RESULTS DIFFER" : "") << std::endl;
+		std::cout << "    ray us bvh:" << bvhRayMicroseconds
+			<< ", linear:" << linearRayMicroseconds
+			<< ((mismatchedHits > 0) ? ", RESULTS DIFFER" : "") << std::endl;
+	}
+}
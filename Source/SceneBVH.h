@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// SceneBVH.h
+// ============
+// bounding volume hierarchy over the scene objects for culling and picking
+//
+//  The hierarchy is built top down over the object bounding boxes.  Each
+//  node is split where the surface area heuristic, evaluated over a few
+//  bins of object centers, predicts the cheapest traversal.  Moving
+//  objects only refit the boxes on the path from their leaf to the
+//  root, so the tree is built once and stays valid.  Whole subtrees are
+//  then accepted or rejected by the frustum, and rays visit the nodes
+//  they cross nearest first.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+/***********************************************************
+ *  SceneBVH
+ *
+ *  This class contains the nodes of the hierarchy and the
+ *  code for building, refitting, culling and ray queries.
+ ***********************************************************/
+class SceneBVH
+{
+public:
+	// constructor
+	SceneBVH();
+
+	// axis aligned bounding box of an object or node
+	struct AABB
+	{
+		glm::vec3 minimum;
+		glm::vec3 maximum;
+	};
+
+	// bins the object centers are sorted into along each axis
+	static const int SAH_BINS = 12;
+	// most objects a leaf holds before splitting is considered
+	static const int MAX_LEAF_OBJECTS = 4;
+
+	// build the hierarchy over the bounds of every object
+	void Build(const std::vector<AABB>& bounds);
+	// change the bounds of an object - the tree is refit later
+	void UpdateBounds(int objectIndex, const AABB& bounds);
+	// refit the nodes above the objects that changed
+	void Refit();
+
+	int GetObjectCount() const { return((int)m_objectBounds.size()); }
+	int GetNodeCount() const { return((int)m_nodes.size()); }
+	// current bounds of an object
+	const AABB& GetObjectBounds(int objectIndex) const { return(m_objectBounds[objectIndex]); }
+
+	// mark the objects inside the frustum planes, given as
+	// xyz = inward normal and w = distance, and return how many
+	int CullFrustum(const glm::vec4 planes[6], std::vector<unsigned char>& visible) const;
+	// mark the objects of the subtrees inside the frustum and
+	// return how many, listing the objects of the leaves that
+	// cross it for the caller to test
+	int CullFrustum(const glm::vec4 planes[6], std::vector<unsigned char>& visible, std::vector<int>& crossingObjects) const;
+	// find the nearest object the ray hits, or -1, and its distance
+	int Raycast(glm::vec3 origin, glm::vec3 direction, float& hitDistance) const;
+
+	// time the build, refit, culling and ray queries against
+	// testing every object, and print the results - CPU only
+	static void RunBVHBenchmark();
+
+private:
+	// node of the tree - interior nodes keep their two children
+	// next to each other, and every node covers a contiguous run
+	// of the ordered objects
+	struct BVH_NODE
+	{
+		AABB bounds;
+		int firstChild;
+		int parent;
+		int firstObject;
+		int objectCount;
+		bool bLeaf;
+	};
+
+	std::vector<BVH_NODE> m_nodes;
+	// object indices in leaf order
+	std::vector<int> m_orderedObjects;
+	// bounds and centers of every object
+	std::vector<AABB> m_objectBounds;
+	std::vector<glm::vec3> m_centers;
+	// leaf holding each object
+	std::vector<int> m_objectLeaves;
+	// leaves whose objects changed since the last refit
+	std::vector<int> m_dirtyLeaves;
+	std::vector<unsigned char> m_leafDirty;
+
+	// split the objects of a node into children until the
+	// heuristic prefers a leaf
+	void BuildNode(int nodeIndex);
+	// find the cheapest binned split of a node, or false when a
+	// leaf is cheaper
+	bool FindSplit(const BVH_NODE& node, int& splitAxis, float& splitPosition) const;
+	// bounds of the objects in a run of the ordered objects
+	AABB ComputeBounds(int firstObject, int objectCount) const;
+
+	// test a box against the frustum planes - -1 outside,
+	// 1 inside, 0 crossing a plane
+	static int ClassifyBox(const AABB& box, const glm::vec4 planes[6]);
+	// distance along a ray to where it enters a box, or false
+	static bool IntersectRay(const AABB& box, glm::vec3 origin, glm::vec3 inverseDirection, float maxDistance, float& entryDistance);
+	// surface area of a box, used by the heuristic
+	static float SurfaceArea(const AABB& box);
+	// box holding both boxes
+	static AABB Merge(const AABB& first, const AABB& second);
+	// box that holds nothing, for growing by merging
+	static AABB EmptyBox();
+};
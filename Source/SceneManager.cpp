@@ -17,6 +17,9 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 // declaration of global variables
@@ -27,6 +30,43 @@ namespace
 	const char* g_TextureValueName = "objectTexture";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UseInstancingName = "bUseInstancing";
+	const char* g_PackedVerticesName = "bPackedVertices";
+	const char* g_UVScaleName = "UVscale";
+
+	// tessellation of each level of detail of the sphere mesh,
+	// finest first, and the smallest radius in pixels a sphere
+	// must have to use each level but the last
+	const int g_SphereLevelCount = 4;
+	const int g_SphereLevelSlices[] = { 40, 24, 12, 8 };
+	const int g_SphereLevelStacks[] = { 20, 12, 6, 4 };
+	const float g_SphereLevelRadii[] = { 64.0f, 24.0f, 8.0f };
+	// tessellation of each level of detail of the cylinder mesh
+	const int g_CylinderLevelCount = 4;
+	const int g_CylinderLevelSlices[] = { 36, 24, 12, 8 };
+	const float g_CylinderLevelRadii[] = { 64.0f, 24.0f, 8.0f };
+	// fraction a radius must pass a threshold by to change level
+	const float g_LodHysteresis = 0.15f;
+
+	// levels of detail of each mesh type, indexed by mesh type -
+	// the flat meshes have no curve to tessellate more coarsely
+	const int g_MeshLevelCounts[] = { 1, 1, 1, g_CylinderLevelCount, g_SphereLevelCount };
+	const float* const g_MeshLevelRadii[] = { NULL, NULL, NULL, g_CylinderLevelRadii, g_SphereLevelRadii };
+	const char* const g_MeshNames[] = { "plane", "prism", "box", "cylinder", "sphere" };
+
+	// bounds of the unit primitive meshes, indexed by mesh type
+	const glm::vec3 g_MeshBoundsMin[] = {
+		glm::vec3(-1.0f, 0.0f, -1.0f),		// plane
+		glm::vec3(-0.5f, -0.5f, -0.5f),		// prism
+		glm::vec3(-0.5f, -0.5f, -0.5f),		// box
+		glm::vec3(-1.0f, 0.0f, -1.0f),		// cylinder
+		glm::vec3(-1.0f, -1.0f, -1.0f) };	// sphere
+	const glm::vec3 g_MeshBoundsMax[] = {
+		glm::vec3(1.0f, 0.0f, 1.0f),
+		glm::vec3(0.5f, 0.5f, 0.5f),
+		glm::vec3(0.5f, 0.5f, 0.5f),
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(1.0f, 1.0f, 1.0f) };
 }
 
 /***********************************************************
@@ -34,11 +74,71 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager* pShaderManager)
+SceneManager::SceneManager(ShaderManager* pShaderManager, UniformCache* pUniformCache, RenderStateCache* pStateCache)
 {
 	m_pShaderManager = pShaderManager;
+	m_pUniformCache = pUniformCache;
+	m_pStateCache = pStateCache;
 	m_basicMeshes = new ShapeMeshes();
-	m_loadedTextures = 0;
+	for (int i = 0; i < LodSelector::MAX_LEVELS; i++)
+	{
+		m_sphereInstances[i] = new InstancedMesh(pStateCache);
+	}
+	for (int i = 0; i < MESH_TYPE_COUNT; i++)
+	{
+		m_pLodSelectors[i] = new LodSelector();
+		m_pLodSelectors[i]->SetThresholds(g_MeshLevelRadii[i], g_MeshLevelCounts[i]);
+		m_pLodSelectors[i]->SetHysteresis(g_LodHysteresis);
+	}
+	m_drawRecordTriangles = 0;
+	m_instancedTriangles = 0;
+	m_materialBuffer = 0;
+	m_lightBuffer = 0;
+	m_lightDataBuffer = 0;
+	m_lightDataTexture = 0;
+	m_bLightsDirty = false;
+	memset(&m_lightBlockData, 0, sizeof(m_lightBlockData));
+	m_bLightBlockValid = false;
+	m_packedLightCount = 0;
+	m_pLightClusterer = new LightClusterer();
+	m_bUseClusteredLighting = true;
+	m_bCameraValid = false;
+	m_bUseInstancing = true;
+	m_pRenderQueue = new RenderQueue();
+	m_pTransformCache = new TransformCache();
+	m_pFrustumCuller = new FrustumCuller();
+	m_pSceneBVH = new SceneBVH();
+	m_bHierarchyDirty = true;
+	m_pOcclusionCuller = new OcclusionCuller(pStateCache);
+	m_bUseOcclusionCulling = true;
+	m_occludedObjectCount = 0;
+	m_pDepthPrepass = new DepthPrepass();
+	m_pMeshBuffer = new MeshBuffer(pStateCache);
+	m_bUseIndirectDraws = true;
+	m_bUseDepthPrepass = false;
+	m_bShowOverdraw = false;
+	m_pTextureArrays = new TextureArrays(pStateCache);
+	m_pTextureLoader = new TextureLoader(m_pTextureArrays);
+	m_pTextureResidency = new TextureResidency(m_pTextureArrays, m_pTextureLoader);
+	m_instanceGeneration = -1;
+	m_instanceBatchCount = 0;
+	// the driver support is checked when the compression is chosen
+	m_pTextureLoader->SetCompression(COMPRESSION_BC1_BC3);
+	m_pProfiler = NULL;
+	m_lightScope = -1;
+	m_drawRecordScope = -1;
+	m_instanceScope = -1;
+	m_occlusionScope = -1;
+	m_depthPrepassScope = -1;
+	m_shadedFragmentsCounter = -1;
+	m_trianglesCounter = -1;
+	for (int i = 0; i < MESH_TYPE_COUNT; i++)
+	{
+		for (int level = 0; level < LodSelector::MAX_LEVELS; level++)
+		{
+			m_lodCounters[i][level] = -1;
+		}
+	}
 }
 
 /***********************************************************
@@ -49,98 +149,205 @@ SceneManager::SceneManager(ShaderManager* pShaderManager)
 SceneManager::~SceneManager()
 {
 	m_pShaderManager = NULL;
+	m_pUniformCache = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	for (int i = 0; i < LodSelector::MAX_LEVELS; i++)
+	{
+		delete m_sphereInstances[i];
+		m_sphereInstances[i] = NULL;
+	}
+	for (int i = 0; i < MESH_TYPE_COUNT; i++)
+	{
+		delete m_pLodSelectors[i];
+		m_pLodSelectors[i] = NULL;
+	}
+	delete m_pRenderQueue;
+	m_pRenderQueue = NULL;
+	delete m_pTransformCache;
+	m_pTransformCache = NULL;
+	delete m_pFrustumCuller;
+	m_pFrustumCuller = NULL;
+	delete m_pSceneBVH;
+	m_pSceneBVH = NULL;
+	delete m_pOcclusionCuller;
+	m_pOcclusionCuller = NULL;
+	delete m_pDepthPrepass;
+	m_pDepthPrepass = NULL;
+	delete m_pMeshBuffer;
+	m_pMeshBuffer = NULL;
+	delete m_pTextureResidency;
+	m_pTextureResidency = NULL;
+	delete m_pTextureLoader;
+	m_pTextureLoader = NULL;
+	delete m_pTextureArrays;
+	m_pTextureArrays = NULL;
+
+	if (m_materialBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_materialBuffer);
+		m_materialBuffer = 0;
+	}
+	if (m_lightBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_lightBuffer);
+		m_lightBuffer = 0;
+	}
+	if (m_lightDataTexture != 0)
+	{
+		glDeleteTextures(1, &m_lightDataTexture);
+		m_lightDataTexture = 0;
+	}
+	if (m_lightDataBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_lightDataBuffer);
+		m_lightDataBuffer = 0;
+	}
+	delete m_pLightClusterer;
+	m_pLightClusterer = NULL;
 }
 
 /***********************************************************
  *  CreateGLTexture()
  *
- *  This method is used for loading textures from image files,
- *  configuring the texture mapping parameters in OpenGL,
- *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
- ***********************************************************/
-bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
-{
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
-
-	// indicate to always flip images vertically when loaded
-	stbi_set_flip_vertically_on_load(true);
-
-	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
-
-	// if the image was successfully read from the image file
-	if (image)
-	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
-
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// set the texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		// set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+ *  This method is used for requesting a texture from an
+ *  image file and registering it with its tag.  The image
+ *  is decoded in the background, and the texture shows a
+ *  placeholder until it is stored in the texture arrays.
+ ***********************************************************/
+bool SceneManager::CreateGLTexture(const char* filename, const std::string& tag)
+{
+	// the handle of a new tag is the next texture index
+	int handle = m_textureRegistry.Intern(tag);
+	if (handle < (int)m_textureIDs.size())
+	{
+		std::cout << "Texture tag " << tag << " is already used - " << filename << " is not loaded" << std::endl;
+		return(false);
+	}
+
+	TEXTURE_INFO texture;
+
+	// register the texture and associate it with the special tag string
+	texture.tag = tag;
+	texture.textureIndex = m_pTextureLoader->RequestTexture(filename);
+	m_textureIDs.push_back(texture);
+
+	return true;
+}
+
+/***********************************************************
+ *  UploadLoadedTextures()
+ *
+ *  This method is used for uploading the texture images
+ *  and streamed levels that finished decoding since the
+ *  last frame.  The
+ *  uploads bind textures behind the state cache, so the
+ *  arrays are bound again afterwards, and the instance
+ *  groups follow the textures to their new arrays.
+ ***********************************************************/
+void SceneManager::UploadLoadedTextures(bool bWaitForAll)
+{
+	int uploadCount = 0;
+
+	if ((m_pTextureLoader->GetPendingCount() == 0) && (m_pTextureLoader->GetStreamingCount() == 0))
+	{
+		return;
+	}
+
+	if (bWaitForAll == true)
+	{
+		uploadCount = m_pTextureLoader->FinishPendingLoads();
+	}
+	else
+	{
+		uploadCount = m_pTextureLoader->ProcessCompletedLoads(TextureLoader::MAX_UPLOADS_PER_FRAME);
+	}
+
+	if (uploadCount > 0)
+	{
+		BindGLTextures();
+		if ((m_instanceGeneration >= 0) && (m_instanceGeneration != m_pTextureArrays->GetGeneration()))
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			GroupInstances();
 		}
+	}
+}
 
-		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// free the image data from local memory
-		stbi_image_free(image);
-		glBindTexture(GL_TEXTURE_2D, 0);
+/***********************************************************
+ *  UpdateTextureResidency()
+ *
+ *  This method is used for telling the residency manager
+ *  which textures the draw records use and how large they
+ *  appear from the current camera, then letting it evict
+ *  and stream levels.  Reallocated arrays are bound again.
+ ***********************************************************/
+void SceneManager::UpdateTextureResidency()
+{
+	if (m_bCameraValid == false)
+	{
+		return;
+	}
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+	m_pTextureResidency->BeginFrame(m_cameraView);
+	for (int i = 0; i < (int)m_drawRecords.size(); i++)
+	{
+		const DRAW_RECORD& record = m_drawRecords[i];
+		m_pTextureResidency->AddTextureUse(record.textureIndex, record.model, record.uvScale);
+	}
 
-		return true;
+	if (m_pTextureResidency->Update() == true)
+	{
+		BindGLTextures();
 	}
+}
+
+/***********************************************************
+ *  FinishTextureLoading()
+ *
+ *  This method is used for waiting until every scene
+ *  texture is loaded, for runs that must not render any
+ *  placeholder textures.
+ ***********************************************************/
+void SceneManager::FinishTextureLoading()
+{
+	UploadLoadedTextures(true);
+}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+/***********************************************************
+ *  SetTextureCompression()
+ *
+ *  This method is used for choosing the compressed formats
+ *  the scene textures are stored in.  Formats the driver
+ *  cannot sample fall back to uncompressed textures.
+ ***********************************************************/
+void SceneManager::SetTextureCompression(TEXTURE_COMPRESSION compression)
+{
+	if ((compression == COMPRESSION_BC7) && (!GLEW_ARB_texture_compression_bptc) && (!GLEW_VERSION_4_2))
+	{
+		std::cout << "BC7 textures are not supported, using uncompressed textures" << std::endl;
+		compression = COMPRESSION_NONE;
+	}
+	if ((compression == COMPRESSION_BC1_BC3) && (!GLEW_EXT_texture_compression_s3tc))
+	{
+		std::cout << "BC1 and BC3 textures are not supported, using uncompressed textures" << std::endl;
+		compression = COMPRESSION_NONE;
+	}
 
-	// Error loading the image
-	return false;
+	m_pTextureLoader->SetCompression(compression);
 }
 
 /***********************************************************
  *  BindGLTextures()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for binding the texture arrays that
+ *  hold the loaded textures to their texture units.
  ***********************************************************/
 void SceneManager::BindGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
-	}
+	// the textures were bound outside of the state cache while loading
+	m_pStateCache->InvalidateTextures();
+
+	m_pTextureArrays->BindArrays();
 }
 
 /***********************************************************
@@ -151,221 +358,1446 @@ void SceneManager::BindGLTextures()
  ***********************************************************/
 void SceneManager::DestroyGLTextures()
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	m_pTextureArrays->DestroyArrays();
+	m_textureIDs.clear();
+	m_textureRegistry.Clear();
+}
+
+/***********************************************************
+ *  FindTextureID()
+ *
+ *  This method is used for getting the ID of the texture
+ *  array holding the previously loaded texture bitmap
+ *  associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(const std::string& tag)
+{
+	int handle = m_textureRegistry.Find(tag);
+	if (handle == TagRegistry::INVALID_HANDLE)
 	{
-		glDeleteTextures(1, &m_textureIDs[i].ID);
+		return(-1);
 	}
+
+	return((int)m_pTextureArrays->GetArrayTexture(m_textureIDs[handle].textureIndex));
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting the texture index for the
+ *  previously loaded texture bitmap associated with the
+ *  passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(const std::string& tag)
+{
+	int handle = m_textureRegistry.Find(tag);
+	if (handle == TagRegistry::INVALID_HANDLE)
+	{
+		return(-1);
+	}
+
+	return(m_textureIDs[handle].textureIndex);
+}
+
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting a material from the previously
+ *  defined materials list that is associated with the passed in tag.
+ ***********************************************************/
+bool SceneManager::FindMaterial(const std::string& tag, OBJECT_MATERIAL& material)
+{
+	int index = FindMaterialIndex(tag);
+	if (index < 0)
+	{
+		return(false);
+	}
+
+	material.ambientColor = m_objectMaterials[index].ambientColor;
+	material.ambientStrength = m_objectMaterials[index].ambientStrength;
+	material.diffuseColor = m_objectMaterials[index].diffuseColor;
+	material.specularColor = m_objectMaterials[index].specularColor;
+	material.shininess = m_objectMaterials[index].shininess;
+
+	return(true);
+}
+
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  This method is used for getting the index of a material
+ *  in the previously defined materials list that is
+ *  associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(const std::string& tag)
+{
+	int handle = m_materialRegistry.Find(tag);
+	if (handle == TagRegistry::INVALID_HANDLE)
+	{
+		return(-1);
+	}
+
+	return(m_materialIndices[handle]);
+}
+
+/***********************************************************
+ *  RegisterMaterialTags()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for interning the tags of the defined
+ *  materials, so the scene looks materials up by handle.  If
+ *  a tag is defined twice the first material keeps it.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::RegisterMaterialTags()
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	m_materialRegistry.Clear();
+	m_materialIndices.clear();
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	for (int i = 0; i < (int)m_objectMaterials.size(); i++)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
+		int handle = m_materialRegistry.Intern(m_objectMaterials[i].tag);
+		if (handle < (int)m_materialIndices.size())
 		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
+			std::cout << "Material tag " << m_objectMaterials[i].tag << " is defined more than once" << std::endl;
+			continue;
 		}
-		else
-			index++;
+		m_materialIndices.push_back(i);
+	}
+}
+
+/***********************************************************
+ *  ComputeModelMatrix()
+ *
+ *  This method is used for building the model matrix from
+ *  the passed in transformation values.  The rotations are
+ *  combined into a quaternion and the matrix is written in
+ *  one pass, which matches translation * rotationX *
+ *  rotationY * rotationZ * scale.
+ ***********************************************************/
+glm::mat4 SceneManager::ComputeModelMatrix(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	glm::vec4 rotation = TransformCache::EulerToQuaternion(
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees);
+
+	return(TransformCache::ComposeModel(scaleXYZ, rotation, positionXYZ));
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	// variables for this method
+	glm::mat4 modelView;
+
+	modelView = ComputeModelMatrix(
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
+
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetValue(m_uniforms.model, modelView);
+	}
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
+
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
+
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetValue(m_uniforms.bUseTexture, false);
+		m_pUniformCache->SetValue(m_uniforms.objectColor, currentColor);
+	}
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in ID into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	std::string textureTag)
+{
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetValue(m_uniforms.bUseTexture, true);
+		SetShaderTextureLocation(FindTextureSlot(textureTag));
+	}
+}
+
+/***********************************************************
+ *  SetShaderTextureLocation()
+ *
+ *  This method is used for sending the unit of the texture
+ *  array, the layer and the atlas rectangle of a texture to
+ *  the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTextureLocation(int textureIndex)
+{
+	const TextureArrays::TEXTURE_LOCATION& location = m_pTextureArrays->GetLocation(textureIndex);
+
+	m_pUniformCache->SetValue(m_uniforms.objectTexture, location.unit);
+	m_pUniformCache->SetValue(m_uniforms.textureLayer, location.layer);
+	m_pUniformCache->SetValue(m_uniforms.textureRect, location.rect);
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	if (NULL != m_pUniformCache)
+	{
+		m_pUniformCache->SetValue(m_uniforms.UVscale, glm::vec2(u, v));
+	}
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the material values
+ *  into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	std::string materialTag)
+{
+	if ((m_objectMaterials.size() > 0) && (NULL != m_pUniformCache))
+	{
+		SetShaderMaterialIndex(FindMaterialIndex(materialTag));
+	}
+}
+
+/***********************************************************
+ *  AddSceneObject()
+ *
+ *  This method is used for adding a scene object to the
+ *  retained draw records.  The texture index and material
+ *  index are resolved once here so that rendering does not
+ *  repeat the work every frame, and the model matrix and
+ *  bounds are filled in by the next transform update.
+ ***********************************************************/
+int SceneManager::AddSceneObject(
+	MESH_TYPE mesh,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ,
+	std::string textureTag,
+	std::string materialTag,
+	float u,
+	float v)
+{
+	DRAW_RECORD record;
+	int objectIndex = (int)m_drawRecords.size();
+
+	record.model = glm::mat4(1.0f);
+	record.textureIndex = FindTextureSlot(textureTag);
+	record.materialIndex = FindMaterialIndex(materialTag);
+	record.uvScale = glm::vec2(u, v);
+	record.mesh = mesh;
+	record.level = 0;
+	record.instanceGroup = -1;
+	record.instanceIndex = -1;
+
+	if (record.textureIndex < 0)
+	{
+		std::cout << "Scene object uses unknown texture:" << textureTag << std::endl;
+	}
+	if (record.materialIndex < 0)
+	{
+		std::cout << "Scene object uses unknown material:" << materialTag << std::endl;
+	}
+
+	m_drawRecords.push_back(record);
+	m_pTransformCache->SetTransform(
+		objectIndex,
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
+	m_bHierarchyDirty = true;
+
+	return(objectIndex);
+}
+
+/***********************************************************
+ *  SetSceneObjectTransform()
+ *
+ *  This method is used for updating the transform of a
+ *  previously added scene object, so only objects that
+ *  actually move pay for the matrix computation.  The
+ *  matrix is built with the other moved objects when the
+ *  next frame is rendered.
+ ***********************************************************/
+void SceneManager::SetSceneObjectTransform(
+	int objectIndex,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	if ((objectIndex < 0) || (objectIndex >= (int)m_drawRecords.size()))
+	{
+		return;
+	}
+
+	m_pTransformCache->SetTransform(
+		objectIndex,
+		scaleXYZ,
+		XrotationDegrees,
+		YrotationDegrees,
+		ZrotationDegrees,
+		positionXYZ);
+}
+
+/***********************************************************
+ *  UpdateTransforms()
+ *
+ *  This method is used for building the model matrices of
+ *  the objects whose transforms changed, and copying them
+ *  into the draw records, the culling bounds and the
+ *  instance groups.
+ ***********************************************************/
+void SceneManager::UpdateTransforms()
+{
+	if (m_pTransformCache->Update() == 0)
+	{
+		return;
+	}
+
+	const std::vector<int>& updatedObjects = m_pTransformCache->GetUpdatedObjects();
+	for (int i = 0; i < (int)updatedObjects.size(); i++)
+	{
+		int objectIndex = updatedObjects[i];
+		if (objectIndex >= (int)m_drawRecords.size())
+		{
+			continue;
+		}
+
+		DRAW_RECORD& record = m_drawRecords[objectIndex];
+		record.model = m_pTransformCache->GetModel(objectIndex);
+		m_pFrustumCuller->SetBounds(objectIndex, ComputeObjectBounds(record));
+		if (m_bHierarchyDirty == false)
+		{
+			m_pSceneBVH->UpdateBounds(objectIndex, ComputeObjectBox(record));
+		}
+
+		// instanced objects are uploaded with the rest of their group
+		if (record.instanceGroup >= 0)
+		{
+			INSTANCE_GROUP& group = m_instanceGroups[record.instanceGroup];
+			group.instances[record.instanceIndex].model = record.model;
+			group.bDirty = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  ComputeObjectBounds()
+ *
+ *  This method is used for getting the world space bounding
+ *  sphere of a draw record.  The sphere around the bounds of
+ *  its unit mesh is moved by the model matrix and grown by
+ *  its largest scale, so it holds the object however it is
+ *  rotated.
+ ***********************************************************/
+FrustumCuller::BOUNDING_SPHERE SceneManager::ComputeObjectBounds(const DRAW_RECORD& record) const
+{
+	glm::vec3 meshCenter = (g_MeshBoundsMin[record.mesh] + g_MeshBoundsMax[record.mesh]) * 0.5f;
+	float meshRadius = glm::length(g_MeshBoundsMax[record.mesh] - g_MeshBoundsMin[record.mesh]) * 0.5f;
+	float scale = std::max(glm::length(glm::vec3(record.model[0])),
+		std::max(glm::length(glm::vec3(record.model[1])), glm::length(glm::vec3(record.model[2]))));
+
+	FrustumCuller::BOUNDING_SPHERE bounds;
+	bounds.center = glm::vec3(record.model * glm::vec4(meshCenter, 1.0f));
+	bounds.radius = meshRadius * scale;
+
+	return(bounds);
+}
+
+/***********************************************************
+ *  ComputeObjectBox()
+ *
+ *  This method is used for getting the world space bounding
+ *  box of a draw record.  The box around its unit mesh is
+ *  moved by the model matrix, and its half size is grown by
+ *  the absolute rotation and scale so the box holds the
+ *  rotated mesh box.
+ ***********************************************************/
+SceneBVH::AABB SceneManager::ComputeObjectBox(const DRAW_RECORD& record) const
+{
+	glm::vec3 meshCenter = (g_MeshBoundsMin[record.mesh] + g_MeshBoundsMax[record.mesh]) * 0.5f;
+	glm::vec3 meshHalfSize = (g_MeshBoundsMax[record.mesh] - g_MeshBoundsMin[record.mesh]) * 0.5f;
+
+	glm::vec3 center = glm::vec3(record.model * glm::vec4(meshCenter, 1.0f));
+	glm::vec3 halfSize =
+		glm::abs(glm::vec3(record.model[0])) * meshHalfSize.x +
+		glm::abs(glm::vec3(record.model[1])) * meshHalfSize.y +
+		glm::abs(glm::vec3(record.model[2])) * meshHalfSize.z;
+
+	SceneBVH::AABB box;
+	box.minimum = center - halfSize;
+	box.maximum = center + halfSize;
+
+	return(box);
+}
+
+/***********************************************************
+ *  UpdateSceneHierarchy()
+ *
+ *  This method is used for bringing the bounding volume
+ *  hierarchy up to date with the draw records.  It is built
+ *  again after objects are added, and only refit after
+ *  objects move.
+ ***********************************************************/
+void SceneManager::UpdateSceneHierarchy()
+{
+	if (m_bHierarchyDirty == true)
+	{
+		std::vector<SceneBVH::AABB> bounds(m_drawRecords.size());
+		for (int i = 0; i < (int)m_drawRecords.size(); i++)
+		{
+			bounds[i] = ComputeObjectBox(m_drawRecords[i]);
+		}
+		m_pSceneBVH->Build(bounds);
+		m_bHierarchyDirty = false;
+	}
+	else
+	{
+		m_pSceneBVH->Refit();
+	}
+}
+
+/***********************************************************
+ *  CullSceneObjects()
+ *
+ *  This method is used for testing every draw record against
+ *  the frustum of the current camera through the bounding
+ *  volume hierarchy.  Instance groups whose visible instances
+ *  changed are marked to be uploaded again.  Without a camera
+ *  every object is drawn.
+ ***********************************************************/
+void SceneManager::CullSceneObjects()
+{
+	UpdateSceneHierarchy();
+	if (m_bCameraValid == true)
+	{
+		m_pFrustumCuller->SetFrustum(m_cameraView.projection * m_cameraView.view);
+	}
+	else
+	{
+		m_pFrustumCuller->ClearFrustum();
+	}
+	m_pFrustumCuller->CullHierarchy(*m_pSceneBVH);
+
+	for (int i = 0; i < (int)m_drawRecords.size(); i++)
+	{
+		const DRAW_RECORD& record = m_drawRecords[i];
+		if (record.instanceGroup < 0)
+		{
+			continue;
+		}
+
+		INSTANCE_GROUP& group = m_instanceGroups[record.instanceGroup];
+		unsigned char bVisible = m_pFrustumCuller->IsVisible(i) ? 1 : 0;
+		if (group.instanceVisible[record.instanceIndex] != bVisible)
+		{
+			group.instanceVisible[record.instanceIndex] = bVisible;
+			group.bDirty = true;
+		}
+	}
+}
+
+/***********************************************************
+ *  SelectObjectLevels()
+ *
+ *  This method is used for choosing the level of detail of
+ *  every object inside the frustum from its radius on
+ *  screen, with the selector of its mesh type.  Groups with
+ *  a sphere that changed level are marked to be uploaded
+ *  again.  Draw records only have levels in the shared
+ *  buffers, so they keep the finest level when the basic
+ *  meshes are drawn instead.  Without a camera every object
+ *  uses the finest level.
+ ***********************************************************/
+void SceneManager::SelectObjectLevels()
+{
+	for (int i = 0; i < MESH_TYPE_COUNT; i++)
+	{
+		m_pLodSelectors[i]->BeginFrame();
+	}
+	m_instancedTriangles = 0;
+	bool bRecordLevels = m_pMeshBuffer->IsCreated();
+
+	for (int i = 0; i < (int)m_drawRecords.size(); i++)
+	{
+		DRAW_RECORD& record = m_drawRecords[i];
+		if (m_pFrustumCuller->IsVisible(i) == false)
+		{
+			continue;
+		}
+		if ((record.instanceGroup < 0) && (bRecordLevels == false))
+		{
+			record.level = 0;
+			continue;
+		}
+
+		int level = 0;
+		if (m_bCameraValid == true)
+		{
+			FrustumCuller::BOUNDING_SPHERE bounds = ComputeObjectBounds(record);
+			level = m_pLodSelectors[record.mesh]->SelectLevel(i,
+				LodSelector::ProjectedRadius(m_cameraView, bounds.center, bounds.radius));
+		}
+		record.level = level;
+
+		if (record.instanceGroup >= 0)
+		{
+			INSTANCE_GROUP& group = m_instanceGroups[record.instanceGroup];
+			if (group.instanceLevels[record.instanceIndex] != level)
+			{
+				group.instanceLevels[record.instanceIndex] = (unsigned char)level;
+				group.bDirty = true;
+			}
+			m_instancedTriangles += m_sphereInstances[level]->GetIndexCount() / 3;
+		}
+	}
+
+	if (NULL != m_pProfiler)
+	{
+		for (int i = 0; i < MESH_TYPE_COUNT; i++)
+		{
+			for (int level = 0; level < g_MeshLevelCounts[i]; level++)
+			{
+				m_pProfiler->AddCounterValue(m_lodCounters[i][level], m_pLodSelectors[i]->GetLevelObjectCount(level));
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  GetMeshLevelCount()
+ *
+ *  This method is used for getting the number of levels of
+ *  detail of a mesh type.
+ ***********************************************************/
+int SceneManager::GetMeshLevelCount(int mesh) const
+{
+	if ((mesh < 0) || (mesh >= MESH_TYPE_COUNT))
+	{
+		return(0);
+	}
+
+	return(g_MeshLevelCounts[mesh]);
+}
+
+/***********************************************************
+ *  GetMeshName()
+ *
+ *  This method is used for getting the name of a mesh type
+ *  for the profiler and benchmark output.
+ ***********************************************************/
+const char* SceneManager::GetMeshName(int mesh) const
+{
+	if ((mesh < 0) || (mesh >= MESH_TYPE_COUNT))
+	{
+		return("unknown");
+	}
+
+	return(g_MeshNames[mesh]);
+}
+
+/***********************************************************
+ *  GetLevelObjectCount()
+ *
+ *  This method is used for getting the number of objects of
+ *  a mesh type drawn with a level of detail in the last
+ *  frame.
+ ***********************************************************/
+int SceneManager::GetLevelObjectCount(int mesh, int level) const
+{
+	if ((mesh < 0) || (mesh >= MESH_TYPE_COUNT))
+	{
+		return(0);
+	}
+
+	return(m_pLodSelectors[mesh]->GetLevelObjectCount(level));
+}
+
+/***********************************************************
+ *  IssueOcclusionQueries()
+ *
+ *  This method is used for querying which of the draw
+ *  records inside the frustum are hidden by the depth of the
+ *  finished frame.  Objects skipped this frame are queried
+ *  too, so they are drawn again once they come into view.
+ *  The instanced groups draw many objects with one call and
+ *  are not queried.
+ ***********************************************************/
+void SceneManager::IssueOcclusionQueries()
+{
+	if ((m_bUseOcclusionCulling == false) || (m_bCameraValid == false))
+	{
+		return;
+	}
+
+	m_occlusionCandidates.clear();
+	for (int i = 0; i < (int)m_drawRecords.size(); i++)
+	{
+		if ((m_drawRecords[i].instanceGroup < 0) && (m_pFrustumCuller->IsVisible(i) == true))
+		{
+			m_occlusionCandidates.push_back(i);
+		}
+	}
+
+	m_pOcclusionCuller->IssueQueries(
+		m_occlusionCandidates,
+		*m_pSceneBVH,
+		m_cameraView.projection * m_cameraView.view,
+		m_cameraView.position);
+}
+
+/***********************************************************
+ *  SetOcclusionCulling()
+ *
+ *  This method is used for turning the occlusion queries on
+ *  or off.  Earlier results are forgotten either way, so no
+ *  object stays hidden by a stale result.
+ ***********************************************************/
+void SceneManager::SetOcclusionCulling(bool bEnable)
+{
+	m_bUseOcclusionCulling = bEnable;
+	m_pOcclusionCuller->Reset();
+	m_occludedObjectCount = 0;
+}
+
+/***********************************************************
+ *  PickObject()
+ *
+ *  This method is used for finding the nearest scene object
+ *  whose bounding box a world space ray hits, such as the
+ *  ray under the mouse cursor.  Objects are tested by their
+ *  boxes, so a ray passing near the corner of a rounded
+ *  object may still pick it.
+ ***********************************************************/
+int SceneManager::PickObject(glm::vec3 origin, glm::vec3 direction)
+{
+	UpdateSceneHierarchy();
+
+	float hitDistance = 0.0f;
+
+	return(m_pSceneBVH->Raycast(origin, direction, hitDistance));
+}
+
+/***********************************************************
+ *  DrawMesh()
+ *
+ *  This method is used for drawing the basic mesh that is
+ *  associated with the passed in mesh type, from the shared
+ *  buffers at the passed in level of detail when they were
+ *  created.  The basic meshes only have one level.
+ ***********************************************************/
+void SceneManager::DrawMesh(MESH_TYPE mesh, int level)
+{
+	// the shared buffers keep their vertex array bound between meshes
+	if (m_pMeshBuffer->IsCreated() == true)
+	{
+		m_pMeshBuffer->DrawMesh(GetMeshIndex(mesh, level));
+		return;
+	}
+
+	switch (mesh)
+	{
+	case MESH_PLANE:
+		m_basicMeshes->DrawPlaneMesh();
+		break;
+	case MESH_PRISM:
+		m_basicMeshes->DrawPrismMesh();
+		break;
+	case MESH_BOX:
+		m_basicMeshes->DrawBoxMesh();
+		break;
+	case MESH_CYLINDER:
+		m_basicMeshes->DrawCylinderMesh();
+		break;
+	case MESH_SPHERE:
+		m_basicMeshes->DrawSphereMesh();
+		break;
+	}
+
+	// the basic meshes bind their own vertex arrays
+	m_pStateCache->InvalidateVertexArray();
+}
+
+/***********************************************************
+ *  GetMeshIndex()
+ *
+ *  This method is used for getting the index of a level of
+ *  detail of a mesh type in the shared buffers.  The meshes
+ *  are added in mesh type order, each followed by its
+ *  coarser levels.
+ ***********************************************************/
+int SceneManager::GetMeshIndex(MESH_TYPE mesh, int level) const
+{
+	int meshIndex = 0;
+	for (int i = 0; i < (int)mesh; i++)
+	{
+		meshIndex += g_MeshLevelCounts[i];
+	}
+
+	return(meshIndex + level);
+}
+
+/***********************************************************
+ *  CreateMeshBuffer()
+ *
+ *  This method is used for packing every primitive mesh into
+ *  the shared vertex and index buffers, with the curved
+ *  meshes tessellated once for each level of detail.  Each
+ *  mesh is reordered for the vertex caches first.
+ ***********************************************************/
+bool SceneManager::CreateMeshBuffer()
+{
+	std::vector<MESH_DATA> meshes(GetMeshIndex(MESH_SPHERE, g_SphereLevelCount));
+	MeshGenerator::BuildPlane(meshes[GetMeshIndex(MESH_PLANE, 0)]);
+	MeshGenerator::BuildPrism(meshes[GetMeshIndex(MESH_PRISM, 0)]);
+	MeshGenerator::BuildBox(meshes[GetMeshIndex(MESH_BOX, 0)]);
+	for (int i = 0; i < g_CylinderLevelCount; i++)
+	{
+		MeshGenerator::BuildCylinder(meshes[GetMeshIndex(MESH_CYLINDER, i)], g_CylinderLevelSlices[i]);
+	}
+	for (int i = 0; i < g_SphereLevelCount; i++)
+	{
+		MeshGenerator::BuildSphere(meshes[GetMeshIndex(MESH_SPHERE, i)], g_SphereLevelSlices[i], g_SphereLevelStacks[i]);
+	}
+
+	for (int i = 0; i < (int)meshes.size(); i++)
+	{
+		MeshOptimizer::OptimizeMesh(meshes[i]);
+		if (m_pMeshBuffer->AddMesh(meshes[i]) != i)
+		{
+			m_pMeshBuffer->Destroy();
+			return(false);
+		}
+	}
+
+	return(m_pMeshBuffer->Create());
+}
+
+/***********************************************************
+ *  SetShaderMaterialIndex()
+ *
+ *  This method is used for selecting the material at the
+ *  passed in index in the material uniform buffer for the
+ *  next draw command.
+ ***********************************************************/
+void SceneManager::SetShaderMaterialIndex(int materialIndex)
+{
+	if ((materialIndex < 0) || (materialIndex >= (int)m_objectMaterials.size()))
+	{
+		return;
+	}
+
+	m_pUniformCache->SetValue(m_uniforms.materialIndex, materialIndex);
+}
+
+/***********************************************************
+ *  CreateMaterialBuffer()
+ *
+ *  This method is used for packing all of the defined
+ *  materials into a std140 uniform buffer once, so that
+ *  switching materials only changes the material index.
+ ***********************************************************/
+bool SceneManager::CreateMaterialBuffer()
+{
+	if ((int)m_objectMaterials.size() > MAX_MATERIALS)
+	{
+		std::cout << "Too many materials defined, only " << MAX_MATERIALS << " are used" << std::endl;
+	}
+
+	// each std140 material is three vec4 values - ambient color and
+	// strength, diffuse color, and specular color and shininess
+	std::vector<glm::vec4> materialData(MAX_MATERIALS * 3, glm::vec4(0.0f));
+	for (int i = 0; (i < (int)m_objectMaterials.size()) && (i < MAX_MATERIALS); i++)
+	{
+		const OBJECT_MATERIAL& material = m_objectMaterials[i];
+		materialData[i * 3 + 0] = glm::vec4(material.ambientColor, material.ambientStrength);
+		materialData[i * 3 + 1] = glm::vec4(material.diffuseColor, 0.0f);
+		materialData[i * 3 + 2] = glm::vec4(material.specularColor, material.shininess);
+	}
+
+	if (m_materialBuffer == 0)
+	{
+		glGenBuffers(1, &m_materialBuffer);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, materialData.size() * sizeof(glm::vec4), materialData.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, m_materialBuffer);
+
+	return(m_pUniformCache->BindUniformBlock("MaterialBlock", MATERIAL_BLOCK_BINDING));
+}
+
+/***********************************************************
+ *  ResolveUniformHandles()
+ *
+ *  This method is used for resolving the handles of all the
+ *  shader uniforms used by the scene.  It is called once when
+ *  the scene is prepared so rendering never looks up uniforms
+ *  by name.
+ ***********************************************************/
+void SceneManager::ResolveUniformHandles()
+{
+	m_uniforms.model = m_pUniformCache->GetHandle<glm::mat4>(g_ModelName);
+	m_uniforms.objectColor = m_pUniformCache->GetHandle<glm::vec4>(g_ColorValueName);
+	m_uniforms.objectTexture = m_pUniformCache->GetHandle<int>(g_TextureValueName);
+	m_uniforms.textureLayer = m_pUniformCache->GetHandle<float>("textureLayer");
+	m_uniforms.textureRect = m_pUniformCache->GetHandle<glm::vec4>("textureRect");
+	m_uniforms.bUseTexture = m_pUniformCache->GetHandle<bool>(g_UseTextureName);
+	m_uniforms.bUseLighting = m_pUniformCache->GetHandle<bool>(g_UseLightingName);
+	m_uniforms.bUseInstancing = m_pUniformCache->GetHandle<bool>(g_UseInstancingName);
+	m_uniforms.bPackedVertices = m_pUniformCache->GetHandle<bool>(g_PackedVerticesName);
+	m_uniforms.UVscale = m_pUniformCache->GetHandle<glm::vec2>(g_UVScaleName);
+
+	m_uniforms.materialIndex = m_pUniformCache->GetHandle<int>("materialIndex");
+
+	m_uniforms.directionalLightActive = m_pUniformCache->GetHandle<bool>("directionalLight.bActive");
+	m_uniforms.spotLightActive = m_pUniformCache->GetHandle<bool>("spotLight.bActive");
+
+	m_uniforms.pointLightData = m_pUniformCache->GetHandle<int>("pointLightData");
+	m_uniforms.clusterData = m_pUniformCache->GetHandle<int>("clusterData");
+	m_uniforms.clusterLightIndices = m_pUniformCache->GetHandle<int>("clusterLightIndices");
+}
+
+/***********************************************************
+ *  BuildInstanceGroups()
+ *
+ *  This method is used for creating the instanced sphere
+ *  mesh and grouping the sphere draw records into instance
+ *  batches.
+ ***********************************************************/
+void SceneManager::BuildInstanceGroups()
+{
+	m_instanceGroups.clear();
+	m_instanceGeneration = -1;
+
+	if (m_bUseInstancing == false)
+	{
+		return;
+	}
+
+	// the instanced spheres use their own copy of the sphere
+	// geometry, tessellated once for each level of detail
+	for (int i = 0; i < g_SphereLevelCount; i++)
+	{
+		MESH_DATA sphereMesh;
+		MeshGenerator::BuildSphere(sphereMesh, g_SphereLevelSlices[i], g_SphereLevelStacks[i]);
+		MeshOptimizer::OptimizeMesh(sphereMesh);
+		if (m_sphereInstances[i]->Create(sphereMesh) == false)
+		{
+			std::cout << "Could not create the instanced sphere mesh" << std::endl;
+			return;
+		}
+	}
+
+	GroupInstances();
+}
+
+/***********************************************************
+ *  GroupInstances()
+ *
+ *  This method is used for grouping all of the sphere draw
+ *  records that share a texture array, and uploading each
+ *  group into an instance batch.  Spheres with different
+ *  textures in the same array are drawn together, each with
+ *  its own layer.  Every group has a batch in the mesh of
+ *  each level of detail, and starts with all of its spheres
+ *  at the finest level.  The groups are rebuilt whenever
+ *  loaded textures move, reusing the batches made before.
+ ***********************************************************/
+void SceneManager::GroupInstances()
+{
+	m_instanceGroups.clear();
+	m_pLodSelectors[MESH_SPHERE]->Clear();
+
+	for (int i = 0; i < (int)m_drawRecords.size(); i++)
+	{
+		DRAW_RECORD& record = m_drawRecords[i];
+		if (record.mesh != MESH_SPHERE)
+		{
+			continue;
+		}
+
+		const TextureArrays::TEXTURE_LOCATION& location = m_pTextureArrays->GetLocation(record.textureIndex);
+
+		// find the group with the same texture array
+		int groupIndex = -1;
+		for (int j = 0; (j < (int)m_instanceGroups.size()) && (groupIndex < 0); j++)
+		{
+			if (m_instanceGroups[j].textureUnit == location.unit)
+			{
+				groupIndex = j;
+			}
+		}
+		if (groupIndex < 0)
+		{
+			INSTANCE_GROUP group;
+			group.textureUnit = location.unit;
+			group.batchIndex = -1;
+			group.bDirty = false;
+			m_instanceGroups.push_back(group);
+			groupIndex = (int)m_instanceGroups.size() - 1;
+		}
+
+		INSTANCE_DATA instance;
+		instance.model = record.model;
+		instance.uvScale = record.uvScale;
+		instance.materialIndex = record.materialIndex;
+		instance.textureRect = location.rect;
+		instance.textureLayer = location.layer;
+
+		record.instanceGroup = groupIndex;
+		record.instanceIndex = (int)m_instanceGroups[groupIndex].instances.size();
+		m_instanceGroups[groupIndex].instances.push_back(instance);
+		m_instanceGroups[groupIndex].instanceVisible.push_back(1);
+		m_instanceGroups[groupIndex].instanceLevels.push_back(0);
+	}
+
+	std::vector<INSTANCE_DATA> noInstances;
+	for (int i = 0; i < (int)m_instanceGroups.size(); i++)
+	{
+		for (int level = 0; level < g_SphereLevelCount; level++)
+		{
+			const std::vector<INSTANCE_DATA>& instances = (level == 0) ? m_instanceGroups[i].instances : noInstances;
+			if (i < m_instanceBatchCount)
+			{
+				m_sphereInstances[level]->UpdateBatch(i, instances);
+			}
+			else
+			{
+				m_sphereInstances[level]->AddBatch(instances);
+			}
+		}
+		if (i >= m_instanceBatchCount)
+		{
+			m_instanceBatchCount++;
+		}
+		m_instanceGroups[i].batchIndex = i;
+	}
+
+	m_instanceGeneration = m_pTextureArrays->GetGeneration();
+}
+
+/***********************************************************
+ *  QueueDrawRecords()
+ *
+ *  This method is used for queueing the draw records that
+ *  are not instanced and sorting them by render state.  The
+ *  records are sorted by texture array rather than by
+ *  texture, since switching layers within an array only
+ *  changes a uniform.
+ ***********************************************************/
+void SceneManager::QueueDrawRecords()
+{
+	m_pRenderQueue->Clear();
+	m_occludedObjectCount = 0;
+	m_drawRecordTriangles = 0;
+	for (int i = 0; i < (int)m_drawRecords.size(); i++)
+	{
+		const DRAW_RECORD& record = m_drawRecords[i];
+
+		// instanced objects are drawn with the rest of their group
+		if ((record.instanceGroup >= 0) || (m_pFrustumCuller->IsVisible(i) == false))
+		{
+			continue;
+		}
+		// objects found hidden in an earlier frame are skipped
+		if ((m_bUseOcclusionCulling == true) && (m_pOcclusionCuller->IsOccluded(i) == true))
+		{
+			m_occludedObjectCount++;
+			continue;
+		}
+
+		m_pRenderQueue->Submit(
+			RenderQueue::MakeSortKey(
+				RenderQueue::PASS_SCENE,
+				false,
+				m_pTextureArrays->GetLocation(record.textureIndex).unit,
+				record.materialIndex,
+				record.mesh),
+			i);
+		if (m_pMeshBuffer->IsCreated() == true)
+		{
+			m_drawRecordTriangles += m_pMeshBuffer->GetIndexCount(GetMeshIndex(record.mesh, record.level)) / 3;
+		}
+	}
+	m_pRenderQueue->Sort();
+}
+
+/***********************************************************
+ *  RenderDrawRecords()
+ *
+ *  This method is used for drawing the queued draw records
+ *  in state order.  The material is only sent to the shader
+ *  when it differs from the previous draw.
+ ***********************************************************/
+void SceneManager::RenderDrawRecords()
+{
+	if (m_pRenderQueue->GetPacketCount() == 0)
+	{
+		return;
+	}
+
+	m_pUniformCache->SetValue(m_uniforms.bUseTexture, true);
+	// only the basic meshes loaded as a fallback are not packed
+	m_pUniformCache->SetValue(m_uniforms.bPackedVertices, m_pMeshBuffer->IsCreated());
+
+	bool bConditional = IsConditionalDrawing();
+	int currentMaterialIndex = -1;
+	for (int i = 0; i < m_pRenderQueue->GetPacketCount(); i++)
+	{
+		const DRAW_RECORD& record = m_drawRecords[m_pRenderQueue->GetPacket(i).drawIndex];
+
+		SetShaderTextureLocation(record.textureIndex);
+		if ((i == 0) || (record.materialIndex != currentMaterialIndex))
+		{
+			SetShaderMaterialIndex(record.materialIndex);
+			currentMaterialIndex = record.materialIndex;
+		}
+
+		m_pUniformCache->SetValue(m_uniforms.model, record.model);
+		m_pUniformCache->SetValue(m_uniforms.UVscale, record.uvScale);
+
+		int drawIndex = m_pRenderQueue->GetPacket(i).drawIndex;
+		BeginProfileScope((drawIndex < (int)m_objectScopes.size()) ? m_objectScopes[drawIndex] : -1);
+		if (bConditional == true)
+		{
+			m_pOcclusionCuller->BeginConditionalDraw(drawIndex);
+			DrawMesh(record.mesh, record.level);
+			m_pOcclusionCuller->EndConditionalDraw(drawIndex);
+		}
+		else
+		{
+			DrawMesh(record.mesh, record.level);
+		}
+		EndProfileScope();
+	}
+}
+
+/***********************************************************
+ *  IsIndirectDrawing()
+ *
+ *  This method is used for checking whether the frame is
+ *  submitted as indirect draw commands, which needs them to
+ *  be turned on and supported by the context.
+ ***********************************************************/
+bool SceneManager::IsIndirectDrawing() const
+{
+	return((m_bUseIndirectDraws == true) && (m_pMeshBuffer->IsIndirectReady() == true));
+}
+
+/***********************************************************
+ *  IsDepthPrepassDrawing()
+ *
+ *  This method is used for checking whether the depth only
+ *  pass runs in front of the shading pass this frame.
+ ***********************************************************/
+bool SceneManager::IsDepthPrepassDrawing() const
+{
+	return((m_bUseDepthPrepass == true) && (m_bCameraValid == true) && (m_pDepthPrepass->IsCreated() == true));
+}
+
+/***********************************************************
+ *  IsConditionalDrawing()
+ *
+ *  This method is used for checking whether the draw of an
+ *  object with a pending query is left to the GPU.  A query
+ *  can finish between the depth and the shading pass, so
+ *  the two passes could choose differently and leave a hole
+ *  where the depth was written but nothing shaded it.  With
+ *  the depth pre-pass on, those objects are always drawn.
+ ***********************************************************/
+bool SceneManager::IsConditionalDrawing() const
+{
+	return((m_bUseOcclusionCulling == true) && (IsDepthPrepassDrawing() == false));
+}
+
+/***********************************************************
+ *  BuildDrawCommands()
+ *
+ *  This method is used for building the draw commands of a
+ *  frame on the CPU.  Each queued record becomes a command
+ *  with one instance holding its model, material and texture
+ *  location, and each level of detail of an instance group
+ *  becomes a command with its visible spheres.  The records
+ *  are queued in texture array order, so commands sharing an
+ *  array fall into runs that each draw with one call.
+ ***********************************************************/
+void SceneManager::BuildDrawCommands()
+{
+	m_pMeshBuffer->ClearCommands();
+	m_indirectRuns.clear();
+
+	for (int i = 0; i < m_pRenderQueue->GetPacketCount(); i++)
+	{
+		const DRAW_RECORD& record = m_drawRecords[m_pRenderQueue->GetPacket(i).drawIndex];
+		const TextureArrays::TEXTURE_LOCATION& location = m_pTextureArrays->GetLocation(record.textureIndex);
+
+		INSTANCE_DATA instance;
+		instance.model = record.model;
+		instance.uvScale = record.uvScale;
+		instance.materialIndex = record.materialIndex;
+		instance.textureRect = location.rect;
+		instance.textureLayer = location.layer;
+		AddDrawCommand(location.unit, GetMeshIndex(record.mesh, record.level), &instance, 1);
+	}
+
+	for (int i = 0; i < (int)m_instanceGroups.size(); i++)
+	{
+		const INSTANCE_GROUP& group = m_instanceGroups[i];
+		for (int level = 0; level < g_SphereLevelCount; level++)
+		{
+			m_visibleInstances.clear();
+			for (int j = 0; j < (int)group.instances.size(); j++)
+			{
+				if ((group.instanceVisible[j] != 0) && (group.instanceLevels[j] == level))
+				{
+					m_visibleInstances.push_back(group.instances[j]);
+				}
+			}
+			AddDrawCommand(group.textureUnit, GetMeshIndex(MESH_SPHERE, level),
+				m_visibleInstances.data(), (int)m_visibleInstances.size());
+		}
+	}
+
+	m_pMeshBuffer->UploadCommands();
+}
+
+/***********************************************************
+ *  AddDrawCommand()
+ *
+ *  This method is used for adding a draw command, starting
+ *  a new run when its texture array differs from the run
+ *  before it.
+ ***********************************************************/
+void SceneManager::AddDrawCommand(int textureUnit, int meshIndex, const INSTANCE_DATA* pInstances, int instanceCount)
+{
+	if (instanceCount <= 0)
+	{
+		return;
+	}
+
+	if ((m_indirectRuns.size() == 0) || (m_indirectRuns.back().textureUnit != textureUnit))
+	{
+		INDIRECT_RUN run;
+		run.textureUnit = textureUnit;
+		run.firstCommand = m_pMeshBuffer->GetCommandCount();
+		run.commandCount = 0;
+		m_indirectRuns.push_back(run);
+	}
+
+	m_pMeshBuffer->AddCommand(meshIndex, pInstances, instanceCount);
+	m_indirectRuns.back().commandCount++;
+}
+
+/***********************************************************
+ *  RenderDrawCommands()
+ *
+ *  This method is used for drawing the frame from its draw
+ *  commands, with one indirect draw per texture array run.
+ *  The shader reads each draw from its instance data, as it
+ *  does for the instanced groups.
+ ***********************************************************/
+void SceneManager::RenderDrawCommands()
+{
+	if (m_indirectRuns.size() == 0)
+	{
+		return;
+	}
+
+	m_pUniformCache->SetValue(m_uniforms.bUseInstancing, true);
+	m_pUniformCache->SetValue(m_uniforms.bUseTexture, true);
+	m_pUniformCache->SetValue(m_uniforms.bPackedVertices, true);
+
+	for (int i = 0; i < (int)m_indirectRuns.size(); i++)
+	{
+		const INDIRECT_RUN& run = m_indirectRuns[i];
+
+		m_pUniformCache->SetValue(m_uniforms.objectTexture, run.textureUnit);
+		m_pMeshBuffer->DrawCommands(run.firstCommand, run.commandCount);
+	}
+
+	m_pUniformCache->SetValue(m_uniforms.bUseInstancing, false);
+}
+
+/***********************************************************
+ *  SetIndirectDraws()
+ *
+ *  This method is used for choosing whether the frame is
+ *  submitted as indirect draw commands when the context
+ *  supports them, or one mesh at a time.
+ ***********************************************************/
+void SceneManager::SetIndirectDraws(bool bEnable)
+{
+	m_bUseIndirectDraws = bEnable;
+}
+
+/***********************************************************
+ *  SetProfiler()
+ *
+ *  This method is used for setting the profiler that
+ *  measures the scene scopes.  Every draw record gets its
+ *  own scope, so slow objects can be found.
+ ***********************************************************/
+void SceneManager::SetProfiler(Profiler* pProfiler)
+{
+	m_pProfiler = pProfiler;
+	m_objectScopes.clear();
+
+	if (NULL == m_pProfiler)
+	{
+		return;
+	}
+
+	m_lightScope = m_pProfiler->RegisterScope("lights");
+	m_drawRecordScope = m_pProfiler->RegisterScope("draw records");
+	m_instanceScope = m_pProfiler->RegisterScope("instanced groups");
+	m_occlusionScope = m_pProfiler->RegisterScope("occlusion queries");
+	m_depthPrepassScope = m_pProfiler->RegisterScope("depth prepass");
+	m_shadedFragmentsCounter = m_pProfiler->RegisterCounter("shaded fragments");
+	m_trianglesCounter = m_pProfiler->RegisterCounter("triangles submitted", GL_PRIMITIVES_GENERATED);
+	// the objects at each level of detail, for the mesh types
+	// that have more than one
+	for (int i = 0; i < MESH_TYPE_COUNT; i++)
+	{
+		for (int level = 0; (level < g_MeshLevelCounts[i]) && (g_MeshLevelCounts[i] > 1); level++)
+		{
+			m_lodCounters[i][level] = m_pProfiler->RegisterCounter(
+				std::string(g_MeshNames[i]) + " lod " + std::to_string(level), 0);
+		}
+	}
+
+	for (int i = 0; i < (int)m_drawRecords.size(); i++)
+	{
+		m_objectScopes.push_back(m_pProfiler->RegisterScope(
+			"object " + std::to_string(i) + " " + g_MeshNames[m_drawRecords[i].mesh]));
 	}
-
-	return(textureID);
 }
 
 /***********************************************************
- *  FindTextureSlot()
+ *  BeginProfileScope()
  *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for opening a profiler scope when a
+ *  profiler is set.
  ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
+void SceneManager::BeginProfileScope(int scopeID)
 {
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
-
-	while ((index < m_loadedTextures) && (bFound == false))
+	if (NULL != m_pProfiler)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
+		m_pProfiler->BeginScope(scopeID);
 	}
-
-	return(textureSlot);
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  EndProfileScope()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for closing the most recent profiler
+ *  scope when a profiler is set.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+void SceneManager::EndProfileScope()
 {
-	if (m_objectMaterials.size() == 0)
+	if (NULL != m_pProfiler)
 	{
-		return(false);
+		m_pProfiler->EndScope();
 	}
+}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < (int)m_objectMaterials.size()) && (bFound == false))
+/***********************************************************
+ *  UpdateInstanceBatches()
+ *
+ *  This method is used for uploading the visible instances
+ *  of the groups with moved objects, or whose instances
+ *  entered or left the frustum or changed level of detail,
+ *  before any pass draws them.  Each level of a group gets
+ *  the visible instances that use it.
+ ***********************************************************/
+void SceneManager::UpdateInstanceBatches()
+{
+	for (int i = 0; i < (int)m_instanceGroups.size(); i++)
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
+		INSTANCE_GROUP& group = m_instanceGroups[i];
+		if (group.bDirty == false)
 		{
-			bFound = true;
-			material.ambientColor = m_objectMaterials[index].ambientColor;
-			material.ambientStrength = m_objectMaterials[index].ambientStrength;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
+			continue;
 		}
-		else
+
+		for (int level = 0; level < g_SphereLevelCount; level++)
 		{
-			index++;
+			m_visibleInstances.clear();
+			for (int j = 0; j < (int)group.instances.size(); j++)
+			{
+				if ((group.instanceVisible[j] != 0) && (group.instanceLevels[j] == level))
+				{
+					m_visibleInstances.push_back(group.instances[j]);
+				}
+			}
+			m_sphereInstances[level]->UpdateBatch(group.batchIndex, m_visibleInstances);
 		}
+		group.bDirty = false;
 	}
-
-	return(bFound);
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  RenderInstanceGroups()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for drawing each group of instanced
+ *  spheres with one draw call per texture array and level
+ *  of detail.  Levels with no spheres issue no draw.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+void SceneManager::RenderInstanceGroups()
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
+	if (m_instanceGroups.size() == 0)
+	{
+		return;
+	}
 
-	modelView = translation * rotationX * rotationY * rotationZ * scale;
+	m_pUniformCache->SetValue(m_uniforms.bUseInstancing, true);
+	m_pUniformCache->SetValue(m_uniforms.bPackedVertices, true);
 
-	if (NULL != m_pShaderManager)
+	for (int i = 0; i < (int)m_instanceGroups.size(); i++)
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		const INSTANCE_GROUP& group = m_instanceGroups[i];
+
+		m_pUniformCache->SetValue(m_uniforms.bUseTexture, true);
+		m_pUniformCache->SetValue(m_uniforms.objectTexture, group.textureUnit);
+		for (int level = 0; level < g_SphereLevelCount; level++)
+		{
+			m_sphereInstances[level]->DrawBatch(group.batchIndex);
+		}
 	}
+
+	m_pUniformCache->SetValue(m_uniforms.bUseInstancing, false);
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  DrawSceneGeometry()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for drawing the queued draw records
+ *  and the instanced groups with the program of the depth
+ *  or overdraw pass, which only needs the model matrices.
+ *  The draw commands of the frame need no texture, so they
+ *  are all drawn with a single indirect draw.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+void SceneManager::DrawSceneGeometry()
 {
-	// variables for this method
-	glm::vec4 currentColor;
-
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+	if (IsIndirectDrawing() == true)
+	{
+		m_pDepthPrepass->SetInstanced(true);
+		m_pDepthPrepass->SetPackedVertices(true);
+		m_pMeshBuffer->DrawCommands(0, m_pMeshBuffer->GetCommandCount());
+		m_pDepthPrepass->SetInstanced(false);
+		return;
+	}
 
-	if (NULL != m_pShaderManager)
+	bool bConditional = IsConditionalDrawing();
+	m_pDepthPrepass->SetPackedVertices(m_pMeshBuffer->IsCreated());
+	for (int i = 0; i < m_pRenderQueue->GetPacketCount(); i++)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		int drawIndex = m_pRenderQueue->GetPacket(i).drawIndex;
+		const DRAW_RECORD& record = m_drawRecords[drawIndex];
+
+		m_pDepthPrepass->SetModel(record.model);
+		if (bConditional == true)
+		{
+			m_pOcclusionCuller->BeginConditionalDraw(drawIndex);
+			DrawMesh(record.mesh, record.level);
+			m_pOcclusionCuller->EndConditionalDraw(drawIndex);
+		}
+		else
+		{
+			DrawMesh(record.mesh, record.level);
+		}
 	}
-}
 
-/***********************************************************
- *  SetShaderTexture()
- *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
- ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
-{
-	if (NULL != m_pShaderManager)
+	if (m_instanceGroups.size() == 0)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
+		return;
+	}
 
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+	m_pDepthPrepass->SetInstanced(true);
+	m_pDepthPrepass->SetPackedVertices(true);
+	for (int i = 0; i < (int)m_instanceGroups.size(); i++)
+	{
+		for (int level = 0; level < g_SphereLevelCount; level++)
+		{
+			m_sphereInstances[level]->DrawBatch(m_instanceGroups[i].batchIndex);
+		}
 	}
+	m_pDepthPrepass->SetInstanced(false);
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  SetDepthPrepass()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for turning the depth only pass in
+ *  front of the shading pass on or off.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+void SceneManager::SetDepthPrepass(bool bEnable)
 {
-	if (NULL != m_pShaderManager)
-	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
-	}
+	m_bUseDepthPrepass = bEnable;
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  SetOverdrawView()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for showing how many times each pixel
+ *  is shaded instead of the lit scene.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+void SceneManager::SetOverdrawView(bool bEnable)
 {
-	if (m_objectMaterials.size() > 0)
-	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
-
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
-		{
-			m_pShaderManager->setVec3Value("material.ambientColor", material.ambientColor);
-			m_pShaderManager->setFloatValue("material.ambientStrength", material.ambientStrength);
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
-		}
-	}
+	m_bShowOverdraw = bEnable;
 }
 
 /**************************************************************/
@@ -384,6 +1816,14 @@ void SceneManager::SetShaderMaterial(
  ***********************************************************/
 void SceneManager::PrepareScene()
 {
+	// the uniform handles are needed by the light and draw setup
+	if ((NULL == m_pUniformCache) || (NULL == m_pStateCache))
+	{
+		std::cout << "Could not prepare the scene, no uniform or state cache" << std::endl;
+		return;
+	}
+	ResolveUniformHandles();
+
 	// Load blueberry texture
 	bool bSuccess = CreateGLTexture("textures/blueberry_v1.1.jpg", "blueberry");
 
@@ -425,452 +1865,406 @@ void SceneManager::PrepareScene()
 	BindGLTextures();
 
 	DefineObjectMaterials();  // Define materials for lighting
+	RegisterMaterialTags();   // Index the materials by tag
+	CreateMaterialBuffer();   // Upload the materials once
 	SetupSceneLights();       // Setup the light sources
 
-	// The meshes needed for the cake slice
-	m_basicMeshes->LoadPlaneMesh();      // table surface
-	m_basicMeshes->LoadPrismMesh();      // Cake layers
-	m_basicMeshes->LoadBoxMesh();        // Frosting layers
-	m_basicMeshes->LoadCylinderMesh();   // For the plate
-	m_basicMeshes->LoadSphereMesh();     // Blueberries and whipped cream
+	// The meshes needed for the cake slice, packed into shared
+	// buffers, or loaded one by one if that fails
+	if (CreateMeshBuffer() == false)
+	{
+		std::cout << "Could not create the shared mesh buffers" << std::endl;
+		m_basicMeshes->LoadPlaneMesh();      // table surface
+		m_basicMeshes->LoadPrismMesh();      // Cake layers
+		m_basicMeshes->LoadBoxMesh();        // Frosting layers
+		m_basicMeshes->LoadCylinderMesh();   // For the plate
+		m_basicMeshes->LoadSphereMesh();     // Blueberries and whipped cream
+	}
+
+	// resolve all of the scene objects into retained draw records
+	BuildSceneObjects();
+	// draw the repeated spheres with instancing
+	BuildInstanceGroups();
+	// box geometry and shader of the occlusion queries
+	if (m_pOcclusionCuller->Create() == false)
+	{
+		std::cout << "Occlusion culling is disabled" << std::endl;
+		m_bUseOcclusionCulling = false;
+	}
+	// depth only and overdraw shaders
+	if (m_pDepthPrepass->Create(m_vertexShaderPath.c_str()) == false)
+	{
+		std::cout << "The depth prepass and overdraw view are disabled" << std::endl;
+	}
+
+	// buffers and textures were bound directly while preparing
+	m_pStateCache->InvalidateTextures();
+	m_pStateCache->InvalidateVertexArray();
 }
 
 /***********************************************************
- *  RenderScene()
+ *  BuildSceneObjects()
  *
- *  This method is used for rendering the 3D scene by
- *  transforming and drawing the basic 3D shapes
+ *  This method is used for adding all of the objects in the
+ *  3D scene to the retained draw records.  It is called once
+ *  after the textures, materials and meshes are loaded.
  ***********************************************************/
-void SceneManager::RenderScene()
+void SceneManager::BuildSceneObjects()
 {
-	// Declare variables for transformations
-	glm::vec3 scaleXYZ;
-	float XrotationDegrees = 0.0f;
-	float YrotationDegrees = 0.0f;
-	float ZrotationDegrees = 0.0f;
-	glm::vec3 positionXYZ;
+	m_drawRecords.clear();
+	m_pTransformCache->Clear();
+	for (int i = 0; i < MESH_TYPE_COUNT; i++)
+	{
+		m_pLodSelectors[i]->Clear();
+	}
+	m_pFrustumCuller->Clear();
+	m_bHierarchyDirty = true;
 
 	// RENDER TABLE SURFACE (Ground Plane)
-	scaleXYZ = glm::vec3(20.0f, 1.0f, 15.0f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("tablecloth");
-	SetShaderMaterial("table");
-	SetTextureUVScale(3.0f, 3.0f);
-	m_basicMeshes->DrawPlaneMesh();
+	AddSceneObject(MESH_PLANE,
+		glm::vec3(20.0f, 1.0f, 15.0f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(0.0f, 0.0f, 0.0f),
+		"tablecloth", "table", 3.0f, 3.0f);
 
 	// RENDER DESSERT PLATE
-	scaleXYZ = glm::vec3(4.2f, 0.1f, 4.0f);  
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.0f, 0.1f, 0.0f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("plate");
-	SetShaderMaterial("plate");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawCylinderMesh();
+	AddSceneObject(MESH_CYLINDER,
+		glm::vec3(4.2f, 0.1f, 4.0f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(0.0f, 0.1f, 0.0f),
+		"plate", "plate", 1.0f, 1.0f);
 
 	// CAKE BASE LAYER 
-	scaleXYZ = glm::vec3(1.5f, 0.8f, 4.0f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -10.0f;
-	ZrotationDegrees = -90.0f;
-	positionXYZ = glm::vec3(-2.55f, 0.35f, 0.09f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("carrot_cake");
-	SetShaderMaterial("cake");
-	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawPrismMesh();
+	AddSceneObject(MESH_PRISM,
+		glm::vec3(1.5f, 0.8f, 4.0f), 0.0f, -10.0f, -90.0f,
+		glm::vec3(-2.55f, 0.35f, 0.09f),
+		"carrot_cake", "cake", 2.0f, 2.0f);
 
 	// FROSTING LAYER 1
-	scaleXYZ = glm::vec3(1.45f, 0.095f, 4.0f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -10.0f;
-	ZrotationDegrees = -90.0f;
-	positionXYZ = glm::vec3(-2.10f, 0.35f, 0.09f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("frosting");
-	SetShaderMaterial("frosting");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawPrismMesh();
+	AddSceneObject(MESH_PRISM,
+		glm::vec3(1.45f, 0.095f, 4.0f), 0.0f, -10.0f, -90.0f,
+		glm::vec3(-2.10f, 0.35f, 0.09f),
+		"frosting", "frosting", 1.0f, 1.0f);
 
 	// CAKE MIDDLE LAYER
-	scaleXYZ = glm::vec3(1.5f, 0.7f, 4.0f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -10.0f;
-	ZrotationDegrees = -90.0f;
-	positionXYZ = glm::vec3(-1.70f, 0.35f, 0.09f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("carrot_cake");
-	SetShaderMaterial("cake");
-	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawPrismMesh();
+	AddSceneObject(MESH_PRISM,
+		glm::vec3(1.5f, 0.7f, 4.0f), 0.0f, -10.0f, -90.0f,
+		glm::vec3(-1.70f, 0.35f, 0.09f),
+		"carrot_cake", "cake", 2.0f, 2.0f);
 
 	// FROSTING LAYER 2
-	scaleXYZ = glm::vec3(1.45f, 0.095f, 4.0f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -10.0f;
-	ZrotationDegrees = -90.0f;
-	positionXYZ = glm::vec3(-1.30f, 0.35f, 0.09f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("frosting");
-	SetShaderMaterial("frosting");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawPrismMesh();
+	AddSceneObject(MESH_PRISM,
+		glm::vec3(1.45f, 0.095f, 4.0f), 0.0f, -10.0f, -90.0f,
+		glm::vec3(-1.30f, 0.35f, 0.09f),
+		"frosting", "frosting", 1.0f, 1.0f);
 
 	// CAKE TOP LAYER
-	scaleXYZ = glm::vec3(1.5f, 0.6f, 4.0f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -10.0f;
-	ZrotationDegrees = -90.0f;
-	positionXYZ = glm::vec3(-0.95f, 0.35f, 0.09f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("carrot_cake");
-	SetShaderMaterial("cake");
-	SetTextureUVScale(2.0f, 2.0f);
-	m_basicMeshes->DrawPrismMesh();
+	AddSceneObject(MESH_PRISM,
+		glm::vec3(1.5f, 0.6f, 4.0f), 0.0f, -10.0f, -90.0f,
+		glm::vec3(-0.95f, 0.35f, 0.09f),
+		"carrot_cake", "cake", 2.0f, 2.0f);
 
 	// FROSTING LAYER TOP CAP on left side
-	scaleXYZ = glm::vec3(1.45f, 0.10f, 4.0f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -10.0f;
-	ZrotationDegrees = -90.0f;
-	positionXYZ = glm::vec3(-3.00f, 0.36f, 0.09f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("frosting");
-	SetShaderMaterial("frosting");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawPrismMesh();
+	AddSceneObject(MESH_PRISM,
+		glm::vec3(1.45f, 0.10f, 4.0f), 0.0f, -10.0f, -90.0f,
+		glm::vec3(-3.00f, 0.36f, 0.09f),
+		"frosting", "frosting", 1.0f, 1.0f);
 
 	// FROSTING BACK SIDE thin rectangle
-	scaleXYZ = glm::vec3(2.40f, 1.60f, 0.4f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = -1.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-1.5f, 0.35f, -1.93f); 
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("frosting");
-	SetShaderMaterial("frosting");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX,
+		glm::vec3(2.40f, 1.60f, 0.4f), 0.0f, -1.0f, 0.0f,
+		glm::vec3(-1.5f, 0.35f, -1.93f),
+		"frosting", "frosting", 1.0f, 1.0f);
 
 	// whipped cream
 	// BASE WHIPPED CREAM 
-	scaleXYZ = glm::vec3(0.8f, 0.25f, 0.7f);  
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-0.85f, 0.28f, 2.8f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("whipped_cream");
-	SetShaderMaterial("cream");
-	SetTextureUVScale(3.0f, 3.0f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.8f, 0.25f, 0.7f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-0.85f, 0.28f, 2.8f),
+		"whipped_cream", "cream", 3.0f, 3.0f);
 
 	// MIDDLE LAYER
-	scaleXYZ = glm::vec3(0.6f, 0.3f, 0.55f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 15.0f;  
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-1.0f, 0.4f, 2.75f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("whipped_cream");
-	SetShaderMaterial("cream");
-	SetTextureUVScale(3.0f, 3.0f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.6f, 0.3f, 0.55f), 0.0f, 15.0f, 0.0f,
+		glm::vec3(-1.0f, 0.4f, 2.75f),
+		"whipped_cream", "cream", 3.0f, 3.0f);
 
 	// TOP PEAK - small peak 
-	scaleXYZ = glm::vec3(0.35f, 0.4f, 0.3f);  
-	XrotationDegrees = 10.0f;
-	YrotationDegrees = -20.0f;
-	ZrotationDegrees = 5.0f;
-	positionXYZ = glm::vec3(-1.0f, 0.55f, 2.7f); 
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("whipped_cream");
-	SetShaderMaterial("cream");
-	SetTextureUVScale(3.0f, 3.0f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.35f, 0.4f, 0.3f), 10.0f, -20.0f, 5.0f,
+		glm::vec3(-1.0f, 0.55f, 2.7f),
+		"whipped_cream", "cream", 3.0f, 3.0f);
 
 	// Strawberry
-	scaleXYZ = glm::vec3(0.5f, 0.45f, 0.30f);
-	XrotationDegrees = -5.0f;
-	YrotationDegrees = -45.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(0.02f, 0.35f, -0.8f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("strawberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(2.0f, 3.3f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.5f, 0.45f, 0.30f), -5.0f, -45.0f, 0.0f,
+		glm::vec3(0.02f, 0.35f, -0.8f),
+		"strawberry", "berry", 2.0f, 3.3f);
 
 	// Blueberry 1 - Top left touching pair (first berry)
-	scaleXYZ = glm::vec3(0.18f, 0.18f, 0.18f);
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.0f;
-	positionXYZ = glm::vec3(-3.35f, 0.35f, 0.2f); 
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(0.6f, 0.6f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.18f, 0.18f, 0.18f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-3.35f, 0.35f, 0.2f),
+		"blueberry", "berry", 0.6f, 0.6f);
 
 	// Blueberry 2 - Top left touching pair (second berry, touching the first)
-	scaleXYZ = glm::vec3(0.17f, 0.17f, 0.17f);
-	positionXYZ = glm::vec3(-3.35F, 0.35f, 0.7f); 
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(0.8f, 0.8f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.17f, 0.17f, 0.17f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-3.35F, 0.35f, 0.7f),
+		"blueberry", "berry", 0.8f, 0.8f);
 
 	// Blueberry 3 - In front of cake(left-side)
-	scaleXYZ = glm::vec3(0.2f, 0.2f, 0.2f);
-	positionXYZ = glm::vec3(-2.8f, 0.3f, 2.5f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(0.9f, 0.9f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.2f, 0.2f, 0.2f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-2.8f, 0.3f, 2.5f),
+		"blueberry", "berry", 0.9f, 0.9f);
 
 	// Blueberry 4 - center plate below number 5
-	scaleXYZ = glm::vec3(0.18f, 0.18f, 0.18f);
-	positionXYZ = glm::vec3(0.5f, 0.3f, 1.0);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(1.0f, 1.0f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.18f, 0.18f, 0.18f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(0.5f, 0.3f, 1.0f),
+		"blueberry", "berry", 1.0f, 1.0f);
 
 	// Blueberry 5 - center plate above number 4
-	scaleXYZ = glm::vec3(0.17f, 0.17f, 0.17f);
-	positionXYZ = glm::vec3(0.6f, 0.3f, 1.45f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(1.2f, 1.2f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.17f, 0.17f, 0.17f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(0.6f, 0.3f, 1.45f),
+		"blueberry", "berry", 1.2f, 1.2f);
 
 	// Blueberry 6 - bottom berry in the triangle formation top right 
-	scaleXYZ = glm::vec3(0.16f, 0.16f, 0.16f);
-	positionXYZ = glm::vec3(1.8f, 0.3f, -0.4f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(1.1f, 1.1f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.16f, 0.16f, 0.16f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(1.8f, 0.3f, -0.4f),
+		"blueberry", "berry", 1.1f, 1.1f);
 
 	// Blueberry 7 - left berry in the triangle formation top right 
-	scaleXYZ = glm::vec3(0.19f, 0.19f, 0.19f);
-	positionXYZ = glm::vec3(1.5f, 0.3f, -1.2f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(1.25f, 1.25f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.19f, 0.19f, 0.19f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(1.5f, 0.3f, -1.2f),
+		"blueberry", "berry", 1.25f, 1.25f);
 
 	// Blueberry 8 - right berry in the triangle formation top right 
-	scaleXYZ = glm::vec3(0.15f, 0.15f, 0.15f);
-	positionXYZ = glm::vec3(2.2, 0.3f, -1.1f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(0.3f, 0.3f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.15f, 0.15f, 0.15f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(2.2f, 0.3f, -1.1f),
+		"blueberry", "berry", 0.3f, 0.3f);
 
 	// Blueberry 9 - right behind whipped cream(barely visible)
-	scaleXYZ = glm::vec3(0.15f, 0.15f, 0.15f);
-	positionXYZ = glm::vec3(-0.5f, 0.3f, 2.0f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("blueberry");
-	SetShaderMaterial("berry");
-	SetTextureUVScale(0.3f, 0.3f);
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.15f, 0.15f, 0.15f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-0.5f, 0.3f, 2.0f),
+		"blueberry", "berry", 0.3f, 0.3f);
 
-	// Caramel Drizzle lines
+	// Caramel Drizzle lines - the end caps keep the UV scale
+	// of the drizzle line they belong to
 	// Drizzle line 1
-	scaleXYZ = glm::vec3(5.6f, 0.065f, 0.085f); 
-	XrotationDegrees = 0.0f;
-	YrotationDegrees = 0.0f;
-	ZrotationDegrees = 0.8f;  
-	positionXYZ = glm::vec3(0.1f, 0.18f, 1.4f);  
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	SetTextureUVScale(1.0f, 7.8f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX,
+		glm::vec3(5.6f, 0.065f, 0.085f), 0.0f, 0.0f, 0.8f,
+		glm::vec3(0.1f, 0.18f, 1.4f),
+		"caramel", "caramel", 1.0f, 7.8f);
 
 	// End caps for line 1
-	scaleXYZ = glm::vec3(0.120f, 0.100f, 0.120f);
-	positionXYZ = glm::vec3(-2.7f, 0.21f, 1.37f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
-
-	scaleXYZ = glm::vec3(0.120f, 0.100f, 0.120f);
-	positionXYZ = glm::vec3(2.9f, 0.21f, 1.43f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.120f, 0.100f, 0.120f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-2.7f, 0.21f, 1.37f),
+		"caramel", "caramel", 1.0f, 7.8f);
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.120f, 0.100f, 0.120f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(2.9f, 0.21f, 1.43f),
+		"caramel", "caramel", 1.0f, 7.8f);
 
 	// Drizzle line 2
-	scaleXYZ = glm::vec3(5.4f, 0.065f, 0.085f);
-	ZrotationDegrees = -0.6f;  
-	positionXYZ = glm::vec3(0.2f, 0.18f, 0.9f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	SetTextureUVScale(1.0f, 7.6f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX,
+		glm::vec3(5.4f, 0.065f, 0.085f), 0.0f, 0.0f, -0.6f,
+		glm::vec3(0.2f, 0.18f, 0.9f),
+		"caramel", "caramel", 1.0f, 7.6f);
 
 	// End caps for line 2
-	scaleXYZ = glm::vec3(0.115f, 0.100f, 0.115f);
-	positionXYZ = glm::vec3(-2.5f, 0.21f, 0.92f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
-
-	scaleXYZ = glm::vec3(0.115f, 0.100f, 0.115f);
-	positionXYZ = glm::vec3(2.9f, 0.21f, 0.88f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.115f, 0.100f, 0.115f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-2.5f, 0.21f, 0.92f),
+		"caramel", "caramel", 1.0f, 7.6f);
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.115f, 0.100f, 0.115f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(2.9f, 0.21f, 0.88f),
+		"caramel", "caramel", 1.0f, 7.6f);
 
 	// Drizzle line 3
-	scaleXYZ = glm::vec3(5.2f, 0.065f, 0.085f);
-	ZrotationDegrees = 0.4f;
-	positionXYZ = glm::vec3(-0.1f, 0.18f, 0.4f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	SetTextureUVScale(1.0f, 7.4f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX,
+		glm::vec3(5.2f, 0.065f, 0.085f), 0.0f, 0.0f, 0.4f,
+		glm::vec3(-0.1f, 0.18f, 0.4f),
+		"caramel", "caramel", 1.0f, 7.4f);
 
 	// End caps for line 3
-	scaleXYZ = glm::vec3(0.112f, 0.100f, 0.112f);
-	positionXYZ = glm::vec3(-2.7f, 0.21f, 0.38f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
-
-	scaleXYZ = glm::vec3(0.112f, 0.100f, 0.112f);
-	positionXYZ = glm::vec3(2.5f, 0.21f, 0.42f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.112f, 0.100f, 0.112f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-2.7f, 0.21f, 0.38f),
+		"caramel", "caramel", 1.0f, 7.4f);
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.112f, 0.100f, 0.112f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(2.5f, 0.21f, 0.42f),
+		"caramel", "caramel", 1.0f, 7.4f);
 
 	// Drizzle line 4
-	scaleXYZ = glm::vec3(5.0f, 0.065f, 0.085f);
-	ZrotationDegrees = -0.3f;
-	positionXYZ = glm::vec3(0.3f, 0.18f, -0.1f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	SetTextureUVScale(1.0f, 7.0f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX,
+		glm::vec3(5.0f, 0.065f, 0.085f), 0.0f, 0.0f, -0.3f,
+		glm::vec3(0.3f, 0.18f, -0.1f),
+		"caramel", "caramel", 1.0f, 7.0f);
 
 	// End caps for line 4
-	scaleXYZ = glm::vec3(0.110f, 0.100f, 0.110f);
-	positionXYZ = glm::vec3(-2.2f, 0.21f, -0.08f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
-
-	scaleXYZ = glm::vec3(0.110f, 0.100f, 0.110f);
-	positionXYZ = glm::vec3(2.8f, 0.21f, -0.12f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.110f, 0.100f, 0.110f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-2.2f, 0.21f, -0.08f),
+		"caramel", "caramel", 1.0f, 7.0f);
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.110f, 0.100f, 0.110f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(2.8f, 0.21f, -0.12f),
+		"caramel", "caramel", 1.0f, 7.0f);
 
 	// Drizzle line 5
-	scaleXYZ = glm::vec3(4.8f, 0.065f, 0.085f);
-	ZrotationDegrees = 0.7f;
-	positionXYZ = glm::vec3(-0.3f, 0.18f, -0.6f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	SetTextureUVScale(1.0f, 6.8f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX,
+		glm::vec3(4.8f, 0.065f, 0.085f), 0.0f, 0.0f, 0.7f,
+		glm::vec3(-0.3f, 0.18f, -0.6f),
+		"caramel", "caramel", 1.0f, 6.8f);
 
 	// End caps for line 5
-	scaleXYZ = glm::vec3(0.108f, 0.100f, 0.108f);
-	positionXYZ = glm::vec3(-2.7f, 0.21f, -0.64f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
-
-	scaleXYZ = glm::vec3(0.108f, 0.100f, 0.108f);
-	positionXYZ = glm::vec3(2.1f, 0.21f, -0.56f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.108f, 0.100f, 0.108f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-2.7f, 0.21f, -0.64f),
+		"caramel", "caramel", 1.0f, 6.8f);
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.108f, 0.100f, 0.108f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(2.1f, 0.21f, -0.56f),
+		"caramel", "caramel", 1.0f, 6.8f);
 
 	//Drizzle line 6 
-	scaleXYZ = glm::vec3(4.6f, 0.065f, 0.085f);
-	ZrotationDegrees = -0.5f;
-	positionXYZ = glm::vec3(0.4f, 0.18f, -1.1f);
-
-	SetTransformations(scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	SetTextureUVScale(1.0f, 6.6f);
-	m_basicMeshes->DrawBoxMesh();
+	AddSceneObject(MESH_BOX,
+		glm::vec3(4.6f, 0.065f, 0.085f), 0.0f, 0.0f, -0.5f,
+		glm::vec3(0.4f, 0.18f, -1.1f),
+		"caramel", "caramel", 1.0f, 6.6f);
 
 	// End caps for line 6
-	scaleXYZ = glm::vec3(0.106f, 0.100f, 0.106f);
-	positionXYZ = glm::vec3(-1.9f, 0.21f, -1.08f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.106f, 0.100f, 0.106f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(-1.9f, 0.21f, -1.08f),
+		"caramel", "caramel", 1.0f, 6.6f);
+	AddSceneObject(MESH_SPHERE,
+		glm::vec3(0.106f, 0.100f, 0.106f), 0.0f, 0.0f, 0.0f,
+		glm::vec3(2.7f, 0.21f, -1.12f),
+		"caramel", "caramel", 1.0f, 6.6f);
+
+	// build the model matrices of every object added above
+	UpdateTransforms();
+}
+
+/***********************************************************
+ *  RenderScene()
+ *
+ *  This method is used for rendering the 3D scene by
+ *  walking the retained draw records that were built when
+ *  the scene was prepared.
+ ***********************************************************/
+void SceneManager::RenderScene()
+{
+	if (NULL == m_pUniformCache)
+	{
+		return;
+	}
+
+	// upload any texture images that finished decoding
+	UploadLoadedTextures(false);
+	// fit the texture levels to the camera and the memory budget
+	UpdateTextureResidency();
+	// rebuild the model matrices of the objects that moved
+	UpdateTransforms();
+	// skip the objects outside the camera frustum
+	CullSceneObjects();
+	// choose the tessellation of the objects on screen
+	SelectObjectLevels();
+	// read the occlusion results the GPU has finished
+	if (m_bUseOcclusionCulling == true)
+	{
+		m_pOcclusionCuller->ResolveQueries((int)m_drawRecords.size());
+	}
+	// sort the draw records and upload the visible instances, or
+	// the draw commands of the frame, once for every pass
+	bool bIndirect = IsIndirectDrawing();
+	QueueDrawRecords();
+	if (bIndirect == true)
+	{
+		BuildDrawCommands();
+	}
+	else
+	{
+		UpdateInstanceBatches();
+	}
+
+	// send any light changes to the shader with one buffer update
+	BeginProfileScope(m_lightScope);
+	UpdateLightBuffer();
+	// bin the lights into the clusters of the current camera
+	UpdateLightClusters();
+	EndProfileScope();
+
+	// count the triangles every pass sends to the rasterizer
+	if (NULL != m_pProfiler)
+	{
+		m_pProfiler->BeginCounter(m_trianglesCounter);
+	}
+
+	// lay down the depth first, so the shading pass only shades
+	// the nearest fragment of each pixel
+	bool bDepthPrepass = IsDepthPrepassDrawing();
+	if (bDepthPrepass == true)
+	{
+		BeginProfileScope(m_depthPrepassScope);
+		m_pDepthPrepass->BeginDepthPass(m_cameraView.view, m_cameraView.projection);
+		DrawSceneGeometry();
+		m_pDepthPrepass->EndDepthPass();
+		EndProfileScope();
+	}
 
-	scaleXYZ = glm::vec3(0.106f, 0.100f, 0.106f);
-	positionXYZ = glm::vec3(2.7f, 0.21f, -1.12f);
-	SetTransformations(scaleXYZ, 0.0f, 0.0f, 0.0f, positionXYZ);
-	SetShaderTexture("caramel");
-	SetShaderMaterial("caramel");
-	m_basicMeshes->DrawSphereMesh();
+	// count the fragments that pass the depth test of the shading
+	// pass, which are the fragments the lighting shader runs for
+	if (NULL != m_pProfiler)
+	{
+		m_pProfiler->BeginCounter(m_shadedFragmentsCounter);
+	}
+	if ((m_bShowOverdraw == true) && (m_bCameraValid == true) && (m_pDepthPrepass->IsCreated() == true))
+	{
+		m_pDepthPrepass->BeginOverdrawPass(m_cameraView.view, m_cameraView.projection);
+		DrawSceneGeometry();
+		m_pDepthPrepass->EndOverdrawPass();
+	}
+	else if (bIndirect == true)
+	{
+		BeginProfileScope(m_drawRecordScope);
+		RenderDrawCommands();
+		EndProfileScope();
+	}
+	else
+	{
+		BeginProfileScope(m_drawRecordScope);
+		RenderDrawRecords();
+		EndProfileScope();
+
+		BeginProfileScope(m_instanceScope);
+		RenderInstanceGroups();
+		EndProfileScope();
+	}
+	if (NULL != m_pProfiler)
+	{
+		m_pProfiler->EndCounter(m_shadedFragmentsCounter);
+		m_pProfiler->EndCounter(m_trianglesCounter);
+	}
+
+	if (bDepthPrepass == true)
+	{
+		m_pDepthPrepass->EndShadingPass();
+	}
+
+	// test the boxes of the drawn objects against the finished depth
+	BeginProfileScope(m_occlusionScope);
+	IssueOcclusionQueries();
+	EndProfileScope();
 }
 
 /***********************************************************
@@ -971,37 +2365,288 @@ void SceneManager::DefineObjectMaterials()
 void SceneManager::SetupSceneLights()
 {
 	// Enable lighting
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	m_pUniformCache->SetValue(m_uniforms.bUseLighting, true);
+
+	// the point lights are sent to the shader through the light buffer
+	CreateLightBuffer();
 
 	// MAIN LIGHT - Warm kitchen lighting from above-right
-	m_pShaderManager->setVec3Value("pointLights[0].position", 6.0f, 12.0f, 4.0f);
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", 0.15f, 0.12f, 0.1f);    
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", 0.9f, 0.8f, 0.7f);      
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 0.6f, 0.6f, 0.5f);    
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
+	AddPointLight(
+		glm::vec3(6.0f, 12.0f, 4.0f),
+		glm::vec3(0.15f, 0.12f, 0.1f),
+		glm::vec3(0.9f, 0.8f, 0.7f),
+		glm::vec3(0.6f, 0.6f, 0.5f));
 
 	// ACCENT LIGHT - Soft blue light from the left
-	m_pShaderManager->setVec3Value("pointLights[1].position", -8.0f, 8.0f, 2.0f);
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.05f, 0.08f, 0.12f);   
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.3f, 0.4f, 0.6f);      
-	m_pShaderManager->setVec3Value("pointLights[1].specular", 0.2f, 0.3f, 0.4f);     
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
+	AddPointLight(
+		glm::vec3(-8.0f, 8.0f, 2.0f),
+		glm::vec3(0.05f, 0.08f, 0.12f),
+		glm::vec3(0.3f, 0.4f, 0.6f),
+		glm::vec3(0.2f, 0.3f, 0.4f));
 
 	// FILL LIGHT - fill light from front-right
-	m_pShaderManager->setVec3Value("pointLights[2].position", 4.0f, 6.0f, 8.0f);
-	m_pShaderManager->setVec3Value("pointLights[2].ambient", 0.08f, 0.08f, 0.08f);   
-	m_pShaderManager->setVec3Value("pointLights[2].diffuse", 0.4f, 0.4f, 0.4f);      
-	m_pShaderManager->setVec3Value("pointLights[2].specular", 0.2f, 0.2f, 0.2f);    
-	m_pShaderManager->setBoolValue("pointLights[2].bActive", true);
+	AddPointLight(
+		glm::vec3(4.0f, 6.0f, 8.0f),
+		glm::vec3(0.08f, 0.08f, 0.08f),
+		glm::vec3(0.4f, 0.4f, 0.4f),
+		glm::vec3(0.2f, 0.2f, 0.2f));
 
-	// Disable remaining lights
-	for (int i = 3; i < 5; i++)
+	UpdateLightBuffer();
+
+	// Disable directional and spot lights
+	m_pUniformCache->SetValue(m_uniforms.directionalLightActive, false);
+	m_pUniformCache->SetValue(m_uniforms.spotLightActive, false);
+}
+
+/***********************************************************
+ *  CreateLightBuffer()
+ *
+ *  This method is used for creating the light uniform block
+ *  buffer, the texture buffer that holds the packed point
+ *  lights, and the cluster buffers, and attaching them to
+ *  the shader.
+ ***********************************************************/
+bool SceneManager::CreateLightBuffer()
+{
+	if (m_lightBuffer == 0)
 	{
-		m_pShaderManager->setBoolValue("pointLights[" + std::to_string(i) + "].bActive", false);
+		glGenBuffers(1, &m_lightBuffer);
 	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LIGHT_BLOCK_DATA), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, m_lightBuffer);
 
-	// Disable directional and spot lights
-	m_pShaderManager->setBoolValue("directionalLight.bActive", false);
-	m_pShaderManager->setBoolValue("spotLight.bActive", false);
+	// four RGBA32F texels per light
+	if (m_lightDataBuffer == 0)
+	{
+		glGenBuffers(1, &m_lightDataBuffer);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, m_lightDataBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, MAX_POINT_LIGHTS * 4 * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	if (m_lightDataTexture == 0)
+	{
+		glGenTextures(1, &m_lightDataTexture);
+	}
+	glBindTexture(GL_TEXTURE_BUFFER, m_lightDataTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_lightDataBuffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	m_pLightClusterer->CreateBuffers();
+
+	m_pUniformCache->SetValue(m_uniforms.pointLightData, LIGHT_DATA_TEXTURE_UNIT);
+	m_pUniformCache->SetValue(m_uniforms.clusterData, CLUSTER_TEXTURE_UNIT);
+	m_pUniformCache->SetValue(m_uniforms.clusterLightIndices, LIGHT_INDEX_TEXTURE_UNIT);
+
+	m_bLightsDirty = true;
+
+	return(m_pUniformCache->BindUniformBlock("LightBlock", LIGHT_BLOCK_BINDING));
+}
+
+/***********************************************************
+ *  AddPointLight()
+ *
+ *  This method is used for adding a point light to the scene.
+ *  The returned light ID stays valid until the light is
+ *  removed.  -1 is returned when the light buffer is full.
+ *  A light with a range only reaches the clusters within
+ *  that distance, while a light without one reaches all.
+ ***********************************************************/
+int SceneManager::AddPointLight(
+	glm::vec3 position,
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	float range)
+{
+	POINT_LIGHT light;
+	light.position = position;
+	light.ambient = ambient;
+	light.diffuse = diffuse;
+	light.specular = specular;
+	light.range = range;
+	light.bInUse = true;
+
+	// reuse the slot of a previously removed light when possible
+	int activeLights = 0;
+	int lightID = -1;
+	for (int i = 0; i < (int)m_pointLights.size(); i++)
+	{
+		if (m_pointLights[i].bInUse == true)
+			activeLights++;
+		else if (lightID < 0)
+			lightID = i;
+	}
+
+	if (activeLights >= MAX_POINT_LIGHTS)
+	{
+		std::cout << "Could not add point light, the limit is " << MAX_POINT_LIGHTS << std::endl;
+		return(-1);
+	}
+
+	if (lightID >= 0)
+	{
+		m_pointLights[lightID] = light;
+	}
+	else
+	{
+		m_pointLights.push_back(light);
+		lightID = (int)m_pointLights.size() - 1;
+	}
+
+	m_bLightsDirty = true;
+
+	return(lightID);
+}
+
+/***********************************************************
+ *  MovePointLight()
+ *
+ *  This method is used for changing the position of a
+ *  previously added point light.
+ ***********************************************************/
+void SceneManager::MovePointLight(int lightID, glm::vec3 position)
+{
+	if ((lightID < 0) || (lightID >= (int)m_pointLights.size()) ||
+		(m_pointLights[lightID].bInUse == false))
+	{
+		return;
+	}
+
+	m_pointLights[lightID].position = position;
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  RemovePointLight()
+ *
+ *  This method is used for removing a previously added point
+ *  light from the scene.
+ ***********************************************************/
+void SceneManager::RemovePointLight(int lightID)
+{
+	if ((lightID < 0) || (lightID >= (int)m_pointLights.size()) ||
+		(m_pointLights[lightID].bInUse == false))
+	{
+		return;
+	}
+
+	m_pointLights[lightID].bInUse = false;
+	m_bLightsDirty = true;
+}
+
+/***********************************************************
+ *  UpdateLightBuffer()
+ *
+ *  This method is used for packing the point lights that are
+ *  in use into the light texture buffer with a single update.
+ *  The positions and ranges of the packed lights are kept
+ *  for the cluster assignment.
+ ***********************************************************/
+void SceneManager::UpdateLightBuffer()
+{
+	if ((m_bLightsDirty == false) || (m_lightDataBuffer == 0))
+	{
+		return;
+	}
+
+	std::vector<glm::vec4> lightData;
+	lightData.reserve(m_pointLights.size() * 4);
+	m_clusterLights.clear();
+
+	for (int i = 0; (i < (int)m_pointLights.size()) && ((int)m_clusterLights.size() < MAX_POINT_LIGHTS); i++)
+	{
+		const POINT_LIGHT& light = m_pointLights[i];
+		if (light.bInUse == false)
+		{
+			continue;
+		}
+
+		// the position w value holds the light range
+		lightData.push_back(glm::vec4(light.position, light.range));
+		lightData.push_back(glm::vec4(light.ambient, 0.0f));
+		lightData.push_back(glm::vec4(light.diffuse, 0.0f));
+		lightData.push_back(glm::vec4(light.specular, 0.0f));
+
+		CLUSTER_LIGHT clusterLight;
+		clusterLight.position = light.position;
+		clusterLight.range = light.range;
+		m_clusterLights.push_back(clusterLight);
+	}
+	m_packedLightCount = (int)m_clusterLights.size();
+
+	if (lightData.size() > 0)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, m_lightDataBuffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, lightData.size() * sizeof(glm::vec4), lightData.data());
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	}
+
+	m_bLightsDirty = false;
+}
+
+/***********************************************************
+ *  SetCameraView()
+ *
+ *  This method is used for setting the camera that the
+ *  point lights are clustered for.
+ ***********************************************************/
+void SceneManager::SetCameraView(const CAMERA_VIEW& cameraView)
+{
+	m_cameraView = cameraView;
+	m_bCameraValid = true;
+}
+
+/***********************************************************
+ *  UpdateLightClusters()
+ *
+ *  This method is used for assigning the packed point lights
+ *  to the clusters of the current camera and uploading the
+ *  cluster lists and the light block.  Without a camera the
+ *  shader falls back to evaluating every light.
+ ***********************************************************/
+void SceneManager::UpdateLightClusters()
+{
+	if (m_lightBuffer == 0)
+	{
+		return;
+	}
+
+	LIGHT_BLOCK_DATA blockData;
+	memset(&blockData, 0, sizeof(blockData));
+	blockData.clusterGrid[0] = LightClusterer::CLUSTERS_X;
+	blockData.clusterGrid[1] = LightClusterer::CLUSTERS_Y;
+	blockData.clusterGrid[2] = LightClusterer::CLUSTERS_Z;
+	blockData.pointLightCount = m_packedLightCount;
+
+	if ((m_bUseClusteredLighting == true) && (m_bCameraValid == true))
+	{
+		m_pLightClusterer->AssignLights(m_cameraView, m_clusterLights);
+		m_pLightClusterer->UploadBuffers();
+
+		blockData.clusterGrid[3] = 1;
+		blockData.clusterDepth[0] = m_cameraView.nearPlane;
+		blockData.clusterDepth[1] = m_cameraView.farPlane;
+		blockData.clusterDepth[2] = m_pLightClusterer->GetSliceScale();
+		blockData.clusterDepth[3] = m_pLightClusterer->GetSliceBias();
+		blockData.clusterTileSize[0] = (float)m_cameraView.viewportWidth / (float)LightClusterer::CLUSTERS_X;
+		blockData.clusterTileSize[1] = (float)m_cameraView.viewportHeight / (float)LightClusterer::CLUSTERS_Y;
+	}
+
+	// the block only changes with the camera projection or the lights
+	if ((m_bLightBlockValid == false) || (memcmp(&blockData, &m_lightBlockData, sizeof(blockData)) != 0))
+	{
+		glBindBuffer(GL_UNIFORM_BUFFER, m_lightBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(blockData), &blockData);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		m_lightBlockData = blockData;
+		m_bLightBlockValid = true;
+	}
+
+	m_pStateCache->BindTexture(LIGHT_DATA_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_lightDataTexture);
+	m_pStateCache->BindTexture(CLUSTER_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_pLightClusterer->GetClusterTexture());
+	m_pStateCache->BindTexture(LIGHT_INDEX_TEXTURE_UNIT, GL_TEXTURE_BUFFER, m_pLightClusterer->GetIndexTexture());
 }
 /****************************************************************/
\ No newline at end of file
@@ -10,6 +10,25 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "InstancedMesh.h"
+#include "UniformCache.h"
+#include "LightClusterer.h"
+#include "RenderQueue.h"
+#include "RenderStateCache.h"
+#include "Profiler.h"
+#include "TextureArrays.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
+#include "FrustumCuller.h"
+#include "SceneBVH.h"
+#include "OcclusionCuller.h"
+#include "DepthPrepass.h"
+#include "LodSelector.h"
+#include "MeshBuffer.h"
+#include "MeshOptimizer.h"
+#include "TransformCache.h"
+#include "TagRegistry.h"
+#include "CameraView.h"
 #include <GL/glew.h>        
 #include <glm/glm.hpp>      
 #include <string>
@@ -25,14 +44,14 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager* pShaderManager);
+	SceneManager(ShaderManager* pShaderManager, UniformCache* pUniformCache, RenderStateCache* pStateCache);
 	// destructor
 	~SceneManager();
 
 	struct TEXTURE_INFO
 	{
 		std::string tag;
-		uint32_t ID;
+		int textureIndex;
 	};
 
 	struct OBJECT_MATERIAL
@@ -45,29 +64,276 @@ public:
 		std::string tag;
 	};
 
+	// primitive meshes that scene objects can be drawn with
+	enum MESH_TYPE
+	{
+		MESH_PLANE,
+		MESH_PRISM,
+		MESH_BOX,
+		MESH_CYLINDER,
+		MESH_SPHERE
+	};
+	// number of mesh types
+	static const int MESH_TYPE_COUNT = MESH_SPHERE + 1;
+
+	// retained draw record for one scene object, resolved once
+	// when the scene is prepared so rendering is a plain walk
+	struct DRAW_RECORD
+	{
+		glm::mat4 model;
+		int textureIndex;
+		int materialIndex;
+		glm::vec2 uvScale;
+		MESH_TYPE mesh;
+		// level of detail of the mesh the object is drawn with
+		int level;
+		// instance group and position within it, or -1 when
+		// the object is drawn on its own
+		int instanceGroup;
+		int instanceIndex;
+	};
+
+	// spheres sharing a texture array, drawn together with one
+	// instanced draw call - each instance has its own material
+	// and texture layer
+	struct INSTANCE_GROUP
+	{
+		int textureUnit;
+		int batchIndex;
+		bool bDirty;
+		std::vector<INSTANCE_DATA> instances;
+		// whether each instance was inside the frustum - only
+		// the visible instances are uploaded to the batch
+		std::vector<unsigned char> instanceVisible;
+		// level of detail each instance is drawn with
+		std::vector<unsigned char> instanceLevels;
+	};
+
+	// draw commands in a row that use the same texture array, and
+	// are submitted together with one indirect draw
+	struct INDIRECT_RUN
+	{
+		int textureUnit;
+		int firstCommand;
+		int commandCount;
+	};
+
+	// number of point lights in the light texture buffer - four
+	// texels per light fill the smallest guaranteed buffer size
+	static const int MAX_POINT_LIGHTS = 16384;
+	// number of materials in the fragment shader material block
+	static const int MAX_MATERIALS = 32;
+	// uniform buffer binding points of the material and light blocks
+	static const int MATERIAL_BLOCK_BINDING = 0;
+	static const int LIGHT_BLOCK_BINDING = 1;
+	// texture units reserved for the light texture buffers - the
+	// loaded textures use the units below them
+	static const int LIGHT_DATA_TEXTURE_UNIT = 13;
+	static const int CLUSTER_TEXTURE_UNIT = 14;
+	static const int LIGHT_INDEX_TEXTURE_UNIT = 15;
+
+	struct POINT_LIGHT
+	{
+		glm::vec3 position;
+		glm::vec3 ambient;
+		glm::vec3 diffuse;
+		glm::vec3 specular;
+		// distance where the light fades out, zero for no limit
+		float range;
+		bool bInUse;
+	};
+
+	// cached uniform handles used by the scene
+	struct SCENE_UNIFORMS
+	{
+		UniformHandle<glm::mat4> model;
+		UniformHandle<glm::vec4> objectColor;
+		UniformHandle<int> objectTexture;
+		UniformHandle<float> textureLayer;
+		UniformHandle<glm::vec4> textureRect;
+		UniformHandle<bool> bUseTexture;
+		UniformHandle<bool> bUseLighting;
+		UniformHandle<bool> bUseInstancing;
+		UniformHandle<bool> bPackedVertices;
+		UniformHandle<glm::vec2> UVscale;
+		UniformHandle<int> materialIndex;
+		UniformHandle<bool> directionalLightActive;
+		UniformHandle<bool> spotLightActive;
+		UniformHandle<int> pointLightData;
+		UniformHandle<int> clusterData;
+		UniformHandle<int> clusterLightIndices;
+	};
+
+	// std140 layout of the light uniform block
+	struct LIGHT_BLOCK_DATA
+	{
+		// xyz = cluster grid size, w = whether clusters are used
+		int clusterGrid[4];
+		// near plane, far plane, depth slice scale and bias
+		float clusterDepth[4];
+		// xy = size of a cluster tile in pixels
+		float clusterTileSize[4];
+		int pointLightCount;
+		int padding[3];
+	};
+
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// pointer to the cached shader uniform locations
+	UniformCache* m_pUniformCache;
+	// pointer to the shadowed texture and vertex array bindings
+	RenderStateCache* m_pStateCache;
+	// uniform handles resolved when the scene is prepared
+	SCENE_UNIFORMS m_uniforms;
 	// pointer to basic shapes object
 	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
 	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// texture tags - a tag's handle indexes m_textureIDs
+	TagRegistry m_textureRegistry;
 	// defined object materials
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// material tags and the material index of each tag handle
+	TagRegistry m_materialRegistry;
+	std::vector<int> m_materialIndices;
+	// uniform buffer holding all of the defined materials
+	GLuint m_materialBuffer;
+	// point light slots - removed lights leave a slot for reuse
+	std::vector<POINT_LIGHT> m_pointLights;
+	// uniform buffer holding the light count and cluster parameters
+	GLuint m_lightBuffer;
+	// texture buffer holding the packed active point lights
+	GLuint m_lightDataBuffer;
+	GLuint m_lightDataTexture;
+	// whether the lights changed since the last buffer update
+	bool m_bLightsDirty;
+	// last values sent to the light block, to skip unchanged uploads
+	LIGHT_BLOCK_DATA m_lightBlockData;
+	bool m_bLightBlockValid;
+	// number of lights packed into the light texture buffer
+	int m_packedLightCount;
+	// positions and ranges of the packed lights for clustering
+	std::vector<CLUSTER_LIGHT> m_clusterLights;
+	// bins the packed lights into view space clusters
+	LightClusterer* m_pLightClusterer;
+	// whether the fragment shader only evaluates clustered lights
+	bool m_bUseClusteredLighting;
+	// camera the lights are clustered for
+	CAMERA_VIEW m_cameraView;
+	bool m_bCameraValid;
+	// retained draw records for all of the scene objects
+	std::vector<DRAW_RECORD> m_drawRecords;
+	// sphere mesh used for instanced drawing at each level of
+	// detail, and the level chosen for each object of each mesh
+	// type - the flat meshes only have one level
+	InstancedMesh* m_sphereInstances[LodSelector::MAX_LEVELS];
+	LodSelector* m_pLodSelectors[MESH_TYPE_COUNT];
+	// triangles the draw records and the instanced spheres
+	// submitted in the last frame
+	long long m_drawRecordTriangles;
+	long long m_instancedTriangles;
+	// groups of sphere objects drawn with instancing
+	std::vector<INSTANCE_GROUP> m_instanceGroups;
+	// scratch list of the visible instances of a group
+	std::vector<INSTANCE_DATA> m_visibleInstances;
+	// transforms of the draw records and their model matrices
+	TransformCache* m_pTransformCache;
+	// bounding spheres of the draw records and their frustum test
+	FrustumCuller* m_pFrustumCuller;
+	// hierarchy over the bounding boxes of the draw records, and
+	// whether objects were added since it was built
+	SceneBVH* m_pSceneBVH;
+	bool m_bHierarchyDirty;
+	// occlusion queries of the draw records, whether they are used,
+	// the objects they skipped in the last frame and the scratch
+	// list of objects queried
+	OcclusionCuller* m_pOcclusionCuller;
+	bool m_bUseOcclusionCulling;
+	int m_occludedObjectCount;
+	std::vector<int> m_occlusionCandidates;
+	// depth only pass in front of the shading pass, whether it is
+	// used, and whether the overdraw is shown instead of the scene
+	DepthPrepass* m_pDepthPrepass;
+	bool m_bUseDepthPrepass;
+	bool m_bShowOverdraw;
+	// vertex shader file of the scene program, which the depth
+	// pass compiles too
+	std::string m_vertexShaderPath;
+	// every primitive mesh packed into shared buffers, whether the
+	// frame is submitted as indirect draw commands, and the runs
+	// of commands sharing a texture array
+	MeshBuffer* m_pMeshBuffer;
+	bool m_bUseIndirectDraws;
+	std::vector<INDIRECT_RUN> m_indirectRuns;
+	// whether repeated spheres are drawn with instancing
+	bool m_bUseInstancing;
+	// draw records ordered by render state each frame
+	RenderQueue* m_pRenderQueue;
+	// texture arrays and atlas the loaded textures are stored in
+	TextureArrays* m_pTextureArrays;
+	// decodes the texture images in the background
+	TextureLoader* m_pTextureLoader;
+	// streams texture mip levels to fit the texture memory budget
+	TextureResidency* m_pTextureResidency;
+	// texture array generation the instance groups were built
+	// for, or -1 before they are built
+	int m_instanceGeneration;
+	// instance batches created so far, reused when regrouping
+	int m_instanceBatchCount;
+	// optional profiler and the IDs of the scene scopes
+	Profiler* m_pProfiler;
+	int m_lightScope;
+	int m_drawRecordScope;
+	int m_instanceScope;
+	int m_occlusionScope;
+	int m_depthPrepassScope;
+	int m_shadedFragmentsCounter;
+	int m_trianglesCounter;
+	int m_lodCounters[MESH_TYPE_COUNT][LodSelector::MAX_LEVELS];
+	std::vector<int> m_objectScopes;
 
 	// load texture images and convert to OpenGL texture data
-	bool CreateGLTexture(const char* filename, std::string tag);
+	bool CreateGLTexture(const char* filename, const std::string& tag);
+	// upload the texture images that finished decoding
+	void UploadLoadedTextures(bool bWaitForAll);
+	// fit the texture mip levels to the current camera and budget
+	void UpdateTextureResidency();
+	// world space bounding sphere of a draw record
+	FrustumCuller::BOUNDING_SPHERE ComputeObjectBounds(const DRAW_RECORD& record) const;
+	// world space bounding box of a draw record
+	SceneBVH::AABB ComputeObjectBox(const DRAW_RECORD& record) const;
+	// copy the rebuilt model matrices of moved objects into the
+	// draw records and their bounds
+	void UpdateTransforms();
+	// build or refit the hierarchy over the draw records
+	void UpdateSceneHierarchy();
+	// test the draw records against the camera frustum
+	void CullSceneObjects();
+	// query which of the drawn records are hidden for the next frame
+	void IssueOcclusionQueries();
+	// choose the level of detail of the objects on screen
+	void SelectObjectLevels();
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
+	int FindTextureID(const std::string& tag);
+	int FindTextureSlot(const std::string& tag);
 	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	bool FindMaterial(const std::string& tag, OBJECT_MATERIAL& material);
+	int FindMaterialIndex(const std::string& tag);
+	// index the defined materials by tag
+	void RegisterMaterialTags();
+
+	// build the model matrix from the passed in transformation values
+	glm::mat4 ComputeModelMatrix(
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
 
 	// set the transformation values into the transform buffer
 	void SetTransformations(
@@ -94,11 +360,144 @@ private:
 	void SetShaderMaterial(std::string materialTag);
 
 	
+	// add a scene object to the retained draw records
+	int AddSceneObject(
+		MESH_TYPE mesh,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ,
+		std::string textureTag,
+		std::string materialTag,
+		float u,
+		float v);
+
+	// pack the primitive meshes into the shared geometry buffers
+	bool CreateMeshBuffer();
+	// index of a level of detail of a mesh type in the shared buffers
+	int GetMeshIndex(MESH_TYPE mesh, int level) const;
+	// draw the basic mesh associated with the passed in type, at
+	// a level of detail when the shared buffers were created
+	void DrawMesh(MESH_TYPE mesh, int level);
+	// set the index of the material used by the next draw
+	void SetShaderMaterialIndex(int materialIndex);
+	// pack the defined materials into the material uniform buffer
+	bool CreateMaterialBuffer();
+	// resolve the uniform handles used by the scene
+	void ResolveUniformHandles();
+	// create the light buffers and attach them to the shader
+	bool CreateLightBuffer();
+	// assign the lights to clusters and upload the light block
+	void UpdateLightClusters();
+
+	// group the sphere draw records into instanced batches
+	void BuildInstanceGroups();
+	// group the spheres by texture array into instance batches
+	void GroupInstances();
+	// send the texture array location of a texture to the shader
+	void SetShaderTextureLocation(int textureIndex);
+	// upload the visible instances of the changed groups
+	void UpdateInstanceBatches();
+	// draw all of the instanced batches
+	void RenderInstanceGroups();
+	// queue the visible draw records in state order
+	void QueueDrawRecords();
+	// draw the queued draw records
+	void RenderDrawRecords();
+	// whether the frame is submitted as indirect draw commands
+	bool IsIndirectDrawing() const;
+	// whether the depth pre-pass runs this frame
+	bool IsDepthPrepassDrawing() const;
+	// whether draws wait on the occlusion query of their object
+	bool IsConditionalDrawing() const;
+	// build the draw commands of the queued records and the
+	// visible instances, and add one to its texture array run
+	void BuildDrawCommands();
+	void AddDrawCommand(int textureUnit, int meshIndex, const INSTANCE_DATA* pInstances, int instanceCount);
+	// draw the command runs with one indirect draw each
+	void RenderDrawCommands();
+	// draw the queued records and instanced groups with the
+	// program of the depth or overdraw pass
+	void DrawSceneGeometry();
+	// open and close a profiler scope when a profiler is set
+	void BeginProfileScope(int scopeID);
+	void EndProfileScope();
+
 	void DefineObjectMaterials();
 	void SetupSceneLights();
+	void BuildSceneObjects();
 
 public:
 	// The following methods are for the students to customize for their own 3D scene
 	void PrepareScene();
 	void RenderScene();
+
+	// add a point light to the scene and return its light ID
+	int AddPointLight(
+		glm::vec3 position,
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		float range = 0.0f);
+	// move a previously added point light
+	void MovePointLight(int lightID, glm::vec3 position);
+	// remove a previously added point light from the scene
+	void RemovePointLight(int lightID);
+	// upload the point lights if any of them changed - called once per frame
+	void UpdateLightBuffer();
+	// set the camera the lights are clustered for - called once per frame
+	void SetCameraView(const CAMERA_VIEW& cameraView);
+
+	// wait until every texture image is decoded and uploaded
+	void FinishTextureLoading();
+	// choose the compressed formats the scene textures are stored
+	// in - must be called before the scene is prepared
+	void SetTextureCompression(TEXTURE_COMPRESSION compression);
+	// set the most memory the textures may use, zero for no limit
+	void SetTextureBudget(size_t budgetBytes) { m_pTextureResidency->SetBudget(budgetBytes); }
+	// residency counters of the scene textures
+	const TextureResidency* GetTextureResidency() const { return(m_pTextureResidency); }
+
+	// set the profiler that measures the scene scopes, or NULL
+	void SetProfiler(Profiler* pProfiler);
+
+	// render state changes the sorted draw order saved in the last frame
+	int GetStateChangesSaved() const { return(m_pRenderQueue->GetStateChangesSaved()); }
+	// scene objects inside and outside the frustum in the last frame
+	int GetVisibleObjectCount() const { return(m_pFrustumCuller->GetVisibleCount()); }
+	int GetCulledObjectCount() const { return(m_pFrustumCuller->GetCulledCount()); }
+	// scene objects skipped as hidden behind others in the last frame
+	int GetOccludedObjectCount() const { return(m_occludedObjectCount); }
+	// levels of detail and name of a mesh type
+	int GetMeshLevelCount(int mesh) const;
+	const char* GetMeshName(int mesh) const;
+	// objects of a mesh type drawn at a level of detail in the
+	// last frame, and the triangles the draw records and the
+	// instanced spheres submitted
+	int GetLevelObjectCount(int mesh, int level) const;
+	long long GetDrawRecordTriangleCount() const { return(m_drawRecordTriangles); }
+	long long GetInstancedTriangleCount() const { return(m_instancedTriangles); }
+	// turn the occlusion queries on or off
+	void SetOcclusionCulling(bool bEnable);
+	// set the vertex shader file the scene program was loaded
+	// from - must be called before the scene is prepared
+	void SetVertexShaderPath(const char* filePath) { m_vertexShaderPath = filePath; }
+	// turn the depth only pass in front of the shading pass on or off
+	void SetDepthPrepass(bool bEnable);
+	// show how many times each pixel is shaded instead of the scene
+	void SetOverdrawView(bool bEnable);
+	// submit the frame as indirect draw commands when supported
+	void SetIndirectDraws(bool bEnable);
+	// index of the nearest scene object hit by a world space ray, or -1
+	int PickObject(glm::vec3 origin, glm::vec3 direction);
+
+	// update the transformation of a previously added scene object
+	void SetSceneObjectTransform(
+		int objectIndex,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
 };
\ No newline at end of file
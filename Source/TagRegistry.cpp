@@ -0,0 +1,232 @@
+///////////////////////////////////////////////////////////////////////////////
+// TagRegistry.cpp
+// ============
+// intern string tags into compact integer handles
+//
+//  Every distinct tag gets the next handle when it is interned, so the
+//  handles can index plain arrays.  Tags are found with an open
+//  addressing hash table using linear probing, which keeps a lookup to
+//  one hash and usually one string compare however many tags there are.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TagRegistry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+// declaration of the registry settings
+namespace
+{
+	// hash index slots allocated for the first tag
+	const int g_InitialSlots = 16;
+}
+
+/***********************************************************
+ *  TagRegistry()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TagRegistry::TagRegistry()
+{
+	Clear();
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every registered tag.
+ ***********************************************************/
+void TagRegistry::Clear()
+{
+	HASH_SLOT emptySlot = { 0, INVALID_HANDLE };
+	m_slots.assign(g_InitialSlots, emptySlot);
+	m_tags.clear();
+}
+
+/***********************************************************
+ *  HashTag()
+ *
+ *  This method is used for hashing a tag with 32-bit FNV-1a.
+ ***********************************************************/
+unsigned int TagRegistry::HashTag(const std::string& tag)
+{
+	unsigned int hash = 2166136261u;
+
+	for (size_t i = 0; i < tag.size(); i++)
+	{
+		hash ^= (unsigned char)tag[i];
+		hash *= 16777619u;
+	}
+
+	return(hash);
+}
+
+/***********************************************************
+ *  FindSlot()
+ *
+ *  This method is used for probing the hash index from the
+ *  home slot of a tag until the tag or an empty slot is
+ *  found.  The index is never full, so the probe ends.
+ ***********************************************************/
+int TagRegistry::FindSlot(const std::string& tag, unsigned int hash) const
+{
+	unsigned int mask = (unsigned int)m_slots.size() - 1;
+	unsigned int slot = hash & mask;
+
+	while (m_slots[slot].handle != INVALID_HANDLE)
+	{
+		if ((m_slots[slot].hash == hash) && (m_tags[m_slots[slot].handle] == tag))
+		{
+			break;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	return((int)slot);
+}
+
+/***********************************************************
+ *  Grow()
+ *
+ *  This method is used for doubling the hash index and
+ *  inserting every registered tag into it again.
+ ***********************************************************/
+void TagRegistry::Grow()
+{
+	std::vector<HASH_SLOT> oldSlots;
+	oldSlots.swap(m_slots);
+
+	HASH_SLOT emptySlot = { 0, INVALID_HANDLE };
+	m_slots.assign(oldSlots.size() * 2, emptySlot);
+	unsigned int mask = (unsigned int)m_slots.size() - 1;
+
+	for (int i = 0; i < (int)oldSlots.size(); i++)
+	{
+		if (oldSlots[i].handle == INVALID_HANDLE)
+		{
+			continue;
+		}
+
+		unsigned int slot = oldSlots[i].hash & mask;
+		while (m_slots[slot].handle != INVALID_HANDLE)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_slots[slot] = oldSlots[i];
+	}
+}
+
+/***********************************************************
+ *  Intern()
+ *
+ *  This method is used for getting the handle of a tag.  A
+ *  new tag is registered with the next handle.
+ ***********************************************************/
+int TagRegistry::Intern(const std::string& tag)
+{
+	unsigned int hash = HashTag(tag);
+	int slot = FindSlot(tag, hash);
+	if (m_slots[slot].handle != INVALID_HANDLE)
+	{
+		return(m_slots[slot].handle);
+	}
+
+	// keep the index at most half full so probes stay short
+	if ((m_tags.size() + 1) * 2 > m_slots.size())
+	{
+		Grow();
+		slot = FindSlot(tag, hash);
+	}
+
+	m_tags.push_back(tag);
+	m_slots[slot].hash = hash;
+	m_slots[slot].handle = (int)m_tags.size() - 1;
+
+	return(m_slots[slot].handle);
+}
+
+/***********************************************************
+ *  Find()
+ *
+ *  This method is used for getting the handle of a tag that
+ *  was registered before, without registering it.
+ ***********************************************************/
+int TagRegistry::Find(const std::string& tag) const
+{
+	return(m_slots[FindSlot(tag, HashTag(tag))].handle);
+}
+
+/***********************************************************
+ *  RunLookupBenchmark()
+ *
+ *  This method is used for timing random tag lookups through
+ *  the registry against the linear scan of a tag list that
+ *  it replaces, with 16, 1k and 100k registered tags.  The
+ *  scan gets fewer lookups at the larger sizes so it ends in
+ *  a reasonable time.
+ ***********************************************************/
+void TagRegistry::RunLookupBenchmark()
+{
+	const int tagCounts[] = { 16, 1000, 100000 };
+	const int registryLookups = 1000000;
+	const long long scanCompareBudget = 200000000;
+
+	std::mt19937 generator(330);
+
+	std::cout << "Tag lookup benchmark" << std::endl;
+
+	for (int i = 0; i < (int)(sizeof(tagCounts) / sizeof(tagCounts[0])); i++)
+	{
+		int tagCount = tagCounts[i];
+
+		// tags shaped like the scene tags, with a shared prefix
+		std::vector<std::string> tags(tagCount);
+		TagRegistry registry;
+		for (int j = 0; j < tagCount; j++)
+		{
+			tags[j] = "texture_" + std::to_string(j) + "_diffuse";
+			registry.Intern(tags[j]);
+		}
+
+		std::uniform_int_distribution<int> pick(0, tagCount - 1);
+		std::vector<int> queries(registryLookups);
+		for (int j = 0; j < registryLookups; j++)
+		{
+			queries[j] = pick(generator);
+		}
+
+		// lookups through the hash index
+		long long checksum = 0;
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		for (int j = 0; j < registryLookups; j++)
+		{
+			checksum += registry.Find(tags[queries[j]]);
+		}
+		double registryNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / registryLookups;
+
+		// the linear scan the scene used to do
+		int scanLookups = (int)std::min((long long)registryLookups, std::max(100LL, scanCompareBudget / tagCount));
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int j = 0; j < scanLookups; j++)
+		{
+			const std::string& tag = tags[queries[j]];
+			int index = 0;
+			while ((index < tagCount) && (tags[index].compare(tag) != 0))
+			{
+				index++;
+			}
+			checksum -= index;
+		}
+		double scanNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / scanLookups;
+
+		std::cout << "  tags:" << tagCount
+			<< ", registry ns/lookup:" << registryNanoseconds
+			<< ", linear scan ns/lookup:" << scanNanoseconds
+			<< ", speedup:" << scanNanoseconds / std::max(registryNanoseconds, 0.001)
+			<< ", checksum:" << checksum << std::endl;
+	}
+}
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// TagRegistry.h
+// ============
+// intern string tags into compact integer handles
+//
+//  Every distinct tag gets the next handle when it is interned, so the
+//  handles can index plain arrays.  Tags are found with an open
+//  addressing hash table using linear probing, which keeps a lookup to
+//  one hash and usually one string compare however many tags there are.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TagRegistry
+ *
+ *  This class contains the tag table and the hash index used
+ *  to turn a tag into its handle.
+ ***********************************************************/
+class TagRegistry
+{
+public:
+	// constructor
+	TagRegistry();
+
+	// handle returned for tags that are not registered
+	static const int INVALID_HANDLE = -1;
+
+	// return the handle of a tag, registering it if it is new
+	int Intern(const std::string& tag);
+	// return the handle of a registered tag or INVALID_HANDLE
+	int Find(const std::string& tag) const;
+	// tag a handle was registered for
+	const std::string& GetTag(int handle) const { return(m_tags[handle]); }
+	// number of registered tags - handles run from zero to this
+	int GetCount() const { return((int)m_tags.size()); }
+	// remove every tag
+	void Clear();
+
+	// time tag lookups through the registry against a linear scan
+	// with 16, 1k and 100k tags - no OpenGL context is needed
+	static void RunLookupBenchmark();
+
+private:
+	// one entry of the hash index - the full hash is kept so
+	// most mismatches are rejected without a string compare
+	struct HASH_SLOT
+	{
+		unsigned int hash;
+		int handle;
+	};
+
+	// hash index, sized to a power of two and at most half full
+	std::vector<HASH_SLOT> m_slots;
+	// registered tags, indexed by handle
+	std::vector<std::string> m_tags;
+
+	// 32-bit FNV-1a hash of a tag
+	static unsigned int HashTag(const std::string& tag);
+	// slot holding the tag, or the empty slot where it belongs
+	int FindSlot(const std::string& tag, unsigned int hash) const;
+	// double the hash index and insert every tag again
+	void Grow();
+};
@@ -0,0 +1,869 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureArrays.cpp
+// ============
+// pack the scene textures into texture array layers and an atlas
+//
+//  Textures with the same size, format and mip count share one
+//  GL_TEXTURE_2D_ARRAY, and the shader selects a texture by its layer,
+//  so objects with different textures from the same array can be drawn
+//  without binding anything.  Every array keeps its own texture unit.
+//  Once the units run out, textures of other sizes are packed into the
+//  layers of an atlas array and addressed by a rectangle in the layer.
+//
+//  The arrays do not have to hold their whole mip chains.  The top
+//  levels of an array can be evicted to save memory and streamed back
+//  in layer by layer, and until every layer has them again the array
+//  samples from its first complete level.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureArrays.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// declaration of the texture array settings
+namespace
+{
+	// mid gray shown until the real texture is stored
+	const unsigned char g_PlaceholderTexel[4] = { 128, 128, 128, 255 };
+	// location of textures that are not stored yet
+	const TextureArrays::TEXTURE_LOCATION g_PlaceholderLocation = {
+		TextureArrays::PLACEHOLDER_UNIT, 0.0f, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f) };
+}
+
+/***********************************************************
+ *  TextureArrays()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureArrays::TextureArrays(RenderStateCache* pStateCache)
+{
+	m_pStateCache = pStateCache;
+	m_transferBuffer = 0;
+	m_generation = 0;
+}
+
+/***********************************************************
+ *  ~TextureArrays()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureArrays::~TextureArrays()
+{
+	DestroyArrays();
+
+	if (m_transferBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_transferBuffer);
+		m_transferBuffer = 0;
+	}
+	m_pStateCache = NULL;
+}
+
+/***********************************************************
+ *  AddTexture()
+ *
+ *  This method is used for adding a texture that samples
+ *  the placeholder until its texels are stored.
+ ***********************************************************/
+int TextureArrays::AddTexture()
+{
+	if (m_arrays.size() == 0)
+	{
+		CreatePlaceholder();
+	}
+
+	m_locations.push_back(g_PlaceholderLocation);
+	m_streamPending.push_back(false);
+
+	return((int)m_locations.size() - 1);
+}
+
+/***********************************************************
+ *  DestroyArrays()
+ *
+ *  This method is used for freeing every array and removing
+ *  all of the added textures.
+ ***********************************************************/
+void TextureArrays::DestroyArrays()
+{
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		glDeleteTextures(1, &m_arrays[i].texture);
+	}
+	m_arrays.clear();
+	m_locations.clear();
+	m_streamPending.clear();
+	m_generation++;
+
+	// a deleted texture name can be handed out again
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateTextures();
+	}
+}
+
+/***********************************************************
+ *  CreatePlaceholder()
+ *
+ *  This method is used for creating the one texel array
+ *  that textures show until they are stored.
+ ***********************************************************/
+void TextureArrays::CreatePlaceholder()
+{
+	TEXTURE_ARRAY placeholder;
+	memset(&placeholder, 0, sizeof(placeholder));
+	placeholder.unit = PLACEHOLDER_UNIT;
+	placeholder.width = 1;
+	placeholder.height = 1;
+	placeholder.format = FORMAT_RGBA8;
+	placeholder.levelCount = 1;
+	placeholder.layerCount = 1;
+	placeholder.capacity = 1;
+	placeholder.bAtlas = false;
+
+	AllocateStorage(placeholder);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, g_PlaceholderTexel);
+
+	m_arrays.push_back(placeholder);
+}
+
+/***********************************************************
+ *  GetUploadFormat()
+ *
+ *  This method is used for getting the OpenGL formats the
+ *  texels of a texture format are uploaded with.
+ ***********************************************************/
+void TextureArrays::GetUploadFormat(TEXTURE_FORMAT format, GLenum& internalFormat, GLenum& pixelFormat)
+{
+	switch (format)
+	{
+	case FORMAT_BC1:
+		internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		pixelFormat = GL_RGB;
+		break;
+	case FORMAT_BC3:
+		internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		pixelFormat = GL_RGBA;
+		break;
+	case FORMAT_BC7:
+		internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+		pixelFormat = GL_RGBA;
+		break;
+	case FORMAT_RGBA8:
+		internalFormat = GL_RGBA8;
+		pixelFormat = GL_RGBA;
+		break;
+	default:
+		internalFormat = GL_RGB8;
+		pixelFormat = GL_RGB;
+		break;
+	}
+}
+
+/***********************************************************
+ *  BindForUpload()
+ *
+ *  This method is used for binding an array on its own unit
+ *  so uploading to it leaves the other units untouched.
+ ***********************************************************/
+void TextureArrays::BindForUpload(const TEXTURE_ARRAY& textureArray)
+{
+	glActiveTexture(GL_TEXTURE0 + textureArray.unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.texture);
+}
+
+/***********************************************************
+ *  AllocateStorage()
+ *
+ *  This method is used for creating the texture of an array
+ *  with storage for every resident mip level of every layer.
+ *  The base level skips the levels that are still streaming
+ *  in.  The atlas clamps at its edges, since the shader
+ *  repeats the atlas entries itself.
+ ***********************************************************/
+void TextureArrays::AllocateStorage(TEXTURE_ARRAY& textureArray)
+{
+	GLenum internalFormat = GL_RGBA8;
+	GLenum pixelFormat = GL_RGBA;
+	GetUploadFormat(textureArray.format, internalFormat, pixelFormat);
+
+	glGenTextures(1, &textureArray.texture);
+	BindForUpload(textureArray);
+
+	GLint wrapMode = (textureArray.bAtlas == true) ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrapMode);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrapMode);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	int storedLevels = textureArray.levelCount - textureArray.residentLevel;
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, textureArray.missingLevels);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, storedLevels - 1);
+
+	for (int level = 0; level < storedLevels; level++)
+	{
+		int width = std::max(textureArray.width >> (textureArray.residentLevel + level), 1);
+		int height = std::max(textureArray.height >> (textureArray.residentLevel + level), 1);
+
+		if (TextureCompressor::IsCompressed(textureArray.format) == true)
+		{
+			GLsizei imageSize = (GLsizei)(TextureCompressor::GetLevelSize(textureArray.format, width, height) * textureArray.capacity);
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, textureArray.capacity, 0, imageSize, NULL);
+		}
+		else
+		{
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, textureArray.capacity, 0, pixelFormat, GL_UNSIGNED_BYTE, NULL);
+		}
+	}
+}
+
+/***********************************************************
+ *  GrowArray()
+ *
+ *  This method is used for doubling the layers of a full
+ *  array, keeping the contents of the old layers.
+ ***********************************************************/
+void TextureArrays::GrowArray(TEXTURE_ARRAY& textureArray)
+{
+	GLuint oldTexture = textureArray.texture;
+	int oldCapacity = textureArray.capacity;
+	textureArray.capacity = oldCapacity * 2;
+	AllocateStorage(textureArray);
+
+	CopyLevels(oldTexture, textureArray.residentLevel, oldCapacity, textureArray);
+	glDeleteTextures(1, &oldTexture);
+}
+
+/***********************************************************
+ *  CopyLevels()
+ *
+ *  This method is used for copying the mip levels an old
+ *  texture of an array has in common with its new storage
+ *  into the first layers of the new storage.  The levels are
+ *  copied on the GPU through the transfer buffer, one level
+ *  at a time.
+ ***********************************************************/
+void TextureArrays::CopyLevels(GLuint sourceTexture, int sourceResidentLevel, int sourceCapacity, const TEXTURE_ARRAY& textureArray)
+{
+	GLenum internalFormat = GL_RGBA8;
+	GLenum pixelFormat = GL_RGBA;
+	GetUploadFormat(textureArray.format, internalFormat, pixelFormat);
+	bool bCompressed = TextureCompressor::IsCompressed(textureArray.format);
+
+	if (m_transferBuffer == 0)
+	{
+		glGenBuffers(1, &m_transferBuffer);
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	int firstLevel = std::max(sourceResidentLevel, textureArray.residentLevel);
+	for (int level = firstLevel; level < textureArray.levelCount; level++)
+	{
+		int width = std::max(textureArray.width >> level, 1);
+		int height = std::max(textureArray.height >> level, 1);
+		GLsizei copySize = (GLsizei)(TextureCompressor::GetLevelSize(textureArray.format, width, height) * sourceCapacity);
+
+		// read the old layers into the transfer buffer
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_transferBuffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, copySize, NULL, GL_STREAM_COPY);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, sourceTexture);
+		if (bCompressed == true)
+			glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, level - sourceResidentLevel, (void*)0);
+		else
+			glGetTexImage(GL_TEXTURE_2D_ARRAY, level - sourceResidentLevel, pixelFormat, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		// and write them into the first layers of the new storage
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_transferBuffer);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.texture);
+		if (bCompressed == true)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level - textureArray.residentLevel, 0, 0, 0, width, height, sourceCapacity, internalFormat, copySize, (void*)0);
+		else
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level - textureArray.residentLevel, 0, 0, 0, width, height, sourceCapacity, pixelFormat, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+/***********************************************************
+ *  FindArray()
+ *
+ *  This method is used for finding the array a texture is
+ *  stored in.  A new array is created for a new size while
+ *  there are units left below the atlas unit.
+ ***********************************************************/
+int TextureArrays::FindArray(const TextureCache::TEXTURE_DATA& texture)
+{
+	int nextUnit = PLACEHOLDER_UNIT + 1;
+
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		const TEXTURE_ARRAY& textureArray = m_arrays[i];
+		if ((textureArray.bAtlas == true) || (textureArray.unit == PLACEHOLDER_UNIT))
+		{
+			continue;
+		}
+		if ((textureArray.width == texture.width) &&
+			(textureArray.height == texture.height) &&
+			(textureArray.format == texture.format) &&
+			(textureArray.levelCount == (int)texture.levels.size()))
+		{
+			return(i);
+		}
+		nextUnit = std::max(nextUnit, textureArray.unit + 1);
+	}
+
+	if (nextUnit >= ATLAS_UNIT)
+	{
+		return(-1);
+	}
+
+	TEXTURE_ARRAY textureArray;
+	memset(&textureArray, 0, sizeof(textureArray));
+	textureArray.unit = nextUnit;
+	textureArray.width = texture.width;
+	textureArray.height = texture.height;
+	textureArray.format = texture.format;
+	textureArray.levelCount = (int)texture.levels.size();
+	textureArray.layerCount = 0;
+	textureArray.capacity = INITIAL_LAYERS;
+	textureArray.bAtlas = false;
+	AllocateStorage(textureArray);
+	m_arrays.push_back(textureArray);
+
+	return((int)m_arrays.size() - 1);
+}
+
+/***********************************************************
+ *  StoreTexture()
+ *
+ *  This method is used for storing the texels of a loaded
+ *  texture and moving the texture from the placeholder to
+ *  its array layer or atlas entry.
+ ***********************************************************/
+bool TextureArrays::StoreTexture(int textureIndex, const TextureCache::TEXTURE_DATA& texture)
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_locations.size()) || (texture.levels.size() == 0))
+	{
+		return(false);
+	}
+
+	bool bStored = true;
+	int arrayIndex = FindArray(texture);
+	if (arrayIndex >= 0)
+	{
+		TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+		if (textureArray.layerCount == textureArray.capacity)
+		{
+			GrowArray(textureArray);
+		}
+
+		int layer = textureArray.layerCount++;
+		StoreInLayer(textureArray, layer, texture, textureArray.residentLevel, textureArray.levelCount);
+
+		m_locations[textureIndex].unit = textureArray.unit;
+		m_locations[textureIndex].layer = (float)layer;
+		m_locations[textureIndex].rect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	}
+	else
+	{
+		bStored = StoreInAtlas(texture, m_locations[textureIndex]);
+	}
+
+	// the uploads bound the arrays behind the state cache
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateTextures();
+	}
+	m_generation++;
+
+	return(bStored);
+}
+
+/***********************************************************
+ *  StoreInLayer()
+ *
+ *  This method is used for uploading the mip levels of a
+ *  texture from the first level up to the end level into one
+ *  array layer, where each is stored below the levels the
+ *  array evicted.  The levels are copied into
+ *  the orphaned transfer buffer, so the copy never waits on
+ *  a previous upload, and each level is specified from its
+ *  offset in that buffer.
+ ***********************************************************/
+void TextureArrays::StoreInLayer(const TEXTURE_ARRAY& textureArray, int layer, const TextureCache::TEXTURE_DATA& texture, int firstLevel, int endLevel)
+{
+	GLenum internalFormat = GL_RGBA8;
+	GLenum pixelFormat = GL_RGBA;
+	GetUploadFormat(texture.format, internalFormat, pixelFormat);
+
+	endLevel = std::min(endLevel, (int)texture.levels.size());
+	if (firstLevel >= endLevel)
+	{
+		return;
+	}
+
+	GLsizeiptr uploadSize = 0;
+	for (int i = firstLevel; i < endLevel; i++)
+	{
+		uploadSize += (GLsizeiptr)texture.levels[i].size;
+	}
+
+	if (m_transferBuffer == 0)
+	{
+		glGenBuffers(1, &m_transferBuffer);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_transferBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, uploadSize, NULL, GL_STREAM_DRAW);
+	unsigned char* mappedBuffer = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploadSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mappedBuffer == NULL)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		std::cout << "Could not map the texture transfer buffer" << std::endl;
+		return;
+	}
+	std::vector<size_t> offsets(texture.levels.size());
+	size_t offset = 0;
+	for (int i = firstLevel; i < endLevel; i++)
+	{
+		memcpy(mappedBuffer + offset, texture.levels[i].pixels, texture.levels[i].size);
+		offsets[i] = offset;
+		offset += texture.levels[i].size;
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	BindForUpload(textureArray);
+	// RGB rows are not always a multiple of four bytes
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (int i = firstLevel; i < endLevel; i++)
+	{
+		const TextureCache::MIP_LEVEL& level = texture.levels[i];
+		int storedLevel = i - textureArray.residentLevel;
+		if (TextureCompressor::IsCompressed(texture.format) == true)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, storedLevel, 0, 0, layer, level.width, level.height, 1, internalFormat, (GLsizei)level.size, (void*)offsets[i]);
+		else
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, storedLevel, 0, 0, layer, level.width, level.height, 1, pixelFormat, GL_UNSIGNED_BYTE, (void*)offsets[i]);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+/***********************************************************
+ *  StoreInAtlas()
+ *
+ *  This method is used for packing a texture into the open
+ *  shelf of the last atlas layer.  The atlas holds RGBA8
+ *  texels, so compressed textures are decoded first, and a
+ *  texture larger than a layer is stored from a smaller mip
+ *  level.  Each entry is surrounded by copies of its edge
+ *  texels so filtering does not pick up its neighbors.
+ ***********************************************************/
+bool TextureArrays::StoreInAtlas(const TextureCache::TEXTURE_DATA& texture, TEXTURE_LOCATION& location)
+{
+	const int maximumSize = ATLAS_SIZE - ATLAS_PADDING * 2;
+
+	int levelIndex = 0;
+	while ((levelIndex + 1 < (int)texture.levels.size()) &&
+		((texture.levels[levelIndex].width > maximumSize) || (texture.levels[levelIndex].height > maximumSize)))
+	{
+		levelIndex++;
+	}
+	const TextureCache::MIP_LEVEL& level = texture.levels[levelIndex];
+	if ((level.width > maximumSize) || (level.height > maximumSize))
+	{
+		std::cout << "Texture is too large for the texture atlas" << std::endl;
+		return(false);
+	}
+
+	// convert the level to RGBA8 texels
+	std::vector<unsigned char> texels((size_t)level.width * level.height * 4);
+	if (TextureCompressor::IsCompressed(texture.format) == true)
+	{
+		TextureCompressor::Decompress(level.pixels, level.width, level.height, texture.format, texels.data());
+	}
+	else
+	{
+		for (size_t i = 0; i < (size_t)level.width * level.height; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				texels[i * 4 + c] = (c < texture.channels) ? level.pixels[i * texture.channels + c] : 255;
+			}
+		}
+	}
+
+	// surround the texels with their repeated edges
+	int entryWidth = level.width + ATLAS_PADDING * 2;
+	int entryHeight = level.height + ATLAS_PADDING * 2;
+	std::vector<unsigned char> entry((size_t)entryWidth * entryHeight * 4);
+	for (int y = 0; y < entryHeight; y++)
+	{
+		int sourceY = std::min(std::max(y - ATLAS_PADDING, 0), level.height - 1);
+		for (int x = 0; x < entryWidth; x++)
+		{
+			int sourceX = std::min(std::max(x - ATLAS_PADDING, 0), level.width - 1);
+			memcpy(&entry[((size_t)y * entryWidth + x) * 4], &texels[((size_t)sourceY * level.width + sourceX) * 4], 4);
+		}
+	}
+
+	int atlasIndex = -1;
+	for (int i = 0; (i < (int)m_arrays.size()) && (atlasIndex < 0); i++)
+	{
+		if (m_arrays[i].bAtlas == true)
+		{
+			atlasIndex = i;
+		}
+	}
+	if (atlasIndex < 0)
+	{
+		TEXTURE_ARRAY atlas;
+		memset(&atlas, 0, sizeof(atlas));
+		atlas.unit = ATLAS_UNIT;
+		atlas.width = ATLAS_SIZE;
+		atlas.height = ATLAS_SIZE;
+		atlas.format = FORMAT_RGBA8;
+		atlas.levelCount = ATLAS_LEVELS;
+		atlas.layerCount = 1;
+		atlas.capacity = 1;
+		atlas.bAtlas = true;
+		AllocateStorage(atlas);
+		m_arrays.push_back(atlas);
+		atlasIndex = (int)m_arrays.size() - 1;
+	}
+	TEXTURE_ARRAY& atlas = m_arrays[atlasIndex];
+
+	// start a new shelf, or a new layer, when the entry does not fit
+	if (atlas.shelfX + entryWidth > ATLAS_SIZE)
+	{
+		atlas.shelfY += atlas.shelfHeight;
+		atlas.shelfX = 0;
+		atlas.shelfHeight = 0;
+	}
+	if (atlas.shelfY + entryHeight > ATLAS_SIZE)
+	{
+		if (atlas.layerCount == atlas.capacity)
+		{
+			GrowArray(atlas);
+		}
+		atlas.layerCount++;
+		atlas.shelfX = 0;
+		atlas.shelfY = 0;
+		atlas.shelfHeight = 0;
+	}
+
+	int entryX = atlas.shelfX;
+	int entryY = atlas.shelfY;
+	int layer = atlas.layerCount - 1;
+	atlas.shelfX += entryWidth;
+	atlas.shelfHeight = std::max(atlas.shelfHeight, entryHeight);
+
+	BindForUpload(atlas);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, entryX, entryY, layer, entryWidth, entryHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, entry.data());
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	location.unit = atlas.unit;
+	location.layer = (float)layer;
+	location.rect = glm::vec4(
+		(float)(entryX + ATLAS_PADDING) / ATLAS_SIZE,
+		(float)(entryY + ATLAS_PADDING) / ATLAS_SIZE,
+		(float)level.width / ATLAS_SIZE,
+		(float)level.height / ATLAS_SIZE);
+
+	return(true);
+}
+
+/***********************************************************
+ *  BindArrays()
+ *
+ *  This method is used for binding every array to its unit.
+ ***********************************************************/
+void TextureArrays::BindArrays()
+{
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		if (NULL != m_pStateCache)
+		{
+			m_pStateCache->BindTexture(m_arrays[i].unit, GL_TEXTURE_2D_ARRAY, m_arrays[i].texture);
+		}
+		else
+		{
+			glActiveTexture(GL_TEXTURE0 + m_arrays[i].unit);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, m_arrays[i].texture);
+		}
+	}
+}
+
+/***********************************************************
+ *  GetLocation()
+ *
+ *  This method is used for getting where a texture is
+ *  sampled from.  Unknown textures sample the placeholder.
+ ***********************************************************/
+const TextureArrays::TEXTURE_LOCATION& TextureArrays::GetLocation(int textureIndex) const
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_locations.size()))
+	{
+		return(g_PlaceholderLocation);
+	}
+
+	return(m_locations[textureIndex]);
+}
+
+/***********************************************************
+ *  GetArrayTexture()
+ *
+ *  This method is used for getting the OpenGL name of the
+ *  array that holds a texture.
+ ***********************************************************/
+GLuint TextureArrays::GetArrayTexture(int textureIndex) const
+{
+	int unit = GetLocation(textureIndex).unit;
+
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		if (m_arrays[i].unit == unit)
+		{
+			return(m_arrays[i].texture);
+		}
+	}
+
+	return(0);
+}
+
+/***********************************************************
+ *  FindArrayIndex()
+ *
+ *  This method is used for getting the index of the array
+ *  that holds a texture.  Textures that are not stored yet
+ *  are held by the placeholder and return -1.
+ ***********************************************************/
+int TextureArrays::FindArrayIndex(int textureIndex) const
+{
+	int unit = GetLocation(textureIndex).unit;
+	if (unit == PLACEHOLDER_UNIT)
+	{
+		return(-1);
+	}
+
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		if (m_arrays[i].unit == unit)
+		{
+			return(i);
+		}
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  GetResidency()
+ *
+ *  This method is used for getting the mip residency of an
+ *  array.  The atlas keeps every level, since its entries
+ *  are packed from several textures.
+ ***********************************************************/
+TextureArrays::ARRAY_RESIDENCY TextureArrays::GetResidency(int arrayIndex) const
+{
+	const TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+
+	ARRAY_RESIDENCY residency;
+	residency.width = textureArray.width;
+	residency.height = textureArray.height;
+	residency.levelCount = textureArray.levelCount;
+	residency.residentLevel = textureArray.residentLevel;
+	residency.bStreamable = (textureArray.bAtlas == false) &&
+		(textureArray.unit != PLACEHOLDER_UNIT) &&
+		(textureArray.bStreamFailed == false);
+	residency.bStreaming = (textureArray.streamingLayers > 0);
+
+	// keep at least one level, and no level smaller than a block
+	residency.maximumResidentLevel = 0;
+	while ((residency.maximumResidentLevel + 1 < textureArray.levelCount) &&
+		((textureArray.width >> (residency.maximumResidentLevel + 1)) >= MIN_RESIDENT_SIZE) &&
+		((textureArray.height >> (residency.maximumResidentLevel + 1)) >= MIN_RESIDENT_SIZE))
+	{
+		residency.maximumResidentLevel++;
+	}
+
+	return(residency);
+}
+
+/***********************************************************
+ *  GetStorageBytes()
+ *
+ *  This method is used for getting the memory an array uses
+ *  for every layer it has room for when it holds the levels
+ *  from the passed in level down.
+ ***********************************************************/
+size_t TextureArrays::GetStorageBytes(int arrayIndex, int residentLevel) const
+{
+	const TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	size_t storageBytes = 0;
+
+	for (int level = residentLevel; level < textureArray.levelCount; level++)
+	{
+		int width = std::max(textureArray.width >> level, 1);
+		int height = std::max(textureArray.height >> level, 1);
+		storageBytes += TextureCompressor::GetLevelSize(textureArray.format, width, height) * textureArray.capacity;
+	}
+
+	return(storageBytes);
+}
+
+/***********************************************************
+ *  GetResidentBytes()
+ *
+ *  This method is used for getting the memory used by every
+ *  array, including the placeholder and the atlas.
+ ***********************************************************/
+size_t TextureArrays::GetResidentBytes() const
+{
+	size_t residentBytes = 0;
+
+	for (int i = 0; i < (int)m_arrays.size(); i++)
+	{
+		residentBytes += GetStorageBytes(i, m_arrays[i].residentLevel);
+	}
+
+	return(residentBytes);
+}
+
+/***********************************************************
+ *  SetResidentLevel()
+ *
+ *  This method is used for reallocating an array to hold
+ *  the levels from the passed in level down.  The levels the
+ *  old and new storage share are copied on the GPU.  When
+ *  levels are added, every layer has to stream them in, and
+ *  the array samples its old first level until they all
+ *  have.  An array that is streaming is not changed.
+ ***********************************************************/
+bool TextureArrays::SetResidentLevel(int arrayIndex, int residentLevel)
+{
+	if ((arrayIndex < 0) || (arrayIndex >= (int)m_arrays.size()))
+	{
+		return(false);
+	}
+
+	ARRAY_RESIDENCY residency = GetResidency(arrayIndex);
+	residentLevel = std::min(std::max(residentLevel, 0), residency.maximumResidentLevel);
+	if ((residency.bStreamable == false) || (residency.bStreaming == true) ||
+		(residentLevel == residency.residentLevel))
+	{
+		return(false);
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	GLuint oldTexture = textureArray.texture;
+	int oldResidentLevel = textureArray.residentLevel;
+	textureArray.residentLevel = residentLevel;
+	textureArray.missingLevels = std::max(oldResidentLevel - residentLevel, 0);
+	textureArray.streamingLayers = (textureArray.missingLevels > 0) ? textureArray.layerCount : 0;
+	AllocateStorage(textureArray);
+
+	CopyLevels(oldTexture, oldResidentLevel, textureArray.capacity, textureArray);
+	glDeleteTextures(1, &oldTexture);
+
+	// every texture in the array now waits for its levels
+	if (textureArray.streamingLayers > 0)
+	{
+		for (int i = 0; i < (int)m_locations.size(); i++)
+		{
+			if (m_locations[i].unit == textureArray.unit)
+			{
+				m_streamPending[i] = true;
+			}
+		}
+	}
+
+	// the array has a new texture name on its unit
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateTextures();
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  StreamTexture()
+ *
+ *  This method is used for uploading the levels a texture
+ *  is missing after its array added levels.  Once the last
+ *  layer has them, the array samples from its first level.
+ ***********************************************************/
+bool TextureArrays::StreamTexture(int textureIndex, const TextureCache::TEXTURE_DATA& texture)
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_locations.size()) || (m_streamPending[textureIndex] == false))
+	{
+		return(false);
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[FindArrayIndex(textureIndex)];
+	if ((texture.width != textureArray.width) ||
+		(texture.height != textureArray.height) ||
+		(texture.format != textureArray.format) ||
+		((int)texture.levels.size() != textureArray.levelCount))
+	{
+		std::cout << "Streamed texture levels do not match their texture array" << std::endl;
+		AbortStream(textureIndex);
+		return(false);
+	}
+
+	m_streamPending[textureIndex] = false;
+	StoreInLayer(textureArray, (int)m_locations[textureIndex].layer, texture,
+		textureArray.residentLevel, textureArray.residentLevel + textureArray.missingLevels);
+
+	textureArray.streamingLayers--;
+	if (textureArray.streamingLayers == 0)
+	{
+		textureArray.missingLevels = 0;
+		BindForUpload(textureArray);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+	}
+
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->InvalidateTextures();
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  AbortStream()
+ *
+ *  This method is used for giving up on streaming levels
+ *  into the array holding a texture.  The array goes back to
+ *  the levels every layer has, and keeps them from then on.
+ ***********************************************************/
+void TextureArrays::AbortStream(int textureIndex)
+{
+	int arrayIndex = FindArrayIndex(textureIndex);
+	if ((arrayIndex < 0) || (m_arrays[arrayIndex].streamingLayers == 0))
+	{
+		return;
+	}
+
+	TEXTURE_ARRAY& textureArray = m_arrays[arrayIndex];
+	for (int i = 0; i < (int)m_locations.size(); i++)
+	{
+		if (m_locations[i].unit == textureArray.unit)
+		{
+			m_streamPending[i] = false;
+		}
+	}
+
+	int completeLevel = textureArray.residentLevel + textureArray.missingLevels;
+	textureArray.streamingLayers = 0;
+	textureArray.missingLevels = 0;
+	SetResidentLevel(arrayIndex, completeLevel);
+	textureArray.bStreamFailed = true;
+}
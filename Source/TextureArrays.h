@@ -0,0 +1,184 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureArrays.h
+// ============
+// pack the scene textures into texture array layers and an atlas
+//
+//  Textures with the same size, format and mip count share one
+//  GL_TEXTURE_2D_ARRAY, and the shader selects a texture by its layer,
+//  so objects with different textures from the same array can be drawn
+//  without binding anything.  Every array keeps its own texture unit.
+//  Once the units run out, textures of other sizes are packed into the
+//  layers of an atlas array and addressed by a rectangle in the layer.
+//
+//  The arrays do not have to hold their whole mip chains.  The top
+//  levels of an array can be evicted to save memory and streamed back
+//  in layer by layer, and until every layer has them again the array
+//  samples from its first complete level.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "RenderStateCache.h"
+#include "TextureCache.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  TextureArrays
+ *
+ *  This class contains the code for creating the texture
+ *  arrays, storing loaded textures in their layers, and
+ *  binding the arrays to their texture units.
+ ***********************************************************/
+class TextureArrays
+{
+public:
+	// constructor - the state cache is told about the bindings
+	// changed while textures are stored
+	TextureArrays(RenderStateCache* pStateCache = NULL);
+	// destructor
+	~TextureArrays();
+
+	// where a texture is sampled from - the unit of its array,
+	// its layer, and the part of the layer it covers as an
+	// offset in xy and a size in zw
+	struct TEXTURE_LOCATION
+	{
+		int unit;
+		float layer;
+		glm::vec4 rect;
+	};
+
+	// unit of the one texel array shown until a texture is stored
+	static const int PLACEHOLDER_UNIT = 0;
+	// unit of the atlas array - the units between the placeholder
+	// and the atlas hold one array each
+	static const int ATLAS_UNIT = 12;
+	// size and mip levels of every atlas layer, and the border of
+	// repeated edge texels around each atlas entry
+	static const int ATLAS_SIZE = 2048;
+	static const int ATLAS_LEVELS = 4;
+	static const int ATLAS_PADDING = 8;
+	// layers an array is created with - full arrays double
+	static const int INITIAL_LAYERS = 4;
+	// smallest level width and height kept when levels are evicted,
+	// one whole compressed block
+	static const int MIN_RESIDENT_SIZE = 4;
+
+	// mip residency of one array - the resident level is the level
+	// of the full chain held as the first stored level
+	struct ARRAY_RESIDENCY
+	{
+		int width;
+		int height;
+		int levelCount;
+		int residentLevel;
+		int maximumResidentLevel;
+		// only arrays holding whole textures can evict levels
+		bool bStreamable;
+		// evicted levels are being streamed back into the layers
+		bool bStreaming;
+	};
+
+	// add a texture that shows the placeholder until it is stored,
+	// and return its texture index
+	int AddTexture();
+	// store the texels of a loaded texture in an array layer or
+	// the atlas and move the texture there
+	bool StoreTexture(int textureIndex, const TextureCache::TEXTURE_DATA& texture);
+	// free every array and move all textures to the placeholder
+	void DestroyArrays();
+
+	// bind every array to its texture unit
+	void BindArrays();
+
+	// where the texture with the passed in index is sampled from
+	const TEXTURE_LOCATION& GetLocation(int textureIndex) const;
+	// OpenGL name of the array holding the texture
+	GLuint GetArrayTexture(int textureIndex) const;
+	int GetTextureCount() const { return((int)m_locations.size()); }
+	int GetArrayCount() const { return((int)m_arrays.size()); }
+	// changes every time a texture moves to another location
+	int GetGeneration() const { return(m_generation); }
+
+	// index of the array holding the texture, or -1 for the placeholder
+	int FindArrayIndex(int textureIndex) const;
+	// mip residency of the array with the passed in index
+	ARRAY_RESIDENCY GetResidency(int arrayIndex) const;
+	// memory used by an array when it holds the levels from the
+	// passed in level down
+	size_t GetStorageBytes(int arrayIndex, int residentLevel) const;
+	// memory used by every array at its current residency
+	size_t GetResidentBytes() const;
+
+	// reallocate an array to hold the levels from the passed in
+	// level down - lower levels are copied over, and any higher
+	// levels must then be streamed into each layer
+	bool SetResidentLevel(int arrayIndex, int residentLevel);
+	// upload the streamed levels of a texture into its layer
+	bool StreamTexture(int textureIndex, const TextureCache::TEXTURE_DATA& texture);
+	// give up streaming the array holding a texture whose levels
+	// could not be loaded, keeping the levels it already has
+	void AbortStream(int textureIndex);
+
+private:
+	// one texture array and the layers used in it
+	struct TEXTURE_ARRAY
+	{
+		GLuint texture;
+		int unit;
+		int width;
+		int height;
+		TEXTURE_FORMAT format;
+		int levelCount;
+		int residentLevel;
+		// stored levels the streaming layers do not have yet, which
+		// the base level skips, and the layers still streaming
+		int missingLevels;
+		int streamingLayers;
+		// streaming failed once, so the levels are not evicted again
+		bool bStreamFailed;
+		int layerCount;
+		int capacity;
+		bool bAtlas;
+		// open shelf of the last atlas layer
+		int shelfX;
+		int shelfY;
+		int shelfHeight;
+	};
+
+	// location of every added texture
+	std::vector<TEXTURE_LOCATION> m_locations;
+	// whether each added texture still has levels streaming in
+	std::vector<bool> m_streamPending;
+	// the placeholder array first, then the arrays in unit order
+	std::vector<TEXTURE_ARRAY> m_arrays;
+	// told about bindings changed while storing textures, or NULL
+	RenderStateCache* m_pStateCache;
+	// pixel buffer the texels are staged and copied through
+	GLuint m_transferBuffer;
+	int m_generation;
+
+	// create the one texel placeholder array
+	void CreatePlaceholder();
+	// find the array for the texture, creating it while units
+	// remain, or -1 when the texture belongs in the atlas
+	int FindArray(const TextureCache::TEXTURE_DATA& texture);
+	// allocate the storage of an array for its capacity and residency
+	void AllocateStorage(TEXTURE_ARRAY& textureArray);
+	// copy the levels an old texture shares with the array on the GPU
+	void CopyLevels(GLuint sourceTexture, int sourceResidentLevel, int sourceCapacity, const TEXTURE_ARRAY& textureArray);
+	// double the layers of a full array, keeping its contents
+	void GrowArray(TEXTURE_ARRAY& textureArray);
+	// upload the mip levels of a texture from the first level up to
+	// the end level into an array layer
+	void StoreInLayer(const TEXTURE_ARRAY& textureArray, int layer, const TextureCache::TEXTURE_DATA& texture, int firstLevel, int endLevel);
+	// pack a texture into the atlas and return its location
+	bool StoreInAtlas(const TextureCache::TEXTURE_DATA& texture, TEXTURE_LOCATION& location);
+	// bind an array for uploading on its own unit
+	void BindForUpload(const TEXTURE_ARRAY& textureArray);
+
+	// OpenGL formats used to upload texels of a format
+	static void GetUploadFormat(TEXTURE_FORMAT format, GLenum& internalFormat, GLenum& pixelFormat);
+};
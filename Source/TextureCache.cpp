@@ -0,0 +1,493 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCache.cpp
+// ============
+// store decoded texture images with their mip chains in cache files
+//
+//  The first time an image file is loaded it is decoded, flipped for
+//  OpenGL, reduced into a full mip chain and optionally block
+//  compressed, and the texels are written to a cache file next to the
+//  image.  Later loads memory map the cache
+//  file and upload the stored levels directly.  The cache file records
+//  a hash of the image file, so an edited image rebuilds its entry.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// declaration of the cache file format
+namespace
+{
+	const char g_CacheMagic[4] = { 'T', 'X', 'C', 'H' };
+	// bump whenever the layout or the texel processing changes
+	const unsigned int g_CacheVersion = 2;
+	// mip levels start on this boundary within the file
+	const unsigned long long g_LevelAlignment = 16;
+}
+
+const char* TextureCache::CACHE_EXTENSION = ".texcache";
+
+/***********************************************************
+ *  LoadTexture()
+ *
+ *  This method is used for loading the texels of an image
+ *  file.  The image file is always read to hash it, but it
+ *  is only decoded when its cache file is missing, was built
+ *  from a different version of the image, or holds another
+ *  format than the compression asks for.
+ ***********************************************************/
+bool TextureCache::LoadTexture(const std::string& filename, TEXTURE_COMPRESSION compression, TEXTURE_DATA& texture)
+{
+	texture.width = 0;
+	texture.height = 0;
+	texture.channels = 0;
+	texture.format = FORMAT_RGB8;
+	texture.bFromCache = false;
+	texture.levels.clear();
+	texture.storage.clear();
+	texture.mappedView = NULL;
+	texture.mappedSize = 0;
+	texture.mappingHandle = NULL;
+
+	std::vector<unsigned char> source;
+	if (ReadFile(filename, source) == false)
+	{
+		return(false);
+	}
+
+	unsigned long long sourceHash = HashBytes(source);
+	std::string cacheFilename = filename + CACHE_EXTENSION;
+
+	if (MapCacheFile(cacheFilename, sourceHash, compression, texture) == true)
+	{
+		texture.bFromCache = true;
+		return(true);
+	}
+
+	if (BuildTexture(source, compression, texture) == false)
+	{
+		return(false);
+	}
+
+	// a cache that cannot be written only costs the next startup
+	if (WriteCacheFile(cacheFilename, sourceHash, texture) == false)
+	{
+		std::cout << "Could not write texture cache file:" << cacheFilename << std::endl;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  ReleaseTexture()
+ *
+ *  This method is used for freeing the texels of a loaded
+ *  texture once they are uploaded.
+ ***********************************************************/
+void TextureCache::ReleaseTexture(TEXTURE_DATA& texture)
+{
+	UnmapCacheFile(texture);
+	texture.levels.clear();
+	std::vector<unsigned char>().swap(texture.storage);
+}
+
+/***********************************************************
+ *  ReadFile()
+ *
+ *  This method is used for reading a whole file into memory.
+ ***********************************************************/
+bool TextureCache::ReadFile(const std::string& filename, std::vector<unsigned char>& contents)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+
+	fseek(file, 0, SEEK_END);
+	long fileSize = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (fileSize <= 0)
+	{
+		fclose(file);
+		return(false);
+	}
+
+	contents.resize((size_t)fileSize);
+	size_t readSize = fread(contents.data(), 1, contents.size(), file);
+	fclose(file);
+
+	return(readSize == contents.size());
+}
+
+/***********************************************************
+ *  HashBytes()
+ *
+ *  This method is used for hashing the contents of an image
+ *  file with 64-bit FNV-1a.
+ ***********************************************************/
+unsigned long long TextureCache::HashBytes(const std::vector<unsigned char>& bytes)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+
+	for (size_t i = 0; i < bytes.size(); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+
+	return(hash);
+}
+
+/***********************************************************
+ *  MapCacheFile()
+ *
+ *  This method is used for memory mapping a cache file and
+ *  pointing the texture levels into the mapped view.  The
+ *  file is rejected if its header does not match the format
+ *  or the hash of the current image file, or if it holds
+ *  another format than the compression asks for.
+ ***********************************************************/
+bool TextureCache::MapCacheFile(const std::string& cacheFilename, unsigned long long sourceHash, TEXTURE_COMPRESSION compression, TEXTURE_DATA& texture)
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(cacheFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+	LARGE_INTEGER fileSize;
+	if ((GetFileSizeEx(file, &fileSize) == FALSE) || (fileSize.QuadPart < (LONGLONG)sizeof(CACHE_HEADER)))
+	{
+		CloseHandle(file);
+		return(false);
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (mapping == NULL)
+	{
+		return(false);
+	}
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == NULL)
+	{
+		CloseHandle(mapping);
+		return(false);
+	}
+	texture.mappedView = view;
+	texture.mappedSize = (size_t)fileSize.QuadPart;
+	texture.mappingHandle = mapping;
+#else
+	int file = open(cacheFilename.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return(false);
+	}
+	struct stat fileStat;
+	if ((fstat(file, &fileStat) != 0) || (fileStat.st_size < (off_t)sizeof(CACHE_HEADER)))
+	{
+		close(file);
+		return(false);
+	}
+	void* view = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+	{
+		return(false);
+	}
+	texture.mappedView = view;
+	texture.mappedSize = (size_t)fileStat.st_size;
+#endif
+
+	const unsigned char* fileData = (const unsigned char*)texture.mappedView;
+	CACHE_HEADER header;
+	memcpy(&header, fileData, sizeof(header));
+
+	unsigned long long tableEnd = sizeof(CACHE_HEADER) + (unsigned long long)header.levelCount * sizeof(CACHE_LEVEL);
+	bool bValid = (memcmp(header.magic, g_CacheMagic, sizeof(g_CacheMagic)) == 0) &&
+		(header.version == g_CacheVersion) &&
+		(header.sourceHash == sourceHash) &&
+		((header.channels == 3) || (header.channels == 4)) &&
+		(header.format == (unsigned int)TextureCompressor::ChooseFormat((int)header.channels, compression)) &&
+		(header.levelCount > 0) && (header.levelCount <= 32) &&
+		(tableEnd <= texture.mappedSize);
+
+	for (unsigned int i = 0; (bValid == true) && (i < header.levelCount); i++)
+	{
+		CACHE_LEVEL level;
+		memcpy(&level, fileData + sizeof(CACHE_HEADER) + i * sizeof(CACHE_LEVEL), sizeof(level));
+
+		bValid = (level.offset >= tableEnd) &&
+			(level.size == TextureCompressor::GetLevelSize((TEXTURE_FORMAT)header.format, (int)level.width, (int)level.height)) &&
+			(level.offset + level.size <= texture.mappedSize);
+		if (bValid == true)
+		{
+			MIP_LEVEL mip;
+			mip.width = (int)level.width;
+			mip.height = (int)level.height;
+			mip.pixels = fileData + level.offset;
+			mip.size = (size_t)level.size;
+			texture.levels.push_back(mip);
+		}
+	}
+
+	if (bValid == false)
+	{
+		UnmapCacheFile(texture);
+		texture.levels.clear();
+		return(false);
+	}
+
+	texture.width = (int)header.width;
+	texture.height = (int)header.height;
+	texture.channels = (int)header.channels;
+	texture.format = (TEXTURE_FORMAT)header.format;
+
+	return(true);
+}
+
+/***********************************************************
+ *  UnmapCacheFile()
+ *
+ *  This method is used for unmapping a mapped cache file.
+ ***********************************************************/
+void TextureCache::UnmapCacheFile(TEXTURE_DATA& texture)
+{
+	if (texture.mappedView == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(texture.mappedView);
+	CloseHandle((HANDLE)texture.mappingHandle);
+#else
+	munmap(texture.mappedView, texture.mappedSize);
+#endif
+
+	texture.mappedView = NULL;
+	texture.mappedSize = 0;
+	texture.mappingHandle = NULL;
+}
+
+/***********************************************************
+ *  BuildTexture()
+ *
+ *  This method is used for decoding an image file, flipping
+ *  it so the first row is the bottom one as OpenGL expects,
+ *  reducing it into a full mip chain with a box filter, and
+ *  compressing the levels if the compression asks for it.
+ *  The global stb_image flip setting is not thread safe, so
+ *  the rows are flipped here instead.
+ ***********************************************************/
+bool TextureCache::BuildTexture(const std::vector<unsigned char>& source, TEXTURE_COMPRESSION compression, TEXTURE_DATA& texture)
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	unsigned char* image = stbi_load_from_memory(source.data(), (int)source.size(), &width, &height, &channels, 0);
+	if (image == NULL)
+	{
+		return(false);
+	}
+	if ((channels != 3) && (channels != 4))
+	{
+		std::cout << "Not implemented to handle image with " << channels << " channels" << std::endl;
+		stbi_image_free(image);
+		return(false);
+	}
+
+	// lay the levels out back to back, each on an aligned offset
+	std::vector<size_t> offsets;
+	size_t totalSize = 0;
+	for (int levelWidth = width, levelHeight = height; ; )
+	{
+		offsets.push_back(totalSize);
+		totalSize += (size_t)levelWidth * levelHeight * channels;
+		totalSize = (totalSize + (size_t)g_LevelAlignment - 1) & ~((size_t)g_LevelAlignment - 1);
+		if ((levelWidth == 1) && (levelHeight == 1))
+		{
+			break;
+		}
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+	texture.storage.resize(totalSize);
+
+	// copy the base level in with its rows flipped
+	size_t rowSize = (size_t)width * channels;
+	for (int row = 0; row < height; row++)
+	{
+		memcpy(texture.storage.data() + rowSize * row, image + rowSize * (height - 1 - row), rowSize);
+	}
+	stbi_image_free(image);
+
+	int levelWidth = width;
+	int levelHeight = height;
+	for (size_t level = 0; level < offsets.size(); level++)
+	{
+		unsigned char* pixels = texture.storage.data() + offsets[level];
+
+		// average each two by two block of the previous level
+		if (level > 0)
+		{
+			int sourceWidth = texture.levels[level - 1].width;
+			int sourceHeight = texture.levels[level - 1].height;
+			const unsigned char* sourcePixels = texture.levels[level - 1].pixels;
+
+			for (int y = 0; y < levelHeight; y++)
+			{
+				int y0 = std::min(y * 2, sourceHeight - 1);
+				int y1 = std::min(y * 2 + 1, sourceHeight - 1);
+				for (int x = 0; x < levelWidth; x++)
+				{
+					int x0 = std::min(x * 2, sourceWidth - 1);
+					int x1 = std::min(x * 2 + 1, sourceWidth - 1);
+					for (int c = 0; c < channels; c++)
+					{
+						int sum = sourcePixels[((size_t)y0 * sourceWidth + x0) * channels + c] +
+							sourcePixels[((size_t)y0 * sourceWidth + x1) * channels + c] +
+							sourcePixels[((size_t)y1 * sourceWidth + x0) * channels + c] +
+							sourcePixels[((size_t)y1 * sourceWidth + x1) * channels + c];
+						pixels[((size_t)y * levelWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+					}
+				}
+			}
+		}
+
+		MIP_LEVEL mip;
+		mip.width = levelWidth;
+		mip.height = levelHeight;
+		mip.pixels = pixels;
+		mip.size = (size_t)levelWidth * levelHeight * channels;
+		texture.levels.push_back(mip);
+
+		levelWidth = std::max(levelWidth / 2, 1);
+		levelHeight = std::max(levelHeight / 2, 1);
+	}
+
+	texture.width = width;
+	texture.height = height;
+	texture.channels = channels;
+	texture.format = TextureCompressor::ChooseFormat(channels, compression);
+
+	if (TextureCompressor::IsCompressed(texture.format) == true)
+	{
+		CompressLevels(texture);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  CompressLevels()
+ *
+ *  This method is used for encoding every mip level of a
+ *  built texture into compressed blocks.  The cache is built
+ *  once, so the slower high quality fit is always used.
+ ***********************************************************/
+void TextureCache::CompressLevels(TEXTURE_DATA& texture)
+{
+	std::vector<size_t> offsets;
+	size_t totalSize = 0;
+	for (int i = 0; i < (int)texture.levels.size(); i++)
+	{
+		offsets.push_back(totalSize);
+		totalSize += TextureCompressor::GetLevelSize(texture.format, texture.levels[i].width, texture.levels[i].height);
+		totalSize = (totalSize + (size_t)g_LevelAlignment - 1) & ~((size_t)g_LevelAlignment - 1);
+	}
+
+	std::vector<unsigned char> blocks(totalSize);
+	for (int i = 0; i < (int)texture.levels.size(); i++)
+	{
+		MIP_LEVEL& level = texture.levels[i];
+		TextureCompressor::Compress(level.pixels, level.width, level.height, texture.channels,
+			texture.format, QUALITY_HIGH, blocks.data() + offsets[i]);
+		level.pixels = blocks.data() + offsets[i];
+		level.size = TextureCompressor::GetLevelSize(texture.format, level.width, level.height);
+	}
+
+	// swapping keeps the block buffer, so the level pointers stay valid
+	texture.storage.swap(blocks);
+}
+
+/***********************************************************
+ *  WriteCacheFile()
+ *
+ *  This method is used for writing the levels of a built
+ *  texture to its cache file.  The file is written under a
+ *  temporary name and renamed, so a reader never maps a
+ *  partly written file.
+ ***********************************************************/
+bool TextureCache::WriteCacheFile(const std::string& cacheFilename, unsigned long long sourceHash, const TEXTURE_DATA& texture)
+{
+	CACHE_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, g_CacheMagic, sizeof(g_CacheMagic));
+	header.version = g_CacheVersion;
+	header.sourceHash = sourceHash;
+	header.width = (unsigned int)texture.width;
+	header.height = (unsigned int)texture.height;
+	header.channels = (unsigned int)texture.channels;
+	header.format = (unsigned int)texture.format;
+	header.levelCount = (unsigned int)texture.levels.size();
+
+	unsigned long long tableEnd = sizeof(CACHE_HEADER) + texture.levels.size() * sizeof(CACHE_LEVEL);
+	unsigned long long dataStart = (tableEnd + g_LevelAlignment - 1) & ~(g_LevelAlignment - 1);
+
+	std::vector<CACHE_LEVEL> table(texture.levels.size());
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		memset(&table[i], 0, sizeof(CACHE_LEVEL));
+		table[i].width = (unsigned int)texture.levels[i].width;
+		table[i].height = (unsigned int)texture.levels[i].height;
+		table[i].offset = dataStart + (unsigned long long)(texture.levels[i].pixels - texture.storage.data());
+		table[i].size = texture.levels[i].size;
+	}
+
+	std::string tempFilename = cacheFilename + ".tmp";
+	FILE* file = fopen(tempFilename.c_str(), "wb");
+	if (file == NULL)
+	{
+		return(false);
+	}
+
+	std::vector<unsigned char> padding((size_t)(dataStart - tableEnd), 0);
+	bool bWritten = (fwrite(&header, sizeof(header), 1, file) == 1) &&
+		(fwrite(table.data(), sizeof(CACHE_LEVEL), table.size(), file) == table.size()) &&
+		(fwrite(padding.data(), 1, padding.size(), file) == padding.size()) &&
+		(fwrite(texture.storage.data(), 1, texture.storage.size(), file) == texture.storage.size());
+	bWritten = (fclose(file) == 0) && bWritten;
+
+	if (bWritten == true)
+	{
+		remove(cacheFilename.c_str());
+		bWritten = (rename(tempFilename.c_str(), cacheFilename.c_str()) == 0);
+	}
+	if (bWritten == false)
+	{
+		remove(tempFilename.c_str());
+	}
+
+	return(bWritten);
+}
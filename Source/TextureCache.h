@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCache.h
+// ============
+// store decoded texture images with their mip chains in cache files
+//
+//  The first time an image file is loaded it is decoded, flipped for
+//  OpenGL, reduced into a full mip chain and optionally block
+//  compressed, and the texels are written to a cache file next to the
+//  image.  Later loads memory map the cache
+//  file and upload the stored levels directly.  The cache file records
+//  a hash of the image file, so an edited image rebuilds its entry.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "TextureCompressor.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class contains the code for reading and writing the
+ *  texture cache files.  It keeps no state between loads, so
+ *  it can be used from several threads at once.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// one mip level of a loaded texture
+	struct MIP_LEVEL
+	{
+		int width;
+		int height;
+		const unsigned char* pixels;
+		size_t size;
+	};
+
+	// texels of a loaded texture, either mapped from the cache
+	// file or built in memory when the cache entry was rebuilt
+	struct TEXTURE_DATA
+	{
+		int width;
+		int height;
+		int channels;
+		TEXTURE_FORMAT format;
+		bool bFromCache;
+		std::vector<MIP_LEVEL> levels;
+		std::vector<unsigned char> storage;
+		void* mappedView;
+		size_t mappedSize;
+		void* mappingHandle;
+	};
+
+	// extension appended to the image file name for its cache file
+	static const char* CACHE_EXTENSION;
+
+	// load the texels of an image file in the format chosen by the
+	// compression, through its cache file when that is current, and
+	// rebuild the cache file when it is not
+	static bool LoadTexture(const std::string& filename, TEXTURE_COMPRESSION compression, TEXTURE_DATA& texture);
+	// free the texels of a loaded texture
+	static void ReleaseTexture(TEXTURE_DATA& texture);
+
+private:
+	// header at the start of every cache file
+	struct CACHE_HEADER
+	{
+		char magic[4];
+		unsigned int version;
+		unsigned long long sourceHash;
+		unsigned int width;
+		unsigned int height;
+		unsigned int channels;
+		unsigned int format;
+		unsigned int levelCount;
+	};
+
+	// location of a mip level within a cache file
+	struct CACHE_LEVEL
+	{
+		unsigned int width;
+		unsigned int height;
+		unsigned long long offset;
+		unsigned long long size;
+	};
+
+	// read a whole file into memory
+	static bool ReadFile(const std::string& filename, std::vector<unsigned char>& contents);
+	// 64-bit FNV-1a hash of a block of bytes
+	static unsigned long long HashBytes(const std::vector<unsigned char>& bytes);
+	// map a cache file and point the levels into it if it is current
+	static bool MapCacheFile(const std::string& cacheFilename, unsigned long long sourceHash, TEXTURE_COMPRESSION compression, TEXTURE_DATA& texture);
+	// decode an image file and build its mip chain in memory
+	static bool BuildTexture(const std::vector<unsigned char>& source, TEXTURE_COMPRESSION compression, TEXTURE_DATA& texture);
+	// replace the texels of every level with compressed blocks
+	static void CompressLevels(TEXTURE_DATA& texture);
+	// write the texels of a built texture to its cache file
+	static bool WriteCacheFile(const std::string& cacheFilename, unsigned long long sourceHash, const TEXTURE_DATA& texture);
+	// unmap a mapped cache file
+	static void UnmapCacheFile(TEXTURE_DATA& texture);
+};
@@ -0,0 +1,979 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCompressor.cpp
+// ============
+// encode texture images into BC1, BC3 and BC7 compressed blocks
+//
+//  Each 4x4 block of texels is reduced to two endpoint colors and a
+//  set of indices that select colors interpolated between them.  The
+//  endpoints are fitted along the principal axis of the block colors,
+//  and the high quality setting refines them with a least squares fit
+//  to the chosen indices.  The decoders are used to measure the PSNR
+//  of the encoded blocks against the source texels.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCompressor.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// declaration of the block encoding helpers
+namespace
+{
+	// least squares refinement passes of the high quality setting
+	const int g_RefinePasses = 3;
+	// BC7 interpolation weights for 4-bit indices, out of 64
+	const int g_BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	// fraction of the second endpoint used by each BC1 index
+	const float g_ColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+	// writes little endian bit fields into a zeroed block
+	struct BIT_WRITER
+	{
+		unsigned char* bytes;
+		int position;
+
+		void Write(unsigned int value, int bitCount)
+		{
+			for (int i = 0; i < bitCount; i++, position++)
+			{
+				if (((value >> i) & 1) != 0)
+				{
+					bytes[position >> 3] |= (unsigned char)(1 << (position & 7));
+				}
+			}
+		}
+	};
+
+	// reads little endian bit fields from a block
+	struct BIT_READER
+	{
+		const unsigned char* bytes;
+		int position;
+
+		unsigned int Read(int bitCount)
+		{
+			unsigned int value = 0;
+			for (int i = 0; i < bitCount; i++, position++)
+			{
+				value |= (unsigned int)((bytes[position >> 3] >> (position & 7)) & 1) << i;
+			}
+			return(value);
+		}
+	};
+
+	// copy the 16 RGBA texels of a block into floats
+	void LoadBlockValues(const unsigned char* texels, float values[16][4])
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				values[i][c] = (float)texels[i * 4 + c];
+			}
+		}
+	}
+
+	// fit the endpoints of a block to the extent of its colors
+	// along their principal axis
+	void FitPrincipalAxis(const float values[16][4], int channelCount, float low[4], float high[4])
+	{
+		float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++)
+		{
+			for (int c = 0; c < channelCount; c++)
+			{
+				mean[c] += values[i][c] / 16.0f;
+			}
+		}
+
+		float covariance[4][4];
+		memset(covariance, 0, sizeof(covariance));
+		for (int i = 0; i < 16; i++)
+		{
+			for (int r = 0; r < channelCount; r++)
+			{
+				for (int c = 0; c < channelCount; c++)
+				{
+					covariance[r][c] += (values[i][r] - mean[r]) * (values[i][c] - mean[c]);
+				}
+			}
+		}
+
+		// start from the channel with the most variance and let
+		// power iteration turn it towards the principal axis
+		int widest = 0;
+		for (int c = 1; c < channelCount; c++)
+		{
+			if (covariance[c][c] > covariance[widest][widest])
+			{
+				widest = c;
+			}
+		}
+		float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int c = 0; c < channelCount; c++)
+		{
+			axis[c] = covariance[widest][c];
+		}
+		for (int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			float length = 0.0f;
+			for (int r = 0; r < channelCount; r++)
+			{
+				for (int c = 0; c < channelCount; c++)
+				{
+					next[r] += covariance[r][c] * axis[c];
+				}
+				length += next[r] * next[r];
+			}
+			if (length < 1.0e-12f)
+			{
+				break;
+			}
+			length = std::sqrt(length);
+			for (int c = 0; c < channelCount; c++)
+			{
+				axis[c] = next[c] / length;
+			}
+		}
+
+		float minimum = 0.0f;
+		float maximum = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for (int c = 0; c < channelCount; c++)
+			{
+				t += (values[i][c] - mean[c]) * axis[c];
+			}
+			minimum = std::min(minimum, t);
+			maximum = std::max(maximum, t);
+		}
+
+		for (int c = 0; c < channelCount; c++)
+		{
+			low[c] = std::min(std::max(mean[c] + axis[c] * minimum, 0.0f), 255.0f);
+			high[c] = std::min(std::max(mean[c] + axis[c] * maximum, 0.0f), 255.0f);
+		}
+	}
+
+	// solve for the endpoints that best reproduce the block when
+	// each texel mixes them by its weight - false if degenerate
+	bool SolveEndpoints(const float values[16][4], int channelCount, const float weights[16], float first[4], float second[4])
+	{
+		float firstFirst = 0.0f;
+		float firstSecond = 0.0f;
+		float secondSecond = 0.0f;
+		float firstValue[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		float secondValue[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+		for (int i = 0; i < 16; i++)
+		{
+			float w = weights[i];
+			firstFirst += (1.0f - w) * (1.0f - w);
+			firstSecond += (1.0f - w) * w;
+			secondSecond += w * w;
+			for (int c = 0; c < channelCount; c++)
+			{
+				firstValue[c] += (1.0f - w) * values[i][c];
+				secondValue[c] += w * values[i][c];
+			}
+		}
+
+		float determinant = firstFirst * secondSecond - firstSecond * firstSecond;
+		if (std::fabs(determinant) < 1.0e-6f)
+		{
+			return(false);
+		}
+
+		for (int c = 0; c < channelCount; c++)
+		{
+			first[c] = (secondSecond * firstValue[c] - firstSecond * secondValue[c]) / determinant;
+			second[c] = (firstFirst * secondValue[c] - firstSecond * firstValue[c]) / determinant;
+			first[c] = std::min(std::max(first[c], 0.0f), 255.0f);
+			second[c] = std::min(std::max(second[c], 0.0f), 255.0f);
+		}
+		return(true);
+	}
+
+	// round an RGB color to 5:6:5 bits
+	unsigned short PackColor565(const float color[4])
+	{
+		int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+		int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+		int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+		return((unsigned short)((r << 11) | (g << 5) | b));
+	}
+
+	// expand a 5:6:5 color back to 8 bits per channel
+	void UnpackColor565(unsigned short packed, int color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+
+	// the four colors a BC1 block selects from, as the decoder
+	// builds them
+	void BuildColorPalette(unsigned short packed0, unsigned short packed1, bool bFourColor, int palette[4][3])
+	{
+		UnpackColor565(packed0, palette[0]);
+		UnpackColor565(packed1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			if (bFourColor == true)
+			{
+				palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+				palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+			}
+			else
+			{
+				palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+				palette[3][c] = 0;
+			}
+		}
+	}
+
+	// pick the nearest of the four colors for every texel and
+	// return the squared error
+	float FitColorIndices(const float values[16][4], unsigned short packed0, unsigned short packed1, unsigned char indices[16])
+	{
+		int palette[4][3];
+		BuildColorPalette(packed0, packed1, true, palette);
+
+		float totalError = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float bestError = 1.0e30f;
+			for (int p = 0; p < 4; p++)
+			{
+				float error = 0.0f;
+				for (int c = 0; c < 3; c++)
+				{
+					float difference = values[i][c] - (float)palette[p][c];
+					error += difference * difference;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					indices[i] = (unsigned char)p;
+				}
+			}
+			totalError += bestError;
+		}
+		return(totalError);
+	}
+
+	// the eight alpha values a BC3 alpha block selects from
+	void BuildAlphaPalette(int alpha0, int alpha1, int palette[8])
+	{
+		palette[0] = alpha0;
+		palette[1] = alpha1;
+		if (alpha0 > alpha1)
+		{
+			for (int i = 2; i < 8; i++)
+			{
+				palette[i] = ((8 - i) * alpha0 + (i - 1) * alpha1) / 7;
+			}
+		}
+		else
+		{
+			for (int i = 2; i < 6; i++)
+			{
+				palette[i] = ((6 - i) * alpha0 + (i - 1) * alpha1) / 5;
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// pick the nearest of the eight alpha values for every texel
+	// and return the squared error
+	float FitAlphaIndices(const float values[16][4], int alpha0, int alpha1, unsigned char indices[16])
+	{
+		int palette[8];
+		BuildAlphaPalette(alpha0, alpha1, palette);
+
+		float totalError = 0.0f;
+		for (int i = 0; i < 16; i++)
+		{
+			float bestError = 1.0e30f;
+			for (int p = 0; p < 8; p++)
+			{
+				float difference = values[i][3] - (float)palette[p];
+				if (difference * difference < bestError)
+				{
+					bestError = difference * difference;
+					indices[i] = (unsigned char)p;
+				}
+			}
+			totalError += bestError;
+		}
+		return(totalError);
+	}
+
+	// quantized BC7 mode 6 endpoints and their indices
+	struct BC7_ENDPOINTS
+	{
+		int endpoint[2][4];
+		int pBit[2];
+		unsigned char indices[16];
+		float error;
+	};
+
+	// quantize two endpoints to 7 bits plus a shared low bit,
+	// trying every low bit pair, and pick the indices
+	void FitBC7Endpoints(const float values[16][4], const float first[4], const float second[4], BC7_ENDPOINTS& result)
+	{
+		result.error = 1.0e30f;
+
+		for (int pBits = 0; pBits < 4; pBits++)
+		{
+			int pBit[2] = { pBits & 1, pBits >> 1 };
+			int endpoint[2][4];
+			int expanded[2][4];
+			for (int c = 0; c < 4; c++)
+			{
+				endpoint[0][c] = std::min(std::max((int)std::floor((first[c] - pBit[0]) / 2.0f + 0.5f), 0), 127);
+				endpoint[1][c] = std::min(std::max((int)std::floor((second[c] - pBit[1]) / 2.0f + 0.5f), 0), 127);
+				expanded[0][c] = (endpoint[0][c] << 1) | pBit[0];
+				expanded[1][c] = (endpoint[1][c] << 1) | pBit[1];
+			}
+
+			int palette[16][4];
+			for (int p = 0; p < 16; p++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					palette[p][c] = ((64 - g_BC7Weights[p]) * expanded[0][c] + g_BC7Weights[p] * expanded[1][c] + 32) >> 6;
+				}
+			}
+
+			unsigned char indices[16];
+			float totalError = 0.0f;
+			for (int i = 0; (i < 16) && (totalError < result.error); i++)
+			{
+				float bestError = 1.0e30f;
+				for (int p = 0; p < 16; p++)
+				{
+					float error = 0.0f;
+					for (int c = 0; c < 4; c++)
+					{
+						float difference = values[i][c] - (float)palette[p][c];
+						error += difference * difference;
+					}
+					if (error < bestError)
+					{
+						bestError = error;
+						indices[i] = (unsigned char)p;
+					}
+				}
+				totalError += bestError;
+			}
+
+			if (totalError < result.error)
+			{
+				result.error = totalError;
+				memcpy(result.endpoint, endpoint, sizeof(endpoint));
+				result.pBit[0] = pBit[0];
+				result.pBit[1] = pBit[1];
+				memcpy(result.indices, indices, sizeof(indices));
+			}
+		}
+	}
+
+	// name of a format for the benchmark output
+	const char* GetFormatName(TEXTURE_FORMAT format)
+	{
+		switch (format)
+		{
+		case FORMAT_BC1: return("BC1");
+		case FORMAT_BC3: return("BC3");
+		case FORMAT_BC7: return("BC7");
+		case FORMAT_RGBA8: return("RGBA8");
+		default: return("RGB8");
+		}
+	}
+}
+
+/***********************************************************
+ *  ChooseFormat()
+ *
+ *  This method is used for choosing the format an image with
+ *  the passed in number of channels is stored in.
+ ***********************************************************/
+TEXTURE_FORMAT TextureCompressor::ChooseFormat(int channels, TEXTURE_COMPRESSION compression)
+{
+	if (compression == COMPRESSION_BC7)
+	{
+		return(FORMAT_BC7);
+	}
+	if (compression == COMPRESSION_BC1_BC3)
+	{
+		return((channels == 4) ? FORMAT_BC3 : FORMAT_BC1);
+	}
+	return((channels == 4) ? FORMAT_RGBA8 : FORMAT_RGB8);
+}
+
+/***********************************************************
+ *  IsCompressed()
+ *
+ *  This method is used for checking whether a format is
+ *  made of 4x4 compressed blocks.
+ ***********************************************************/
+bool TextureCompressor::IsCompressed(TEXTURE_FORMAT format)
+{
+	return((format == FORMAT_BC1) || (format == FORMAT_BC3) || (format == FORMAT_BC7));
+}
+
+/***********************************************************
+ *  GetLevelSize()
+ *
+ *  This method is used for getting the bytes one mip level
+ *  takes in a format.  Compressed levels are padded out to
+ *  whole blocks.
+ ***********************************************************/
+size_t TextureCompressor::GetLevelSize(TEXTURE_FORMAT format, int width, int height)
+{
+	size_t blockCount = (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4);
+
+	switch (format)
+	{
+	case FORMAT_BC1:
+		return(blockCount * 8);
+	case FORMAT_BC3:
+	case FORMAT_BC7:
+		return(blockCount * 16);
+	case FORMAT_RGBA8:
+		return((size_t)width * height * 4);
+	default:
+		return((size_t)width * height * 3);
+	}
+}
+
+/***********************************************************
+ *  Compress()
+ *
+ *  This method is used for encoding a level of texels into
+ *  compressed blocks.  Blocks past the edge of the image
+ *  repeat the last row and column.
+ ***********************************************************/
+void TextureCompressor::Compress(
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int channels,
+	TEXTURE_FORMAT format,
+	ENCODE_QUALITY quality,
+	unsigned char* blocks)
+{
+	int blocksWide = (width + 3) / 4;
+	int blocksHigh = (height + 3) / 4;
+	size_t blockBytes = (format == FORMAT_BC1) ? 8 : 16;
+
+	for (int blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			unsigned char texels[64];
+			for (int y = 0; y < 4; y++)
+			{
+				int sourceY = std::min(blockY * 4 + y, height - 1);
+				for (int x = 0; x < 4; x++)
+				{
+					int sourceX = std::min(blockX * 4 + x, width - 1);
+					const unsigned char* source = pixels + ((size_t)sourceY * width + sourceX) * channels;
+					unsigned char* texel = texels + (y * 4 + x) * 4;
+					texel[0] = source[0];
+					texel[1] = source[1];
+					texel[2] = source[2];
+					texel[3] = (channels == 4) ? source[3] : 255;
+				}
+			}
+
+			unsigned char* block = blocks + ((size_t)blockY * blocksWide + blockX) * blockBytes;
+			if (format == FORMAT_BC1)
+			{
+				EncodeColorBlock(texels, quality, block);
+			}
+			else if (format == FORMAT_BC3)
+			{
+				EncodeAlphaBlock(texels, quality, block);
+				EncodeColorBlock(texels, quality, block + 8);
+			}
+			else
+			{
+				EncodeBC7Block(texels, quality, block);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Decompress()
+ *
+ *  This method is used for decoding compressed blocks into
+ *  RGBA texels.
+ ***********************************************************/
+void TextureCompressor::Decompress(
+	const unsigned char* blocks,
+	int width,
+	int height,
+	TEXTURE_FORMAT format,
+	unsigned char* rgbaPixels)
+{
+	int blocksWide = (width + 3) / 4;
+	int blocksHigh = (height + 3) / 4;
+	size_t blockBytes = (format == FORMAT_BC1) ? 8 : 16;
+
+	for (int blockY = 0; blockY < blocksHigh; blockY++)
+	{
+		for (int blockX = 0; blockX < blocksWide; blockX++)
+		{
+			const unsigned char* block = blocks + ((size_t)blockY * blocksWide + blockX) * blockBytes;
+			unsigned char texels[64];
+			if (format == FORMAT_BC1)
+			{
+				DecodeColorBlock(block, false, texels);
+			}
+			else if (format == FORMAT_BC3)
+			{
+				DecodeColorBlock(block + 8, true, texels);
+				DecodeAlphaBlock(block, texels);
+			}
+			else
+			{
+				DecodeBC7Block(block, texels);
+			}
+
+			for (int y = 0; (y < 4) && (blockY * 4 + y < height); y++)
+			{
+				for (int x = 0; (x < 4) && (blockX * 4 + x < width); x++)
+				{
+					memcpy(rgbaPixels + ((size_t)(blockY * 4 + y) * width + blockX * 4 + x) * 4, texels + (y * 4 + x) * 4, 4);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  ComputePSNR()
+ *
+ *  This method is used for measuring how closely compressed
+ *  blocks reproduce the source texels.  Alpha only counts
+ *  when the source has it and the format can store it.
+ ***********************************************************/
+double TextureCompressor::ComputePSNR(
+	const unsigned char* pixels,
+	int width,
+	int height,
+	int channels,
+	const unsigned char* blocks,
+	TEXTURE_FORMAT format)
+{
+	std::vector<unsigned char> decoded((size_t)width * height * 4);
+	Decompress(blocks, width, height, format, decoded.data());
+
+	int comparedChannels = (format == FORMAT_BC1) ? 3 : channels;
+	double squaredError = 0.0;
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		for (int c = 0; c < comparedChannels; c++)
+		{
+			double difference = (double)pixels[i * channels + c] - (double)decoded[i * 4 + c];
+			squaredError += difference * difference;
+		}
+	}
+
+	double meanSquaredError = squaredError / ((double)width * height * comparedChannels);
+	if (meanSquaredError <= 0.0)
+	{
+		return(100.0);
+	}
+	return(10.0 * std::log10(255.0 * 255.0 / meanSquaredError));
+}
+
+/***********************************************************
+ *  EncodeColorBlock()
+ *
+ *  This method is used for encoding the color of a block as
+ *  BC1 in four color mode.  The endpoints span the colors
+ *  along their principal axis, and the high quality setting
+ *  refits them to the chosen indices while the error drops.
+ ***********************************************************/
+void TextureCompressor::EncodeColorBlock(const unsigned char* texels, ENCODE_QUALITY quality, unsigned char* block)
+{
+	float values[16][4];
+	LoadBlockValues(texels, values);
+
+	float low[4];
+	float high[4];
+	FitPrincipalAxis(values, 3, low, high);
+
+	unsigned short packed0 = PackColor565(high);
+	unsigned short packed1 = PackColor565(low);
+	unsigned char indices[16];
+	float bestError = FitColorIndices(values, packed0, packed1, indices);
+
+	for (int pass = 0; (quality == QUALITY_HIGH) && (pass < g_RefinePasses); pass++)
+	{
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = g_ColorWeights[indices[i]];
+		}
+		float first[4];
+		float second[4];
+		if (SolveEndpoints(values, 3, weights, first, second) == false)
+		{
+			break;
+		}
+
+		unsigned short refined0 = PackColor565(first);
+		unsigned short refined1 = PackColor565(second);
+		unsigned char refinedIndices[16];
+		float error = FitColorIndices(values, refined0, refined1, refinedIndices);
+		if (error >= bestError)
+		{
+			break;
+		}
+		bestError = error;
+		packed0 = refined0;
+		packed1 = refined1;
+		memcpy(indices, refinedIndices, sizeof(indices));
+	}
+
+	// the first endpoint must be larger to select four color mode,
+	// which swaps the roles of both endpoint and midpoint indices
+	if (packed0 < packed1)
+	{
+		std::swap(packed0, packed1);
+		for (int i = 0; i < 16; i++)
+		{
+			indices[i] ^= 1;
+		}
+	}
+	else if (packed0 == packed1)
+	{
+		memset(indices, 0, sizeof(indices));
+	}
+
+	block[0] = (unsigned char)(packed0 & 0xFF);
+	block[1] = (unsigned char)(packed0 >> 8);
+	block[2] = (unsigned char)(packed1 & 0xFF);
+	block[3] = (unsigned char)(packed1 >> 8);
+	unsigned int indexBits = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		indexBits |= (unsigned int)indices[i] << (i * 2);
+	}
+	block[4] = (unsigned char)(indexBits & 0xFF);
+	block[5] = (unsigned char)((indexBits >> 8) & 0xFF);
+	block[6] = (unsigned char)((indexBits >> 16) & 0xFF);
+	block[7] = (unsigned char)(indexBits >> 24);
+}
+
+/***********************************************************
+ *  EncodeAlphaBlock()
+ *
+ *  This method is used for encoding the alpha of a block as
+ *  a BC3 alpha block in eight value mode.
+ ***********************************************************/
+void TextureCompressor::EncodeAlphaBlock(const unsigned char* texels, ENCODE_QUALITY quality, unsigned char* block)
+{
+	float values[16][4];
+	LoadBlockValues(texels, values);
+
+	int alpha0 = 0;
+	int alpha1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		alpha0 = std::max(alpha0, (int)texels[i * 4 + 3]);
+		alpha1 = std::min(alpha1, (int)texels[i * 4 + 3]);
+	}
+
+	unsigned char indices[16];
+	float bestError = FitAlphaIndices(values, alpha0, alpha1, indices);
+
+	for (int pass = 0; (quality == QUALITY_HIGH) && (alpha0 > alpha1) && (pass < g_RefinePasses); pass++)
+	{
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = (indices[i] < 2) ? (float)indices[i] : (float)(indices[i] - 1) / 7.0f;
+		}
+
+		// solve on the alpha channel alone
+		float alphaValues[16][4];
+		for (int i = 0; i < 16; i++)
+		{
+			alphaValues[i][0] = values[i][3];
+		}
+		float first[4];
+		float second[4];
+		if (SolveEndpoints(alphaValues, 1, weights, first, second) == false)
+		{
+			break;
+		}
+
+		int refined0 = (int)(first[0] + 0.5f);
+		int refined1 = (int)(second[0] + 0.5f);
+		if (refined0 <= refined1)
+		{
+			break;
+		}
+		unsigned char refinedIndices[16];
+		float error = FitAlphaIndices(values, refined0, refined1, refinedIndices);
+		if (error >= bestError)
+		{
+			break;
+		}
+		bestError = error;
+		alpha0 = refined0;
+		alpha1 = refined1;
+		memcpy(indices, refinedIndices, sizeof(indices));
+	}
+
+	memset(block, 0, 8);
+	block[0] = (unsigned char)alpha0;
+	block[1] = (unsigned char)alpha1;
+	BIT_WRITER writer = { block, 16 };
+	for (int i = 0; i < 16; i++)
+	{
+		writer.Write(indices[i], 3);
+	}
+}
+
+/***********************************************************
+ *  EncodeBC7Block()
+ *
+ *  This method is used for encoding a block as BC7 mode 6,
+ *  which has one pair of RGBA endpoints with 7 bits per
+ *  channel plus a low bit each, and 4-bit indices.
+ ***********************************************************/
+void TextureCompressor::EncodeBC7Block(const unsigned char* texels, ENCODE_QUALITY quality, unsigned char* block)
+{
+	float values[16][4];
+	LoadBlockValues(texels, values);
+
+	float low[4];
+	float high[4];
+	FitPrincipalAxis(values, 4, low, high);
+
+	BC7_ENDPOINTS best;
+	FitBC7Endpoints(values, low, high, best);
+
+	for (int pass = 0; (quality == QUALITY_HIGH) && (pass < g_RefinePasses); pass++)
+	{
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+		{
+			weights[i] = (float)g_BC7Weights[best.indices[i]] / 64.0f;
+		}
+		float first[4];
+		float second[4];
+		if (SolveEndpoints(values, 4, weights, first, second) == false)
+		{
+			break;
+		}
+
+		BC7_ENDPOINTS refined;
+		FitBC7Endpoints(values, first, second, refined);
+		if (refined.error >= best.error)
+		{
+			break;
+		}
+		best = refined;
+	}
+
+	// the first index is stored with its top bit left out, so it
+	// must be below 8 - swap the endpoints when it is not
+	if (best.indices[0] >= 8)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			std::swap(best.endpoint[0][c], best.endpoint[1][c]);
+		}
+		std::swap(best.pBit[0], best.pBit[1]);
+		for (int i = 0; i < 16; i++)
+		{
+			best.indices[i] = (unsigned char)(15 - best.indices[i]);
+		}
+	}
+
+	memset(block, 0, 16);
+	BIT_WRITER writer = { block, 0 };
+	writer.Write(1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writer.Write(best.endpoint[0][c], 7);
+		writer.Write(best.endpoint[1][c], 7);
+	}
+	writer.Write(best.pBit[0], 1);
+	writer.Write(best.pBit[1], 1);
+	for (int i = 0; i < 16; i++)
+	{
+		writer.Write(best.indices[i], (i == 0) ? 3 : 4);
+	}
+}
+
+/***********************************************************
+ *  DecodeColorBlock()
+ *
+ *  This method is used for decoding a BC1 color block into
+ *  16 RGBA texels.
+ ***********************************************************/
+void TextureCompressor::DecodeColorBlock(const unsigned char* block, bool bFourColorOnly, unsigned char* texels)
+{
+	unsigned short packed0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short packed1 = (unsigned short)(block[2] | (block[3] << 8));
+	bool bFourColor = (bFourColorOnly == true) || (packed0 > packed1);
+
+	int palette[4][3];
+	BuildColorPalette(packed0, packed1, bFourColor, palette);
+
+	unsigned int indexBits = (unsigned int)block[4] | ((unsigned int)block[5] << 8) |
+		((unsigned int)block[6] << 16) | ((unsigned int)block[7] << 24);
+	for (int i = 0; i < 16; i++)
+	{
+		int index = (indexBits >> (i * 2)) & 3;
+		texels[i * 4 + 0] = (unsigned char)palette[index][0];
+		texels[i * 4 + 1] = (unsigned char)palette[index][1];
+		texels[i * 4 + 2] = (unsigned char)palette[index][2];
+		texels[i * 4 + 3] = ((bFourColor == false) && (index == 3)) ? 0 : 255;
+	}
+}
+
+/***********************************************************
+ *  DecodeAlphaBlock()
+ *
+ *  This method is used for decoding a BC3 alpha block into
+ *  the alpha of 16 RGBA texels.
+ ***********************************************************/
+void TextureCompressor::DecodeAlphaBlock(const unsigned char* block, unsigned char* texels)
+{
+	int palette[8];
+	BuildAlphaPalette(block[0], block[1], palette);
+
+	BIT_READER reader = { block, 16 };
+	for (int i = 0; i < 16; i++)
+	{
+		texels[i * 4 + 3] = (unsigned char)palette[reader.Read(3)];
+	}
+}
+
+/***********************************************************
+ *  DecodeBC7Block()
+ *
+ *  This method is used for decoding a BC7 block into 16 RGBA
+ *  texels.  Only mode 6 is decoded, since it is the only
+ *  mode the encoder writes - other modes decode to magenta.
+ ***********************************************************/
+void TextureCompressor::DecodeBC7Block(const unsigned char* block, unsigned char* texels)
+{
+	if ((block[0] & 0x7F) != (1 << 6))
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			texels[i * 4 + 0] = 255;
+			texels[i * 4 + 1] = 0;
+			texels[i * 4 + 2] = 255;
+			texels[i * 4 + 3] = 255;
+		}
+		return;
+	}
+
+	BIT_READER reader = { block, 7 };
+	int endpoint[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		endpoint[0][c] = (int)reader.Read(7);
+		endpoint[1][c] = (int)reader.Read(7);
+	}
+	int pBit0 = (int)reader.Read(1);
+	int pBit1 = (int)reader.Read(1);
+	for (int c = 0; c < 4; c++)
+	{
+		endpoint[0][c] = (endpoint[0][c] << 1) | pBit0;
+		endpoint[1][c] = (endpoint[1][c] << 1) | pBit1;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		int weight = g_BC7Weights[reader.Read((i == 0) ? 3 : 4)];
+		for (int c = 0; c < 4; c++)
+		{
+			texels[i * 4 + c] = (unsigned char)(((64 - weight) * endpoint[0][c] + weight * endpoint[1][c] + 32) >> 6);
+		}
+	}
+}
+
+/***********************************************************
+ *  RunCompressionBenchmark()
+ *
+ *  This method is used for timing every encoder at both
+ *  quality settings on two of the scene textures, and for
+ *  printing the encode speed and the PSNR of the result.
+ ***********************************************************/
+void TextureCompressor::RunCompressionBenchmark()
+{
+	const char* filenames[] = { "textures/carrot_cake.jpg", "textures/tablecloth.jpg" };
+	const TEXTURE_FORMAT formats[] = { FORMAT_BC1, FORMAT_BC3, FORMAT_BC7 };
+	const ENCODE_QUALITY qualities[] = { QUALITY_FAST, QUALITY_HIGH };
+
+	std::cout << "Texture compression benchmark" << std::endl;
+
+	for (int f = 0; f < (int)(sizeof(filenames) / sizeof(filenames[0])); f++)
+	{
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		unsigned char* image = stbi_load(filenames[f], &width, &height, &channels, 0);
+		if (image == NULL)
+		{
+			std::cout << "Could not load image:" << filenames[f] << std::endl;
+			continue;
+		}
+		if ((channels != 3) && (channels != 4))
+		{
+			std::cout << "Not implemented to handle image with " << channels << " channels" << std::endl;
+			stbi_image_free(image);
+			continue;
+		}
+
+		std::cout << "  image:" << filenames[f] << ", width:" << width << ", height:" << height
+			<< ", uncompressed bytes:" << (size_t)width * height * channels << std::endl;
+
+		for (int i = 0; i < (int)(sizeof(formats) / sizeof(formats[0])); i++)
+		{
+			for (int q = 0; q < (int)(sizeof(qualities) / sizeof(qualities[0])); q++)
+			{
+				std::vector<unsigned char> blocks(GetLevelSize(formats[i], width, height));
+
+				std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+				Compress(image, width, height, channels, formats[i], qualities[q], blocks.data());
+				double milliseconds = std::chrono::duration<double, std::milli>(
+					std::chrono::high_resolution_clock::now() - startTime).count();
+
+				std::cout << "    " << GetFormatName(formats[i])
+					<< ((qualities[q] == QUALITY_HIGH) ? " high" : " fast")
+					<< ", ms:" << milliseconds
+					<< ", Mpixels/s:" << ((double)width * height / 1000.0) / std::max(milliseconds, 0.001)
+					<< ", bytes:" << blocks.size()
+					<< ", PSNR dB:" << ComputePSNR(image, width, height, channels, blocks.data(), formats[i]) << std::endl;
+			}
+		}
+
+		stbi_image_free(image);
+	}
+}
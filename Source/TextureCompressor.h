@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureCompressor.h
+// ============
+// encode texture images into BC1, BC3 and BC7 compressed blocks
+//
+//  Each 4x4 block of texels is reduced to two endpoint colors and a
+//  set of indices that select colors interpolated between them.  The
+//  endpoints are fitted along the principal axis of the block colors,
+//  and the high quality setting refines them with a least squares fit
+//  to the chosen indices.  The decoders are used to measure the PSNR
+//  of the encoded blocks against the source texels.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <cstddef>
+
+// texel formats a texture can be stored and uploaded in
+enum TEXTURE_FORMAT
+{
+	FORMAT_RGB8 = 0,
+	FORMAT_RGBA8 = 1,
+	FORMAT_BC1 = 2,
+	FORMAT_BC3 = 3,
+	FORMAT_BC7 = 4
+};
+
+// which compressed formats textures are encoded into
+enum TEXTURE_COMPRESSION
+{
+	COMPRESSION_NONE = 0,
+	// BC1 for RGB images and BC3 for RGBA images
+	COMPRESSION_BC1_BC3,
+	// BC7 for all images
+	COMPRESSION_BC7
+};
+
+// time spent fitting the endpoints of each block
+enum ENCODE_QUALITY
+{
+	QUALITY_FAST = 0,
+	QUALITY_HIGH
+};
+
+/***********************************************************
+ *  TextureCompressor
+ *
+ *  This class contains the CPU block encoders and decoders.
+ *  It keeps no state, so it can be used from several threads
+ *  at once.
+ ***********************************************************/
+class TextureCompressor
+{
+public:
+	// format an image with the passed in channels is stored in
+	static TEXTURE_FORMAT ChooseFormat(int channels, TEXTURE_COMPRESSION compression);
+	// whether the format is made of 4x4 blocks
+	static bool IsCompressed(TEXTURE_FORMAT format);
+	// bytes needed for one mip level in the format
+	static size_t GetLevelSize(TEXTURE_FORMAT format, int width, int height);
+
+	// encode 3 or 4 channel texels into compressed blocks
+	static void Compress(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int channels,
+		TEXTURE_FORMAT format,
+		ENCODE_QUALITY quality,
+		unsigned char* blocks);
+	// decode compressed blocks into RGBA texels
+	static void Decompress(
+		const unsigned char* blocks,
+		int width,
+		int height,
+		TEXTURE_FORMAT format,
+		unsigned char* rgbaPixels);
+	// peak signal to noise ratio in dB of the blocks against the texels
+	static double ComputePSNR(
+		const unsigned char* pixels,
+		int width,
+		int height,
+		int channels,
+		const unsigned char* blocks,
+		TEXTURE_FORMAT format);
+
+	// time each encoder and quality on the scene textures and
+	// print the speed and PSNR - no OpenGL context is needed
+	static void RunCompressionBenchmark();
+
+private:
+	// encode the color of a block of RGBA texels as BC1
+	static void EncodeColorBlock(const unsigned char* texels, ENCODE_QUALITY quality, unsigned char* block);
+	// encode the alpha of a block of RGBA texels as a BC3 alpha block
+	static void EncodeAlphaBlock(const unsigned char* texels, ENCODE_QUALITY quality, unsigned char* block);
+	// encode a block of RGBA texels as BC7 mode 6
+	static void EncodeBC7Block(const unsigned char* texels, ENCODE_QUALITY quality, unsigned char* block);
+
+	// decode a BC1 color block - BC3 color blocks always use four colors
+	static void DecodeColorBlock(const unsigned char* block, bool bFourColorOnly, unsigned char* texels);
+	static void DecodeAlphaBlock(const unsigned char* block, unsigned char* texels);
+	static void DecodeBC7Block(const unsigned char* block, unsigned char* texels);
+};
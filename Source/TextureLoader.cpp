@@ -0,0 +1,302 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.cpp
+// ============
+// decode texture images on worker threads and upload them as they finish
+//
+//  A texture showing the placeholder is added to the texture arrays as
+//  soon as it is requested, so the scene can render right away.  The
+//  image files are loaded in parallel by a pool of worker threads,
+//  through the texture cache when it is current, and the main thread
+//  stores the finished mip chains in the texture arrays.  Textures are
+//  loaded again the same way when evicted levels are streamed back in.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureLoader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// declaration of the loader settings
+namespace
+{
+	// most worker threads started when the count is picked from the CPU
+	const int g_MaxWorkers = 8;
+}
+
+/***********************************************************
+ *  TextureLoader()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureLoader::TextureLoader(TextureArrays* pTextureArrays, int workerCount)
+{
+	m_pTextureArrays = pTextureArrays;
+	m_bStopping = false;
+	m_pendingCount = 0;
+	m_streamingCount = 0;
+	m_requestedCount = 0;
+	m_compression = COMPRESSION_NONE;
+
+	// leave one core for the main thread
+	if (workerCount <= 0)
+	{
+		workerCount = std::min(std::max((int)std::thread::hardware_concurrency() - 1, 1), g_MaxWorkers);
+	}
+
+	for (int i = 0; i < workerCount; i++)
+	{
+		m_workers.push_back(std::thread(&TextureLoader::WorkerLoop, this));
+	}
+}
+
+/***********************************************************
+ *  ~TextureLoader()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureLoader::~TextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+		m_jobs.clear();
+	}
+	m_jobAvailable.notify_all();
+
+	for (int i = 0; i < (int)m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	// free any images that were never uploaded
+	for (int i = 0; i < (int)m_decodedImages.size(); i++)
+	{
+		ReleaseImage(m_decodedImages[i]);
+	}
+	m_decodedImages.clear();
+	m_pTextureArrays = NULL;
+}
+
+/***********************************************************
+ *  RequestTexture()
+ *
+ *  This method is used for adding a texture that shows the
+ *  placeholder and queueing the image file to be decoded by
+ *  the workers.
+ ***********************************************************/
+int TextureLoader::RequestTexture(const std::string& filename)
+{
+	int textureIndex = m_pTextureArrays->AddTexture();
+
+	if (m_requestedCount == 0)
+	{
+		m_firstRequestTime = std::chrono::steady_clock::now();
+	}
+	m_requestedCount++;
+	m_pendingCount++;
+
+	DECODE_JOB job;
+	job.textureIndex = textureIndex;
+	job.filename = filename;
+	job.compression = m_compression;
+	job.bStreaming = false;
+	if (textureIndex >= (int)m_sources.size())
+	{
+		m_sources.resize(textureIndex + 1);
+	}
+	m_sources[textureIndex] = job;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+	}
+	m_jobAvailable.notify_one();
+
+	return(textureIndex);
+}
+
+/***********************************************************
+ *  WorkerLoop()
+ *
+ *  This method is run by every worker thread.  It loads the
+ *  texels of queued image files and hands them to the main
+ *  thread.
+ ***********************************************************/
+void TextureLoader::WorkerLoop()
+{
+	while (true)
+	{
+		DECODE_JOB job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this] { return((m_bStopping == true) || (m_jobs.size() > 0)); });
+			if (m_bStopping == true)
+			{
+				return;
+			}
+			job = m_jobs.front();
+			m_jobs.pop_front();
+		}
+
+		DECODED_IMAGE image;
+		image.textureIndex = job.textureIndex;
+		image.filename = job.filename;
+		image.bStreaming = job.bStreaming;
+		image.pTexture = new TextureCache::TEXTURE_DATA();
+		if (TextureCache::LoadTexture(job.filename, job.compression, *image.pTexture) == false)
+		{
+			ReleaseImage(image);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_decodedImages.push_back(image);
+		}
+		m_imageDecoded.notify_one();
+	}
+}
+
+/***********************************************************
+ *  ReleaseImage()
+ *
+ *  This method is used for freeing the texels of a loaded
+ *  image.
+ ***********************************************************/
+void TextureLoader::ReleaseImage(DECODED_IMAGE& image)
+{
+	if (image.pTexture != NULL)
+	{
+		TextureCache::ReleaseTexture(*image.pTexture);
+		delete image.pTexture;
+		image.pTexture = NULL;
+	}
+}
+
+/***********************************************************
+ *  StoreImage()
+ *
+ *  This method is used for storing the mip chain of a
+ *  loaded image in the texture arrays.
+ ***********************************************************/
+void TextureLoader::StoreImage(const DECODED_IMAGE& image)
+{
+	if (image.pTexture == NULL)
+	{
+		std::cout << "Could not load image:" << image.filename << std::endl;
+		if (image.bStreaming == true)
+		{
+			m_pTextureArrays->AbortStream(image.textureIndex);
+		}
+		return;
+	}
+
+	const TextureCache::TEXTURE_DATA& texture = *image.pTexture;
+	if (image.bStreaming == true)
+	{
+		m_pTextureArrays->StreamTexture(image.textureIndex, texture);
+		return;
+	}
+
+	if (m_pTextureArrays->StoreTexture(image.textureIndex, texture) == false)
+	{
+		std::cout << "Could not store image:" << image.filename << std::endl;
+		return;
+	}
+
+	std::cout << "Successfully loaded image:" << image.filename << ", width:" << texture.width << ", height:" << texture.height << ", channels:" << texture.channels << (texture.bFromCache ? ", from cache" : "") << std::endl;
+}
+
+/***********************************************************
+ *  ProcessCompletedLoads()
+ *
+ *  This method is used for storing the images the workers
+ *  have finished decoding, both requested textures and
+ *  streamed levels.  It never waits for a decode.
+ ***********************************************************/
+int TextureLoader::ProcessCompletedLoads(int maxUploads)
+{
+	int uploadCount = 0;
+
+	while ((m_pendingCount + m_streamingCount > 0) && (uploadCount < maxUploads))
+	{
+		DECODED_IMAGE image;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_decodedImages.size() == 0)
+			{
+				break;
+			}
+			image = m_decodedImages.front();
+			m_decodedImages.pop_front();
+		}
+
+		StoreImage(image);
+		ReleaseImage(image);
+		uploadCount++;
+		if (image.bStreaming == true)
+		{
+			m_streamingCount--;
+			continue;
+		}
+		m_pendingCount--;
+
+		if (m_pendingCount == 0)
+		{
+			double loadMilliseconds = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - m_firstRequestTime).count();
+			std::cout << "Finished loading " << m_requestedCount << " textures in " << loadMilliseconds << " ms" << std::endl;
+		}
+	}
+
+	return(uploadCount);
+}
+
+/***********************************************************
+ *  FinishPendingLoads()
+ *
+ *  This method is used for waiting until every requested
+ *  texture is decoded and stored.
+ ***********************************************************/
+int TextureLoader::FinishPendingLoads()
+{
+	int uploadCount = 0;
+
+	while (m_pendingCount > 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_imageDecoded.wait(lock, [this] { return(m_decodedImages.size() > 0); });
+		}
+		uploadCount += ProcessCompletedLoads(m_pendingCount + m_streamingCount);
+	}
+
+	return(uploadCount);
+}
+
+/***********************************************************
+ *  RequestLevels()
+ *
+ *  This method is used for queueing the image file of a
+ *  stored texture to be loaded again by the workers, so the
+ *  levels its array is missing can be streamed in.  With a
+ *  current cache file this only maps the stored levels.
+ ***********************************************************/
+bool TextureLoader::RequestLevels(int textureIndex)
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_sources.size()) || (m_sources[textureIndex].filename.size() == 0))
+	{
+		return(false);
+	}
+
+	DECODE_JOB job = m_sources[textureIndex];
+	job.bStreaming = true;
+	m_streamingCount++;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(job);
+	}
+	m_jobAvailable.notify_one();
+
+	return(true);
+}
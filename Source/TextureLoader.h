@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureLoader.h
+// ============
+// decode texture images on worker threads and upload them as they finish
+//
+//  A texture showing the placeholder is added to the texture arrays as
+//  soon as it is requested, so the scene can render right away.  The
+//  image files are loaded in parallel by a pool of worker threads,
+//  through the texture cache when it is current, and the main thread
+//  stores the finished mip chains in the texture arrays.  Textures are
+//  loaded again the same way when evicted levels are streamed back in.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "TextureArrays.h"
+#include "TextureCache.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/***********************************************************
+ *  TextureLoader
+ *
+ *  This class contains the worker thread pool that decodes
+ *  the image files and the code for storing the decoded
+ *  images in the texture arrays.
+ ***********************************************************/
+class TextureLoader
+{
+public:
+	// constructor - loaded textures are stored in the passed in
+	// arrays, and zero workers picks a count from the CPU
+	TextureLoader(TextureArrays* pTextureArrays, int workerCount = 0);
+	// destructor
+	~TextureLoader();
+
+	// most finished images uploaded in one call during rendering
+	static const int MAX_UPLOADS_PER_FRAME = 4;
+
+	// add a texture showing the placeholder and queue the image file
+	// for decoding - the returned texture index stays valid once loaded
+	int RequestTexture(const std::string& filename);
+
+	// store up to the passed in number of finished images and
+	// return how many textures were stored
+	int ProcessCompletedLoads(int maxUploads);
+	// wait for every requested texture to be decoded and stored
+	int FinishPendingLoads();
+
+	// load a stored texture again and stream the levels its array
+	// is missing into its layer
+	bool RequestLevels(int textureIndex);
+
+	// number of requested textures that are not stored yet
+	int GetPendingCount() const { return(m_pendingCount); }
+	// number of textures whose levels are still streaming in
+	int GetStreamingCount() const { return(m_streamingCount); }
+
+	// choose the compressed formats later requests are stored in
+	void SetCompression(TEXTURE_COMPRESSION compression) { m_compression = compression; }
+	TEXTURE_COMPRESSION GetCompression() const { return(m_compression); }
+
+private:
+	// an image file waiting to be decoded - streaming jobs load
+	// the levels of a texture that was already stored
+	struct DECODE_JOB
+	{
+		int textureIndex;
+		std::string filename;
+		TEXTURE_COMPRESSION compression;
+		bool bStreaming;
+	};
+
+	// a loaded image waiting to be stored - no texture data
+	// means the image could not be loaded
+	struct DECODED_IMAGE
+	{
+		int textureIndex;
+		std::string filename;
+		bool bStreaming;
+		TextureCache::TEXTURE_DATA* pTexture;
+	};
+
+	// worker threads and the queues they share with the main thread
+	std::vector<std::thread> m_workers;
+	std::deque<DECODE_JOB> m_jobs;
+	std::deque<DECODED_IMAGE> m_decodedImages;
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_imageDecoded;
+	bool m_bStopping;
+
+	// requested textures that are not stored yet - main thread only
+	int m_pendingCount;
+	int m_streamingCount;
+	int m_requestedCount;
+	std::chrono::steady_clock::time_point m_firstRequestTime;
+	// arrays the loaded textures are stored in
+	TextureArrays* m_pTextureArrays;
+	// compressed formats new requests are stored in
+	TEXTURE_COMPRESSION m_compression;
+	// image file and formats of every requested texture, indexed
+	// by texture index, for loading its levels again
+	std::vector<DECODE_JOB> m_sources;
+
+	// load queued image files until the loader is destroyed
+	void WorkerLoop();
+	// store a loaded image in the texture arrays
+	void StoreImage(const DECODED_IMAGE& image);
+	// free the texels of a loaded image
+	static void ReleaseImage(DECODED_IMAGE& image);
+};
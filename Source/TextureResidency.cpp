@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureResidency.cpp
+// ============
+// keep the texture arrays within a memory budget by streaming mip levels
+//
+//  Every frame the objects drawn with each texture are projected with
+//  the camera to estimate the finest mip level the texture needs.  The
+//  arrays are then fit to those levels: levels that are needed again are
+//  streamed in on the loader workers, and levels nothing needs are
+//  evicted once they have gone unused for a while.  When the needed
+//  levels do not fit the budget, the largest levels are dropped first.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+/***********************************************************
+ *  TextureResidency()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureResidency::TextureResidency(TextureArrays* pTextureArrays, TextureLoader* pTextureLoader)
+{
+	m_pTextureArrays = pTextureArrays;
+	m_pTextureLoader = pTextureLoader;
+	m_budgetBytes = 0;
+	m_cameraView = CAMERA_VIEW();
+	m_evictionCount = 0;
+	m_streamInCount = 0;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a frame.  Textures no
+ *  object uses this frame need only their smallest level.
+ ***********************************************************/
+void TextureResidency::BeginFrame(const CAMERA_VIEW& cameraView)
+{
+	m_cameraView = cameraView;
+	m_neededLevels.assign(m_pTextureArrays->GetTextureCount(), INT_MAX);
+}
+
+/***********************************************************
+ *  AddTextureUse()
+ *
+ *  This method is used for estimating the finest mip level
+ *  an object needs from its projected size.  The projection
+ *  scale turns the largest extent of the object into pixels
+ *  at its distance from the camera, and every halving of the
+ *  texels spread across those pixels is one level coarser.
+ *  The distance rather than the depth is used, so the level
+ *  does not change as the camera turns.
+ ***********************************************************/
+void TextureResidency::AddTextureUse(int textureIndex, const glm::mat4& model, glm::vec2 uvScale)
+{
+	if ((textureIndex < 0) || (textureIndex >= (int)m_neededLevels.size()))
+	{
+		return;
+	}
+	int arrayIndex = m_pTextureArrays->FindArrayIndex(textureIndex);
+	if (arrayIndex < 0)
+	{
+		return;
+	}
+	TextureArrays::ARRAY_RESIDENCY residency = m_pTextureArrays->GetResidency(arrayIndex);
+	if (residency.bStreamable == false)
+	{
+		return;
+	}
+
+	float objectSize = std::max(glm::length(glm::vec3(model[0])),
+		std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	float pixels = objectSize * m_cameraView.projection[1][1] * 0.5f * (float)m_cameraView.viewportHeight;
+	if (m_cameraView.bOrthographic == false)
+	{
+		glm::vec3 offset = glm::vec3(model[3]) - m_cameraView.position;
+		pixels /= std::max(glm::length(offset), m_cameraView.nearPlane);
+	}
+
+	int level = 0;
+	float texels = (float)std::max(residency.width, residency.height) * std::max(std::max(uvScale.x, uvScale.y), 1.0f);
+	if (pixels < texels)
+	{
+		level = (pixels > 0.0f) ? (int)std::floor(std::log2(texels / pixels)) : residency.levelCount - 1;
+	}
+	level = std::min(std::max(level, 0), residency.maximumResidentLevel);
+
+	m_neededLevels[textureIndex] = std::min(m_neededLevels[textureIndex], level);
+}
+
+/***********************************************************
+ *  StreamArray()
+ *
+ *  This method is used for adding levels to an array and
+ *  asking the loader for the levels of each of its layers.
+ ***********************************************************/
+void TextureResidency::StreamArray(int arrayIndex, int residentLevel)
+{
+	int oldResidentLevel = m_pTextureArrays->GetResidency(arrayIndex).residentLevel;
+	if (m_pTextureArrays->SetResidentLevel(arrayIndex, residentLevel) == false)
+	{
+		return;
+	}
+	m_streamInCount += oldResidentLevel - m_pTextureArrays->GetResidency(arrayIndex).residentLevel;
+
+	for (int i = 0; i < m_pTextureArrays->GetTextureCount(); i++)
+	{
+		if (m_pTextureArrays->FindArrayIndex(i) == arrayIndex)
+		{
+			if (m_pTextureLoader->RequestLevels(i) == false)
+			{
+				m_pTextureArrays->AbortStream(i);
+				break;
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for fitting the arrays to the levels
+ *  their textures need this frame.  Every array shares one
+ *  level count across its layers, so it needs the finest
+ *  level any of its textures needs.  While the total is over
+ *  the budget, the array whose first level is largest drops
+ *  it.  Levels the budget forces out are evicted at once,
+ *  levels that are just unused after a delay, and missing
+ *  levels are streamed in.  Arrays that are still streaming
+ *  are left as they are.
+ ***********************************************************/
+bool TextureResidency::Update()
+{
+	int arrayCount = m_pTextureArrays->GetArrayCount();
+	m_unneededFrames.resize(arrayCount, 0);
+
+	std::vector<TextureArrays::ARRAY_RESIDENCY> residency(arrayCount);
+	std::vector<int> neededLevels(arrayCount);
+	for (int i = 0; i < arrayCount; i++)
+	{
+		residency[i] = m_pTextureArrays->GetResidency(i);
+		neededLevels[i] = residency[i].maximumResidentLevel;
+	}
+	for (int i = 0; i < (int)m_neededLevels.size(); i++)
+	{
+		int arrayIndex = m_pTextureArrays->FindArrayIndex(i);
+		if ((arrayIndex >= 0) && (m_neededLevels[i] != INT_MAX))
+		{
+			neededLevels[arrayIndex] = std::min(neededLevels[arrayIndex], m_neededLevels[i]);
+		}
+	}
+
+	// the arrays that cannot change count at their current levels
+	std::vector<int> targetLevels(arrayCount);
+	size_t totalBytes = 0;
+	for (int i = 0; i < arrayCount; i++)
+	{
+		bool bFixed = (residency[i].bStreamable == false) || (residency[i].bStreaming == true);
+		targetLevels[i] = (bFixed == true) ? residency[i].residentLevel : neededLevels[i];
+		totalBytes += m_pTextureArrays->GetStorageBytes(i, targetLevels[i]);
+	}
+
+	// drop the largest levels until the arrays fit the budget
+	while ((m_budgetBytes > 0) && (totalBytes > m_budgetBytes))
+	{
+		int largestArray = -1;
+		size_t largestBytes = 0;
+		for (int i = 0; i < arrayCount; i++)
+		{
+			if ((residency[i].bStreamable == false) || (residency[i].bStreaming == true) ||
+				(targetLevels[i] >= residency[i].maximumResidentLevel))
+			{
+				continue;
+			}
+			size_t levelBytes = m_pTextureArrays->GetStorageBytes(i, targetLevels[i]) -
+				m_pTextureArrays->GetStorageBytes(i, targetLevels[i] + 1);
+			if (levelBytes > largestBytes)
+			{
+				largestArray = i;
+				largestBytes = levelBytes;
+			}
+		}
+		if (largestArray < 0)
+		{
+			break;
+		}
+		targetLevels[largestArray]++;
+		totalBytes -= largestBytes;
+	}
+
+	bool bChanged = false;
+
+	// evict first so the memory is free before anything streams in
+	for (int i = 0; i < arrayCount; i++)
+	{
+		if ((residency[i].bStreamable == false) || (residency[i].bStreaming == true) ||
+			(targetLevels[i] <= residency[i].residentLevel))
+		{
+			m_unneededFrames[i] = 0;
+			continue;
+		}
+
+		// levels the budget still leaves room for wait to be evicted
+		bool bOverBudget = (targetLevels[i] > neededLevels[i]) ||
+			((m_budgetBytes > 0) && (m_pTextureArrays->GetResidentBytes() > m_budgetBytes));
+		m_unneededFrames[i]++;
+		if ((bOverBudget == false) && (m_unneededFrames[i] < EVICTION_DELAY_FRAMES))
+		{
+			continue;
+		}
+
+		if (m_pTextureArrays->SetResidentLevel(i, targetLevels[i]) == true)
+		{
+			m_evictionCount += targetLevels[i] - residency[i].residentLevel;
+			m_unneededFrames[i] = 0;
+			bChanged = true;
+		}
+	}
+
+	// then stream in the levels that are needed and fit
+	for (int i = 0; i < arrayCount; i++)
+	{
+		if ((residency[i].bStreamable == true) && (residency[i].bStreaming == false) &&
+			(targetLevels[i] < residency[i].residentLevel))
+		{
+			StreamArray(i, targetLevels[i]);
+			bChanged = true;
+		}
+	}
+
+	return(bChanged);
+}
@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// TextureResidency.h
+// ============
+// keep the texture arrays within a memory budget by streaming mip levels
+//
+//  Every frame the objects drawn with each texture are projected with
+//  the camera to estimate the finest mip level the texture needs.  The
+//  arrays are then fit to those levels: levels that are needed again are
+//  streamed in on the loader workers, and levels nothing needs are
+//  evicted once they have gone unused for a while.  When the needed
+//  levels do not fit the budget, the largest levels are dropped first.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "TextureArrays.h"
+#include "TextureLoader.h"
+#include "CameraView.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  TextureResidency
+ *
+ *  This class contains the code for choosing the resident
+ *  mip levels of every texture array and the counters of
+ *  the streaming it causes.
+ ***********************************************************/
+class TextureResidency
+{
+public:
+	// constructor - the residency of the passed in arrays is managed,
+	// and evicted levels are streamed back in through the loader
+	TextureResidency(TextureArrays* pTextureArrays, TextureLoader* pTextureLoader);
+
+	// frames an unneeded level stays resident before it is evicted,
+	// so levels are not thrown away while the camera turns around
+	static const int EVICTION_DELAY_FRAMES = 120;
+
+	// set the most memory the texture arrays may use, zero for no limit
+	void SetBudget(size_t budgetBytes) { m_budgetBytes = budgetBytes; }
+	size_t GetBudget() const { return(m_budgetBytes); }
+
+	// start collecting the levels needed by the objects of a frame
+	void BeginFrame(const CAMERA_VIEW& cameraView);
+	// note an object drawn with a texture this frame
+	void AddTextureUse(int textureIndex, const glm::mat4& model, glm::vec2 uvScale);
+	// fit the arrays to the needed levels and the budget, and
+	// return true when any array was reallocated
+	bool Update();
+
+	// memory used by the texture arrays
+	size_t GetResidentBytes() const { return(m_pTextureArrays->GetResidentBytes()); }
+	// textures whose streamed levels are not uploaded yet
+	int GetPendingUploads() const { return(m_pTextureLoader->GetStreamingCount()); }
+	// levels evicted and streamed in since the scene was prepared
+	int GetEvictionCount() const { return(m_evictionCount); }
+	int GetStreamInCount() const { return(m_streamInCount); }
+
+private:
+	// arrays managed, and the loader streaming their levels
+	TextureArrays* m_pTextureArrays;
+	TextureLoader* m_pTextureLoader;
+	size_t m_budgetBytes;
+	// camera the needed levels of this frame are estimated for
+	CAMERA_VIEW m_cameraView;
+	// finest level needed by each texture this frame
+	std::vector<int> m_neededLevels;
+	// frames each array has held levels that nothing needed
+	std::vector<int> m_unneededFrames;
+	int m_evictionCount;
+	int m_streamInCount;
+
+	// stream the missing levels of every texture in an array
+	void StreamArray(int arrayIndex, int residentLevel);
+};
@@ -0,0 +1,438 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformCache.cpp
+// ============
+// keep the model matrices of the scene objects and rebuild only moved ones
+//
+//  Each object stores its scale, rotation and position, with the rotation
+//  turned into a quaternion once when the transform is set, so no sines
+//  or cosines are taken while the matrices are built.  The values are
+//  kept as separate arrays of each component, and the matrices of four
+//  objects at a time are written straight from them with SSE
+//  instructions.  Only the groups of four holding an object whose
+//  transform changed since the last update are built again.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformCache.h"
+
+#include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+// SSE is part of every x64 target and of x86 targets built for it
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define TRANSFORM_CACHE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+/***********************************************************
+ *  TransformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransformCache::TransformCache()
+{
+	m_objectCount = 0;
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every object.
+ ***********************************************************/
+void TransformCache::Clear()
+{
+	m_positionX.clear();
+	m_positionY.clear();
+	m_positionZ.clear();
+	m_rotationX.clear();
+	m_rotationY.clear();
+	m_rotationZ.clear();
+	m_rotationW.clear();
+	m_scaleX.clear();
+	m_scaleY.clear();
+	m_scaleZ.clear();
+	m_models.clear();
+	m_objectDirty.clear();
+	m_blockDirty.clear();
+	m_dirtyObjects.clear();
+	m_dirtyBlocks.clear();
+	m_updatedObjects.clear();
+	m_objectCount = 0;
+}
+
+/***********************************************************
+ *  SetTransform()
+ *
+ *  This method is used for setting the transform of an
+ *  object and marking it to be built at the next update.
+ *  The arrays grow in steps of four, and the unused entries
+ *  at the end are built but never reported.
+ ***********************************************************/
+void TransformCache::SetTransform(
+	int objectIndex,
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	if (objectIndex < 0)
+	{
+		return;
+	}
+
+	if (objectIndex >= m_objectCount)
+	{
+		m_objectCount = objectIndex + 1;
+		size_t paddedCount = ((size_t)m_objectCount + 3) & ~(size_t)3;
+		m_positionX.resize(paddedCount, 0.0f);
+		m_positionY.resize(paddedCount, 0.0f);
+		m_positionZ.resize(paddedCount, 0.0f);
+		m_rotationX.resize(paddedCount, 0.0f);
+		m_rotationY.resize(paddedCount, 0.0f);
+		m_rotationZ.resize(paddedCount, 0.0f);
+		m_rotationW.resize(paddedCount, 1.0f);
+		m_scaleX.resize(paddedCount, 1.0f);
+		m_scaleY.resize(paddedCount, 1.0f);
+		m_scaleZ.resize(paddedCount, 1.0f);
+		m_models.resize(paddedCount, glm::mat4(1.0f));
+		m_objectDirty.resize(m_objectCount, 0);
+		m_blockDirty.resize(paddedCount / 4, 0);
+	}
+
+	glm::vec4 rotation = EulerToQuaternion(XrotationDegrees, YrotationDegrees, ZrotationDegrees);
+	m_positionX[objectIndex] = positionXYZ.x;
+	m_positionY[objectIndex] = positionXYZ.y;
+	m_positionZ[objectIndex] = positionXYZ.z;
+	m_rotationX[objectIndex] = rotation.x;
+	m_rotationY[objectIndex] = rotation.y;
+	m_rotationZ[objectIndex] = rotation.z;
+	m_rotationW[objectIndex] = rotation.w;
+	m_scaleX[objectIndex] = scaleXYZ.x;
+	m_scaleY[objectIndex] = scaleXYZ.y;
+	m_scaleZ[objectIndex] = scaleXYZ.z;
+
+	if (m_objectDirty[objectIndex] == 0)
+	{
+		m_objectDirty[objectIndex] = 1;
+		m_dirtyObjects.push_back(objectIndex);
+	}
+	int block = objectIndex / 4;
+	if (m_blockDirty[block] == 0)
+	{
+		m_blockDirty[block] = 1;
+		m_dirtyBlocks.push_back(block);
+	}
+}
+
+/***********************************************************
+ *  Update()
+ *
+ *  This method is used for building the matrices of the
+ *  groups of four holding a changed object.  The changed
+ *  objects are kept for the caller to copy their matrices.
+ ***********************************************************/
+int TransformCache::Update()
+{
+	m_updatedObjects.clear();
+	m_updatedObjects.swap(m_dirtyObjects);
+
+	for (int i = 0; i < (int)m_dirtyBlocks.size(); i++)
+	{
+		int block = m_dirtyBlocks[i];
+		ComposeBlockSIMD(block * 4);
+		m_blockDirty[block] = 0;
+	}
+	m_dirtyBlocks.clear();
+
+	for (int i = 0; i < (int)m_updatedObjects.size(); i++)
+	{
+		m_objectDirty[m_updatedObjects[i]] = 0;
+	}
+
+	return((int)m_updatedObjects.size());
+}
+
+/***********************************************************
+ *  EulerToQuaternion()
+ *
+ *  This method is used for turning rotations about X, then
+ *  Y, then Z into one quaternion, matching the product of
+ *  the three rotation matrices.  The product of the three
+ *  single axis quaternions is written out, so only the sines
+ *  and cosines of the half angles are taken.
+ ***********************************************************/
+glm::vec4 TransformCache::EulerToQuaternion(float XrotationDegrees, float YrotationDegrees, float ZrotationDegrees)
+{
+	float halfX = glm::radians(XrotationDegrees) * 0.5f;
+	float halfY = glm::radians(YrotationDegrees) * 0.5f;
+	float halfZ = glm::radians(ZrotationDegrees) * 0.5f;
+	float sinX = sinf(halfX);
+	float cosX = cosf(halfX);
+	float sinY = sinf(halfY);
+	float cosY = cosf(halfY);
+	float sinZ = sinf(halfZ);
+	float cosZ = cosf(halfZ);
+
+	return(glm::vec4(
+		sinX * cosY * cosZ + cosX * sinY * sinZ,
+		cosX * sinY * cosZ - sinX * cosY * sinZ,
+		cosX * cosY * sinZ + sinX * sinY * cosZ,
+		cosX * cosY * cosZ - sinX * sinY * sinZ));
+}
+
+/***********************************************************
+ *  ComposeModel()
+ *
+ *  This method is used for building the model matrix from a
+ *  scale, a quaternion and a position.  The columns of the
+ *  rotation matrix are written scaled, and the position is
+ *  the last column, so no matrices are multiplied.
+ ***********************************************************/
+glm::mat4 TransformCache::ComposeModel(glm::vec3 scaleXYZ, const glm::vec4& rotation, glm::vec3 positionXYZ)
+{
+	float xx = rotation.x * rotation.x;
+	float yy = rotation.y * rotation.y;
+	float zz = rotation.z * rotation.z;
+	float xy = rotation.x * rotation.y;
+	float xz = rotation.x * rotation.z;
+	float yz = rotation.y * rotation.z;
+	float wx = rotation.w * rotation.x;
+	float wy = rotation.w * rotation.y;
+	float wz = rotation.w * rotation.z;
+
+	glm::mat4 model;
+	model[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * scaleXYZ.x;
+	model[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * scaleXYZ.y;
+	model[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * scaleXYZ.z;
+	model[3] = glm::vec4(positionXYZ, 1.0f);
+
+	return(model);
+}
+
+/***********************************************************
+ *  ComposeBlockScalar()
+ *
+ *  This method is used for building the matrices of four
+ *  objects one at a time.
+ ***********************************************************/
+void TransformCache::ComposeBlockScalar(int firstObject)
+{
+	for (int i = firstObject; i < firstObject + 4; i++)
+	{
+		m_models[i] = ComposeModel(
+			glm::vec3(m_scaleX[i], m_scaleY[i], m_scaleZ[i]),
+			glm::vec4(m_rotationX[i], m_rotationY[i], m_rotationZ[i], m_rotationW[i]),
+			glm::vec3(m_positionX[i], m_positionY[i], m_positionZ[i]));
+	}
+}
+
+/***********************************************************
+ *  ComposeBlockSIMD()
+ *
+ *  This method is used for building the matrices of four
+ *  objects together.  Each matrix entry is found for the
+ *  four objects at once from the component arrays, and
+ *  every column is then transposed from one entry of four
+ *  objects into the four entries of one object.  Targets
+ *  without SSE build the matrices one at a time.
+ ***********************************************************/
+void TransformCache::ComposeBlockSIMD(int firstObject)
+{
+#if defined(TRANSFORM_CACHE_SSE)
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+
+	__m128 x = _mm_loadu_ps(&m_rotationX[firstObject]);
+	__m128 y = _mm_loadu_ps(&m_rotationY[firstObject]);
+	__m128 z = _mm_loadu_ps(&m_rotationZ[firstObject]);
+	__m128 w = _mm_loadu_ps(&m_rotationW[firstObject]);
+	__m128 scaleX = _mm_loadu_ps(&m_scaleX[firstObject]);
+	__m128 scaleY = _mm_loadu_ps(&m_scaleY[firstObject]);
+	__m128 scaleZ = _mm_loadu_ps(&m_scaleZ[firstObject]);
+
+	__m128 xx = _mm_mul_ps(x, x);
+	__m128 yy = _mm_mul_ps(y, y);
+	__m128 zz = _mm_mul_ps(z, z);
+	__m128 xy = _mm_mul_ps(x, y);
+	__m128 xz = _mm_mul_ps(x, z);
+	__m128 yz = _mm_mul_ps(y, z);
+	__m128 wx = _mm_mul_ps(w, x);
+	__m128 wy = _mm_mul_ps(w, y);
+	__m128 wz = _mm_mul_ps(w, z);
+
+	__m128 columns[4][4];
+	columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX);
+	columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX);
+	columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX);
+	columns[0][3] = _mm_setzero_ps();
+	columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY);
+	columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY);
+	columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY);
+	columns[1][3] = _mm_setzero_ps();
+	columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ);
+	columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ);
+	columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ);
+	columns[2][3] = _mm_setzero_ps();
+	columns[3][0] = _mm_loadu_ps(&m_positionX[firstObject]);
+	columns[3][1] = _mm_loadu_ps(&m_positionY[firstObject]);
+	columns[3][2] = _mm_loadu_ps(&m_positionZ[firstObject]);
+	columns[3][3] = one;
+
+	for (int c = 0; c < 4; c++)
+	{
+		_MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			_mm_storeu_ps(&m_models[firstObject + lane][c][0], columns[c][lane]);
+		}
+	}
+#else
+	ComposeBlockScalar(firstObject);
+#endif
+}
+
+/***********************************************************
+ *  RunTransformBenchmark()
+ *
+ *  This method is used for timing the ways of building the
+ *  model matrices of random objects - the five matrix
+ *  product the scene used to build, the one pass quaternion
+ *  build one object at a time and four at a time, and a
+ *  full update after every object changed.  The results are
+ *  checked against the five matrix product.
+ ***********************************************************/
+void TransformCache::RunTransformBenchmark()
+{
+	const int objectCounts[] = { 10000, 1000000 };
+
+	std::mt19937 generator(330);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> angle(-180.0f, 180.0f);
+	std::uniform_real_distribution<float> scale(0.1f, 4.0f);
+
+	std::cout << "Transform benchmark, ns per object" << std::endl;
+
+	for (int i = 0; i < (int)(sizeof(objectCounts) / sizeof(objectCounts[0])); i++)
+	{
+		int objectCount = objectCounts[i];
+		int repeatCount = std::max(1, 2000000 / objectCount);
+
+		std::vector<glm::vec3> scales(objectCount);
+		std::vector<glm::vec3> angles(objectCount);
+		std::vector<glm::vec3> positions(objectCount);
+		for (int j = 0; j < objectCount; j++)
+		{
+			scales[j] = glm::vec3(scale(generator), scale(generator), scale(generator));
+			angles[j] = glm::vec3(angle(generator), angle(generator), angle(generator));
+			positions[j] = glm::vec3(position(generator), position(generator), position(generator));
+		}
+
+		// the five matrix product with the angles in degrees
+		std::vector<glm::mat4> reference(objectCount);
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeatCount; r++)
+		{
+			for (int j = 0; j < objectCount; j++)
+			{
+				reference[j] = glm::translate(positions[j]) *
+					glm::rotate(glm::radians(angles[j].x), glm::vec3(1.0f, 0.0f, 0.0f)) *
+					glm::rotate(glm::radians(angles[j].y), glm::vec3(0.0f, 1.0f, 0.0f)) *
+					glm::rotate(glm::radians(angles[j].z), glm::vec3(0.0f, 0.0f, 1.0f)) *
+					glm::scale(scales[j]);
+			}
+		}
+		double productNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / repeatCount / objectCount;
+
+		// setting the transforms again takes the sines and cosines
+		// once for each change
+		TransformCache cache;
+		for (int j = 0; j < objectCount; j++)
+		{
+			cache.SetTransform(j, glm::vec3(1.0f), 0.0f, 0.0f, 0.0f, glm::vec3(0.0f));
+		}
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int j = 0; j < objectCount; j++)
+		{
+			cache.SetTransform(j, scales[j], angles[j].x, angles[j].y, angles[j].z, positions[j]);
+		}
+		double setNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / objectCount;
+		cache.Update();
+
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeatCount; r++)
+		{
+			for (int j = 0; j < objectCount; j += 4)
+			{
+				cache.ComposeBlockScalar(j);
+			}
+		}
+		double scalarNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / repeatCount / objectCount;
+		std::vector<glm::mat4> scalarModels = cache.m_models;
+
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < repeatCount; r++)
+		{
+			for (int j = 0; j < objectCount; j += 4)
+			{
+				cache.ComposeBlockSIMD(j);
+			}
+		}
+		double simdNanoseconds = std::chrono::duration<double, std::nano>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / repeatCount / objectCount;
+
+		// every object changed, including the cost of the dirty lists
+		double updateNanoseconds = 0.0;
+		for (int r = 0; r < repeatCount; r++)
+		{
+			for (int j = 0; j < objectCount; j++)
+			{
+				if (cache.m_objectDirty[j] == 0)
+				{
+					cache.m_objectDirty[j] = 1;
+					cache.m_dirtyObjects.push_back(j);
+				}
+				if (cache.m_blockDirty[j / 4] == 0)
+				{
+					cache.m_blockDirty[j / 4] = 1;
+					cache.m_dirtyBlocks.push_back(j / 4);
+				}
+			}
+			startTime = std::chrono::high_resolution_clock::now();
+			cache.Update();
+			updateNanoseconds += std::chrono::duration<double, std::nano>(
+				std::chrono::high_resolution_clock::now() - startTime).count();
+		}
+		updateNanoseconds = updateNanoseconds / repeatCount / objectCount;
+
+		float maxError = 0.0f;
+		for (int j = 0; j < objectCount; j++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				for (int r = 0; r < 4; r++)
+				{
+					maxError = std::max(maxError, fabsf(reference[j][c][r] - cache.GetModel(j)[c][r]));
+					maxError = std::max(maxError, fabsf(reference[j][c][r] - scalarModels[j][c][r]));
+				}
+			}
+		}
+
+		std::cout << "  objects:" << objectCount
+			<< ", five matrices:" << productNanoseconds
+			<< ", set transform:" << setNanoseconds
+			<< ", scalar:" << scalarNanoseconds
+			<< ", simd:" << simdNanoseconds
+			<< ", update all:" << updateNanoseconds
+			<< ", speedup:" << productNanoseconds / std::max(simdNanoseconds, 0.001)
+			<< ", max error:" << maxError
+			<< ((maxError > 1e-4f) ? ", RESULTS DIFFER" : "")
+			<< std::endl;
+	}
+}
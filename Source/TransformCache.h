@@ -0,0 +1,89 @@
+///////////////////////////////////////////////////////////////////////////////
+// TransformCache.h
+// ============
+// keep the model matrices of the scene objects and rebuild only moved ones
+//
+//  Each object stores its scale, rotation and position, with the rotation
+//  turned into a quaternion once when the transform is set, so no sines
+//  or cosines are taken while the matrices are built.  The values are
+//  kept as separate arrays of each component, and the matrices of four
+//  objects at a time are written straight from them with SSE
+//  instructions.  Only the groups of four holding an object whose
+//  transform changed since the last update are built again.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+/***********************************************************
+ *  TransformCache
+ *
+ *  This class contains the transforms and model matrices of
+ *  the scene objects and the code for updating the matrices
+ *  of the objects that changed.
+ ***********************************************************/
+class TransformCache
+{
+public:
+	// constructor
+	TransformCache();
+
+	// set the transform of an object, adding objects as needed -
+	// the rotations are applied about X, then Y, then Z in degrees
+	void SetTransform(
+		int objectIndex,
+		glm::vec3 scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		glm::vec3 positionXYZ);
+	// remove every object
+	void Clear();
+	int GetObjectCount() const { return(m_objectCount); }
+
+	// build the matrices of the changed objects and return how
+	// many objects changed
+	int Update();
+	// objects whose matrices the last update changed
+	const std::vector<int>& GetUpdatedObjects() const { return(m_updatedObjects); }
+	// model matrix of an object as of the last update
+	const glm::mat4& GetModel(int objectIndex) const { return(m_models[objectIndex]); }
+
+	// rotation about X, then Y, then Z as a unit quaternion, with
+	// the vector part in xyz and the scalar part in w
+	static glm::vec4 EulerToQuaternion(float XrotationDegrees, float YrotationDegrees, float ZrotationDegrees);
+	// translation * rotation * scale built in one pass
+	static glm::mat4 ComposeModel(glm::vec3 scaleXYZ, const glm::vec4& rotation, glm::vec3 positionXYZ);
+
+	// time the matrix building with many objects and print the
+	// results - no OpenGL context is needed
+	static void RunTransformBenchmark();
+
+private:
+	// transform components, padded to a multiple of four
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+	std::vector<float> m_rotationX;
+	std::vector<float> m_rotationY;
+	std::vector<float> m_rotationZ;
+	std::vector<float> m_rotationW;
+	std::vector<float> m_scaleX;
+	std::vector<float> m_scaleY;
+	std::vector<float> m_scaleZ;
+	int m_objectCount;
+	// built matrices, padded like the components
+	std::vector<glm::mat4> m_models;
+	// objects and groups of four changed since the last update
+	std::vector<unsigned char> m_objectDirty;
+	std::vector<unsigned char> m_blockDirty;
+	std::vector<int> m_dirtyObjects;
+	std::vector<int> m_dirtyBlocks;
+	std::vector<int> m_updatedObjects;
+
+	// build the matrices of four objects one at a time
+	void ComposeBlockScalar(int firstObject);
+	// build the matrices of four objects together
+	void ComposeBlockSIMD(int firstObject);
+};
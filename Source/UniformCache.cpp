@@ -0,0 +1,277 @@
+///////////////////////////////////////////////////////////////////////////////
+// UniformCache.cpp
+// ============
+// resolve shader uniform locations once and set values through handles
+//
+//  All active uniforms of the shader program are looked up by name a
+//  single time after the shaders are loaded.  Callers keep the typed
+//  handles and the per-frame code never looks up a uniform by name.
+//  The last value sent to every uniform is shadowed, so setting a
+//  uniform to the value it already has is dropped.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformCache.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/***********************************************************
+ *  UniformCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformCache::UniformCache()
+{
+	m_programID = 0;
+	m_issuedCalls = 0;
+	m_filteredCalls = 0;
+}
+
+/***********************************************************
+ *  ~UniformCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformCache::~UniformCache()
+{
+	m_locations.clear();
+}
+
+/***********************************************************
+ *  LoadProgramUniforms()
+ *
+ *  This method is used for querying every active uniform in
+ *  the shader program and storing its location by name.  It
+ *  is called once after the shaders are loaded.
+ ***********************************************************/
+bool UniformCache::LoadProgramUniforms(GLuint programID)
+{
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+
+	m_locations.clear();
+	m_shadowValues.clear();
+	m_programID = programID;
+
+	if (programID == 0)
+	{
+		std::cout << "Could not load uniforms, no shader program" << std::endl;
+		return(false);
+	}
+
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<GLchar> nameBuffer(maxNameLength + 1);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = 0;
+
+		glGetActiveUniform(
+			programID, (GLuint)i, (GLsizei)nameBuffer.size(),
+			&nameLength, &arraySize, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), nameLength);
+		GLint location = glGetUniformLocation(programID, name.c_str());
+		if (location < 0)
+		{
+			// uniforms inside uniform blocks have no location
+			continue;
+		}
+
+		m_locations[name] = location;
+
+		// arrays of basic types are reported as "name[0]", so
+		// also register them by the plain name and every element
+		if ((name.size() > 3) && (name.compare(name.size() - 3, 3, "[0]") == 0))
+		{
+			std::string baseName = name.substr(0, name.size() - 3);
+			m_locations[baseName] = location;
+			for (GLint element = 1; element < arraySize; element++)
+			{
+				std::string elementName = baseName + "[" + std::to_string(element) + "]";
+				m_locations[elementName] = glGetUniformLocation(programID, elementName.c_str());
+			}
+		}
+	}
+
+	// one shadow value for every location in use
+	GLint maxLocation = -1;
+	for (std::unordered_map<std::string, GLint>::const_iterator it = m_locations.begin(); it != m_locations.end(); ++it)
+	{
+		if (it->second > maxLocation)
+			maxLocation = it->second;
+	}
+	m_shadowValues.resize(maxLocation + 1);
+	InvalidateValues();
+
+	return(true);
+}
+
+/***********************************************************
+ *  InvalidateValues()
+ *
+ *  This method is used for forgetting all of the shadowed
+ *  uniform values, so the next update of each is sent.
+ ***********************************************************/
+void UniformCache::InvalidateValues()
+{
+	for (int i = 0; i < (int)m_shadowValues.size(); i++)
+	{
+		m_shadowValues[i].bValid = false;
+	}
+}
+
+/***********************************************************
+ *  ResetCounters()
+ *
+ *  This method is used for clearing the issued and filtered
+ *  update counters, usually once per frame.
+ ***********************************************************/
+void UniformCache::ResetCounters()
+{
+	m_issuedCalls = 0;
+	m_filteredCalls = 0;
+}
+
+/***********************************************************
+ *  IsRedundant()
+ *
+ *  This method is used for comparing a new uniform value
+ *  with the last value sent to the same location.  A new
+ *  value is stored as the shadow and counted as issued.
+ ***********************************************************/
+bool UniformCache::IsRedundant(GLint location, const void* value, size_t size)
+{
+	if (location >= (GLint)m_shadowValues.size())
+	{
+		m_issuedCalls++;
+		return(false);
+	}
+
+	UNIFORM_SHADOW& shadow = m_shadowValues[location];
+	if ((shadow.bValid == true) && (memcmp(shadow.data, value, size) == 0))
+	{
+		m_filteredCalls++;
+		return(true);
+	}
+
+	memcpy(shadow.data, value, size);
+	shadow.bValid = true;
+	m_issuedCalls++;
+
+	return(false);
+}
+
+/***********************************************************
+ *  FindLocation()
+ *
+ *  This method is used for looking up the cached location of
+ *  a uniform by name.  Names that are not active in the
+ *  program return an invalid location of -1.
+ ***********************************************************/
+GLint UniformCache::FindLocation(const std::string& name) const
+{
+	std::unordered_map<std::string, GLint>::const_iterator found = m_locations.find(name);
+	if (found == m_locations.end())
+	{
+		return(-1);
+	}
+
+	return(found->second);
+}
+
+/***********************************************************
+ *  BindUniformBlock()
+ *
+ *  This method is used for assigning a named uniform block
+ *  of the program to a uniform buffer binding point.
+ ***********************************************************/
+bool UniformCache::BindUniformBlock(const std::string& blockName, GLuint bindingPoint) const
+{
+	GLuint blockIndex = glGetUniformBlockIndex(m_programID, blockName.c_str());
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "Could not find uniform block:" << blockName << std::endl;
+		return(false);
+	}
+
+	glUniformBlockBinding(m_programID, blockIndex, bindingPoint);
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetValue()
+ *
+ *  These methods are used for setting the value of a uniform
+ *  in the currently used shader program.  Invalid handles
+ *  and values equal to the last value sent are ignored.
+ ***********************************************************/
+void UniformCache::SetValue(UniformHandle<bool> handle, bool value)
+{
+	if (handle.location < 0)
+		return;
+
+	GLint intValue = (GLint)value;
+	if (IsRedundant(handle.location, &intValue, sizeof(intValue)) == false)
+		glUniform1i(handle.location, intValue);
+}
+
+void UniformCache::SetValue(UniformHandle<int> handle, int value)
+{
+	if (handle.location < 0)
+		return;
+
+	if (IsRedundant(handle.location, &value, sizeof(value)) == false)
+		glUniform1i(handle.location, value);
+}
+
+void UniformCache::SetValue(UniformHandle<float> handle, float value)
+{
+	if (handle.location < 0)
+		return;
+
+	if (IsRedundant(handle.location, &value, sizeof(value)) == false)
+		glUniform1f(handle.location, value);
+}
+
+void UniformCache::SetValue(UniformHandle<glm::vec2> handle, const glm::vec2& value)
+{
+	if (handle.location < 0)
+		return;
+
+	if (IsRedundant(handle.location, glm::value_ptr(value), sizeof(GLfloat) * 2) == false)
+		glUniform2fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetValue(UniformHandle<glm::vec3> handle, const glm::vec3& value)
+{
+	if (handle.location < 0)
+		return;
+
+	if (IsRedundant(handle.location, glm::value_ptr(value), sizeof(GLfloat) * 3) == false)
+		glUniform3fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetValue(UniformHandle<glm::vec4> handle, const glm::vec4& value)
+{
+	if (handle.location < 0)
+		return;
+
+	if (IsRedundant(handle.location, glm::value_ptr(value), sizeof(GLfloat) * 4) == false)
+		glUniform4fv(handle.location, 1, glm::value_ptr(value));
+}
+
+void UniformCache::SetValue(UniformHandle<glm::mat4> handle, const glm::mat4& value)
+{
+	if (handle.location < 0)
+		return;
+
+	if (IsRedundant(handle.location, glm::value_ptr(value), sizeof(GLfloat) * 16) == false)
+		glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
+}
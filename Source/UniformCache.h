@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// UniformCache.h
+// ============
+// resolve shader uniform locations once and set values through handles
+//
+//  All active uniforms of the shader program are looked up by name a
+//  single time after the shaders are loaded.  Callers keep the typed
+//  handles and the per-frame code never looks up a uniform by name.
+//  The last value sent to every uniform is shadowed, so setting a
+//  uniform to the value it already has is dropped.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  UniformHandle
+ *
+ *  The cached location of a shader uniform.  The template
+ *  type is the value type of the uniform, so a handle can
+ *  only be set with a matching value.
+ ***********************************************************/
+template <typename T>
+struct UniformHandle
+{
+	GLint location;
+
+	UniformHandle() : location(-1) {}
+	bool IsValid() const { return(location >= 0); }
+};
+
+/***********************************************************
+ *  UniformCache
+ *
+ *  This class contains the table of active uniform locations
+ *  for a shader program and the methods for setting uniform
+ *  values through typed handles.
+ ***********************************************************/
+class UniformCache
+{
+public:
+	// constructor
+	UniformCache();
+	// destructor
+	~UniformCache();
+
+	// resolve the locations of all active uniforms in the program
+	bool LoadProgramUniforms(GLuint programID);
+
+	// get the handle of a uniform by name - call once at setup time
+	template <typename T>
+	UniformHandle<T> GetHandle(const std::string& name) const
+	{
+		UniformHandle<T> handle;
+		handle.location = FindLocation(name);
+		return(handle);
+	}
+
+	// set uniform values through previously resolved handles
+	void SetValue(UniformHandle<bool> handle, bool value);
+	void SetValue(UniformHandle<int> handle, int value);
+	void SetValue(UniformHandle<float> handle, float value);
+	void SetValue(UniformHandle<glm::vec2> handle, const glm::vec2& value);
+	void SetValue(UniformHandle<glm::vec3> handle, const glm::vec3& value);
+	void SetValue(UniformHandle<glm::vec4> handle, const glm::vec4& value);
+	void SetValue(UniformHandle<glm::mat4> handle, const glm::mat4& value);
+
+	// forget the shadowed values - called after uniforms of the
+	// program were set outside of the cache
+	void InvalidateValues();
+
+	// number of uniform updates sent to OpenGL and dropped
+	int GetIssuedCalls() const { return(m_issuedCalls); }
+	int GetFilteredCalls() const { return(m_filteredCalls); }
+	void ResetCounters();
+
+	// assign a uniform block of the program to a buffer binding point
+	bool BindUniformBlock(const std::string& blockName, GLuint bindingPoint) const;
+
+	// the program the uniform locations were resolved from
+	GLuint GetProgramID() const { return(m_programID); }
+
+private:
+	// program the locations belong to
+	GLuint m_programID;
+	// uniform locations keyed by uniform name
+	std::unordered_map<std::string, GLint> m_locations;
+
+	// last value sent to a uniform, large enough for a mat4
+	struct UNIFORM_SHADOW
+	{
+		bool bValid;
+		GLfloat data[16];
+	};
+	// shadowed values indexed by uniform location
+	std::vector<UNIFORM_SHADOW> m_shadowValues;
+
+	// uniform update counters
+	int m_issuedCalls;
+	int m_filteredCalls;
+
+	// look up the location of a uniform by name
+	GLint FindLocation(const std::string& name) const;
+	// check the value against the shadow of the location, and
+	// store it when it differs - true means the update is redundant
+	bool IsRedundant(GLint location, const void* value, size_t size);
+};
@@ -0,0 +1,435 @@
+///////////////////////////////////////////////////////////////////////////////
+// VertexPacker.cpp
+// ============
+// quantize interleaved float vertices into a compact 16 byte layout
+//
+//  The generated meshes are built with 32 bit floats - a position, a
+//  normal and a texture coordinate make 32 bytes per vertex.  Packed
+//  vertices keep the position as three signed normalized 16 bit values,
+//  the normal as an octahedral direction in two signed normalized 16 bit
+//  values and the texture coordinate as two half floats, which halves
+//  the vertex data read by every draw.  The vertex shader turns them
+//  back into floats.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "VertexPacker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// declaration of the vertex attribute locations used in the vertex shader
+namespace
+{
+	const GLuint g_PositionLocation = 0;
+	const GLuint g_NormalLocation = 1;
+	const GLuint g_TextureCoordinateLocation = 2;
+
+	const float g_SnormMax = 32767.0f;
+	const float g_PI = 3.14159265358979f;
+}
+
+const float VertexPacker::POSITION_RANGE = 1.0f;
+
+/***********************************************************
+ *  FloatToSnorm()
+ *
+ *  This method is used for rounding a value in [-1, 1] to a
+ *  signed normalized 16 bit value.
+ ***********************************************************/
+short VertexPacker::FloatToSnorm(float value)
+{
+	value = std::min(std::max(value, -1.0f), 1.0f);
+	return((short)lroundf(value * g_SnormMax));
+}
+
+/***********************************************************
+ *  SnormToFloat()
+ *
+ *  This method is used for turning a signed normalized 16
+ *  bit value back into a float, as the vertex shader does.
+ ***********************************************************/
+float VertexPacker::SnormToFloat(short value)
+{
+	return(std::max((float)value / g_SnormMax, -1.0f));
+}
+
+/***********************************************************
+ *  FloatToHalf()
+ *
+ *  This method is used for converting a float to a half
+ *  float, rounding to the nearest value with ties to even.
+ *  Values too small for a normal half become subnormal and
+ *  values too large become infinite.
+ ***********************************************************/
+unsigned short VertexPacker::FloatToHalf(float value)
+{
+	unsigned int bits = 0;
+	memcpy(&bits, &value, sizeof(bits));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	unsigned int floatExponent = (bits >> 23) & 0xFF;
+	unsigned int mantissa = bits & 0x7FFFFF;
+
+	// infinity and not a number keep their kind
+	if (floatExponent == 0xFF)
+	{
+		return((unsigned short)(sign | 0x7C00 | ((mantissa != 0) ? 0x200 : 0)));
+	}
+
+	int exponent = (int)floatExponent - 127 + 15;
+	if (exponent >= 31)
+	{
+		return((unsigned short)(sign | 0x7C00));
+	}
+
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return((unsigned short)sign);
+		}
+
+		// subnormal - shift the mantissa with its leading one
+		mantissa |= 0x800000;
+		unsigned int shift = (unsigned int)(14 - exponent);
+		unsigned int half = mantissa >> shift;
+		unsigned int rest = mantissa & ((1u << shift) - 1);
+		unsigned int halfway = 1u << (shift - 1);
+		if ((rest > halfway) || ((rest == halfway) && ((half & 1) != 0)))
+		{
+			half++;
+		}
+		return((unsigned short)(sign | half));
+	}
+
+	// a carry out of the mantissa correctly moves to the next
+	// exponent, or to infinity
+	unsigned int half = ((unsigned int)exponent << 10) | (mantissa >> 13);
+	unsigned int rest = mantissa & 0x1FFF;
+	if ((rest > 0x1000) || ((rest == 0x1000) && ((half & 1) != 0)))
+	{
+		half++;
+	}
+	return((unsigned short)(sign | half));
+}
+
+/***********************************************************
+ *  HalfToFloat()
+ *
+ *  This method is used for converting a half float back to
+ *  a float.  Every half float is exact as a float.
+ ***********************************************************/
+float VertexPacker::HalfToFloat(unsigned short value)
+{
+	unsigned int sign = ((unsigned int)value & 0x8000) << 16;
+	unsigned int exponent = ((unsigned int)value >> 10) & 0x1F;
+	unsigned int mantissa = (unsigned int)value & 0x3FF;
+
+	if (exponent == 0)
+	{
+		float magnitude = ldexpf((float)mantissa, -24);
+		return((sign != 0) ? -magnitude : magnitude);
+	}
+
+	unsigned int bits = 0;
+	if (exponent == 31)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float result = 0.0f;
+	memcpy(&result, &bits, sizeof(result));
+	return(result);
+}
+
+/***********************************************************
+ *  EncodeNormal()
+ *
+ *  This method is used for encoding a unit direction as a
+ *  point on the octahedron folded flat into a square.  Each
+ *  way of rounding the two values is decoded, and the one
+ *  closest to the direction is kept.
+ ***********************************************************/
+void VertexPacker::EncodeNormal(glm::vec3 normal, short* pEncoded)
+{
+	float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (length <= 0.0f)
+	{
+		pEncoded[0] = 0;
+		pEncoded[1] = 0;
+		return;
+	}
+
+	float x = normal.x / length;
+	float y = normal.y / length;
+	// the lower half folds over the diagonals
+	if (normal.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	glm::vec3 direction = glm::normalize(normal);
+	float scaledX = std::min(std::max(x, -1.0f), 1.0f) * g_SnormMax;
+	float scaledY = std::min(std::max(y, -1.0f), 1.0f) * g_SnormMax;
+	float bestDot = -2.0f;
+	for (int i = 0; i < 4; i++)
+	{
+		short candidate[2];
+		candidate[0] = (short)((i & 1) ? ceilf(scaledX) : floorf(scaledX));
+		candidate[1] = (short)((i & 2) ? ceilf(scaledY) : floorf(scaledY));
+
+		float dot = glm::dot(DecodeNormal(candidate), direction);
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			pEncoded[0] = candidate[0];
+			pEncoded[1] = candidate[1];
+		}
+	}
+}
+
+/***********************************************************
+ *  DecodeNormal()
+ *
+ *  This method is used for decoding an octahedral normal,
+ *  the same way the vertex shader does.
+ ***********************************************************/
+glm::vec3 VertexPacker::DecodeNormal(const short* pEncoded)
+{
+	glm::vec3 normal(SnormToFloat(pEncoded[0]), SnormToFloat(pEncoded[1]), 0.0f);
+	normal.z = 1.0f - fabsf(normal.x) - fabsf(normal.y);
+	if (normal.z < 0.0f)
+	{
+		float x = normal.x;
+		normal.x = (1.0f - fabsf(normal.y)) * ((x >= 0.0f) ? 1.0f : -1.0f);
+		normal.y = (1.0f - fabsf(x)) * ((normal.y >= 0.0f) ? 1.0f : -1.0f);
+	}
+
+	return(glm::normalize(normal));
+}
+
+/***********************************************************
+ *  PackMesh()
+ *
+ *  This method is used for packing the interleaved float
+ *  vertices of a mesh.  The indices are copied as they are.
+ *  A position outside of the position range can not be
+ *  packed, so the mesh is rejected.
+ ***********************************************************/
+bool VertexPacker::PackMesh(const MESH_DATA& mesh, PACKED_MESH_DATA& packed)
+{
+	int vertexCount = (int)(mesh.vertices.size() / MeshGenerator::FLOATS_PER_VERTEX);
+
+	packed.vertices.resize(vertexCount);
+	packed.indices = mesh.indices;
+
+	for (int i = 0; i < vertexCount; i++)
+	{
+		const float* pVertex = &mesh.vertices[i * MeshGenerator::FLOATS_PER_VERTEX];
+		PACKED_VERTEX& vertex = packed.vertices[i];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (fabsf(pVertex[axis]) > POSITION_RANGE)
+			{
+				packed.vertices.clear();
+				packed.indices.clear();
+				return(false);
+			}
+			vertex.position[axis] = FloatToSnorm(pVertex[axis] / POSITION_RANGE);
+		}
+		vertex.padding = 0;
+		EncodeNormal(glm::vec3(pVertex[3], pVertex[4], pVertex[5]), vertex.normal);
+		vertex.textureCoordinate[0] = FloatToHalf(pVertex[6]);
+		vertex.textureCoordinate[1] = FloatToHalf(pVertex[7]);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  UnpackVertex()
+ *
+ *  This method is used for turning a packed vertex back into
+ *  the eight interleaved floats it was packed from.
+ ***********************************************************/
+void VertexPacker::UnpackVertex(const PACKED_VERTEX& vertex, float* pFloats)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		pFloats[axis] = SnormToFloat(vertex.position[axis]) * POSITION_RANGE;
+	}
+
+	glm::vec3 normal = DecodeNormal(vertex.normal);
+	pFloats[3] = normal.x;
+	pFloats[4] = normal.y;
+	pFloats[5] = normal.z;
+	pFloats[6] = HalfToFloat(vertex.textureCoordinate[0]);
+	pFloats[7] = HalfToFloat(vertex.textureCoordinate[1]);
+}
+
+/***********************************************************
+ *  SetupVertexAttributes()
+ *
+ *  This method is used for pointing the vertex attributes of
+ *  the bound vertex array at a buffer of packed vertices.
+ *  The position and normal are read as plain integers and
+ *  scaled in the vertex shader, so the result does not
+ *  depend on how the driver maps signed normalized values.
+ *  The texture coordinate is read as half floats.
+ ***********************************************************/
+void VertexPacker::SetupVertexAttributes(GLuint vertexBuffer)
+{
+	const GLsizei vertexStride = sizeof(PACKED_VERTEX);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glEnableVertexAttribArray(g_PositionLocation);
+	glVertexAttribPointer(
+		g_PositionLocation, 3, GL_SHORT, GL_FALSE, vertexStride,
+		(void*)offsetof(PACKED_VERTEX, position));
+	glEnableVertexAttribArray(g_NormalLocation);
+	glVertexAttribPointer(
+		g_NormalLocation, 2, GL_SHORT, GL_FALSE, vertexStride,
+		(void*)offsetof(PACKED_VERTEX, normal));
+	glEnableVertexAttribArray(g_TextureCoordinateLocation);
+	glVertexAttribPointer(
+		g_TextureCoordinateLocation, 2, GL_HALF_FLOAT, GL_FALSE, vertexStride,
+		(void*)offsetof(PACKED_VERTEX, textureCoordinate));
+}
+
+/***********************************************************
+ *  RunVertexBenchmark()
+ *
+ *  This method is used for comparing the packed and float
+ *  layouts of a finely tessellated sphere and cylinder.  It
+ *  reports the bytes of each layout, the time to pack them,
+ *  and the rate of reading every vertex through the index
+ *  list as a draw would - the float layout reads its values
+ *  directly and the packed layout decodes them the way the
+ *  vertex shader does.  The unpacked vertices are compared
+ *  with the float reference for the position, normal angle
+ *  and texture coordinate errors.
+ ***********************************************************/
+void VertexPacker::RunVertexBenchmark()
+{
+	const int readRepeats = 20;
+
+	MESH_DATA meshes[2];
+	const char* meshNames[] = { "sphere 512x256", "cylinder 4096" };
+	MeshGenerator::BuildSphere(meshes[0], 512, 256);
+	MeshGenerator::BuildCylinder(meshes[1], 4096);
+
+	std::cout << "Vertex packing benchmark" << std::endl;
+
+	for (int m = 0; m < 2; m++)
+	{
+		const MESH_DATA& mesh = meshes[m];
+		int vertexCount = (int)(mesh.vertices.size() / MeshGenerator::FLOATS_PER_VERTEX);
+		int indexCount = (int)mesh.indices.size();
+
+		PACKED_MESH_DATA packed;
+		std::chrono::high_resolution_clock::time_point startTime = std::chrono::high_resolution_clock::now();
+		bool bPacked = PackMesh(mesh, packed);
+		double packMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count();
+		if (bPacked == false)
+		{
+			std::cout << "  " << meshNames[m] << " could not be packed" << std::endl;
+			continue;
+		}
+
+		// read the float vertices through the indices
+		float floatSum = 0.0f;
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < readRepeats; r++)
+		{
+			for (int i = 0; i < indexCount; i++)
+			{
+				const float* pVertex = &mesh.vertices[mesh.indices[i] * MeshGenerator::FLOATS_PER_VERTEX];
+				glm::vec3 position(pVertex[0], pVertex[1], pVertex[2]);
+				glm::vec3 normal(pVertex[3], pVertex[4], pVertex[5]);
+				floatSum += position.x + normal.y + pVertex[6] + pVertex[7];
+			}
+		}
+		double floatMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / readRepeats;
+
+		// read and decode the packed vertices through the indices
+		float packedSum = 0.0f;
+		startTime = std::chrono::high_resolution_clock::now();
+		for (int r = 0; r < readRepeats; r++)
+		{
+			for (int i = 0; i < indexCount; i++)
+			{
+				float unpacked[MeshGenerator::FLOATS_PER_VERTEX];
+				UnpackVertex(packed.vertices[packed.indices[i]], unpacked);
+				packedSum += unpacked[0] + unpacked[4] + unpacked[6] + unpacked[7];
+			}
+		}
+		double packedMilliseconds = std::chrono::duration<double, std::milli>(
+			std::chrono::high_resolution_clock::now() - startTime).count() / readRepeats;
+
+		// errors against the float reference
+		double positionErrorSum = 0.0;
+		float positionErrorMax = 0.0f;
+		float normalErrorMax = 0.0f;
+		float textureErrorMax = 0.0f;
+		for (int i = 0; i < vertexCount; i++)
+		{
+			const float* pVertex = &mesh.vertices[i * MeshGenerator::FLOATS_PER_VERTEX];
+			float unpacked[MeshGenerator::FLOATS_PER_VERTEX];
+			UnpackVertex(packed.vertices[i], unpacked);
+
+			float positionError = glm::length(
+				glm::vec3(unpacked[0], unpacked[1], unpacked[2]) - glm::vec3(pVertex[0], pVertex[1], pVertex[2]));
+			positionErrorSum += positionError;
+			positionErrorMax = std::max(positionErrorMax, positionError);
+
+			// the angle from its sine and cosine stays accurate when
+			// it is tiny, where acos of the cosine does not
+			glm::vec3 unpackedNormal(unpacked[3], unpacked[4], unpacked[5]);
+			glm::vec3 referenceNormal = glm::normalize(glm::vec3(pVertex[3], pVertex[4], pVertex[5]));
+			float angle = atan2f(
+				glm::length(glm::cross(unpackedNormal, referenceNormal)),
+				glm::dot(unpackedNormal, referenceNormal)) * 180.0f / g_PI;
+			normalErrorMax = std::max(normalErrorMax, angle);
+
+			textureErrorMax = std::max(textureErrorMax,
+				std::max(fabsf(unpacked[6] - pVertex[6]), fabsf(unpacked[7] - pVertex[7])));
+		}
+
+		double floatBytes = (double)mesh.vertices.size() * sizeof(float);
+		double packedBytes = (double)packed.vertices.size() * sizeof(PACKED_VERTEX);
+		// bytes of vertex data fetched through the index list
+		double floatFetched = (double)indexCount * MeshGenerator::FLOATS_PER_VERTEX * sizeof(float);
+		double packedFetched = (double)indexCount * sizeof(PACKED_VERTEX);
+
+		std::cout << "  " << meshNames[m]
+			<< ", vertices:" << vertexCount
+			<< ", indices:" << indexCount
+			<< ", pack ms:" << packMilliseconds << std::endl;
+		std::cout << "    bytes float:" << floatBytes
+			<< ", packed:" << packedBytes
+			<< ", ratio:" << (packedBytes / floatBytes) << std::endl;
+		std::cout << "    read ms float:" << floatMilliseconds
+			<< " (" << (floatFetched / (floatMilliseconds * 1.0e6)) << " GB/s)"
+			<< ", packed:" << packedMilliseconds
+			<< " (" << (packedFetched / (packedMilliseconds * 1.0e6)) << " GB/s)"
+			<< ", checksum difference:" << fabsf(floatSum - packedSum) / readRepeats << std::endl;
+		std::cout << "    position error mean:" << (positionErrorSum / vertexCount)
+			<< ", max:" << positionErrorMax
+			<< ", normal error max degrees:" << normalErrorMax
+			<< ", texture coordinate error max:" << textureErrorMax << std::endl;
+	}
+}
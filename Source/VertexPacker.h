@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// VertexPacker.h
+// ============
+// quantize interleaved float vertices into a compact 16 byte layout
+//
+//  The generated meshes are built with 32 bit floats - a position, a
+//  normal and a texture coordinate make 32 bytes per vertex.  Packed
+//  vertices keep the position as three signed normalized 16 bit values,
+//  the normal as an octahedral direction in two signed normalized 16 bit
+//  values and the texture coordinate as two half floats, which halves
+//  the vertex data read by every draw.  The vertex shader turns them
+//  back into floats.
+///////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "MeshGenerator.h"
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+/***********************************************************
+ *  PACKED_VERTEX
+ *
+ *  One quantized vertex as it is stored in a vertex buffer.
+ ***********************************************************/
+struct PACKED_VERTEX
+{
+	// position divided by the position range, as SNORM16
+	short position[3];
+	short padding;
+	// octahedral normal as SNORM16
+	short normal[2];
+	// texture coordinate as half floats
+	unsigned short textureCoordinate[2];
+};
+
+/***********************************************************
+ *  PACKED_MESH_DATA
+ *
+ *  Packed vertices and the triangle list indices of a mesh.
+ ***********************************************************/
+struct PACKED_MESH_DATA
+{
+	std::vector<PACKED_VERTEX> vertices;
+	std::vector<unsigned int> indices;
+};
+
+/***********************************************************
+ *  VertexPacker
+ *
+ *  This class contains the code for packing and unpacking
+ *  vertices and for setting up the packed vertex attributes.
+ ***********************************************************/
+class VertexPacker
+{
+public:
+	// largest coordinate a packed position can hold - the unit
+	// primitive meshes all fit inside it
+	static const float POSITION_RANGE;
+
+	// pack a float mesh, failing if a position is out of range
+	static bool PackMesh(const MESH_DATA& mesh, PACKED_MESH_DATA& packed);
+	// unpack a vertex into the interleaved float layout
+	static void UnpackVertex(const PACKED_VERTEX& vertex, float* pFloats);
+
+	// point the position, normal and texture coordinate attributes
+	// of the bound vertex array at a buffer of packed vertices
+	static void SetupVertexAttributes(GLuint vertexBuffer);
+
+	// convert between floats and half floats, rounding to nearest
+	static unsigned short FloatToHalf(float value);
+	static float HalfToFloat(unsigned short value);
+	// encode a unit direction on the octahedron, and decode it
+	static void EncodeNormal(glm::vec3 normal, short* pEncoded);
+	static glm::vec3 DecodeNormal(const short* pEncoded);
+
+	// time reading the packed meshes against the float meshes and
+	// print their errors - no OpenGL context is needed
+	static void RunVertexBenchmark();
+
+private:
+	// convert between [-1, 1] and signed normalized 16 bit values
+	static short FloatToSnorm(float value);
+	static float SnormToFloat(short value);
+};
@@ -21,8 +21,12 @@ namespace
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
+	// near and far clipping planes of both projection modes
+	const float NEAR_PLANE = 0.1f;
+	const float FAR_PLANE = 100.0f;
 	const char* g_ViewName = "view";
 	const char* g_ProjectionName = "projection";
+	const char* g_ViewPositionName = "viewPosition";
 
 	// Camera position and orientation vectors
 	glm::vec3 cameraPos = glm::vec3(0.0f, 3.0f, 12.0f);
@@ -50,6 +54,11 @@ namespace
 	bool orthographicProjection = false;
 	bool pKeyPressed = false;
 	bool oKeyPressed = false;
+
+	// left mouse button state, and whether a click is waiting
+	// to be turned into a picking ray
+	bool leftButtonPressed = false;
+	bool pickRequested = false;
 }
 
 /***********************************************************
@@ -61,6 +70,16 @@ ViewManager::ViewManager(ShaderManager* pShaderManager)
 {
 	m_pShaderManager = pShaderManager;
 	m_pWindow = NULL;
+	m_pUniformCache = NULL;
+
+	m_cameraView.view = glm::mat4(1.0f);
+	m_cameraView.projection = glm::mat4(1.0f);
+	m_cameraView.position = glm::vec3(0.0f);
+	m_cameraView.nearPlane = NEAR_PLANE;
+	m_cameraView.farPlane = FAR_PLANE;
+	m_cameraView.bOrthographic = false;
+	m_cameraView.viewportWidth = WINDOW_WIDTH;
+	m_cameraView.viewportHeight = WINDOW_HEIGHT;
 }
 
 /***********************************************************
@@ -72,6 +91,7 @@ ViewManager::~ViewManager()
 {
 	m_pShaderManager = NULL;
 	m_pWindow = NULL;
+	m_pUniformCache = NULL;
 }
 
 /***********************************************************
@@ -110,6 +130,25 @@ GLFWwindow* ViewManager::CreateDisplayWindow(const char* windowTitle)
 	return(window);
 }
 
+/***********************************************************
+ *  SetUniformCache()
+ *
+ *  This method is used for setting the uniform cache and
+ *  resolving the handles of the view uniforms.  It is called
+ *  once after the shaders are loaded.
+ ***********************************************************/
+void ViewManager::SetUniformCache(UniformCache* pUniformCache)
+{
+	m_pUniformCache = pUniformCache;
+
+	if (NULL != m_pUniformCache)
+	{
+		m_viewHandle = m_pUniformCache->GetHandle<glm::mat4>(g_ViewName);
+		m_projectionHandle = m_pUniformCache->GetHandle<glm::mat4>(g_ProjectionName);
+		m_viewPositionHandle = m_pUniformCache->GetHandle<glm::vec3>(g_ViewPositionName);
+	}
+}
+
 /***********************************************************
  *  Mouse_Position_Callback()
  *
@@ -238,6 +277,68 @@ void ViewManager::ProcessKeyboardEvents()
 	{
 		oKeyPressed = false;
 	}
+
+	// left mouse button picks the object under the cursor
+	if (glfwGetMouseButton(m_pWindow, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+	{
+		if (!leftButtonPressed)
+		{
+			pickRequested = true;
+			leftButtonPressed = true;
+		}
+	}
+	else
+	{
+		leftButtonPressed = false;
+	}
+}
+
+/***********************************************************
+ *  SetCameraPose()
+ *
+ *  This method is used for placing the camera at the passed
+ *  in position, looking along the passed in direction.  It
+ *  is used to play back scripted camera paths.
+ ***********************************************************/
+void ViewManager::SetCameraPose(glm::vec3 position, glm::vec3 front)
+{
+	cameraPos = position;
+	cameraFront = glm::normalize(front);
+}
+
+/***********************************************************
+ *  GetPickRay()
+ *
+ *  This method is used for getting the world space ray under
+ *  the mouse cursor when the left button was clicked since
+ *  the last call.  The cursor position is moved back through
+ *  the inverse projection and view of the last prepared view
+ *  onto the near and far planes, which works for both the
+ *  perspective and orthographic projections.
+ ***********************************************************/
+bool ViewManager::GetPickRay(glm::vec3& origin, glm::vec3& direction)
+{
+	if (pickRequested == false)
+	{
+		return(false);
+	}
+	pickRequested = false;
+
+	float ndcX = 2.0f * lastX / (float)m_cameraView.viewportWidth - 1.0f;
+	float ndcY = 1.0f - 2.0f * lastY / (float)m_cameraView.viewportHeight;
+	glm::mat4 inverseViewProjection = glm::inverse(m_cameraView.projection * m_cameraView.view);
+
+	glm::vec4 nearPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+	if ((nearPoint.w == 0.0f) || (farPoint.w == 0.0f))
+	{
+		return(false);
+	}
+
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+	return(true);
 }
 
 /***********************************************************
@@ -274,21 +375,31 @@ void ViewManager::PrepareSceneView()
 			orthoSize * aspectRatio / 2.0f,
 			-orthoSize / 2.0f,
 			orthoSize / 2.0f,
-			0.1f,
-			100.0f
+			NEAR_PLANE,
+			FAR_PLANE
 		);
 	}
 	else
 	{
 		// Perspective projection for 3D view
-		projection = glm::perspective(glm::radians(fov), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, 0.1f, 100.0f);
+		projection = glm::perspective(glm::radians(fov), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, NEAR_PLANE, FAR_PLANE);
 	}
 
+	// keep the camera data for the view dependent scene work
+	m_cameraView.view = view;
+	m_cameraView.projection = projection;
+	m_cameraView.position = cameraPos;
+	m_cameraView.nearPlane = NEAR_PLANE;
+	m_cameraView.farPlane = FAR_PLANE;
+	m_cameraView.bOrthographic = orthographicProjection;
+	m_cameraView.viewportWidth = WINDOW_WIDTH;
+	m_cameraView.viewportHeight = WINDOW_HEIGHT;
+
 	// Send matrices to shader
-	if (NULL != m_pShaderManager)
+	if (NULL != m_pUniformCache)
 	{
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		m_pShaderManager->setVec3Value("viewPosition", cameraPos);
+		m_pUniformCache->SetValue(m_viewHandle, view);
+		m_pUniformCache->SetValue(m_projectionHandle, projection);
+		m_pUniformCache->SetValue(m_viewPositionHandle, cameraPos);
 	}
 }
\ No newline at end of file
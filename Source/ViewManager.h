@@ -10,6 +10,8 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "UniformCache.h"
+#include "CameraView.h"
 // Note: Removed camera.h include since we're using pure LearnOpenGL approach
 
 // GLFW library
@@ -43,6 +45,14 @@ private:
 	ShaderManager* m_pShaderManager;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
+	// pointer to the cached shader uniform locations
+	UniformCache* m_pUniformCache;
+	// cached handles of the view uniforms
+	UniformHandle<glm::mat4> m_viewHandle;
+	UniformHandle<glm::mat4> m_projectionHandle;
+	UniformHandle<glm::vec3> m_viewPositionHandle;
+	// camera data of the most recently prepared view
+	CAMERA_VIEW m_cameraView;
 
 	// process keyboard events for interaction with the 3D scene
 	// handles WASDQE movement and P/O projection switching
@@ -52,7 +62,20 @@ public:
 	// create the initial OpenGL display window
 	GLFWwindow* CreateDisplayWindow(const char* windowTitle);
 
+	// set the uniform cache used to send the view to the shader
+	void SetUniformCache(UniformCache* pUniformCache);
+
 	// prepare the conversion from 3D object display to 2D scene display
 	// handles both perspective and orthographic projection modes
 	void PrepareSceneView();
+
+	// get the camera data of the most recently prepared view
+	const CAMERA_VIEW& GetCameraView() const { return(m_cameraView); }
+
+	// place the camera for scripted playback instead of user input
+	void SetCameraPose(glm::vec3 position, glm::vec3 front);
+
+	// get the world space ray under the mouse cursor if the left
+	// button was clicked since the last call
+	bool GetPickRay(glm::vec3& origin, glm::vec3& direction);
 };
\ No newline at end of file
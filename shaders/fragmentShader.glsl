@@ -4,6 +4,11 @@ out vec4 fragmentColor;
 in vec3 fragmentPosition;
 in vec3 fragmentVertexNormal;
 in vec2 fragmentTextureCoordinate;
+in vec2 fragmentUVScale;
+flat in int fragmentMaterialIndex;
+flat in vec4 fragmentTextureRect;
+flat in float fragmentTextureLayer;
+in float fragmentViewDepth;
 
 struct Material {
     vec3 diffuseColor;
@@ -11,6 +16,13 @@ struct Material {
     float shininess;
 }; 
 
+// std140 layout of one material in the material uniform buffer
+struct MaterialData {
+    vec4 ambient;           // rgb = ambient color, a = ambient strength
+    vec4 diffuse;           // rgb = diffuse color
+    vec4 specular;          // rgb = specular color, a = shininess
+};
+
 struct DirectionalLight {
     vec3 direction;
 	
@@ -21,14 +33,13 @@ struct DirectionalLight {
     bool bActive;
 };
 
+// one point light, read from four texels of the light texture buffer
 struct PointLight {
-    vec3 position;
+    vec4 position;          // xyz = position, w = range or zero for no limit
     
-    vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    bool bActive;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
 };
 
 struct SpotLight {
@@ -48,26 +59,54 @@ struct SpotLight {
     bool bActive;
 };
 
-#define TOTAL_POINT_LIGHTS 5
+#define MAX_MATERIALS 32
+
+// all of the scene materials, selected by the material index of each draw
+layout(std140) uniform MaterialBlock
+{
+    MaterialData materials[MAX_MATERIALS];
+};
+
+// the light count and the layout of the light clusters
+layout(std140) uniform LightBlock
+{
+    ivec4 clusterGrid;      // xyz = clusters per axis, w = clusters in use
+    vec4 clusterDepth;      // near, far, depth slice scale and bias
+    vec4 clusterTileSize;   // xy = size of a cluster tile in pixels
+    int pointLightCount;
+};
+
+// the packed point lights, and the offset and count of the light
+// index list of every cluster
+uniform samplerBuffer pointLightData;
+uniform usamplerBuffer clusterData;
+uniform usamplerBuffer clusterLightIndices;
 
 uniform bool bUseTexture=false;
 uniform bool bUseLighting=false;
 uniform vec4 objectColor = vec4(1.0f);
 uniform vec3 viewPosition;
 uniform DirectionalLight directionalLight;
-uniform PointLight pointLights[TOTAL_POINT_LIGHTS];
 uniform SpotLight spotLight;
-uniform Material material;
-uniform sampler2D objectTexture;
-uniform vec2 UVscale = vec2(1.0f, 1.0f);
+Material material;
+// texture array holding the object texture, selected by its layer
+uniform sampler2DArray objectTexture;
 
 // function prototypes
 vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+PointLight FetchPointLight(int index);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec4 SampleObjectTexture(vec2 uv);
 
 void main()
 {    
+    // look up the material of this draw in the material buffer
+    int materialSlot = clamp(fragmentMaterialIndex, 0, MAX_MATERIALS - 1);
+    material.diffuseColor = materials[materialSlot].diffuse.rgb;
+    material.specularColor = materials[materialSlot].specular.rgb;
+    material.shininess = materials[materialSlot].specular.a;
+
     if(bUseLighting == true)
     {
         vec3 phongResult = vec3(0.0f);
@@ -86,14 +125,27 @@ void main()
         {
             phongResult += CalcDirectionalLight(directionalLight, norm, viewDir);
         }
-        // phase 2: point lights
-        for(int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+        // phase 2: point lights - only the lights of this fragment's cluster
+        if(clusterGrid.w != 0)
         {
-	    if(pointLights[i].bActive == true)
+            ivec3 cluster;
+            cluster.xy = clamp(ivec2(gl_FragCoord.xy / clusterTileSize.xy), ivec2(0), clusterGrid.xy - 1);
+            cluster.z = clamp(int(floor(log(fragmentViewDepth) * clusterDepth.z + clusterDepth.w)), 0, clusterGrid.z - 1);
+            int clusterIndex = (cluster.z * clusterGrid.y + cluster.y) * clusterGrid.x + cluster.x;
+            uvec2 lightList = texelFetch(clusterData, clusterIndex).xy;
+            for(uint i = 0u; i < lightList.y; i++)
             {
-                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir);   
+                int lightIndex = int(texelFetch(clusterLightIndices, int(lightList.x + i)).r);
+                phongResult += CalcPointLight(FetchPointLight(lightIndex), norm, fragmentPosition, viewDir);
             }
-        } 
+        }
+        else
+        {
+            for(int i = 0; i < pointLightCount; i++)
+            {
+                phongResult += CalcPointLight(FetchPointLight(i), norm, fragmentPosition, viewDir);   
+            } 
+        }
         // phase 3: spot light
         if(spotLight.bActive == true)
         {
@@ -102,7 +154,7 @@ void main()
     
         if(bUseTexture == true)
         {
-            fragmentColor = vec4(phongResult, (texture(objectTexture, fragmentTextureCoordinate)).a);
+            fragmentColor = vec4(phongResult, (SampleObjectTexture(fragmentTextureCoordinate)).a);
         }
         else
         {
@@ -113,7 +165,7 @@ void main()
     {
         if(bUseTexture == true)
         {
-            fragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
+            fragmentColor = SampleObjectTexture(fragmentTextureCoordinate * fragmentUVScale);
         }
         else
         {
@@ -138,9 +190,9 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
     // combine results
     if(bUseTexture == true)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        ambient = light.ambient * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        diffuse = light.diffuse * diff * material.diffuseColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        specular = light.specular * spec * material.specularColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
     }
     else
     {
@@ -152,6 +204,17 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
     return (ambient + diffuse + specular);
 }
 
+// reads a point light from the light texture buffer.
+PointLight FetchPointLight(int index)
+{
+    PointLight light;
+    light.position = texelFetch(pointLightData, index * 4 + 0);
+    light.ambient = texelFetch(pointLightData, index * 4 + 1);
+    light.diffuse = texelFetch(pointLightData, index * 4 + 2);
+    light.specular = texelFetch(pointLightData, index * 4 + 3);
+    return light;
+}
+
 // calculates the color when using a point light.
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
 {
@@ -159,7 +222,7 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     vec3 diffuse = vec3(0.0f);
     vec3 specular= vec3(0.0f);
 
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
@@ -170,15 +233,26 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     if(bUseTexture == true)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * specularComponent * material.specularColor;
+        ambient = light.ambient.rgb * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        diffuse = light.diffuse.rgb * diff * material.diffuseColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        specular = light.specular.rgb * specularComponent * material.specularColor;
     }
     else
     {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * specularComponent * material.specularColor;
+        ambient = light.ambient.rgb * vec3(objectColor);
+        diffuse = light.diffuse.rgb * diff * material.diffuseColor * vec3(objectColor);
+        specular = light.specular.rgb * specularComponent * material.specularColor;
+    }
+
+    // lights with a range fade out smoothly to zero at that range
+    if(light.position.w > 0.0)
+    {
+        float distanceRatio = length(light.position.xyz - fragPos) / light.position.w;
+        float window = clamp(1.0 - pow(distanceRatio, 4.0), 0.0, 1.0);
+        float attenuation = window * window;
+        ambient *= attenuation;
+        diffuse *= attenuation;
+        specular *= attenuation;
     }
     
     return (ambient + diffuse + specular);
@@ -207,9 +281,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     // combine results
     if(bUseTexture == true)
     {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
+        ambient = light.ambient * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        diffuse = light.diffuse * diff * material.diffuseColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
+        specular = light.specular * spec * material.specularColor * vec3(SampleObjectTexture(fragmentTextureCoordinate));
     }
     else
     {
@@ -223,3 +297,16 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     specular *= attenuation * intensity;
     return (ambient + diffuse + specular);
 }
+
+// sample the object texture from its array layer - atlas entries only
+// cover part of the layer, so their repeat is done here
+vec4 SampleObjectTexture(vec2 uv)
+{
+    if((fragmentTextureRect.z < 1.0f) || (fragmentTextureRect.w < 1.0f))
+    {
+        vec2 atlasUV = fragmentTextureRect.xy + fract(uv) * fragmentTextureRect.zw;
+        return textureGrad(objectTexture, vec3(atlasUV, fragmentTextureLayer),
+            dFdx(uv) * fragmentTextureRect.zw, dFdy(uv) * fragmentTextureRect.zw);
+    }
+    return texture(objectTexture, vec3(uv, fragmentTextureLayer));
+}
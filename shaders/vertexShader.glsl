@@ -1,20 +1,83 @@
 #version 330 core
+// packed vertices hold the position as SNORM16 integers and the normal
+// as an octahedral SNORM16 pair, which are scaled and decoded below
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
+// per-instance attributes, only read when bUseInstancing is set
+layout (location = 3) in mat4 inInstanceModel;
+layout (location = 7) in vec2 inInstanceUVScale;
+layout (location = 8) in int inInstanceMaterial;
+layout (location = 9) in vec4 inInstanceTextureRect;
+layout (location = 10) in float inInstanceTextureLayer;
 
 out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
+out vec2 fragmentUVScale;
+flat out int fragmentMaterialIndex;
+// layer of the texture array and the part of the layer the texture covers
+flat out vec4 fragmentTextureRect;
+flat out float fragmentTextureLayer;
+// view space depth, used to find the light cluster of the fragment
+out float fragmentViewDepth;
+// the depth prepass compiles this same shader, so the depths match
+invariant gl_Position;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec2 UVscale = vec2(1.0f, 1.0f);
+uniform bool bUseInstancing = false;
+uniform int materialIndex = 0;
+uniform vec4 textureRect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+uniform float textureLayer = 0.0f;
+uniform bool bPackedVertices = false;
+
+const float SNORM16_SCALE = 1.0f / 32767.0f;
+
+vec3 DecodeOctahedralNormal(vec2 encoded)
+{
+   vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+   if(normal.z < 0.0f)
+   {
+      normal.xy = (1.0f - abs(normal.yx)) * vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+   }
+   return normalize(normal);
+}
 
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
-   fragmentVertexNormal = inVertexNormal;
+   mat4 objectModel = model;
+   vec2 objectUVScale = UVscale;
+   int objectMaterial = materialIndex;
+   vec4 objectTextureRect = textureRect;
+   float objectTextureLayer = textureLayer;
+   if(bUseInstancing == true)
+   {
+      objectModel = inInstanceModel;
+      objectUVScale = inInstanceUVScale;
+      objectMaterial = inInstanceMaterial;
+      objectTextureRect = inInstanceTextureRect;
+      objectTextureLayer = inInstanceTextureLayer;
+   }
+
+   vec3 vertexPosition = inVertexPosition;
+   vec3 vertexNormal = inVertexNormal;
+   if(bPackedVertices == true)
+   {
+      vertexPosition = max(inVertexPosition * SNORM16_SCALE, -1.0f);
+      vertexNormal = DecodeOctahedralNormal(max(inVertexNormal.xy * SNORM16_SCALE, -1.0f));
+   }
+
+   fragmentPosition = vec3(objectModel * vec4(vertexPosition, 1.0));
+   vec4 viewPosition = view * objectModel * vec4(vertexPosition, 1.0f);
+   gl_Position = projection * viewPosition;
+   fragmentViewDepth = -viewPosition.z;
+   fragmentVertexNormal = vertexNormal;
    fragmentTextureCoordinate = inTextureCoordinate;
-}
\ No newline at end of file
+   fragmentUVScale = objectUVScale;
+   fragmentMaterialIndex = objectMaterial;
+   fragmentTextureRect = objectTextureRect;
+   fragmentTextureLayer = objectTextureLayer;
+}